@@ -0,0 +1,261 @@
+const path = require('path');
+const fs = require('fs');
+const zlib = require('zlib');
+
+// 用法: node build_backdrop.js <rain|snow|clouds|帧目录> [输出 .bin] [帧间隔 ms]
+// 把一段循环动画编码成关键帧加每帧变化的图块, 烧录到 "backdrop" 分区由 app_backdrop.c 播放.
+// 帧目录里是按文件名排序的 800x480 RGB565 小端原始帧, 最后一帧之后回到第一帧
+const source = process.argv[2];
+const outputPath = process.argv[3] || path.join(__dirname, '/assets/backdrop.bin');
+const frameMs = parseInt(process.argv[4] || '100', 10);
+
+if (!source) {
+    console.error('用法: node build_backdrop.js <rain|snow|clouds|帧目录> [输出 .bin] [帧间隔 ms]');
+    process.exit(1);
+}
+
+// 与 app_backdrop.c 中的 backdrop_header_t 保持一致
+const MAGIC = 0x44425753;       // "SWBD"
+const VERSION = 1;
+const HEADER_SIZE = 28;
+const WIDTH = 800;
+const HEIGHT = 480;
+const TILE = 32;
+const FRAMES = 48;
+const RLE_RUN = 0x8000;         // 一个像素重复 n 次, 否则是 n 个原样像素, 与 app_boot.c 相同
+const RLE_MAX = 0x7fff;
+const PARTITION_SIZE = 768 * 1024;
+
+const TILES_X = Math.ceil(WIDTH / TILE);
+const TILES_Y = Math.ceil(HEIGHT / TILE);
+
+function rgb565(r, g, b) {
+    return ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3);
+}
+
+// 固定种子, 每次生成同样的动画
+function random(seed) {
+    let s = seed >>> 0;
+    return () => {
+        s = (Math.imul(s, 1664525) + 1013904223) >>> 0;
+        return s / 0x100000000;
+    };
+}
+
+// 上深下浅的天空, 每行一种颜色, 压缩后每行只有一个游程
+function sky(top, bottom) {
+    const frame = new Uint16Array(WIDTH * HEIGHT);
+    for (let y = 0; y < HEIGHT; y++) {
+        const t = y / (HEIGHT - 1);
+        const c = rgb565(...top.map((v, i) => Math.round(v + (bottom[i] - v) * t)));
+        frame.fill(c, y * WIDTH, (y + 1) * WIDTH);
+    }
+    return frame;
+}
+
+function blend(frame, x, y, color, alpha) {
+    if (x < 0 || y < 0 || x >= WIDTH || y >= HEIGHT) {
+        return;
+    }
+    const p = frame[y * WIDTH + x];
+    const r = ((p >> 11) & 0x1f) << 3;
+    const g = ((p >> 5) & 0x3f) << 2;
+    const b = (p & 0x1f) << 3;
+    frame[y * WIDTH + x] = rgb565(Math.round(r + (color[0] - r) * alpha), Math.round(g + (color[1] - g) * alpha),
+                                  Math.round(b + (color[2] - b) * alpha));
+}
+
+// 每种动画的速度都让它在 FRAMES 帧后回到原位, 循环没有跳变
+function generate(kind) {
+    const rnd = random(0x5757);
+    const frames = [];
+    if (kind === 'rain') {
+        const drops = Array.from({ length: 50 }, () => ({ x: Math.floor(rnd() * WIDTH), y: rnd() * HEIGHT, len: 8 + Math.floor(rnd() * 8) }));
+        const speed = HEIGHT * 2 / FRAMES;
+        for (let f = 0; f < FRAMES; f++) {
+            const frame = sky([70, 84, 104], [132, 146, 160]);
+            for (const d of drops) {
+                const y0 = Math.floor((d.y + f * speed) % HEIGHT);
+                for (let k = 0; k < d.len; k++) {
+                    blend(frame, d.x, (y0 + k) % HEIGHT, [210, 220, 235], 0.25 + 0.5 * k / d.len);
+                }
+            }
+            frames.push(frame);
+        }
+    } else if (kind === 'snow') {
+        const flakes = Array.from({ length: 60 }, () => ({ x: rnd() * WIDTH, y: rnd() * HEIGHT, r: 1 + Math.floor(rnd() * 2), phase: rnd() * Math.PI * 2 }));
+        const speed = HEIGHT / FRAMES;
+        for (let f = 0; f < FRAMES; f++) {
+            const frame = sky([120, 134, 150], [196, 204, 214]);
+            for (const s of flakes) {
+                const cx = Math.round(s.x + 4 * Math.sin(s.phase + f * Math.PI * 4 / FRAMES));
+                const cy = Math.round((s.y + f * speed) % HEIGHT);
+                for (let dy = -s.r; dy <= s.r; dy++) {
+                    for (let dx = -s.r; dx <= s.r; dx++) {
+                        if (dx * dx + dy * dy <= s.r * s.r) {
+                            blend(frame, cx + dx, cy + dy, [255, 255, 255], 0.85);
+                        }
+                    }
+                }
+            }
+            frames.push(frame);
+        }
+    } else if (kind === 'clouds') {
+        // 只在上方三分之一飘动, 云是实心的椭圆, 每行的云只有一个游程
+        const clouds = Array.from({ length: 4 }, (_, i) => ({ x: i * WIDTH / 4 + rnd() * 80, y: 40 + rnd() * 90, w: 90 + rnd() * 60 }));
+        const speed = WIDTH / FRAMES / 4;
+        for (let f = 0; f < FRAMES; f++) {
+            const frame = sky([64, 128, 200], [170, 206, 236]);
+            for (const c of clouds) {
+                const cx = (c.x + f * speed) % WIDTH;
+                for (let y = Math.floor(c.y - c.w / 3); y < c.y + c.w / 3; y++) {
+                    for (let x = Math.floor(cx - c.w); x < cx + c.w; x++) {
+                        const d = ((x - cx) / c.w) ** 2 + ((y - c.y) / (c.w / 3)) ** 2;
+                        if (d < 1) {
+                            blend(frame, ((x % WIDTH) + WIDTH) % WIDTH, y, [245, 248, 252], 0.8);
+                        }
+                    }
+                }
+            }
+            frames.push(frame);
+        }
+    } else {
+        return null;
+    }
+    return frames;
+}
+
+function readFrames(dir) {
+    const files = fs.readdirSync(dir).filter(f => f.endsWith('.rgb565')).sort();
+    if (files.length < 2) {
+        throw new Error(`${dir} 里至少要有 2 个 .rgb565 帧`);
+    }
+    return files.map(f => {
+        const buf = fs.readFileSync(path.join(dir, f));
+        if (buf.length !== WIDTH * HEIGHT * 2) {
+            throw new Error(`${f} 不是 ${WIDTH}x${HEIGHT} RGB565`);
+        }
+        return new Uint16Array(buf.buffer.slice(buf.byteOffset, buf.byteOffset + buf.length));
+    });
+}
+
+// 3 个及以上相同像素编码成 (RLE_RUN | n, 像素), 其余编码成 (n, 像素...)
+function rleEncode(px) {
+    const out = [];
+    let i = 0;
+    while (i < px.length) {
+        let run = 1;
+        while (i + run < px.length && run < RLE_MAX && px[i + run] === px[i]) {
+            run++;
+        }
+        if (run >= 3) {
+            out.push(RLE_RUN | run, px[i]);
+            i += run;
+            continue;
+        }
+        let lit = 0;
+        while (i + lit < px.length && lit < RLE_MAX &&
+               !(i + lit + 2 < px.length && px[i + lit] === px[i + lit + 1] && px[i + lit] === px[i + lit + 2])) {
+            lit++;
+        }
+        out.push(lit);
+        for (let k = 0; k < lit; k++) {
+            out.push(px[i + k]);
+        }
+        i += lit;
+    }
+    return out;
+}
+
+function tilePixels(frame, tx, ty) {
+    const x0 = tx * TILE;
+    const y0 = ty * TILE;
+    const w = Math.min(TILE, WIDTH - x0);
+    const h = Math.min(TILE, HEIGHT - y0);
+    const px = new Uint16Array(w * h);
+    for (let y = 0; y < h; y++) {
+        px.set(frame.subarray((y0 + y) * WIDTH + x0, (y0 + y) * WIDTH + x0 + w), y * w);
+    }
+    return px;
+}
+
+function tileChanged(a, b, tx, ty) {
+    const x0 = tx * TILE;
+    const x1 = Math.min(x0 + TILE, WIDTH);
+    for (let y = ty * TILE; y < Math.min((ty + 1) * TILE, HEIGHT); y++) {
+        for (let x = x0; x < x1; x++) {
+            if (a[y * WIDTH + x] !== b[y * WIDTH + x]) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+function build() {
+    const frames = generate(source) || readFrames(source);
+    const words = rleEncode(frames[0]);
+    const keyLen = words.length;
+    let changed = 0;
+    let maxChanged = 0;
+
+    // 第 i 段把第 i 帧变成第 i + 1 帧, 最后一段回到第一帧: [图块数, (图块编号, 长度, RLE 像素...)...]
+    for (let f = 0; f < frames.length; f++) {
+        const prev = frames[f];
+        const next = frames[(f + 1) % frames.length];
+        const body = [];
+        let tiles = 0;
+        for (let ty = 0; ty < TILES_Y; ty++) {
+            for (let tx = 0; tx < TILES_X; tx++) {
+                if (tileChanged(prev, next, tx, ty)) {
+                    const rle = rleEncode(tilePixels(next, tx, ty));
+                    body.push(ty * TILES_X + tx, rle.length);
+                    rle.forEach(w => body.push(w));
+                    tiles++;
+                }
+            }
+        }
+        changed += tiles;
+        maxChanged = Math.max(maxChanged, tiles);
+        words.push(tiles);
+        body.forEach(w => words.push(w));
+    }
+
+    const data = Buffer.alloc(words.length * 2);
+    words.forEach((w, i) => data.writeUInt16LE(w, i * 2));
+    const header = Buffer.alloc(HEADER_SIZE);
+    header.writeUInt32LE(MAGIC, 0);
+    header.writeUInt16LE(VERSION, 4);
+    header.writeUInt16LE(TILE, 6);
+    header.writeUInt16LE(WIDTH, 8);
+    header.writeUInt16LE(HEIGHT, 10);
+    header.writeUInt16LE(frames.length, 12);
+    header.writeUInt16LE(frameMs, 14);
+    header.writeUInt32LE(keyLen, 16);
+    header.writeUInt32LE(data.length, 20);
+    // 与设备端 esp_crc32_le(0, ...) 相同
+    header.writeUInt32LE(zlib.crc32(data), 24);
+
+    const total = HEADER_SIZE + data.length;
+    if (total > PARTITION_SIZE) {
+        throw new Error(`动画 ${total} 字节, 超过 backdrop 分区的 ${PARTITION_SIZE} 字节`);
+    }
+    fs.mkdirSync(path.dirname(outputPath), { recursive: true });
+    fs.writeFileSync(outputPath, Buffer.concat([header, data]));
+
+    const frameBytes = WIDTH * HEIGHT * 2;
+    const tileBytes = TILE * TILE * 2;
+    const avgTiles = changed / frames.length;
+    console.log(`${frames.length} 帧, 每帧 ${frameMs} ms, 图块 ${TILE}x${TILE}, 共 ${TILES_X * TILES_Y} 块`);
+    console.log(`每帧平均变化 ${avgTiles.toFixed(1)} 块, 最多 ${maxChanged} 块, ` +
+                `约写 ${Math.round(avgTiles * tileBytes)} 字节 PSRAM, 整帧是 ${frameBytes} 字节`);
+    console.log(`关键帧 ${keyLen * 2} 字节, 动画共 ${total} 字节, 不压缩的整帧序列 ${frameBytes * frames.length} 字节`);
+    console.log(`已写入 ${outputPath}`);
+}
+
+try {
+    build();
+} catch (error) {
+    console.error('动画编码失败', error);
+    process.exit(1);
+}
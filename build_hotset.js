@@ -0,0 +1,161 @@
+const path = require('path');
+const fs = require('fs');
+
+// 用法: node build_hotset.js <monitor 日志> <profile 构建的 .map> [IRAM 预算字节] [DRAM 预算字节]
+// 日志来自 CONFIG_APP_HOTSET_PROFILE=y 的固件, map 文件必须是同一次构建生成的
+const logPath = process.argv[2];
+const mapPath = process.argv[3];
+const iramBudget = parseInt(process.argv[4] || '16384', 10);
+const dramBudget = parseInt(process.argv[5] || '32768', 10);
+const outputPath = path.join(__dirname, '/main/hotset.lf');
+
+if (!logPath || !mapPath) {
+    console.error('用法: node build_hotset.js <monitor 日志> <map 文件> [IRAM 预算] [DRAM 预算]');
+    process.exit(1);
+}
+
+// 读取 "hotset: begin" 和 "hotset: end" 之间最后一段数据
+function parseLog(text) {
+    const fns = new Map();
+    const fonts = new Map();
+    let inDump = false;
+    for (const line of text.split(/\r?\n/)) {
+        if (line.includes('hotset: begin')) {
+            fns.clear();
+            fonts.clear();
+            inDump = true;
+            continue;
+        }
+        if (line.includes('hotset: end')) {
+            inDump = false;
+            continue;
+        }
+        if (!inDump) {
+            continue;
+        }
+        let m = line.match(/hotset: fn (0x[0-9a-fA-F]+) (\d+)/);
+        if (m) {
+            fns.set(parseInt(m[1], 16), parseInt(m[2], 10));
+            continue;
+        }
+        m = line.match(/hotset: glyph (0x[0-9a-fA-F]+) U\+([0-9A-F]+) (\d+)/);
+        if (m) {
+            const font = parseInt(m[1], 16);
+            const glyphs = fonts.get(font) || new Map();
+            glyphs.set(parseInt(m[2], 16), parseInt(m[3], 10));
+            fonts.set(font, glyphs);
+        }
+    }
+    return { fns, fonts };
+}
+
+// 解析链接器 map 文件中的输入段, 例如:
+//  .text.lv_obj_get_style_prop
+//                 0x42034abc       0x5c esp-idf/lvgl__lvgl/liblvgl__lvgl.a(lv_obj_style.c.obj)
+function parseMap(text) {
+    const sections = [];
+    const re = /^ (\.(?:text|literal|rodata)\.\S+)\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+\S*?([^/\s]+\.a)\(([^)]+)\)$/gm;
+    let m;
+    while ((m = re.exec(text)) !== null) {
+        const size = parseInt(m[3], 16);
+        if (size === 0) {
+            continue;
+        }
+        const name = m[1];
+        const kind = name.split('.')[1];
+        sections.push({
+            kind,
+            symbol: name.slice(kind.length + 2),
+            addr: parseInt(m[2], 16),
+            size,
+            archive: m[4],
+            object: m[5].replace(/\.(c|cpp|S)\.obj$/, '').replace(/\.o(bj)?$/, ''),
+        });
+    }
+    sections.sort((a, b) => a.addr - b.addr);
+    return sections;
+}
+
+function findSection(sections, addr) {
+    let lo = 0;
+    let hi = sections.length - 1;
+    while (lo <= hi) {
+        const mid = (lo + hi) >> 1;
+        const s = sections[mid];
+        if (addr < s.addr) {
+            hi = mid - 1;
+        } else if (addr >= s.addr + s.size) {
+            lo = mid + 1;
+        } else {
+            return s;
+        }
+    }
+    return null;
+}
+
+const { fns, fonts } = parseLog(fs.readFileSync(logPath, 'utf8'));
+const sections = parseMap(fs.readFileSync(mapPath, 'utf8'));
+const entries = new Map();      // archive -> [entry]
+let iramUsed = 0;
+let dramUsed = 0;
+
+function addEntry(archive, entry) {
+    const list = entries.get(archive) || [];
+    list.push(entry);
+    entries.set(archive, list);
+}
+
+// 函数: 按调用次数从高到低放入 IRAM, 直到用完预算
+const hotFns = [];
+for (const [addr, count] of fns) {
+    const s = findSection(sections, addr);
+    if (s && s.kind === 'text') {
+        const literal = sections.find((l) => l.kind === 'literal' && l.symbol === s.symbol && l.object === s.object);
+        hotFns.push({ ...s, count, size: s.size + (literal ? literal.size : 0) });
+    }
+}
+hotFns.sort((a, b) => b.count - a.count);
+for (const f of hotFns) {
+    if (iramUsed + f.size > iramBudget) {
+        continue;
+    }
+    iramUsed += f.size;
+    addEntry(f.archive, `${f.object}:${f.symbol} (noflash)`);
+}
+
+// 字体: 字形表就是字体所在目标文件的全部 rodata, 整个目标文件放入 DRAM
+const fontObjects = [];
+for (const [addr, glyphs] of fonts) {
+    const s = findSection(sections, addr);
+    if (!s) {
+        console.warn(`找不到字体 0x${addr.toString(16)}`);
+        continue;
+    }
+    const rodata = sections.filter((r) => r.kind === 'rodata' && r.archive === s.archive && r.object === s.object);
+    const size = rodata.reduce((sum, r) => sum + r.size, 0);
+    const lookups = [...glyphs.values()].reduce((sum, n) => sum + n, 0);
+    fontObjects.push({ ...s, size, lookups, glyphs: glyphs.size });
+}
+fontObjects.sort((a, b) => b.lookups - a.lookups);
+for (const f of fontObjects) {
+    console.log(`字体 ${f.symbol}: ${f.glyphs} 个字形, ${f.lookups} 次查找, rodata ${f.size} 字节`);
+    if (dramUsed + f.size > dramBudget) {
+        console.log(`  超出 DRAM 预算, 跳过`);
+        continue;
+    }
+    dramUsed += f.size;
+    addEntry(f.archive, `${f.object} (noflash_data)`);
+}
+
+let output = '# 由 build_hotset.js 根据 CONFIG_APP_HOTSET_PROFILE 的采样结果生成, 请勿手动修改\n';
+for (const [archive, list] of entries) {
+    output += `\n[mapping:hotset_${archive.replace(/^lib|\.a$/g, '').replace(/[^A-Za-z0-9_]/g, '_')}]\n`;
+    output += `archive: ${archive}\n`;
+    output += 'entries:\n';
+    for (const entry of list) {
+        output += `    ${entry}\n`;
+    }
+}
+fs.writeFileSync(outputPath, output, 'utf8');
+console.log(`热点函数 ${hotFns.length} 个, 放入 IRAM ${iramUsed} 字节; 字体放入 DRAM ${dramUsed} 字节`);
+console.log(`已生成 ${outputPath}`);
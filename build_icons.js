@@ -0,0 +1,220 @@
+const { execSync } = require('child_process');
+const path = require('path');
+const fs = require('fs');
+const os = require('os');
+const zlib = require('zlib');
+
+// 用法: node build_icons.js [输出 .bin]
+// 用 lv_font_conv 把 Nerd Font 里的天气图标光栅化成 8 位 alpha, 按尺寸打包并 RLE 压缩,
+// 输出烧录到 "icons" 分区的图标集, 格式与 app_icons.c 中的 icons_header_t 保持一致
+const fontPath = path.join(__dirname, '/fonts/InconsolataNerdFontPropo-Regular.ttf');
+const outputPath = process.argv[2] || path.join(__dirname, '/assets/icons.bin');
+
+const MAGIC = 0x41495753;       // "SWIA"
+const VERSION = 1;
+const HEADER_SIZE = 24;
+const ENTRY_SIZE = 16;
+const MAX_SIZES = 4;
+const LV_COLOR_FORMAT_A8 = 0x0e;
+const RLE_RUN = 0x80;           // 一个字节重复 n 次, 否则是 n 个原样字节
+const RLE_MAX = 0x7f;
+
+// 图标尺寸 (像素), 最多 MAX_SIZES 个, 从小到大
+const sizes = [24, 48, 96];
+
+// 天气图标, 顺序即图标编号
+const glyphs = [
+    { name: 'na', code: 0xe374 },
+    { name: 'day_sunny', code: 0xe30d },
+    { name: 'day_cloudy', code: 0xe302 },
+    { name: 'cloudy', code: 0xe312 },
+    { name: 'showers', code: 0xe319 },
+    { name: 'thunderstorm', code: 0xe31d },
+    { name: 'hail', code: 0xe314 },
+    { name: 'sleet', code: 0xe3ad },
+    { name: 'sprinkle', code: 0xe31b },
+    { name: 'rain', code: 0xe318 },
+    { name: 'storm_showers', code: 0xe31c },
+    { name: 'day_snow', code: 0xe30a },
+    { name: 'snow', code: 0xe31a },
+    { name: 'snow_wind', code: 0xe35e },
+    { name: 'fog', code: 0xe313 },
+    { name: 'rain_mix', code: 0xe316 },
+    { name: 'sandstorm', code: 0xe37a },
+    { name: 'dust', code: 0xe35d },
+    { name: 'day_haze', code: 0xe3ae },
+];
+
+// 中国天气网天气现象编码 ("d01" 中的 01) 对应的图标, 没有列出的编码用 na
+const conditions = {
+    0: 'day_sunny', 1: 'day_cloudy', 2: 'cloudy', 3: 'showers', 4: 'thunderstorm', 5: 'hail',
+    6: 'sleet', 7: 'sprinkle', 8: 'rain', 9: 'rain', 10: 'storm_showers', 11: 'storm_showers',
+    12: 'storm_showers', 13: 'day_snow', 14: 'snow', 15: 'snow', 16: 'snow', 17: 'snow_wind',
+    18: 'fog', 19: 'rain_mix', 20: 'sandstorm', 21: 'rain', 22: 'rain', 23: 'rain', 24: 'storm_showers',
+    25: 'storm_showers', 26: 'snow', 27: 'snow', 28: 'snow_wind', 29: 'dust', 30: 'dust', 31: 'sandstorm',
+    32: 'fog', 49: 'fog', 53: 'day_haze', 54: 'day_haze', 55: 'day_haze', 56: 'day_haze', 57: 'fog', 58: 'fog',
+};
+
+// 光栅化一个尺寸的所有图标: 不压缩的 8 位 lvgl 格式, 再从生成的 C 文件里读出点阵
+function rasterize(size) {
+    const tmp = path.join(os.tmpdir(), `icons_${size}.c`);
+    const range = glyphs.map(g => '0x' + g.code.toString(16)).join(',');
+    execSync(`npx lv_font_conv --font ${fontPath} --range ${range} --size ${size} --format lvgl --bpp 8 ` +
+             `--no-compress --no-prefilter --lv-font-name icons_${size} --output ${tmp}`, { stdio: 'inherit' });
+    const text = fs.readFileSync(tmp, 'utf8');
+    fs.unlinkSync(tmp);
+    return parseFont(text);
+}
+
+// glyph_bitmap[] 是所有点阵连在一起, glyph_dsc[] 按码位从小到大排列, 第 0 项保留
+function parseFont(text) {
+    const bitmapText = text.match(/glyph_bitmap\[\]\s*=\s*\{([\s\S]*?)\};/)[1];
+    const bitmap = Buffer.from(bitmapText.replace(/\/\*[\s\S]*?\*\//g, '').split(',')
+        .map(s => s.trim()).filter(s => s.length).map(s => parseInt(s, 16)));
+    const dscText = text.match(/glyph_dsc\[\]\s*=\s*\{([\s\S]*?)\n\};/)[1];
+    const dscs = [];
+    const re = /\.bitmap_index = (\d+), \.adv_w = \d+, \.box_w = (\d+), \.box_h = (\d+)/g;
+    let m;
+    while ((m = re.exec(dscText)) !== null) {
+        dscs.push({ index: parseInt(m[1], 10), w: parseInt(m[2], 10), h: parseInt(m[3], 10) });
+    }
+    dscs.shift();
+    const byCode = new Map();
+    const codes = glyphs.map(g => g.code).sort((a, b) => a - b);
+    if (dscs.length !== codes.length) {
+        throw new Error(`字体里只找到 ${dscs.length} 个图标, 需要 ${codes.length} 个`);
+    }
+    codes.forEach((code, i) => byCode.set(code, { ...dscs[i], data: bitmap.subarray(dscs[i].index, dscs[i].index + dscs[i].w * dscs[i].h) }));
+    return byCode;
+}
+
+// 把字形居中放到 size x size 的画布上, 字形更大时画布随之变大
+function place(glyph, size) {
+    const w = Math.max(size, glyph.w);
+    const h = Math.max(size, glyph.h);
+    const out = Buffer.alloc(w * h);
+    const x0 = (w - glyph.w) >> 1;
+    const y0 = (h - glyph.h) >> 1;
+    for (let y = 0; y < glyph.h; y++) {
+        glyph.data.copy(out, (y0 + y) * w + x0, y * glyph.w, (y + 1) * glyph.w);
+    }
+    return { w, h, data: out };
+}
+
+// 3 个及以上相同字节编码成 (RLE_RUN | n, 字节), 其余编码成 (n, 字节...), 与 app_boot.c 的帧缓存同一思路
+function rleEncode(data) {
+    const out = [];
+    let i = 0;
+    while (i < data.length) {
+        let run = 1;
+        while (i + run < data.length && run < RLE_MAX && data[i + run] === data[i]) {
+            run++;
+        }
+        if (run >= 3) {
+            out.push(RLE_RUN | run, data[i]);
+            i += run;
+            continue;
+        }
+        let lit = 0;
+        while (i + lit < data.length && lit < RLE_MAX &&
+               !(i + lit + 2 < data.length && data[i + lit] === data[i + lit + 1] && data[i + lit] === data[i + lit + 2])) {
+            lit++;
+        }
+        out.push(lit);
+        for (let k = 0; k < lit; k++) {
+            out.push(data[i + k]);
+        }
+        i += lit;
+    }
+    return Buffer.from(out);
+}
+
+function rleDecode(data, len) {
+    const out = Buffer.alloc(len);
+    let o = 0;
+    for (let i = 0; i < data.length;) {
+        const n = data[i] & RLE_MAX;
+        if (data[i++] & RLE_RUN) {
+            out.fill(data[i++], o, o + n);
+        } else {
+            data.copy(out, o, i, i + n);
+            i += n;
+        }
+        o += n;
+    }
+    return out;
+}
+
+function build() {
+    if (sizes.length > MAX_SIZES) {
+        throw new Error(`最多 ${MAX_SIZES} 个尺寸`);
+    }
+    const names = new Map(glyphs.map((g, i) => [g.name, i]));
+    const maxCode = Math.max(...Object.keys(conditions).map(Number));
+    const codeMap = Buffer.alloc(maxCode + 1, names.get('na'));
+    for (const [code, name] of Object.entries(conditions)) {
+        codeMap[Number(code)] = names.get(name);
+    }
+
+    // 图标 i 的尺寸 s 在第 i * sizes.length + s 项
+    const entries = [];
+    const chunks = [];
+    let offset = 0;
+    let rawBytes = 0;
+    const rasters = sizes.map(rasterize);
+    for (const g of glyphs) {
+        sizes.forEach((size, s) => {
+            const icon = place(rasters[s].get(g.code), size);
+            const packed = rleEncode(icon.data);
+            if (!rleDecode(packed, icon.data.length).equals(icon.data)) {
+                throw new Error(`${g.name} ${size} 解码不一致`);
+            }
+            entries.push({ w: icon.w, h: icon.h, size, offset, len: packed.length });
+            chunks.push(packed);
+            offset += packed.length;
+            rawBytes += icon.data.length;
+        });
+    }
+
+    const tablesLen = entries.length * ENTRY_SIZE + ((codeMap.length + 3) & ~3);
+    const body = Buffer.alloc(tablesLen + offset);
+    entries.forEach((e, i) => {
+        const p = i * ENTRY_SIZE;
+        body.writeUInt16LE(e.w, p);
+        body.writeUInt16LE(e.h, p + 2);
+        body.writeUInt8(e.size, p + 4);
+        body.writeUInt8(LV_COLOR_FORMAT_A8, p + 5);
+        body.writeUInt32LE(e.offset, p + 8);
+        body.writeUInt32LE(e.len, p + 12);
+    });
+    codeMap.copy(body, entries.length * ENTRY_SIZE);
+    Buffer.concat(chunks).copy(body, tablesLen);
+
+    const header = Buffer.alloc(HEADER_SIZE);
+    header.writeUInt32LE(MAGIC, 0);
+    header.writeUInt16LE(VERSION, 4);
+    header.writeUInt8(glyphs.length, 6);
+    header.writeUInt8(sizes.length, 7);
+    sizes.forEach((size, i) => header.writeUInt8(size, 8 + i));
+    header.writeUInt16LE(codeMap.length, 12);
+    header.writeUInt32LE(body.length, 16);
+    // 与设备端 esp_crc32_le(0, ...) 相同
+    header.writeUInt32LE(zlib.crc32(body), 20);
+
+    fs.mkdirSync(path.dirname(outputPath), { recursive: true });
+    fs.writeFileSync(outputPath, Buffer.concat([header, body]));
+
+    const total = HEADER_SIZE + body.length;
+    console.log(`图标: ${glyphs.length} 个 x ${sizes.length} 种尺寸 (${sizes.join(', ')})`);
+    console.log(`不压缩 A8 ${rawBytes} 字节, ARGB8888 ${rawBytes * 4} 字节, RGB565 ${rawBytes * 2} 字节`);
+    console.log(`图标集 ${total} 字节, 比 A8 小 ${(100 - total * 100 / rawBytes).toFixed(1)}%, ` +
+                `比 ARGB8888 小 ${(100 - total * 100 / (rawBytes * 4)).toFixed(1)}%`);
+    console.log(`已写入 ${outputPath}`);
+}
+
+try {
+    build();
+} catch (error) {
+    console.error('图标打包失败', error);
+    process.exit(1);
+}
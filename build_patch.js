@@ -0,0 +1,236 @@
+const fs = require('fs');
+const zlib = require('zlib');
+const crypto = require('crypto');
+
+// 用法: node build_patch.js <旧固件 .bin> <新固件 .bin> [输出 .patch]
+// 生成设备端 app_ota.c 可以边下载边应用的差分包: 旧固件必须与设备上正在运行的完全一致
+const [oldPath, newPath] = process.argv.slice(2);
+
+if (!oldPath || !newPath) {
+    console.error('用法: node build_patch.js <旧固件 .bin> <新固件 .bin> [输出 .patch]');
+    process.exit(1);
+}
+
+const outputPath = process.argv[4] || newPath.replace(/\.[^./\\]*$/, '') + '.patch';
+
+// 与 app_ota.h 中的 app_ota_patch_header_t 保持一致
+const MAGIC = 0x31504457;
+const HEADER_SIZE = 76;
+const RECORD_SIZE = 12;
+
+// 哈希索引: 旧固件中每个位置的 8 字节窗口, 相同哈希的位置串成链表, 查找时最多看 CHAIN_MAX 个
+const WINDOW = 8;
+const HASH_BITS = 20;
+const CHAIN_MAX = 32;
+
+function hashAt(buf, pos) {
+    let h = 0;
+    for (let i = 0; i < WINDOW; i++) {
+        h = (Math.imul(h, 31) + buf[pos + i]) | 0;
+    }
+    return (h ^ (h >>> HASH_BITS)) & ((1 << HASH_BITS) - 1);
+}
+
+function buildIndex(old) {
+    const head = new Int32Array(1 << HASH_BITS).fill(-1);
+    const next = new Int32Array(Math.max(old.length, 1)).fill(-1);
+    // 倒序插入, 链表按位置从小到大
+    for (let pos = old.length - WINDOW; pos >= 0; pos--) {
+        const h = hashAt(old, pos);
+        next[pos] = head[h];
+        head[h] = pos;
+    }
+    return { head, next };
+}
+
+function matchLength(old, oldPos, neu, newPos) {
+    let len = 0;
+    while (oldPos + len < old.length && newPos + len < neu.length && old[oldPos + len] === neu[newPos + len]) {
+        len++;
+    }
+    return len;
+}
+
+// 在旧固件中找与 neu[scan..] 最长的完全匹配
+function search(index, old, neu, scan) {
+    if (scan + WINDOW > neu.length) {
+        return { pos: 0, len: 0 };
+    }
+    let best = { pos: 0, len: 0 };
+    let pos = index.head[hashAt(neu, scan)];
+    for (let n = 0; pos >= 0 && n < CHAIN_MAX; n++, pos = index.next[pos]) {
+        const len = matchLength(old, pos, neu, scan);
+        if (len > best.len) {
+            best = { pos, len };
+        }
+    }
+    return best;
+}
+
+// bsdiff 的主循环, 只是把后缀数组换成了哈希索引: 先沿用上一段的对齐方式近似匹配,
+// 找到明显更好的新位置时输出一条记录 (差值段, 原样段, 旧游标跳转)
+function diff(old, neu) {
+    const index = buildIndex(old);
+    const records = [];
+    let scan = 0;
+    let len = 0;
+    let pos = 0;
+    let lastScan = 0;
+    let lastPos = 0;
+    let lastOffset = 0;
+
+    while (scan < neu.length) {
+        let oldScore = 0;
+        let scsc = scan += len;
+        for (; scan < neu.length; scan++) {
+            ({ pos, len } = search(index, old, neu, scan));
+            for (; scsc < scan + len; scsc++) {
+                if (scsc + lastOffset < old.length && old[scsc + lastOffset] === neu[scsc]) {
+                    oldScore++;
+                }
+            }
+            if ((len === oldScore && len !== 0) || len > oldScore + 8) {
+                break;
+            }
+            if (scan + lastOffset < old.length && old[scan + lastOffset] === neu[scan]) {
+                oldScore--;
+            }
+        }
+
+        if (len !== oldScore || scan === neu.length) {
+            // 向前延伸上一段对齐, 直到不匹配的字节多于一半
+            let s = 0;
+            let best = 0;
+            let lenf = 0;
+            for (let i = 0; lastScan + i < scan && lastPos + i < old.length;) {
+                if (old[lastPos + i] === neu[lastScan + i]) {
+                    s++;
+                }
+                i++;
+                if (s * 2 - i > best * 2 - lenf) {
+                    best = s;
+                    lenf = i;
+                }
+            }
+
+            // 从新位置向后延伸
+            let lenb = 0;
+            if (scan < neu.length) {
+                s = 0;
+                best = 0;
+                for (let i = 1; scan >= lastScan + i && pos >= i; i++) {
+                    if (old[pos - i] === neu[scan - i]) {
+                        s++;
+                    }
+                    if (s * 2 - i > best * 2 - lenb) {
+                        best = s;
+                        lenb = i;
+                    }
+                }
+            }
+
+            // 两段重叠时找最好的分界点
+            if (lastScan + lenf > scan - lenb) {
+                const overlap = (lastScan + lenf) - (scan - lenb);
+                s = 0;
+                best = 0;
+                let lens = 0;
+                for (let i = 0; i < overlap; i++) {
+                    if (neu[lastScan + lenf - overlap + i] === old[lastPos + lenf - overlap + i]) {
+                        s++;
+                    }
+                    if (neu[scan - lenb + i] === old[pos - lenb + i]) {
+                        s--;
+                    }
+                    if (s > best) {
+                        best = s;
+                        lens = i + 1;
+                    }
+                }
+                lenf += lens - overlap;
+                lenb -= lens;
+            }
+
+            records.push({
+                newPos: lastScan,
+                oldPos: lastPos,
+                diffLen: lenf,
+                extraLen: (scan - lenb) - (lastScan + lenf),
+                seek: (pos - lenb) - (lastPos + lenf),
+            });
+            lastScan = scan - lenb;
+            lastPos = pos - lenb;
+            lastOffset = pos - scan;
+        }
+    }
+    return records;
+}
+
+function encodeRecords(records, old, neu) {
+    const parts = [];
+    for (const r of records) {
+        const head = Buffer.alloc(RECORD_SIZE);
+        head.writeUInt32LE(r.diffLen, 0);
+        head.writeUInt32LE(r.extraLen, 4);
+        head.writeInt32LE(r.seek, 8);
+        const diffBytes = Buffer.alloc(r.diffLen);
+        for (let i = 0; i < r.diffLen; i++) {
+            diffBytes[i] = (neu[r.newPos + i] - old[r.oldPos + i]) & 0xff;
+        }
+        const extraStart = r.newPos + r.diffLen;
+        parts.push(head, diffBytes, neu.subarray(extraStart, extraStart + r.extraLen));
+    }
+    return Buffer.concat(parts);
+}
+
+// 与设备端相同的应用过程, 生成后先在本机验证一遍
+function apply(old, body, newSize) {
+    const out = Buffer.alloc(newSize);
+    let written = 0;
+    let oldPos = 0;
+    for (let off = 0; off < body.length;) {
+        const diffLen = body.readUInt32LE(off);
+        const extraLen = body.readUInt32LE(off + 4);
+        const seek = body.readInt32LE(off + 8);
+        off += RECORD_SIZE;
+        for (let i = 0; i < diffLen; i++) {
+            out[written++] = (old[oldPos++] + body[off++]) & 0xff;
+        }
+        body.copy(out, written, off, off + extraLen);
+        written += extraLen;
+        off += extraLen;
+        oldPos += seek;
+    }
+    return out.subarray(0, written);
+}
+
+function sha256(buf) {
+    return crypto.createHash('sha256').update(buf).digest();
+}
+
+const old = fs.readFileSync(oldPath);
+const neu = fs.readFileSync(newPath);
+const started = Date.now();
+
+const records = diff(old, neu);
+const body = encodeRecords(records, old, neu);
+if (!apply(old, body, neu.length).equals(neu)) {
+    console.error('差分包自检失败');
+    process.exit(1);
+}
+
+const header = Buffer.alloc(HEADER_SIZE);
+header.writeUInt32LE(MAGIC, 0);
+header.writeUInt32LE(old.length, 4);
+header.writeUInt32LE(neu.length, 8);
+sha256(old).copy(header, 12);
+sha256(neu).copy(header, 44);
+const patch = Buffer.concat([header, zlib.deflateSync(body, { level: 9 })]);
+fs.writeFileSync(outputPath, patch);
+
+// 与整包 (以及整包压缩后) 的大小对比
+const fullDeflated = zlib.deflateSync(neu, { level: 9 }).length;
+const percent = (n) => (n * 100 / neu.length).toFixed(1);
+console.log(`patch: records=${records.length} old=${old.length} new=${neu.length} patch=${patch.length} ` +
+    `(${percent(patch.length)}% of full, ${percent(fullDeflated)}% full deflated) ${Date.now() - started} ms`);
+console.log(`已写入 ${outputPath}`);
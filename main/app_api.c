@@ -0,0 +1,515 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_console.h"
+#include "esp_http_server.h"
+#include "app_history.h"
+#include "app_mem.h"
+#include "app_render.h"
+#include "app_wifi.h"
+#include "app_api.h"
+#if CONFIG_APP_TASKMON
+#include "app_taskmon.h"
+#endif
+
+#define API_CHUNK_SIZE          (1024)
+#define API_QUERY_MAX           (96)
+#define API_ARG_MAX             (24)
+#define API_TASK_STACK          (6144)
+#define API_HISTORY_DEFAULT_MIN (60)
+#define API_MEM_ENTRIES         (12)
+
+static const char *TAG = "api";
+
+typedef enum {
+    API_PATH_READINGS = 0,
+    API_PATH_ROLLUPS,
+    API_PATH_HISTORY,
+    API_PATH_METRICS,
+    API_PATH_MAX,
+} api_path_t;
+
+static const char *const s_path_names[API_PATH_MAX] = {
+    [API_PATH_READINGS] = "/api/readings",
+    [API_PATH_ROLLUPS] = "/api/rollups",
+    [API_PATH_HISTORY] = "/api/history",
+    [API_PATH_METRICS] = "/metrics",
+};
+
+/* Counters never cleared, for /metrics */
+typedef struct {
+    uint32_t requests;
+    uint32_t errors;
+    uint64_t bytes;
+    uint64_t duration_us;
+} api_path_counters_t;
+
+/* Formats a chunked response. The server runs every handler on its one task, so a single
+ * writer and its buffer serve all connections without allocating per request. */
+typedef struct {
+    httpd_req_t *req;
+    size_t len;
+    size_t sent;
+    esp_err_t err;
+    char buf[API_CHUNK_SIZE];
+} api_writer_t;
+
+static struct {
+    httpd_handle_t server;
+    api_writer_t writer;
+    api_path_counters_t counters[API_PATH_MAX];
+    app_api_stats_t stats;
+    portMUX_TYPE lock;
+} s_api = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static api_writer_t *api_begin(httpd_req_t *req, const char *type)
+{
+    api_writer_t *w = &s_api.writer;
+    w->req = req;
+    w->len = 0;
+    w->sent = 0;
+    w->err = httpd_resp_set_type(req, type);
+    return w;
+}
+
+static void api_flush(api_writer_t *w)
+{
+    if (w->len && w->err == ESP_OK) {
+        w->err = httpd_resp_send_chunk(w->req, w->buf, w->len);
+        w->sent += w->len;
+    }
+    w->len = 0;
+}
+
+static void api_printf(api_writer_t *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void api_printf(api_writer_t *w, const char *fmt, ...)
+{
+    for (int attempt = 0; attempt < 2 && w->err == ESP_OK; attempt++) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(w->buf + w->len, sizeof(w->buf) - w->len, fmt, ap);
+        va_end(ap);
+        if (n >= 0 && w->len + n < sizeof(w->buf)) {
+            w->len += n;
+            return;
+        }
+        api_flush(w);
+    }
+    if (w->err == ESP_OK) {
+        w->err = ESP_ERR_INVALID_SIZE;  /* One line longer than the whole buffer */
+    }
+}
+
+/* Send `data` as its own chunk, without copying it into the buffer */
+static void api_send_raw(api_writer_t *w, const void *data, size_t len)
+{
+    api_flush(w);
+    if (len && w->err == ESP_OK) {
+        w->err = httpd_resp_send_chunk(w->req, data, len);
+        w->sent += len;
+    }
+}
+
+static esp_err_t api_end(api_writer_t *w)
+{
+    api_flush(w);
+    if (w->err == ESP_OK) {
+        w->err = httpd_resp_send_chunk(w->req, NULL, 0);
+    }
+    return w->err;
+}
+
+static void api_account(api_path_t path, int64_t start_us, size_t bytes, bool error)
+{
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start_us);
+    /* Sampled after the response went out, while the connection buffers are still held */
+    size_t heap_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+
+    portENTER_CRITICAL(&s_api.lock);
+    api_path_counters_t *c = &s_api.counters[path];
+    c->requests++;
+    c->errors += error;
+    c->bytes += bytes;
+    c->duration_us += us;
+    s_api.stats.requests++;
+    s_api.stats.errors += error;
+    s_api.stats.bytes += bytes;
+    s_api.stats.handler_sum_us += us;
+    s_api.stats.handler_max_us = MAX(s_api.stats.handler_max_us, us);
+    if (!s_api.stats.heap_min_free || heap_free < s_api.stats.heap_min_free) {
+        s_api.stats.heap_min_free = heap_free;
+    }
+    portEXIT_CRITICAL(&s_api.lock);
+}
+
+static esp_err_t api_finish(api_writer_t *w, api_path_t path, int64_t start_us)
+{
+    esp_err_t ret = api_end(w);
+    api_account(path, start_us, w->sent, ret != ESP_OK);
+    if (ret != ESP_OK) {
+        ESP_LOGD(TAG, "%s: %s", s_path_names[path], esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static esp_err_t api_bad_request(httpd_req_t *req, api_path_t path, int64_t start_us, const char *msg)
+{
+    api_account(path, start_us, 0, true);
+    return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+}
+
+/* Value of `key` in the query string, `fallback` when missing */
+static const char *api_query_arg(const char *query, const char *key, char *val, size_t size, const char *fallback)
+{
+    if (query[0] && httpd_query_key_value(query, key, val, size) == ESP_OK) {
+        return val;
+    }
+    return fallback;
+}
+
+static bool api_query_u32(const char *query, const char *key, uint32_t fallback, uint32_t *out)
+{
+    char val[API_ARG_MAX];
+    const char *s = api_query_arg(query, key, val, sizeof(val), NULL);
+    if (!s) {
+        *out = fallback;
+        return true;
+    }
+    char *end;
+    unsigned long v = strtoul(s, &end, 10);
+    *out = (uint32_t)v;
+    return end != s && *end == '\0' && v <= UINT32_MAX;
+}
+
+static void api_get_query(httpd_req_t *req, char *query, size_t size)
+{
+    if (httpd_req_get_url_query_str(req, query, size) != ESP_OK) {
+        query[0] = '\0';
+    }
+}
+
+static esp_err_t api_readings_handler(httpd_req_t *req)
+{
+    int64_t start = esp_timer_get_time();
+    api_writer_t *w = api_begin(req, "application/json");
+
+    api_printf(w, "{\"uptime_s\":%" PRIu32 ",\"readings\":{", (uint32_t)(start / 1000000));
+    const char *sep = "";
+    for (int q = 0; q < APP_SENSOR_QUANTITY_MAX; q++) {
+        float value;
+        int64_t t_us;
+        if (app_history_latest(q, &value, &t_us)) {
+            api_printf(w, "%s\"%s\":{\"value\":%.2f,\"age_ms\":%" PRIu32 "}", sep, app_history_quantity_name(q),
+                       value, (uint32_t)((start - t_us) / 1000));
+            sep = ",";
+        }
+    }
+    api_printf(w, "}}\n");
+    return api_finish(w, API_PATH_READINGS, start);
+}
+
+static esp_err_t api_rollups_handler(httpd_req_t *req)
+{
+    int64_t start = esp_timer_get_time();
+    char query[API_QUERY_MAX];
+    uint32_t minutes;
+
+    api_get_query(req, query, sizeof(query));
+    if (!api_query_u32(query, "minutes", API_HISTORY_DEFAULT_MIN, &minutes) || !minutes) {
+        return api_bad_request(req, API_PATH_ROLLUPS, start, "minutes must be a positive number");
+    }
+    minutes = MIN(minutes, CONFIG_APP_HISTORY_MINUTES);
+
+    api_writer_t *w = api_begin(req, "application/json");
+    api_printf(w, "{\"minutes\":%" PRIu32 ",\"now_minute\":%" PRIu32 ",\"rollups\":{", minutes,
+               app_history_now_minute());
+    const char *sep = "";
+    for (int q = 0; q < APP_SENSOR_QUANTITY_MAX; q++) {
+        app_history_rollup_t r;
+        app_history_summary(q, minutes, &r);
+        if (r.count) {
+            api_printf(w, "%s\"%s\":{\"min\":%.2f,\"max\":%.2f,\"mean\":%.2f,\"count\":%" PRIu32
+                       ",\"from_minute\":%" PRIu32 "}", sep, app_history_quantity_name(q),
+                       r.min, r.max, r.mean, r.count, r.minute);
+            sep = ",";
+        }
+    }
+    api_printf(w, "}}\n");
+    return api_finish(w, API_PATH_ROLLUPS, start);
+}
+
+typedef enum {
+    API_FORMAT_CSV,
+    API_FORMAT_JSON,
+    API_FORMAT_BIN,
+} api_format_t;
+
+typedef struct {
+    api_writer_t *w;
+    api_format_t format;
+    uint32_t records;
+} api_history_walk_t;
+
+static esp_err_t api_history_block(const app_history_rollup_t *records, size_t count, void *arg)
+{
+    api_history_walk_t *walk = arg;
+    api_writer_t *w = walk->w;
+
+    if (walk->format == API_FORMAT_BIN) {
+        api_send_raw(w, records, count * sizeof(*records));
+    } else {
+        for (size_t i = 0; i < count && w->err == ESP_OK; i++) {
+            const app_history_rollup_t *r = &records[i];
+            if (walk->format == API_FORMAT_CSV) {
+                api_printf(w, "%" PRIu32 ",%.2f,%.2f,%.2f,%" PRIu32 "\n", r->minute, r->min, r->max, r->mean, r->count);
+            } else {
+                api_printf(w, "%s[%" PRIu32 ",%.2f,%.2f,%.2f,%" PRIu32 "]", walk->records + i ? "," : "",
+                           r->minute, r->min, r->max, r->mean, r->count);
+            }
+        }
+    }
+    walk->records += count;
+    return w->err;
+}
+
+static esp_err_t api_history_handler(httpd_req_t *req)
+{
+    int64_t start = esp_timer_get_time();
+    char query[API_QUERY_MAX];
+    char val[API_ARG_MAX];
+
+    api_get_query(req, query, sizeof(query));
+    const char *name = api_query_arg(query, "q", val, sizeof(val), "temperature");
+    app_sensor_quantity_t q = 0;
+    while (q < APP_SENSOR_QUANTITY_MAX && strcmp(name, app_history_quantity_name(q)) != 0) {
+        q++;
+    }
+    if (q == APP_SENSOR_QUANTITY_MAX) {
+        return api_bad_request(req, API_PATH_HISTORY, start, "unknown quantity");
+    }
+
+    uint32_t now = app_history_now_minute();
+    uint32_t from, to;
+    if (!api_query_u32(query, "from", now > API_HISTORY_DEFAULT_MIN ? now - API_HISTORY_DEFAULT_MIN : 0, &from) ||
+            !api_query_u32(query, "to", UINT32_MAX, &to) || from > to) {
+        return api_bad_request(req, API_PATH_HISTORY, start, "from and to must be minutes since boot, from <= to");
+    }
+
+    const char *format = api_query_arg(query, "format", val, sizeof(val), "csv");
+    api_history_walk_t walk = { 0 };
+    if (strcmp(format, "csv") == 0) {
+        walk.format = API_FORMAT_CSV;
+    } else if (strcmp(format, "json") == 0) {
+        walk.format = API_FORMAT_JSON;
+    } else if (strcmp(format, "bin") == 0) {
+        walk.format = API_FORMAT_BIN;
+    } else {
+        return api_bad_request(req, API_PATH_HISTORY, start, "format is csv, json or bin");
+    }
+
+    static const char *const types[] = {
+        [API_FORMAT_CSV] = "text/csv",
+        [API_FORMAT_JSON] = "application/json",
+        [API_FORMAT_BIN] = "application/octet-stream",
+    };
+    walk.w = api_begin(req, types[walk.format]);
+    if (walk.format == API_FORMAT_BIN) {
+        /* Little endian app_history_rollup_t: u32 minute, f32 min, f32 max, f32 mean, u32 count */
+        _Static_assert(sizeof(app_history_rollup_t) == 20, "update X-Record-Size");
+        httpd_resp_set_hdr(req, "X-Record-Size", "20");
+    } else if (walk.format == API_FORMAT_CSV) {
+        api_printf(walk.w, "minute,min,max,mean,count\n");
+    } else {
+        api_printf(walk.w, "{\"quantity\":\"%s\",\"fields\":[\"minute\",\"min\",\"max\",\"mean\",\"count\"],\"records\":[",
+                   name);
+    }
+
+    esp_err_t ret = app_history_read(q, from, to, api_history_block, &walk);
+    if (ret != ESP_OK && walk.w->err == ESP_OK) {
+        walk.w->err = ret;
+    }
+    if (walk.format == API_FORMAT_JSON) {
+        api_printf(walk.w, "]}\n");
+    }
+    return api_finish(walk.w, API_PATH_HISTORY, start);
+}
+
+/* One "# HELP" and "# TYPE" pair per metric family */
+static void api_metric_header(api_writer_t *w, const char *name, const char *type, const char *help)
+{
+    api_printf(w, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static esp_err_t api_metrics_handler(httpd_req_t *req)
+{
+    int64_t start = esp_timer_get_time();
+    api_writer_t *w = api_begin(req, "text/plain; version=0.0.4");
+
+    api_metric_header(w, "weather_uptime_seconds", "gauge", "Time since boot.");
+    api_printf(w, "weather_uptime_seconds %.3f\n", start / 1e6);
+    api_metric_header(w, "weather_wifi_connected", "gauge", "1 while the station holds an IP address.");
+    api_printf(w, "weather_wifi_connected %d\n", app_wifi_is_connected());
+
+    api_metric_header(w, "weather_sensor_value", "gauge", "Latest reading of each quantity.");
+    int64_t reading_us[APP_SENSOR_QUANTITY_MAX] = { 0 };
+    for (int q = 0; q < APP_SENSOR_QUANTITY_MAX; q++) {
+        float value;
+        if (app_history_latest(q, &value, &reading_us[q])) {
+            api_printf(w, "weather_sensor_value{quantity=\"%s\"} %.3f\n", app_history_quantity_name(q), value);
+        }
+    }
+    api_metric_header(w, "weather_sensor_age_seconds", "gauge", "Time since the latest reading.");
+    for (int q = 0; q < APP_SENSOR_QUANTITY_MAX; q++) {
+        if (reading_us[q]) {
+            api_printf(w, "weather_sensor_age_seconds{quantity=\"%s\"} %.3f\n", app_history_quantity_name(q),
+                       (start - reading_us[q]) / 1e6);
+        }
+    }
+
+    app_mem_stats_t mem[API_MEM_ENTRIES];
+    size_t mem_count = app_mem_get_stats(mem, API_MEM_ENTRIES);
+    static const struct {
+        const char *name;
+        const char *type;
+        const char *help;
+    } mem_families[] = {
+        { "weather_mem_capacity_bytes", "gauge", "Size of each arena, pool and heap." },
+        { "weather_mem_used_bytes", "gauge", "Bytes in use." },
+        { "weather_mem_high_water_bytes", "gauge", "Most bytes ever in use." },
+        { "weather_mem_alloc_failures_total", "counter", "Allocations that did not fit." },
+        { "weather_mem_fragmentation_ratio", "gauge", "1 - largest free block / free bytes." },
+    };
+    for (int f = 0; f < sizeof(mem_families) / sizeof(mem_families[0]); f++) {
+        api_metric_header(w, mem_families[f].name, mem_families[f].type, mem_families[f].help);
+        for (size_t i = 0; i < mem_count; i++) {
+            const app_mem_stats_t *m = &mem[i];
+            const double values[] = { m->capacity, m->used, m->high_water, m->failures, m->frag_pct / 100.0 };
+            api_printf(w, "%s{name=\"%s\",kind=\"%s\",where=\"%s\"} %.10g\n", mem_families[f].name,
+                       m->name, m->kind, m->where, values[f]);
+        }
+    }
+    api_metric_header(w, "weather_heap_min_free_bytes", "gauge", "Least free internal heap since boot.");
+    api_printf(w, "weather_heap_min_free_bytes %u\n", (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL));
+
+#if CONFIG_APP_TASKMON
+    /* Large: keep it off the server task stack, handlers never run concurrently */
+    static app_taskmon_summary_t tm;
+    if (app_taskmon_get_summary(&tm) == ESP_OK && tm.window_ms) {
+        api_metric_header(w, "weather_cpu_load_ratio", "gauge", "Non-idle share of each core over the last window.");
+        for (int c = 0; c < portNUM_PROCESSORS; c++) {
+            api_printf(w, "weather_cpu_load_ratio{core=\"%d\"} %.3f\n", c, tm.load_permille[c] / 1000.0);
+        }
+        api_metric_header(w, "weather_wake_latency_seconds", "gauge", "Average notify to run delay of the probe task.");
+        for (int c = 0; c < portNUM_PROCESSORS; c++) {
+            api_printf(w, "weather_wake_latency_seconds{core=\"%d\"} %.6f\n", c, tm.wake_avg_us[c] / 1e6);
+        }
+        api_metric_header(w, "weather_task_cpu_ratio", "gauge", "Share of one core used by each task.");
+        for (size_t i = 0; i < tm.task_count; i++) {
+            api_printf(w, "weather_task_cpu_ratio{task=\"%s\"} %.3f\n", tm.tasks[i].name, tm.tasks[i].cpu_permille / 1000.0);
+        }
+        api_metric_header(w, "weather_task_stack_free_bytes", "gauge", "Stack never used since the task started.");
+        for (size_t i = 0; i < tm.task_count; i++) {
+            api_printf(w, "weather_task_stack_free_bytes{task=\"%s\"} %" PRIu32 "\n", tm.tasks[i].name, tm.tasks[i].stack_free);
+        }
+    }
+#endif
+
+    api_path_counters_t counters[API_PATH_MAX];
+    portENTER_CRITICAL(&s_api.lock);
+    memcpy(counters, s_api.counters, sizeof(counters));
+    portEXIT_CRITICAL(&s_api.lock);
+    api_metric_header(w, "weather_api_requests_total", "counter", "Requests answered by the HTTP API.");
+    for (int p = 0; p < API_PATH_MAX; p++) {
+        api_printf(w, "weather_api_requests_total{path=\"%s\"} %" PRIu32 "\n", s_path_names[p], counters[p].requests);
+    }
+    api_metric_header(w, "weather_api_errors_total", "counter", "Bad requests and failed sends.");
+    for (int p = 0; p < API_PATH_MAX; p++) {
+        api_printf(w, "weather_api_errors_total{path=\"%s\"} %" PRIu32 "\n", s_path_names[p], counters[p].errors);
+    }
+    api_metric_header(w, "weather_api_response_bytes_total", "counter", "Response body bytes sent.");
+    for (int p = 0; p < API_PATH_MAX; p++) {
+        api_printf(w, "weather_api_response_bytes_total{path=\"%s\"} %" PRIu64 "\n", s_path_names[p], counters[p].bytes);
+    }
+    api_metric_header(w, "weather_api_request_duration_seconds", "summary", "Time spent in the request handlers.");
+    for (int p = 0; p < API_PATH_MAX; p++) {
+        api_printf(w, "weather_api_request_duration_seconds_sum{path=\"%s\"} %.6f\n", s_path_names[p],
+                   counters[p].duration_us / 1e6);
+        api_printf(w, "weather_api_request_duration_seconds_count{path=\"%s\"} %" PRIu32 "\n", s_path_names[p],
+                   counters[p].requests);
+    }
+    return api_finish(w, API_PATH_METRICS, start);
+}
+
+esp_err_t app_api_start(void)
+{
+    ESP_RETURN_ON_FALSE(!s_api.server, ESP_ERR_INVALID_STATE, TAG, "already started");
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = CONFIG_APP_API_PORT;
+    config.max_open_sockets = CONFIG_APP_API_MAX_CLIENTS;
+    config.stack_size = API_TASK_STACK;
+    config.lru_purge_enable = true;     /* A new scraper replaces the oldest idle connection */
+    config.max_uri_handlers = API_PATH_MAX;
+    config.core_id = app_render_background_core();
+    ESP_RETURN_ON_ERROR(httpd_start(&s_api.server, &config), TAG, "server start failed");
+
+    static const httpd_uri_t uris[API_PATH_MAX] = {
+        [API_PATH_READINGS] = { .uri = "/api/readings", .method = HTTP_GET, .handler = api_readings_handler },
+        [API_PATH_ROLLUPS] = { .uri = "/api/rollups", .method = HTTP_GET, .handler = api_rollups_handler },
+        [API_PATH_HISTORY] = { .uri = "/api/history", .method = HTTP_GET, .handler = api_history_handler },
+        [API_PATH_METRICS] = { .uri = "/metrics", .method = HTTP_GET, .handler = api_metrics_handler },
+    };
+    for (int i = 0; i < API_PATH_MAX; i++) {
+        ESP_RETURN_ON_ERROR(httpd_register_uri_handler(s_api.server, &uris[i]), TAG, "register %s failed", uris[i].uri);
+    }
+    ESP_LOGI(TAG, "listening port=%d max_clients=%d", CONFIG_APP_API_PORT, CONFIG_APP_API_MAX_CLIENTS);
+    return ESP_OK;
+}
+
+esp_err_t app_api_get_stats(app_api_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    portENTER_CRITICAL(&s_api.lock);
+    *stats = s_api.stats;
+    memset(&s_api.stats, 0, sizeof(s_api.stats));
+    portEXIT_CRITICAL(&s_api.lock);
+    return ESP_OK;
+}
+
+static int api_cmd(int argc, char **argv)
+{
+    app_api_stats_t st;
+    app_api_get_stats(&st);
+    printf("api: requests=%" PRIu32 " errors=%" PRIu32 " bytes=%" PRIu64 " handler_avg_us=%" PRIu32
+           " handler_max_us=%" PRIu32 " heap_min_free=%u heap_free=%u\n",
+           st.requests, st.errors, st.bytes, st.requests ? (uint32_t)(st.handler_sum_us / st.requests) : 0,
+           st.handler_max_us, (unsigned)st.heap_min_free, (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+    return 0;
+}
+
+esp_err_t app_api_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "api",
+        .help = "Show the HTTP API request count, handler time and least free heap since the last call",
+        .func = api_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,53 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t requests;
+    uint64_t bytes;                 /*!< Response bytes, headers excluded */
+    uint32_t errors;                /*!< Bad requests and failed sends */
+    uint32_t handler_max_us;        /*!< Longest request handler run */
+    uint64_t handler_sum_us;
+    size_t heap_min_free;           /*!< Least free internal heap seen while answering */
+} app_api_stats_t;
+
+/**
+ * @brief Start the HTTP API on CONFIG_APP_API_PORT
+ *
+ *  - GET /api/readings                 latest value and age of every quantity, JSON
+ *  - GET /api/rollups?minutes=60       min, max and mean of every quantity, JSON
+ *  - GET /api/history?q=temperature&from=&to=&format=csv|json|bin
+ *                                      stored minutes of one quantity, `from` and `to` in
+ *                                      minutes since boot, "bin" is the raw
+ *                                      app_history_rollup_t records
+ *  - GET /metrics                      Prometheus text format
+ *
+ * Responses are chunked. Text is formatted into one small buffer that is flushed to the
+ * socket whenever it fills, binary history is sent straight out of the history ring.
+ * Call after app_history_init().
+ */
+esp_err_t app_api_start(void);
+
+/**
+ * @brief Read the statistics since the last call and clear them
+ */
+esp_err_t app_api_get_stats(app_api_stats_t *stats);
+
+/**
+ * @brief Add the "api" console command printing and clearing the statistics
+ */
+esp_err_t app_api_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,369 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+#include "esp_crc.h"
+#include "esp_console.h"
+#include "esp_lvgl_port.h"
+#include "app_backdrop.h"
+
+#define BACKDROP_MAGIC              (0x44425753)    /* "SWBD" */
+#define BACKDROP_VERSION            (1)
+#define BACKDROP_PARTITION_SUBTYPE  (0x43)
+#define BACKDROP_PARTITION_LABEL    "backdrop"
+#define BACKDROP_RLE_RUN            (0x8000)        /* Run of one pixel, else a literal pixel count */
+#define BACKDROP_RLE_MAX            (0x7FFF)
+
+static const char *TAG = "backdrop";
+
+/* Start of the "backdrop" partition, followed by `data_len` bytes of 16-bit words: the RLE keyframe,
+ * then per frame a tile count and (tile index, length, RLE pixels) per changed tile. The last frame
+ * leads back to the keyframe. Kept in sync with build_backdrop.js */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t tile;                  /* Tiles are tile x tile pixels, smaller on the right and bottom edges */
+    uint16_t width;
+    uint16_t height;
+    uint16_t frames;
+    uint16_t frame_ms;
+    uint32_t key_len;               /* Words */
+    uint32_t data_len;              /* Bytes */
+    uint32_t crc;                   /* esp_crc32_le() of the data */
+} backdrop_header_t;
+
+static struct {
+    const backdrop_header_t *hdr;   /* NULL until a valid animation is mapped */
+    const uint16_t *data;
+    const uint16_t *end;
+    const uint16_t *next;           /* Delta of the next frame */
+    esp_partition_mmap_handle_t map_handle;
+    uint16_t *px;
+    lv_image_dsc_t dsc;
+    lv_obj_t *img;
+    lv_obj_t *screen;               /* Parent of `img`, the timer only runs while it is shown */
+    lv_timer_t *timer;
+    bool paused;                    /* While `screen` is not shown */
+    lv_display_t *disp;
+    uint16_t tiles_x;
+    uint16_t frame;
+    int64_t render_start_us;
+    portMUX_TYPE stats_lock;
+    app_backdrop_stats_t stats;
+    uint64_t apply_sum_us;
+    uint64_t psram_bytes;
+    uint64_t render_sum_us;
+} s_bd = {
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+/* Decode RLE pixels into a `w` x `h` rectangle of a buffer `stride` pixels wide, runs may cross rows */
+static bool backdrop_decode_rect(const uint16_t *in, size_t len, uint16_t *dst, int stride, int w, int h)
+{
+    size_t i = 0;
+    int x = 0;
+    int y = 0;
+    while (i < len) {
+        size_t n = in[i] & BACKDROP_RLE_MAX;
+        bool run = in[i++] & BACKDROP_RLE_RUN;
+        if (i + (run ? 1 : n) > len) {
+            return false;
+        }
+        uint16_t value = run ? in[i++] : 0;
+        while (n) {
+            if (y >= h) {
+                return false;
+            }
+            size_t seg = MIN(n, (size_t)(w - x));
+            uint16_t *row = dst + y * stride + x;
+            if (run) {
+                for (size_t k = 0; k < seg; k++) {
+                    row[k] = value;
+                }
+            } else {
+                memcpy(row, in + i, seg * sizeof(uint16_t));
+                i += seg;
+            }
+            n -= seg;
+            x += seg;
+            if (x == w) {
+                x = 0;
+                y++;
+            }
+        }
+    }
+    return y == h && x == 0;
+}
+
+static esp_err_t backdrop_map(void)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, BACKDROP_PARTITION_SUBTYPE,
+                                                           BACKDROP_PARTITION_LABEL);
+    if (!part) {
+        ESP_LOGW(TAG, "No %s partition", BACKDROP_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    /* Stays mapped, frames are decoded straight from flash */
+    const void *map = NULL;
+    ESP_RETURN_ON_ERROR(esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &map, &s_bd.map_handle),
+                        TAG, "map %s partition failed", BACKDROP_PARTITION_LABEL);
+    const backdrop_header_t *hdr = map;
+    if (hdr->magic != BACKDROP_MAGIC || hdr->version != BACKDROP_VERSION || !hdr->tile || !hdr->width ||
+            !hdr->height || !hdr->frames || !hdr->frame_ms || hdr->data_len > part->size - sizeof(*hdr) ||
+            hdr->key_len > hdr->data_len / sizeof(uint16_t) ||
+            esp_crc32_le(0, (const uint8_t *)(hdr + 1), hdr->data_len) != hdr->crc) {
+        ESP_LOGW(TAG, "No valid animation, run build_backdrop.js and flash it");
+        esp_partition_munmap(s_bd.map_handle);
+        return ESP_ERR_NOT_FOUND;
+    }
+    s_bd.data = (const uint16_t *)(hdr + 1);
+    s_bd.end = s_bd.data + hdr->data_len / sizeof(uint16_t);
+    s_bd.tiles_x = (hdr->width + hdr->tile - 1) / hdr->tile;
+    s_bd.hdr = hdr;
+    return ESP_OK;
+}
+
+/* Write the changed tiles of the next frame and invalidate only them */
+static bool backdrop_apply_frame(uint32_t *tiles, uint32_t *bytes)
+{
+    const backdrop_header_t *hdr = s_bd.hdr;
+    const uint16_t *p = s_bd.next;
+    if (p >= s_bd.end) {
+        return false;
+    }
+    uint32_t count = *p++;
+    uint32_t written = 0;
+    lv_area_t coords;
+    lv_obj_get_coords(s_bd.img, &coords);
+
+    for (uint32_t t = 0; t < count; t++) {
+        if (p + 2 > s_bd.end) {
+            return false;
+        }
+        uint32_t index = p[0];
+        uint32_t len = p[1];
+        p += 2;
+        int x = (index % s_bd.tiles_x) * hdr->tile;
+        int y = (index / s_bd.tiles_x) * hdr->tile;
+        if (y >= hdr->height || p + len > s_bd.end) {
+            return false;
+        }
+        int w = MIN(hdr->tile, hdr->width - x);
+        int h = MIN(hdr->tile, hdr->height - y);
+        if (!backdrop_decode_rect(p, len, s_bd.px + y * hdr->width + x, hdr->width, w, h)) {
+            return false;
+        }
+        p += len;
+
+        lv_area_t area = { coords.x1 + x, coords.y1 + y, coords.x1 + x + w - 1, coords.y1 + y + h - 1 };
+        lv_obj_invalidate_area(s_bd.img, &area);
+        written += w * h * sizeof(uint16_t);
+    }
+
+    *tiles = count;
+    *bytes = written;
+    s_bd.next = p;
+    if (++s_bd.frame == hdr->frames) {
+        s_bd.frame = 0;
+        s_bd.next = s_bd.data + hdr->key_len;
+    }
+    return true;
+}
+
+static void backdrop_timer_cb(lv_timer_t *timer)
+{
+    int64_t start = esp_timer_get_time();
+    uint32_t tiles = 0;
+    uint32_t bytes = 0;
+    if (!backdrop_apply_frame(&tiles, &bytes)) {
+        ESP_LOGE(TAG, "frame %d is corrupt, stopping", s_bd.frame);
+        app_backdrop_stop();
+        return;
+    }
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+
+    portENTER_CRITICAL(&s_bd.stats_lock);
+    s_bd.stats.frames++;
+    s_bd.stats.tiles += tiles;
+    s_bd.psram_bytes += bytes;
+    s_bd.apply_sum_us += us;
+    s_bd.stats.apply_max_us = MAX(s_bd.stats.apply_max_us, us);
+    portEXIT_CRITICAL(&s_bd.stats_lock);
+}
+
+static void backdrop_render_start_cb(lv_event_t *e)
+{
+    s_bd.render_start_us = esp_timer_get_time();
+}
+
+static void backdrop_render_ready_cb(lv_event_t *e)
+{
+    if (!s_bd.img || !s_bd.render_start_us) {
+        return;
+    }
+    uint32_t us = (uint32_t)(esp_timer_get_time() - s_bd.render_start_us);
+    portENTER_CRITICAL(&s_bd.stats_lock);
+    s_bd.stats.renders++;
+    s_bd.render_sum_us += us;
+    portEXIT_CRITICAL(&s_bd.stats_lock);
+}
+
+/* Nothing to update while another page is shown, catch up with the next frame once back */
+static void backdrop_screen_cb(lv_event_t *e)
+{
+    if (!s_bd.timer) {
+        return;
+    }
+    s_bd.paused = lv_event_get_code(e) == LV_EVENT_SCREEN_UNLOADED;
+    if (s_bd.paused) {
+        lv_timer_pause(s_bd.timer);
+    } else {
+        lv_timer_resume(s_bd.timer);
+    }
+}
+
+/* Whoever deletes the image, its screen included, the playback ends with it */
+static void backdrop_img_delete_cb(lv_event_t *e)
+{
+    s_bd.img = NULL;
+    lv_obj_remove_event_cb(s_bd.screen, backdrop_screen_cb);
+    s_bd.screen = NULL;
+    if (s_bd.timer) {
+        lv_timer_delete(s_bd.timer);
+        s_bd.timer = NULL;
+    }
+    lv_image_cache_drop(&s_bd.dsc);
+    heap_caps_free(s_bd.px);
+    s_bd.px = NULL;
+}
+
+esp_err_t app_backdrop_start(lv_obj_t *screen)
+{
+    ESP_RETURN_ON_FALSE(screen, ESP_ERR_INVALID_ARG, TAG, "screen is required");
+    ESP_RETURN_ON_FALSE(!s_bd.img, ESP_ERR_INVALID_STATE, TAG, "already playing");
+    if (!s_bd.hdr && backdrop_map() != ESP_OK) {
+        /* Not fatal, the screen keeps its plain background */
+        return ESP_OK;
+    }
+
+    const backdrop_header_t *hdr = s_bd.hdr;
+    size_t size = hdr->width * hdr->height * sizeof(uint16_t);
+    s_bd.px = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    ESP_RETURN_ON_FALSE(s_bd.px, ESP_ERR_NO_MEM, TAG, "no memory for the background");
+    if (!backdrop_decode_rect(s_bd.data, hdr->key_len, s_bd.px, hdr->width, hdr->width, hdr->height)) {
+        heap_caps_free(s_bd.px);
+        s_bd.px = NULL;
+        ESP_LOGE(TAG, "keyframe does not decode");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    s_bd.next = s_bd.data + hdr->key_len;
+    s_bd.frame = 0;
+
+    s_bd.dsc = (lv_image_dsc_t) {
+        .header = {
+            .magic = LV_IMAGE_HEADER_MAGIC,
+            .cf = LV_COLOR_FORMAT_RGB565,
+            .w = hdr->width,
+            .h = hdr->height,
+            .stride = hdr->width * sizeof(uint16_t),
+        },
+        .data_size = size,
+        .data = (const uint8_t *)s_bd.px,
+    };
+    s_bd.img = lv_image_create(screen);
+    lv_image_set_src(s_bd.img, &s_bd.dsc);
+    lv_obj_remove_flag(s_bd.img, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_flag(s_bd.img, LV_OBJ_FLAG_FLOATING);
+    lv_obj_set_pos(s_bd.img, 0, 0);
+    lv_obj_move_to_index(s_bd.img, 0);
+    lv_obj_add_event_cb(s_bd.img, backdrop_img_delete_cb, LV_EVENT_DELETE, NULL);
+    s_bd.timer = lv_timer_create(backdrop_timer_cb, hdr->frame_ms, NULL);
+    s_bd.screen = screen;
+    lv_obj_add_event_cb(screen, backdrop_screen_cb, LV_EVENT_SCREEN_UNLOADED, NULL);
+    lv_obj_add_event_cb(screen, backdrop_screen_cb, LV_EVENT_SCREEN_LOADED, NULL);
+    s_bd.paused = screen != lv_display_get_screen_active(lv_obj_get_display(screen));
+    if (s_bd.paused) {
+        lv_timer_pause(s_bd.timer);
+    }
+
+    lv_display_t *disp = lv_obj_get_display(screen);
+    if (disp != s_bd.disp) {
+        s_bd.disp = disp;
+        lv_display_add_event_cb(disp, backdrop_render_start_cb, LV_EVENT_RENDER_START, NULL);
+        lv_display_add_event_cb(disp, backdrop_render_ready_cb, LV_EVENT_RENDER_READY, NULL);
+    }
+    ESP_LOGI(TAG, "playing %dx%d frames=%d frame_ms=%d tile=%d flash_bytes=%u", hdr->width, hdr->height,
+             hdr->frames, hdr->frame_ms, hdr->tile, (unsigned)(sizeof(*hdr) + hdr->data_len));
+    return ESP_OK;
+}
+
+void app_backdrop_stop(void)
+{
+    if (s_bd.img) {
+        lv_obj_delete(s_bd.img);
+    }
+}
+
+void app_backdrop_get_stats(app_backdrop_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_bd.stats_lock);
+    *stats = s_bd.stats;
+    stats->apply_avg_us = stats->frames ? (uint32_t)(s_bd.apply_sum_us / stats->frames) : 0;
+    stats->psram_bytes_avg = stats->frames ? (uint32_t)(s_bd.psram_bytes / stats->frames) : 0;
+    stats->render_avg_us = stats->renders ? (uint32_t)(s_bd.render_sum_us / stats->renders) : 0;
+    memset(&s_bd.stats, 0, sizeof(s_bd.stats));
+    s_bd.apply_sum_us = 0;
+    s_bd.psram_bytes = 0;
+    s_bd.render_sum_us = 0;
+    portEXIT_CRITICAL(&s_bd.stats_lock);
+    stats->full_frame_bytes = s_bd.hdr ? s_bd.hdr->width * s_bd.hdr->height * sizeof(uint16_t) : 0;
+}
+
+static int backdrop_cmd(int argc, char **argv)
+{
+    bool start = argc == 2 && strcmp(argv[1], "start") == 0;
+    if (start || (argc == 2 && strcmp(argv[1], "stop") == 0)) {
+        esp_err_t err = ESP_OK;
+        lvgl_port_lock(0);
+        if (start) {
+            err = app_backdrop_start(lv_screen_active());
+        } else {
+            app_backdrop_stop();
+        }
+        lvgl_port_unlock();
+        if (err != ESP_OK) {
+            printf("backdrop: %s\n", esp_err_to_name(err));
+            return 1;
+        }
+    }
+
+    app_backdrop_stats_t st;
+    app_backdrop_get_stats(&st);
+    printf("backdrop: playing=%d paused=%d frames=%" PRIu32 " tiles_avg=%" PRIu32 " apply_avg_us=%" PRIu32 " apply_max_us=%" PRIu32
+           " psram_bytes_avg=%" PRIu32 " full_frame_bytes=%" PRIu32 " renders=%" PRIu32 " render_avg_us=%" PRIu32 "\n",
+           s_bd.img != NULL, s_bd.img && s_bd.paused, st.frames, st.frames ? st.tiles / st.frames : 0, st.apply_avg_us, st.apply_max_us,
+           st.psram_bytes_avg, st.full_frame_bytes, st.renders, st.render_avg_us);
+    return 0;
+}
+
+esp_err_t app_backdrop_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "backdrop",
+        .help = "Show the animated background counters since the last call: backdrop [start|stop]",
+        .func = backdrop_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
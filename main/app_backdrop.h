@@ -0,0 +1,57 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t frames;                /*!< Animation frames applied */
+    uint32_t tiles;                 /*!< Changed tiles written and invalidated */
+    uint32_t apply_avg_us;          /*!< Per frame, decoding its tiles into the background */
+    uint32_t apply_max_us;
+    uint32_t psram_bytes_avg;       /*!< Written to the background per frame */
+    uint32_t full_frame_bytes;      /*!< What a whole frame would write */
+    uint32_t renders;               /*!< Display renders meanwhile */
+    uint32_t render_avg_us;
+} app_backdrop_stats_t;
+
+/**
+ * @brief Play the animation written by build_backdrop.js to the "backdrop" partition behind `screen`
+ *
+ * The keyframe is decoded into a background image in PSRAM, which becomes the bottom child of
+ * `screen`. Each frame then only overwrites and invalidates the tiles that changed, the widgets
+ * above are drawn over them as usual. Under full refresh the whole screen is still redrawn
+ * every frame, only the PSRAM writes stay small. Playback pauses while `screen` is not the active screen.
+ * Without a valid animation nothing is shown, which is not an error. Must be called with the
+ * LVGL lock held.
+ */
+esp_err_t app_backdrop_start(lv_obj_t *screen);
+
+/**
+ * @brief Remove the background and free it, also done when its screen is deleted
+ *
+ * Must be called with the LVGL lock held.
+ */
+void app_backdrop_stop(void);
+
+/**
+ * @brief Read the playback counters and clear them
+ */
+void app_backdrop_get_stats(app_backdrop_stats_t *stats);
+
+/**
+ * @brief Add the "backdrop" console command
+ */
+esp_err_t app_backdrop_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,108 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "app_bind.h"
+
+static const char *TAG = "bind";
+
+typedef struct {
+    app_bind_format_cb_t format;
+    void *user_data;
+} binding_t;
+
+/* Only touched from the LVGL task */
+static app_bind_stats_t s_stats;
+
+static void bind_set_text(lv_obj_t *label, const char *text)
+{
+    s_stats.notifications++;
+#if !CONFIG_APP_BIND_ALWAYS_SET
+    /* lv_label_set_text() invalidates even when the text is the same */
+    if (strcmp(lv_label_get_text(label), text) == 0) {
+        s_stats.suppressed++;
+        return;
+    }
+#endif
+    s_stats.applied++;
+    lv_label_set_text(label, text);
+}
+
+static void bind_observer_cb(lv_observer_t *observer, lv_subject_t *subject)
+{
+    binding_t *binding = lv_observer_get_user_data(observer);
+    char text[APP_BIND_TEXT_MAX];
+
+    binding->format(subject, text, sizeof(text), binding->user_data);
+    bind_set_text(lv_observer_get_target_obj(observer), text);
+}
+
+static void bind_string_observer_cb(lv_observer_t *observer, lv_subject_t *subject)
+{
+    bind_set_text(lv_observer_get_target_obj(observer), lv_subject_get_string(subject));
+}
+
+static void bind_label_delete_cb(lv_event_t *e)
+{
+    lv_free(lv_event_get_user_data(e));
+}
+
+static void bind_invalidate_cb(lv_event_t *e)
+{
+    const lv_area_t *area = lv_event_get_param(e);
+    s_stats.invalidated_px += lv_area_get_size(area);
+}
+
+static void bind_log_timer_cb(lv_timer_t *timer)
+{
+    app_bind_log_stats();
+}
+
+esp_err_t app_bind_init(lv_display_t *disp)
+{
+    ESP_RETURN_ON_FALSE(disp, ESP_ERR_INVALID_ARG, TAG, "display is required");
+
+    lv_display_add_event_cb(disp, bind_invalidate_cb, LV_EVENT_INVALIDATE_AREA, NULL);
+    if (CONFIG_APP_MODEL_STATS_PERIOD_S) {
+        lv_timer_create(bind_log_timer_cb, CONFIG_APP_MODEL_STATS_PERIOD_S * 1000, NULL);
+    }
+    return ESP_OK;
+}
+
+lv_observer_t *app_bind_label(lv_obj_t *label, lv_subject_t *subject, app_bind_format_cb_t format, void *user_data)
+{
+    ESP_RETURN_ON_FALSE(label && subject && format, NULL, TAG, "invalid argument");
+
+    binding_t *binding = lv_malloc(sizeof(binding_t));
+    ESP_RETURN_ON_FALSE(binding, NULL, TAG, "no memory for binding");
+    binding->format = format;
+    binding->user_data = user_data;
+    lv_obj_add_event_cb(label, bind_label_delete_cb, LV_EVENT_DELETE, binding);
+
+    return lv_subject_add_observer_obj(subject, bind_observer_cb, label, binding);
+}
+
+lv_observer_t *app_bind_label_string(lv_obj_t *label, lv_subject_t *subject)
+{
+    ESP_RETURN_ON_FALSE(label && subject, NULL, TAG, "invalid argument");
+    return lv_subject_add_observer_obj(subject, bind_string_observer_cb, label, NULL);
+}
+
+void app_bind_get_stats(app_bind_stats_t *stats)
+{
+    *stats = s_stats;
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+void app_bind_log_stats(void)
+{
+    app_bind_stats_t st;
+    app_bind_get_stats(&st);
+    ESP_LOGI(TAG, "notified=%"PRIu32" applied=%"PRIu32" suppressed=%"PRIu32" invalidated_px=%"PRIu64,
+             st.notifications, st.applied, st.suppressed, st.invalidated_px);
+}
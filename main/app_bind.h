@@ -0,0 +1,62 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_BIND_TEXT_MAX   (48)
+
+/**
+ * @brief Turn the subject's value into the label text
+ */
+typedef void (*app_bind_format_cb_t)(lv_subject_t *subject, char *buf, size_t len, void *user_data);
+
+typedef struct {
+    uint32_t notifications;     /*!< Subject changes seen by bound labels */
+    uint32_t applied;           /*!< Label texts changed, each one invalidates the label */
+    uint32_t suppressed;        /*!< Notifications whose formatted text was unchanged */
+    uint64_t invalidated_px;    /*!< Pixels invalidated on the display, from any source */
+} app_bind_stats_t;
+
+/**
+ * @brief Start counting invalidated area on `disp`
+ *
+ * Must be called with the LVGL lock held.
+ */
+esp_err_t app_bind_init(lv_display_t *disp);
+
+/**
+ * @brief Keep `label` showing `subject` formatted by `format`
+ *
+ * The label text is only set, and the label only invalidated, when the formatted
+ * text differs from what is shown.
+ */
+lv_observer_t *app_bind_label(lv_obj_t *label, lv_subject_t *subject, app_bind_format_cb_t format, void *user_data);
+
+/**
+ * @brief Like app_bind_label() for string subjects shown verbatim
+ */
+lv_observer_t *app_bind_label_string(lv_obj_t *label, lv_subject_t *subject);
+
+/**
+ * @brief Read statistics and clear them
+ */
+void app_bind_get_stats(app_bind_stats_t *stats);
+
+/**
+ * @brief Log the statistics as one line and clear them
+ */
+void app_bind_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
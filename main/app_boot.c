@@ -0,0 +1,310 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+#include "esp_crc.h"
+#include "app_render.h"
+#include "app_timeline.h"
+#include "app_boot.h"
+
+#define BOOT_FRAME_MAGIC            (0x46425753)    /* "SWBF" */
+#define BOOT_PARTITION_SUBTYPE      (0x40)
+#define BOOT_PARTITION_LABEL        "splash"
+#define BOOT_RLE_RUN                (0x8000)        /* Run of one pixel, else a literal pixel count */
+#define BOOT_RLE_MAX                (0x7FFF)
+#define BOOT_WRITER_STACK           (3072)
+
+static const char *TAG = "boot";
+
+/* Start of the "splash" partition, followed by `data_len` bytes of RLE encoded RGB565 pixels */
+typedef struct {
+    uint32_t magic;
+    uint16_t width;
+    uint16_t height;
+    uint32_t data_len;
+    uint32_t crc;                   /* esp_crc32_le() of the data */
+} boot_frame_header_t;
+
+static struct {
+    lv_display_t *disp;
+    int64_t first_pixel_us;
+    int64_t interactive_us;
+    bool report_pending;            /* Report once the first frame of the live UI is flushed */
+    bool cached_shown;
+#if CONFIG_APP_BOOT_CACHED_FRAME
+    const esp_partition_t *part;
+    lv_obj_t *cached_img;
+    lv_image_dsc_t cached_dsc;
+    bool save_requested;
+    uint32_t saved_crc;             /* CRC of the frame in flash, to skip unchanged frames */
+    uint8_t *volatile save_buf;     /* Header and data handed to the writer task */
+    size_t save_len;
+    TaskHandle_t writer;
+#endif
+} s_boot;
+
+#if CONFIG_APP_BOOT_CACHED_FRAME
+/* Runs of 3 or more equal pixels become (BOOT_RLE_RUN | n, pixel), anything else (n, pixels...) */
+static size_t boot_rle_encode(const uint16_t *px, size_t count, uint16_t *out, size_t out_max)
+{
+    size_t i = 0;
+    size_t o = 0;
+    while (i < count) {
+        size_t run = 1;
+        while (i + run < count && run < BOOT_RLE_MAX && px[i + run] == px[i]) {
+            run++;
+        }
+        if (run >= 3) {
+            if (o + 2 > out_max) {
+                return 0;
+            }
+            out[o++] = BOOT_RLE_RUN | run;
+            out[o++] = px[i];
+            i += run;
+            continue;
+        }
+
+        size_t lit = 0;
+        while (i + lit < count && lit < BOOT_RLE_MAX &&
+                !(i + lit + 2 < count && px[i + lit] == px[i + lit + 1] && px[i + lit] == px[i + lit + 2])) {
+            lit++;
+        }
+        if (o + 1 + lit > out_max) {
+            return 0;
+        }
+        out[o++] = lit;
+        memcpy(&out[o], &px[i], lit * sizeof(uint16_t));
+        o += lit;
+        i += lit;
+    }
+    return o;
+}
+
+static bool boot_rle_decode(const uint16_t *in, size_t in_len, uint16_t *px, size_t count)
+{
+    size_t i = 0;
+    size_t o = 0;
+    while (i < in_len && o < count) {
+        size_t n = in[i] & BOOT_RLE_MAX;
+        bool run = in[i++] & BOOT_RLE_RUN;
+        if (o + n > count || i + (run ? 1 : n) > in_len) {
+            return false;
+        }
+        if (run) {
+            for (size_t k = 0; k < n; k++) {
+                px[o++] = in[i];
+            }
+            i++;
+        } else {
+            memcpy(&px[o], &in[i], n * sizeof(uint16_t));
+            i += n;
+            o += n;
+        }
+    }
+    return o == count;
+}
+
+static void boot_writer_task(void *arg)
+{
+    const esp_partition_t *part = s_boot.part;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        const boot_frame_header_t *hdr = (const boot_frame_header_t *)s_boot.save_buf;
+        size_t erase_len = (s_boot.save_len + part->erase_size - 1) / part->erase_size * part->erase_size;
+        int64_t start = esp_timer_get_time();
+
+        /* The header goes last, so an interrupted write leaves no valid frame behind */
+        esp_err_t err = esp_partition_erase_range(part, 0, erase_len);
+        if (err == ESP_OK) {
+            err = esp_partition_write(part, sizeof(*hdr), s_boot.save_buf + sizeof(*hdr), s_boot.save_len - sizeof(*hdr));
+        }
+        if (err == ESP_OK) {
+            err = esp_partition_write(part, 0, hdr, sizeof(*hdr));
+        }
+        if (err == ESP_OK) {
+            s_boot.saved_crc = hdr->crc;
+            ESP_LOGI(TAG, "Cached frame saved, %u bytes in %"PRId64" ms", (unsigned)s_boot.save_len,
+                     (esp_timer_get_time() - start) / 1000);
+        } else {
+            ESP_LOGW(TAG, "Saving cached frame failed: %s", esp_err_to_name(err));
+        }
+        heap_caps_free(s_boot.save_buf);
+        s_boot.save_buf = NULL;
+    }
+}
+
+/* Runs in the LVGL task while `buf` holds the complete frame about to be flushed */
+static void boot_capture(const lv_draw_buf_t *buf)
+{
+    int32_t w = lv_display_get_horizontal_resolution(s_boot.disp);
+    int32_t h = lv_display_get_vertical_resolution(s_boot.disp);
+    if (s_boot.save_buf || !buf || buf->header.stride != w * sizeof(uint16_t) || buf->header.h < h) {
+        return;
+    }
+
+    uint8_t *out = heap_caps_malloc(s_boot.part->size, MALLOC_CAP_SPIRAM);
+    if (!out) {
+        ESP_LOGW(TAG, "No memory to cache the frame");
+        return;
+    }
+    boot_frame_header_t *hdr = (boot_frame_header_t *)out;
+    size_t words = boot_rle_encode((const uint16_t *)buf->data, w * h, (uint16_t *)(hdr + 1),
+                                   (s_boot.part->size - sizeof(*hdr)) / sizeof(uint16_t));
+    if (!words) {
+        ESP_LOGW(TAG, "Frame does not fit the %s partition", BOOT_PARTITION_LABEL);
+        heap_caps_free(out);
+        return;
+    }
+
+    *hdr = (boot_frame_header_t) {
+        .magic = BOOT_FRAME_MAGIC,
+        .width = w,
+        .height = h,
+        .data_len = words * sizeof(uint16_t),
+    };
+    hdr->crc = esp_crc32_le(0, (const uint8_t *)(hdr + 1), hdr->data_len);
+    if (hdr->crc == s_boot.saved_crc) {
+        heap_caps_free(out);
+        return;
+    }
+    s_boot.save_len = sizeof(*hdr) + hdr->data_len;
+    s_boot.save_buf = out;
+    xTaskNotifyGive(s_boot.writer);
+}
+
+static void boot_flush_start_cb(lv_event_t *e)
+{
+    if (s_boot.save_requested && !s_boot.cached_img) {
+        s_boot.save_requested = false;
+        boot_capture(lv_display_get_buf_active(s_boot.disp));
+    }
+}
+
+static void boot_save_timer_cb(lv_timer_t *timer)
+{
+    /* Full refresh: the next render covers the whole screen */
+    s_boot.save_requested = true;
+    lv_obj_invalidate(lv_screen_active());
+    lv_timer_set_period(timer, CONFIG_APP_BOOT_FRAME_SAVE_PERIOD_S * 1000);
+}
+
+static esp_err_t boot_load_frame(void)
+{
+    int32_t w = lv_display_get_horizontal_resolution(s_boot.disp);
+    int32_t h = lv_display_get_vertical_resolution(s_boot.disp);
+    const void *map = NULL;
+    esp_partition_mmap_handle_t map_handle;
+    ESP_RETURN_ON_ERROR(esp_partition_mmap(s_boot.part, 0, s_boot.part->size, ESP_PARTITION_MMAP_DATA, &map, &map_handle),
+                        TAG, "map %s partition failed", BOOT_PARTITION_LABEL);
+
+    esp_err_t ret = ESP_OK;
+    uint16_t *px = NULL;
+    const boot_frame_header_t *hdr = map;
+    if (hdr->magic != BOOT_FRAME_MAGIC || hdr->width != w || hdr->height != h ||
+            hdr->data_len > s_boot.part->size - sizeof(*hdr)) {
+        ESP_LOGI(TAG, "No cached frame");
+        goto out;
+    }
+    ESP_GOTO_ON_FALSE(esp_crc32_le(0, (const uint8_t *)(hdr + 1), hdr->data_len) == hdr->crc, ESP_ERR_INVALID_CRC, out,
+                      TAG, "cached frame is corrupt");
+    s_boot.saved_crc = hdr->crc;
+
+    px = heap_caps_malloc(w * h * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+    ESP_GOTO_ON_FALSE(px, ESP_ERR_NO_MEM, out, TAG, "no memory for cached frame");
+    ESP_GOTO_ON_FALSE(boot_rle_decode((const uint16_t *)(hdr + 1), hdr->data_len / sizeof(uint16_t), px, w * h),
+                      ESP_ERR_INVALID_SIZE, out, TAG, "cached frame does not decode");
+
+    s_boot.cached_dsc = (lv_image_dsc_t) {
+        .header = {
+            .magic = LV_IMAGE_HEADER_MAGIC,
+            .cf = LV_COLOR_FORMAT_RGB565,
+            .w = w,
+            .h = h,
+            .stride = w * sizeof(uint16_t),
+        },
+        .data_size = w * h * sizeof(uint16_t),
+        .data = (const uint8_t *)px,
+    };
+    s_boot.cached_img = lv_image_create(lv_layer_top());
+    lv_image_set_src(s_boot.cached_img, &s_boot.cached_dsc);
+    lv_obj_set_pos(s_boot.cached_img, 0, 0);
+    s_boot.cached_shown = true;
+    px = NULL;
+
+out:
+    heap_caps_free(px);
+    esp_partition_munmap(map_handle);
+    return ret;
+}
+#endif
+
+static void boot_flush_finish_cb(lv_event_t *e)
+{
+    int64_t now = esp_timer_get_time();
+    if (!s_boot.first_pixel_us) {
+        s_boot.first_pixel_us = now;
+        app_timeline_mark(APP_TIMELINE_FIRST_FRAME);
+    }
+    if (s_boot.report_pending) {
+        s_boot.report_pending = false;
+        s_boot.interactive_us = now;
+        /* esp_timer starts counting in the startup code, after the ROM and the bootloader */
+        ESP_LOGI(TAG, "first_pixel_ms=%"PRId64" interactive_ms=%"PRId64" cached_frame=%d", s_boot.first_pixel_us / 1000,
+                 s_boot.interactive_us / 1000, s_boot.cached_shown);
+        app_timeline_mark(APP_TIMELINE_INTERACTIVE);
+    }
+}
+
+esp_err_t app_boot_show_cached_frame(lv_display_t *disp)
+{
+    ESP_RETURN_ON_FALSE(disp, ESP_ERR_INVALID_ARG, TAG, "display is required");
+    s_boot.disp = disp;
+    lv_display_add_event_cb(disp, boot_flush_finish_cb, LV_EVENT_FLUSH_FINISH, NULL);
+
+#if CONFIG_APP_BOOT_CACHED_FRAME
+    s_boot.part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, BOOT_PARTITION_SUBTYPE, BOOT_PARTITION_LABEL);
+    if (!s_boot.part) {
+        /* Not fatal, the boot just starts with a blank panel */
+        ESP_LOGW(TAG, "No %s partition, frame caching disabled", BOOT_PARTITION_LABEL);
+        return ESP_OK;
+    }
+    lv_display_add_event_cb(disp, boot_flush_start_cb, LV_EVENT_FLUSH_START, NULL);
+    BaseType_t res = xTaskCreatePinnedToCore(boot_writer_task, "boot_cache", BOOT_WRITER_STACK, NULL, 1, &s_boot.writer,
+                                             app_render_background_core());
+    ESP_RETURN_ON_FALSE(res == pdPASS, ESP_ERR_NO_MEM, TAG, "create writer task failed");
+
+    if (boot_load_frame() != ESP_OK) {
+        ESP_LOGW(TAG, "Starting without the cached frame");
+    }
+#endif
+    return ESP_OK;
+}
+
+void app_boot_mark_interactive(void)
+{
+    s_boot.report_pending = true;
+    lv_obj_invalidate(lv_screen_active());
+
+#if CONFIG_APP_BOOT_CACHED_FRAME
+    if (s_boot.cached_img) {
+        lv_obj_delete(s_boot.cached_img);
+        s_boot.cached_img = NULL;
+        lv_image_cache_drop(&s_boot.cached_dsc);
+        heap_caps_free((void *)s_boot.cached_dsc.data);
+        s_boot.cached_dsc.data = NULL;
+    }
+    if (s_boot.part) {
+        lv_timer_create(boot_save_timer_cb, CONFIG_APP_BOOT_FRAME_SAVE_DELAY_S * 1000, NULL);
+    }
+#endif
+}
@@ -0,0 +1,32 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Show the frame cached in the "splash" partition and start timing the boot
+ *
+ * The cached frame covers the screen on the top layer until app_boot_mark_interactive().
+ * Must be called with the LVGL lock held, right after the display is added.
+ */
+esp_err_t app_boot_show_cached_frame(lv_display_t *disp);
+
+/**
+ * @brief The UI is built and takes touch input: drop the cached frame and report the boot times
+ *
+ * Must be called with the LVGL lock held. Logs "boot: first_pixel_ms= interactive_ms=" once
+ * the next frame reaches the panel, then keeps the cache up to date.
+ */
+void app_boot_mark_interactive(void);
+
+#ifdef __cplusplus
+}
+#endif
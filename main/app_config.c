@@ -0,0 +1,444 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_console.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "app_config.h"
+
+#define CFG_TASK_STACK        (3072)
+#define CFG_SNAPSHOTS         (4)         /* The current one and three a reader may still hold */
+#define CFG_MAX_LISTENERS     (4)
+/* A steady stream of changes is still applied this often */
+#define CFG_MAX_DEFER_US      (CONFIG_APP_CONFIG_COMMIT_DELAY_MS * 5 * 1000LL)
+#define CFG_NVS_NAMESPACE     "app_config"
+
+static const char *TAG = "config";
+
+typedef struct {
+    const char *name;               /* NVS key, at most 15 characters */
+    app_config_type_t type;
+    size_t offset;                  /* Of the field in app_config_t */
+    size_t size;                    /* Of the field, a string holds at most size - 1 characters */
+    uint32_t min;                   /* Range of a number */
+    uint32_t max;
+    uint32_t def_u32;
+    const char *def_str;
+    bool (*valid)(const char *value);   /* Extra check of a string */
+} config_item_t;
+
+static bool config_valid_cities(const char *value)
+{
+    return strspn(value, "0123456789, ") == strlen(value);
+}
+
+static bool config_valid_broker(const char *value)
+{
+    static const char *const schemes[] = { "mqtt://", "mqtts://", "ws://", "wss://" };
+    if (!value[0]) {
+        return true;
+    }
+    for (int i = 0; i < sizeof(schemes) / sizeof(schemes[0]); i++) {
+        if (strncmp(value, schemes[i], strlen(schemes[i])) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#define CFG_FIELD(f)     .offset = offsetof(app_config_t, f), .size = sizeof(((app_config_t *)0)->f)
+
+static const config_item_t s_schema[APP_CONFIG_KEY_MAX] = {
+    [APP_CONFIG_WEATHER_CITIES] = {
+        .name = "wx_cities",
+        .type = APP_CONFIG_TYPE_STR,
+        CFG_FIELD(weather_cities),
+        .def_str = CONFIG_APP_WEATHER_CITIES,
+        .valid = config_valid_cities,
+    },
+    [APP_CONFIG_WEATHER_REFRESH_S] = {
+        .name = "wx_refresh_s",
+        .type = APP_CONFIG_TYPE_U32,
+        CFG_FIELD(weather_refresh_s),
+        .min = 0,
+        .max = 24 * 3600,
+        .def_u32 = CONFIG_APP_WEATHER_REFRESH_S,
+    },
+    [APP_CONFIG_TELEMETRY_BROKER] = {
+        .name = "tel_broker",
+        .type = APP_CONFIG_TYPE_STR,
+        CFG_FIELD(telemetry_broker),
+#if CONFIG_APP_TELEMETRY
+        .def_str = CONFIG_APP_TELEMETRY_BROKER_URL,
+#else
+        .def_str = "",
+#endif
+        .valid = config_valid_broker,
+    },
+};
+
+static struct {
+    app_config_backend_t backend;
+    app_config_t snapshots[CFG_SNAPSHOTS];
+    atomic_int current;             /* Index of the published snapshot */
+    app_config_t staged;            /* The current snapshot with the changes not applied yet */
+    uint32_t dirty;                 /* Keys changed in `staged` */
+    SemaphoreHandle_t apply_lock;   /* One batch at a time, from the task or app_config_commit() */
+    TaskHandle_t task;
+    struct {
+        app_config_listener_t cb;
+        void *arg;
+    } listeners[CFG_MAX_LISTENERS];
+    int listener_count;
+    app_config_stats_t stats;
+    portMUX_TYPE lock;              /* Guards `staged`, `dirty`, the listeners and the statistics */
+} s_config = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static void *config_field(const app_config_t *cfg, const config_item_t *item)
+{
+    return (uint8_t *)cfg + item->offset;
+}
+
+static bool config_check(const config_item_t *item, const void *value)
+{
+    if (item->type == APP_CONFIG_TYPE_U32) {
+        uint32_t v = *(const uint32_t *)value;
+        return v >= item->min && v <= item->max;
+    }
+    return strlen(value) < item->size && (!item->valid || item->valid(value));
+}
+
+static void config_set_default(const config_item_t *item, app_config_t *cfg)
+{
+    if (item->type == APP_CONFIG_TYPE_U32) {
+        *(uint32_t *)config_field(cfg, item) = item->def_u32;
+    } else {
+        strlcpy(config_field(cfg, item), item->def_str, item->size);
+    }
+}
+
+static esp_err_t nvs_backend_load(void *ctx, const char *key, app_config_type_t type, void *value, size_t size)
+{
+    nvs_handle_t handle = (nvs_handle_t)(uintptr_t)ctx;
+    esp_err_t err = type == APP_CONFIG_TYPE_U32 ? nvs_get_u32(handle, key, value) : nvs_get_str(handle, key, value, &size);
+    return err == ESP_ERR_NVS_NOT_FOUND ? ESP_ERR_NOT_FOUND : err;
+}
+
+static esp_err_t nvs_backend_store(void *ctx, const char *key, app_config_type_t type, const void *value)
+{
+    nvs_handle_t handle = (nvs_handle_t)(uintptr_t)ctx;
+    return type == APP_CONFIG_TYPE_U32 ? nvs_set_u32(handle, key, *(const uint32_t *)value) : nvs_set_str(handle, key, value);
+}
+
+static esp_err_t nvs_backend_commit(void *ctx)
+{
+    return nvs_commit((nvs_handle_t)(uintptr_t)ctx);
+}
+
+/* The handle stays open, a batch costs the writes of its keys and one commit */
+static esp_err_t nvs_backend_init(app_config_backend_t *backend)
+{
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_LOGW(TAG, "erasing NVS: %s", esp_err_to_name(ret));
+        ESP_RETURN_ON_ERROR(nvs_flash_erase(), TAG, "erase NVS failed");
+        ret = nvs_flash_init();
+    }
+    ESP_RETURN_ON_ERROR(ret, TAG, "NVS init failed");
+
+    nvs_handle_t handle;
+    ESP_RETURN_ON_ERROR(nvs_open(CFG_NVS_NAMESPACE, NVS_READWRITE, &handle), TAG, "open NVS failed");
+    *backend = (app_config_backend_t) {
+        .load = nvs_backend_load,
+        .store = nvs_backend_store,
+        .commit = nvs_backend_commit,
+        .ctx = (void *)(uintptr_t)handle,
+    };
+    return ESP_OK;
+}
+
+/* Publish the staged changes, store them with one commit, then tell the listeners */
+static esp_err_t config_apply(void)
+{
+    xSemaphoreTake(s_config.apply_lock, portMAX_DELAY);
+    int slot = (atomic_load(&s_config.current) + 1) % CFG_SNAPSHOTS;
+    portENTER_CRITICAL(&s_config.lock);
+    uint32_t changed = s_config.dirty;
+    s_config.dirty = 0;
+    s_config.snapshots[slot] = s_config.staged;
+    portEXIT_CRITICAL(&s_config.lock);
+    if (!changed) {
+        xSemaphoreGive(s_config.apply_lock);
+        return ESP_OK;
+    }
+    atomic_store(&s_config.current, slot);
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = ESP_OK;
+    uint32_t stored = 0;
+    for (int k = 0; k < APP_CONFIG_KEY_MAX && ret == ESP_OK; k++) {
+        if (changed & (1u << k)) {
+            const config_item_t *item = &s_schema[k];
+            ret = s_config.backend.store(s_config.backend.ctx, item->name, item->type,
+                                         config_field(&s_config.snapshots[slot], item));
+            stored++;
+        }
+    }
+    if (ret == ESP_OK) {
+        ret = s_config.backend.commit(s_config.backend.ctx);
+    }
+    uint32_t ms = (esp_timer_get_time() - start) / 1000;
+
+    portENTER_CRITICAL(&s_config.lock);
+    if (ret != ESP_OK) {
+        /* Readers already have the values, storing them is tried again with the next batch */
+        s_config.dirty |= changed;
+    } else {
+        s_config.stats.batches++;
+        s_config.stats.stored += stored;
+        s_config.stats.commit_max_ms = MAX(s_config.stats.commit_max_ms, ms);
+    }
+    int listeners = s_config.listener_count;
+    portEXIT_CRITICAL(&s_config.lock);
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "storing %" PRIu32 " keys failed: %s", stored, esp_err_to_name(ret));
+        xTaskNotifyGive(s_config.task);
+    } else {
+        ESP_LOGI(TAG, "applied keys=%" PRIu32 " commit_ms=%" PRIu32, stored, ms);
+    }
+    for (int i = 0; i < listeners; i++) {
+        s_config.listeners[i].cb(changed, s_config.listeners[i].arg);
+    }
+    xSemaphoreGive(s_config.apply_lock);
+    return ret;
+}
+
+static void config_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        /* Let the burst end, a settings screen or a remote push changes many keys at once */
+        int64_t deadline = esp_timer_get_time() + CFG_MAX_DEFER_US;
+        while (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONFIG_APP_CONFIG_COMMIT_DELAY_MS)) &&
+                esp_timer_get_time() < deadline) {
+        }
+        config_apply();
+    }
+}
+
+esp_err_t app_config_init(const app_config_backend_t *backend)
+{
+    ESP_RETURN_ON_FALSE(!s_config.task, ESP_ERR_INVALID_STATE, TAG, "already initialized");
+
+    if (backend) {
+        s_config.backend = *backend;
+    } else {
+        ESP_RETURN_ON_ERROR(nvs_backend_init(&s_config.backend), TAG, "NVS backend init failed");
+    }
+
+    app_config_t *cfg = &s_config.snapshots[0];
+    int loaded = 0;
+    for (int k = 0; k < APP_CONFIG_KEY_MAX; k++) {
+        const config_item_t *item = &s_schema[k];
+        void *field = config_field(cfg, item);
+        esp_err_t err = s_config.backend.load(s_config.backend.ctx, item->name, item->type, field, item->size);
+        if (err == ESP_OK && config_check(item, field)) {
+            loaded++;
+            continue;
+        }
+        if (err == ESP_OK) {
+            ESP_LOGW(TAG, "%s: stored value rejected, using the default", item->name);
+        } else if (err != ESP_ERR_NOT_FOUND) {
+            ESP_LOGW(TAG, "%s: %s, using the default", item->name, esp_err_to_name(err));
+        }
+        config_set_default(item, cfg);
+    }
+    s_config.staged = *cfg;
+    atomic_store(&s_config.current, 0);
+
+    s_config.apply_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_config.apply_lock, ESP_ERR_NO_MEM, TAG, "no memory for mutex");
+    BaseType_t res = xTaskCreate(config_task, "config", CFG_TASK_STACK, NULL, 1, &s_config.task);
+    ESP_RETURN_ON_FALSE(res == pdPASS, ESP_ERR_NO_MEM, TAG, "create task failed");
+    ESP_LOGI(TAG, "keys=%d stored=%d delay_ms=%d", APP_CONFIG_KEY_MAX, loaded, CONFIG_APP_CONFIG_COMMIT_DELAY_MS);
+    return ESP_OK;
+}
+
+const app_config_t *app_config_get(void)
+{
+    return &s_config.snapshots[atomic_load(&s_config.current)];
+}
+
+static esp_err_t config_set(app_config_key_t key, app_config_type_t type, const void *value)
+{
+    ESP_RETURN_ON_FALSE(s_config.task, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    ESP_RETURN_ON_FALSE(key < APP_CONFIG_KEY_MAX && s_schema[key].type == type && value, ESP_ERR_INVALID_ARG, TAG,
+                        "invalid argument");
+
+    const config_item_t *item = &s_schema[key];
+    if (!config_check(item, value)) {
+        portENTER_CRITICAL(&s_config.lock);
+        s_config.stats.rejected++;
+        portEXIT_CRITICAL(&s_config.lock);
+        ESP_LOGW(TAG, "%s: value rejected", item->name);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    void *field = config_field(&s_config.staged, item);
+    bool changed;
+    portENTER_CRITICAL(&s_config.lock);
+    if (type == APP_CONFIG_TYPE_U32) {
+        changed = *(uint32_t *)field != *(const uint32_t *)value;
+        *(uint32_t *)field = *(const uint32_t *)value;
+    } else {
+        changed = strcmp(field, value) != 0;
+        strlcpy(field, value, item->size);
+    }
+    if (changed) {
+        s_config.dirty |= 1u << key;
+        s_config.stats.sets++;
+    }
+    portEXIT_CRITICAL(&s_config.lock);
+
+    if (changed) {
+        xTaskNotifyGive(s_config.task);
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_config_set_u32(app_config_key_t key, uint32_t value)
+{
+    return config_set(key, APP_CONFIG_TYPE_U32, &value);
+}
+
+esp_err_t app_config_set_str(app_config_key_t key, const char *value)
+{
+    return config_set(key, APP_CONFIG_TYPE_STR, value);
+}
+
+esp_err_t app_config_set_text(const char *name, const char *text)
+{
+    ESP_RETURN_ON_FALSE(name && text, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    for (int k = 0; k < APP_CONFIG_KEY_MAX; k++) {
+        if (strcmp(name, s_schema[k].name) != 0) {
+            continue;
+        }
+        if (s_schema[k].type == APP_CONFIG_TYPE_STR) {
+            return app_config_set_str(k, text);
+        }
+        char *end;
+        unsigned long v = strtoul(text, &end, 0);
+        ESP_RETURN_ON_FALSE(text[0] && !*end && v <= UINT32_MAX, ESP_ERR_INVALID_ARG, TAG, "%s: not a number", name);
+        return app_config_set_u32(k, v);
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t app_config_commit(void)
+{
+    ESP_RETURN_ON_FALSE(s_config.task, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    return config_apply();
+}
+
+esp_err_t app_config_add_listener(app_config_listener_t listener, void *arg)
+{
+    ESP_RETURN_ON_FALSE(listener, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&s_config.lock);
+    if (s_config.listener_count < CFG_MAX_LISTENERS) {
+        s_config.listeners[s_config.listener_count].cb = listener;
+        s_config.listeners[s_config.listener_count].arg = arg;
+        s_config.listener_count++;
+    } else {
+        ret = ESP_ERR_NO_MEM;
+    }
+    portEXIT_CRITICAL(&s_config.lock);
+    ESP_RETURN_ON_ERROR(ret, TAG, "too many listeners");
+    return ESP_OK;
+}
+
+esp_err_t app_config_get_stats(app_config_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    portENTER_CRITICAL(&s_config.lock);
+    *stats = s_config.stats;
+    memset(&s_config.stats, 0, sizeof(s_config.stats));
+    portEXIT_CRITICAL(&s_config.lock);
+    return ESP_OK;
+}
+
+static int config_cmd(int argc, char **argv)
+{
+    if (argc >= 4 && strcmp(argv[1], "set") == 0) {
+        /* A value with spaces, like a list of cities, comes in several arguments */
+        char value[APP_CONFIG_WEATHER_CITIES_MAX] = "";
+        for (int i = 3; i < argc; i++) {
+            if (i > 3) {
+                strlcat(value, " ", sizeof(value));
+            }
+            strlcat(value, argv[i], sizeof(value));
+        }
+        esp_err_t err = app_config_set_text(argv[2], value);
+        if (err != ESP_OK) {
+            printf("config: %s %s\n", argv[2], err == ESP_ERR_NOT_FOUND ? "is not a key" : "rejected the value");
+            return 1;
+        }
+        return 0;
+    }
+    if (argc == 2 && strcmp(argv[1], "commit") == 0) {
+        return app_config_commit() == ESP_OK ? 0 : 1;
+    }
+    if (argc != 1) {
+        printf("usage: config [set <key> <value> | commit]\n");
+        return 1;
+    }
+
+    const app_config_t *cfg = app_config_get();
+    for (int k = 0; k < APP_CONFIG_KEY_MAX; k++) {
+        const config_item_t *item = &s_schema[k];
+        if (item->type == APP_CONFIG_TYPE_U32) {
+            printf("  %-14s %" PRIu32 "\n", item->name, *(const uint32_t *)config_field(cfg, item));
+        } else {
+            printf("  %-14s \"%s\"\n", item->name, (const char *)config_field(cfg, item));
+        }
+    }
+    app_config_stats_t st;
+    app_config_get_stats(&st);
+    portENTER_CRITICAL(&s_config.lock);
+    int staged = __builtin_popcount(s_config.dirty);
+    portEXIT_CRITICAL(&s_config.lock);
+    printf("config: sets=%" PRIu32 " rejected=%" PRIu32 " batches=%" PRIu32 " stored=%" PRIu32 " commit_max_ms=%" PRIu32
+           " staged=%d\n", st.sets, st.rejected, st.batches, st.stored, st.commit_max_ms, staged);
+    return 0;
+}
+
+esp_err_t app_config_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "config",
+        .help = "Show the settings and how many changes were batched into how many commits, or change one: "
+                "config [set <key> <value> | commit]",
+        .func = config_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,121 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_CONFIG_WEATHER_CITIES_MAX   (128)
+#define APP_CONFIG_BROKER_URL_MAX       (96)
+
+typedef enum {
+    APP_CONFIG_WEATHER_CITIES,      /*!< Space or comma separated city codes */
+    APP_CONFIG_WEATHER_REFRESH_S,   /*!< 0 refreshes only on request */
+    APP_CONFIG_TELEMETRY_BROKER,    /*!< Empty keeps telemetry offline */
+    APP_CONFIG_KEY_MAX,
+} app_config_key_t;
+
+typedef enum {
+    APP_CONFIG_TYPE_U32,
+    APP_CONFIG_TYPE_STR,
+} app_config_type_t;
+
+/**
+ * @brief Every setting, as last applied. Snapshots are never modified once published.
+ */
+typedef struct {
+    char weather_cities[APP_CONFIG_WEATHER_CITIES_MAX];
+    uint32_t weather_refresh_s;
+    char telemetry_broker[APP_CONFIG_BROKER_URL_MAX];
+} app_config_t;
+
+/**
+ * @brief Where settings are kept, NVS or a mock
+ *
+ * `load` returns ESP_ERR_NOT_FOUND for a key that was never stored. `store` may only stage
+ * the value, `commit` makes everything staged since the last commit durable at once.
+ */
+typedef struct {
+    esp_err_t (*load)(void *ctx, const char *key, app_config_type_t type, void *value, size_t size);
+    esp_err_t (*store)(void *ctx, const char *key, app_config_type_t type, const void *value);
+    esp_err_t (*commit)(void *ctx);
+    void *ctx;
+} app_config_backend_t;
+
+/**
+ * @brief Called from the config task after a batch was applied, bit n of `changed` for app_config_key_t n
+ */
+typedef void (*app_config_listener_t)(uint32_t changed, void *arg);
+
+typedef struct {
+    uint32_t sets;                  /*!< Values changed */
+    uint32_t rejected;              /*!< Values out of range or malformed */
+    uint32_t batches;               /*!< Snapshots published, each with one commit */
+    uint32_t stored;                /*!< Keys written to the backend */
+    uint32_t commit_max_ms;         /*!< Longest store and commit of a batch */
+} app_config_stats_t;
+
+/**
+ * @brief Load every setting once, falling back to its default, and start the config task
+ *
+ * `backend` NULL selects NVS, which is initialized here, erasing it when its layout changed.
+ * Call before anything reads a setting or uses NVS.
+ */
+esp_err_t app_config_init(const app_config_backend_t *backend);
+
+/**
+ * @brief The current snapshot, without locking
+ *
+ * A snapshot stays valid until three more batches were applied, at least three times
+ * CONFIG_APP_CONFIG_COMMIT_DELAY_MS. Copy what is kept for longer.
+ */
+const app_config_t *app_config_get(void);
+
+/**
+ * @brief Change a setting
+ *
+ * The value is checked against the schema, then staged. Changes are applied together once
+ * none came for CONFIG_APP_CONFIG_COMMIT_DELAY_MS: a new snapshot is published, the changed
+ * keys are stored with one commit, and the listeners are called.
+ *
+ * @return ESP_ERR_INVALID_ARG when the value is rejected
+ */
+esp_err_t app_config_set_u32(app_config_key_t key, uint32_t value);
+esp_err_t app_config_set_str(app_config_key_t key, const char *value);
+
+/**
+ * @brief Change a setting by its key name, parsing `text` by the type of the key, for the console and remote config
+ */
+esp_err_t app_config_set_text(const char *name, const char *text);
+
+/**
+ * @brief Apply the staged changes now instead of after the delay, e.g. before a reboot
+ */
+esp_err_t app_config_commit(void);
+
+/**
+ * @brief Call `listener` after every batch, listeners are called in the order they were added
+ */
+esp_err_t app_config_add_listener(app_config_listener_t listener, void *arg);
+
+/**
+ * @brief Read the statistics since the last call and clear them
+ */
+esp_err_t app_config_get_stats(app_config_stats_t *stats);
+
+/**
+ * @brief Add the "config" console command
+ */
+esp_err_t app_config_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,42 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_console.h"
+#include "app_console.h"
+
+/* Commands like "fetch" run TLS handshakes on the console task */
+#define CONSOLE_TASK_STACK      (8192)
+
+static const char *TAG = "console";
+
+static esp_console_repl_t *s_repl;
+
+esp_err_t app_console_init(void)
+{
+    esp_console_repl_config_t repl_cfg = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_cfg.prompt = "weather>";
+    repl_cfg.task_stack_size = CONSOLE_TASK_STACK;
+
+#if CONFIG_ESP_CONSOLE_UART_DEFAULT || CONFIG_ESP_CONSOLE_UART_CUSTOM
+    esp_console_dev_uart_config_t dev_cfg = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    ESP_RETURN_ON_ERROR(esp_console_new_repl_uart(&dev_cfg, &repl_cfg, &s_repl), TAG, "create UART REPL failed");
+#elif CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG
+    esp_console_dev_usb_serial_jtag_config_t dev_cfg = ESP_CONSOLE_DEV_USB_SERIAL_JTAG_CONFIG_DEFAULT();
+    ESP_RETURN_ON_ERROR(esp_console_new_repl_usb_serial_jtag(&dev_cfg, &repl_cfg, &s_repl), TAG,
+                        "create USB serial JTAG REPL failed");
+#else
+#error "The console needs a UART or USB serial JTAG console port"
+#endif
+    return ESP_OK;
+}
+
+esp_err_t app_console_start(void)
+{
+    ESP_RETURN_ON_FALSE(s_repl, ESP_ERR_INVALID_STATE, TAG, "console not initialized");
+    ESP_RETURN_ON_ERROR(esp_console_register_help_command(), TAG, "register help failed");
+    return esp_console_start_repl(s_repl);
+}
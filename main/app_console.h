@@ -0,0 +1,27 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Create the console REPL on the configured console port
+ *
+ * Commands can be added with esp_console_cmd_register() until app_console_start().
+ */
+esp_err_t app_console_init(void);
+
+/**
+ * @brief Add the help command and start reading commands
+ */
+esp_err_t app_console_start(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,174 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
+#include "app_bind.h"
+#include "app_shadow.h"
+#include "app_dashboard.h"
+
+#define DASHBOARD_NO_VALUE   INT32_MIN
+
+/* Widgets follow these subjects through app_bind, which only touches a label when its text changes */
+typedef struct {
+    lv_subject_t city;
+    lv_subject_t condition;
+    lv_subject_t temp_c10;
+    lv_subject_t temp_low_c10;
+    lv_subject_t temp_high_c10;
+    lv_subject_t range;             /* Group of temp_low_c10 and temp_high_c10 */
+    lv_subject_t *range_list[2];
+    lv_subject_t sensor_x10[APP_SENSOR_QUANTITY_MAX];
+    char city_buf[sizeof(((app_weather_snapshot_t *)0)->city_name)];
+    char condition_buf[sizeof(((app_weather_snapshot_t *)0)->condition)];
+    bool created;
+} dashboard_t;
+
+static dashboard_t s_dash;
+
+/* LVGL's built-in sprintf has no float support, values are formatted as fixed point */
+static const struct {
+    const char *prefix;
+    const char *unit;
+    int decimals;
+} s_sensor_fmt[APP_SENSOR_QUANTITY_MAX] = {
+    [APP_SENSOR_TEMPERATURE] = { "In ", "C", 1 },
+    [APP_SENSOR_HUMIDITY] = { "", "%RH", 0 },
+    [APP_SENSOR_PRESSURE] = { "", " hPa", 0 },
+    [APP_SENSOR_LIGHT] = { "", " lx", 0 },
+    [APP_SENSOR_AIR_QUALITY] = { "AQI ", "", 0 },
+};
+
+void app_dashboard_format_c10(char *buf, size_t len, int32_t c10)
+{
+    snprintf(buf, len, "%s%d.%dC", c10 < 0 ? "-" : "", (int)abs(c10) / 10, (int)abs(c10) % 10);
+}
+
+void app_dashboard_format_sensor(char *buf, size_t len, app_sensor_quantity_t q, float value)
+{
+    if (s_sensor_fmt[q].decimals) {
+        int32_t v10 = (int32_t)(value * 10.0f + (value < 0 ? -0.5f : 0.5f));
+        snprintf(buf, len, "%s%s%d.%d%s", s_sensor_fmt[q].prefix, v10 < 0 ? "-" : "", (int)abs(v10) / 10,
+                 (int)abs(v10) % 10, s_sensor_fmt[q].unit);
+    } else {
+        snprintf(buf, len, "%s%d%s", s_sensor_fmt[q].prefix, (int)(value + 0.5f), s_sensor_fmt[q].unit);
+    }
+}
+
+/* The colour of the condition group, icons are drawn in it */
+lv_color_t app_dashboard_icon_color(uint8_t icon)
+{
+    if (icon == 0) {
+        return lv_palette_main(LV_PALETTE_ORANGE);
+    } else if (icon <= 2) {
+        return lv_palette_main(LV_PALETTE_GREY);
+    } else if (icon <= 12 || icon == 19 || (icon >= 21 && icon <= 25)) {
+        return lv_palette_main(LV_PALETTE_BLUE);
+    } else if (icon <= 17 || (icon >= 26 && icon <= 28)) {
+        return lv_palette_main(LV_PALETTE_CYAN);
+    }
+    return lv_palette_main(LV_PALETTE_BROWN);
+}
+
+static int32_t dashboard_temp(int16_t c10)
+{
+    return c10 == APP_WEATHER_TEMP_NONE ? DASHBOARD_NO_VALUE : c10;
+}
+
+static void dashboard_temp_format_cb(lv_subject_t *subject, char *buf, size_t len, void *user_data)
+{
+    int32_t c10 = lv_subject_get_int(subject);
+    if (c10 == DASHBOARD_NO_VALUE) {
+        snprintf(buf, len, "--C");
+    } else {
+        app_dashboard_format_c10(buf, len, c10);
+    }
+}
+
+static void dashboard_range_format_cb(lv_subject_t *subject, char *buf, size_t len, void *user_data)
+{
+    int32_t low = lv_subject_get_int(lv_subject_get_group_element(subject, 0));
+    int32_t high = lv_subject_get_int(lv_subject_get_group_element(subject, 1));
+    if (low == DASHBOARD_NO_VALUE || high == DASHBOARD_NO_VALUE) {
+        snprintf(buf, len, "--/--");
+    } else {
+        snprintf(buf, len, "%d/%dC", (int)(low / 10), (int)(high / 10));
+    }
+}
+
+static void dashboard_sensor_format_cb(lv_subject_t *subject, char *buf, size_t len, void *user_data)
+{
+    app_sensor_quantity_t q = (app_sensor_quantity_t)(intptr_t)user_data;
+    int32_t x10 = lv_subject_get_int(subject);
+    if (x10 == DASHBOARD_NO_VALUE) {
+        snprintf(buf, len, "--");
+    } else {
+        app_dashboard_format_sensor(buf, len, q, x10 / 10.0f);
+    }
+}
+
+void app_dashboard_create(lv_obj_t *parent)
+{
+    lv_subject_init_string(&s_dash.city, s_dash.city_buf, NULL, sizeof(s_dash.city_buf), "--");
+    lv_subject_init_string(&s_dash.condition, s_dash.condition_buf, NULL, sizeof(s_dash.condition_buf), "--");
+    lv_subject_init_int(&s_dash.temp_c10, DASHBOARD_NO_VALUE);
+    lv_subject_init_int(&s_dash.temp_low_c10, DASHBOARD_NO_VALUE);
+    lv_subject_init_int(&s_dash.temp_high_c10, DASHBOARD_NO_VALUE);
+    s_dash.range_list[0] = &s_dash.temp_low_c10;
+    s_dash.range_list[1] = &s_dash.temp_high_c10;
+    lv_subject_init_group(&s_dash.range, s_dash.range_list, 2);
+    for (int q = 0; q < APP_SENSOR_QUANTITY_MAX; q++) {
+        lv_subject_init_int(&s_dash.sensor_x10[q], DASHBOARD_NO_VALUE);
+    }
+
+    lv_obj_t *bar = lv_obj_create(parent);
+    lv_obj_set_size(bar, LV_PCT(100), LV_SIZE_CONTENT);
+    lv_obj_align(bar, LV_ALIGN_TOP_MID, 0, 0);
+    lv_obj_set_flex_flow(bar, LV_FLEX_FLOW_ROW);
+    lv_obj_set_flex_align(bar, LV_FLEX_ALIGN_SPACE_EVENLY, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
+    lv_obj_remove_flag(bar, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_style_shadow_width(bar, 20, 0);
+    lv_obj_set_style_shadow_offset_y(bar, 4, 0);
+    lv_obj_set_style_shadow_opa(bar, LV_OPA_20, 0);
+#if CONFIG_APP_SHADOW_CACHE
+    app_shadow_attach(bar);
+#endif
+
+    app_bind_label_string(lv_label_create(bar), &s_dash.city);
+    app_bind_label_string(lv_label_create(bar), &s_dash.condition);
+    app_bind_label(lv_label_create(bar), &s_dash.temp_c10, dashboard_temp_format_cb, NULL);
+    app_bind_label(lv_label_create(bar), &s_dash.range, dashboard_range_format_cb, NULL);
+    for (int q = 0; q < APP_SENSOR_QUANTITY_MAX; q++) {
+        app_bind_label(lv_label_create(bar), &s_dash.sensor_x10[q], dashboard_sensor_format_cb, (void *)(intptr_t)q);
+    }
+    s_dash.created = true;
+}
+
+void app_dashboard_apply(const app_weather_snapshot_t *weather, const app_weather_snapshot_t *prev_weather,
+                         const app_sensor_snapshot_t *sensors, const app_sensor_snapshot_t *prev_sensors)
+{
+    if (!s_dash.created) {
+        return;
+    }
+
+    /* Every field is pushed, app_bind drops notifications that would not change the text */
+    if (weather) {
+        lv_subject_copy_string(&s_dash.city, weather->city_name);
+        lv_subject_copy_string(&s_dash.condition, weather->condition);
+        lv_subject_set_int(&s_dash.temp_c10, dashboard_temp(weather->temp_c10));
+        lv_subject_set_int(&s_dash.temp_low_c10, dashboard_temp(weather->temp_low_c10));
+        lv_subject_set_int(&s_dash.temp_high_c10, dashboard_temp(weather->temp_high_c10));
+    }
+
+    if (sensors) {
+        for (int q = 0; q < APP_SENSOR_QUANTITY_MAX; q++) {
+            if (sensors->valid_mask & (1u << q)) {
+                float v = sensors->value[q];
+                lv_subject_set_int(&s_dash.sensor_x10[q], (int32_t)(v * 10.0f + (v < 0 ? -0.5f : 0.5f)));
+            }
+        }
+    }
+}
@@ -0,0 +1,42 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "lvgl.h"
+#include "app_model.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Build the weather and indoor readings strip on top of `parent`
+ */
+void app_dashboard_create(lv_obj_t *parent);
+
+/**
+ * @brief Push the snapshots into the bound subjects, matches app_model_apply_cb_t
+ */
+void app_dashboard_apply(const app_weather_snapshot_t *weather, const app_weather_snapshot_t *prev_weather,
+                         const app_sensor_snapshot_t *sensors, const app_sensor_snapshot_t *prev_sensors);
+
+/**
+ * @brief Format 0.1 degree Celsius as "-1.5C"
+ */
+void app_dashboard_format_c10(char *buf, size_t len, int32_t c10);
+
+/**
+ * @brief Format a sensor value with the unit of its quantity
+ */
+void app_dashboard_format_sensor(char *buf, size_t len, app_sensor_quantity_t q, float value);
+
+/**
+ * @brief Colour standing for the weather condition code `icon`
+ */
+lv_color_t app_dashboard_icon_color(uint8_t icon);
+
+#ifdef __cplusplus
+}
+#endif
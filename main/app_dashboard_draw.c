@@ -0,0 +1,524 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "app_history.h"
+#include "app_render.h"
+#include "app_dashboard.h"
+#include "app_icons.h"
+#include "app_dashboard_draw.h"
+
+#define DASH_TILES          (1 + APP_SENSOR_QUANTITY_MAX + APP_MODEL_MAX_CITIES - 1)
+#define DASH_FIRST_SENSOR   (1)
+#define DASH_FIRST_CITY     (1 + APP_SENSOR_QUANTITY_MAX)
+#define DASH_ROWS           (2)
+#define DASH_GAP            (6)
+#define DASH_PAD            (8)
+#define DASH_LINE_GAP       (2)
+#define DASH_ICON_SIZE      (24)
+#define DASH_DOT_SIZE       (14)
+#define DASH_RADIUS         (6)
+
+static const char *TAG = "dash_draw";
+
+LV_FONT_DECLARE(HarmonyMedium);
+
+typedef struct {
+    char title[24];
+    char value[16];
+    char sub[32];
+    lv_color_t icon_color;
+    uint8_t icon;
+    bool has_icon;
+} dash_text_t;
+
+typedef struct {
+    lv_area_t area;                 /* Relative to the widget, like the areas below */
+    lv_area_t title;
+    lv_area_t value;
+    lv_area_t sub;
+    lv_area_t icon;
+    dash_text_t text;
+    const lv_image_dsc_t *icon_img;     /* Held from app_icons_acquire(), NULL draws a dot */
+} dash_tile_t;
+
+typedef struct {
+    lv_obj_t *obj;
+    dash_tile_t tiles[DASH_TILES];
+} dash_draw_t;
+
+/* Only touched from the LVGL task */
+static dash_draw_t *s_live;
+
+static const lv_font_t *dash_title_font(void)
+{
+    return &lv_font_montserrat_14;
+}
+
+static const lv_font_t *dash_sub_font(void)
+{
+    return &lv_font_montserrat_12;
+}
+
+/* The title line also holds the icon */
+static int32_t dash_head_height(void)
+{
+    return LV_MAX(lv_font_get_line_height(dash_title_font()), DASH_ICON_SIZE);
+}
+
+static int32_t dash_tile_height(void)
+{
+    return 2 * DASH_PAD + dash_head_height() + lv_font_get_line_height(&HarmonyMedium) +
+           lv_font_get_line_height(dash_sub_font()) + 2 * DASH_LINE_GAP;
+}
+
+static int32_t dash_height(void)
+{
+    return DASH_ROWS * dash_tile_height() + (DASH_ROWS - 1) * DASH_GAP;
+}
+
+/* What tile `i` shows, the same for the widget and the object tree */
+static void dash_tile_text(int i, const app_weather_snapshot_t *weather, const app_sensor_snapshot_t *sensors,
+                           dash_text_t *text)
+{
+    memset(text, 0, sizeof(*text));
+    if (i >= DASH_FIRST_SENSOR && i < DASH_FIRST_CITY) {
+        app_sensor_quantity_t q = (app_sensor_quantity_t)(i - DASH_FIRST_SENSOR);
+        strlcpy(text->title, app_history_quantity_name(q), sizeof(text->title));
+        if (sensors && (sensors->valid_mask & (1u << q))) {
+            app_dashboard_format_sensor(text->value, sizeof(text->value), q, sensors->value[q]);
+        } else {
+            strlcpy(text->value, "--", sizeof(text->value));
+        }
+        return;
+    }
+
+    if (!weather || !weather->updated_us) {
+        strlcpy(text->title, "--", sizeof(text->title));
+        strlcpy(text->value, "--C", sizeof(text->value));
+        return;
+    }
+    strlcpy(text->title, weather->city_name, sizeof(text->title));
+    if (weather->temp_c10 == APP_WEATHER_TEMP_NONE) {
+        strlcpy(text->value, "--C", sizeof(text->value));
+    } else {
+        app_dashboard_format_c10(text->value, sizeof(text->value), weather->temp_c10);
+    }
+    if (i == 0 && weather->temp_low_c10 != APP_WEATHER_TEMP_NONE && weather->temp_high_c10 != APP_WEATHER_TEMP_NONE) {
+        snprintf(text->sub, sizeof(text->sub), "%s %d/%dC", weather->condition, weather->temp_low_c10 / 10,
+                 weather->temp_high_c10 / 10);
+    } else {
+        strlcpy(text->sub, weather->condition, sizeof(text->sub));
+    }
+    text->icon_color = app_dashboard_icon_color(weather->icon);
+    text->icon = weather->icon;
+    text->has_icon = true;
+}
+
+static const app_weather_snapshot_t *dash_city_weather(int i, const app_weather_snapshot_t *city0)
+{
+    return i == 0 ? city0 : app_model_get_weather(i - DASH_FIRST_CITY + 1);
+}
+
+/* Tiles fill DASH_ROWS rows left to right, the text lines are stacked inside */
+static void dash_layout(dash_draw_t *d)
+{
+    int32_t cols = (DASH_TILES + DASH_ROWS - 1) / DASH_ROWS;
+    int32_t w = (lv_obj_get_width(d->obj) - (cols - 1) * DASH_GAP) / cols;
+    int32_t h = dash_tile_height();
+    int32_t lh_head = dash_head_height();
+    int32_t lh_title = lv_font_get_line_height(dash_title_font());
+    int32_t lh_value = lv_font_get_line_height(&HarmonyMedium);
+    int32_t lh_sub = lv_font_get_line_height(dash_sub_font());
+
+    for (int i = 0; i < DASH_TILES; i++) {
+        dash_tile_t *t = &d->tiles[i];
+        int32_t x = (i % cols) * (w + DASH_GAP);
+        int32_t y = (i / cols) * (h + DASH_GAP);
+        int32_t tx1 = x + DASH_PAD;
+        int32_t tx2 = x + w - 1 - DASH_PAD;
+        int32_t ty = y + DASH_PAD;
+
+        lv_area_set(&t->area, x, y, x + w - 1, y + h - 1);
+        lv_area_set(&t->title, tx1, ty + (lh_head - lh_title) / 2, tx2 - DASH_ICON_SIZE - DASH_LINE_GAP,
+                    ty + (lh_head - lh_title) / 2 + lh_title - 1);
+        lv_area_set(&t->icon, tx2 - DASH_ICON_SIZE + 1, ty + (lh_head - DASH_ICON_SIZE) / 2, tx2,
+                    ty + (lh_head - DASH_ICON_SIZE) / 2 + DASH_ICON_SIZE - 1);
+        ty += lh_head + DASH_LINE_GAP;
+        lv_area_set(&t->value, tx1, ty, tx2, ty + lh_value - 1);
+        ty += lh_value + DASH_LINE_GAP;
+        lv_area_set(&t->sub, tx1, ty, tx2, ty + lh_sub - 1);
+    }
+}
+
+static void dash_draw_label(lv_layer_t *layer, lv_draw_label_dsc_t *dsc, const char *text, const lv_area_t *rel,
+                            const lv_area_t *coords)
+{
+    if (!text[0]) {
+        return;
+    }
+    lv_area_t a = *rel;
+    lv_area_move(&a, coords->x1, coords->y1);
+    dsc->text = text;
+    lv_draw_label(layer, dsc, &a);
+}
+
+static void dash_draw_cb(lv_event_t *e)
+{
+    dash_draw_t *d = lv_event_get_user_data(e);
+    lv_layer_t *layer = lv_event_get_layer(e);
+    lv_area_t coords;
+    lv_obj_get_coords(d->obj, &coords);
+
+    lv_draw_rect_dsc_t bg;
+    lv_draw_rect_dsc_init(&bg);
+    bg.bg_color = lv_color_white();
+    bg.radius = DASH_RADIUS;
+    bg.border_width = 1;
+    bg.border_color = lv_palette_lighten(LV_PALETTE_GREY, 2);
+
+    lv_draw_rect_dsc_t dot;
+    lv_draw_rect_dsc_init(&dot);
+    dot.radius = LV_RADIUS_CIRCLE;
+
+    lv_draw_image_dsc_t icon;
+    lv_draw_image_dsc_init(&icon);
+    icon.recolor_opa = LV_OPA_COVER;
+
+    lv_draw_label_dsc_t title;
+    lv_draw_label_dsc_init(&title);
+    title.font = dash_title_font();
+    title.color = lv_palette_darken(LV_PALETTE_GREY, 2);
+    title.flag = LV_TEXT_FLAG_NONE;
+    lv_draw_label_dsc_t value = title;
+    value.font = &HarmonyMedium;
+    value.color = lv_color_black();
+    lv_draw_label_dsc_t sub = title;
+    sub.font = dash_sub_font();
+
+    for (int i = 0; i < DASH_TILES; i++) {
+        const dash_tile_t *t = &d->tiles[i];
+        lv_area_t a = t->area;
+        lv_area_move(&a, coords.x1, coords.y1);
+        /* Tiles outside the area being redrawn are clipped away by the renderer */
+        lv_draw_rect(layer, &bg, &a);
+        dash_draw_label(layer, &title, t->text.title, &t->title, &coords);
+        dash_draw_label(layer, &value, t->text.value, &t->value, &coords);
+        dash_draw_label(layer, &sub, t->text.sub, &t->sub, &coords);
+        a = t->icon;
+        lv_area_move(&a, coords.x1, coords.y1);
+        if (t->icon_img) {
+            icon.src = t->icon_img;
+            icon.recolor = t->text.icon_color;
+            lv_draw_image(layer, &icon, &a);
+        } else if (t->text.has_icon) {
+            lv_area_increase(&a, -(DASH_ICON_SIZE - DASH_DOT_SIZE) / 2, -(DASH_ICON_SIZE - DASH_DOT_SIZE) / 2);
+            dot.bg_color = t->text.icon_color;
+            lv_draw_rect(layer, &dot, &a);
+        }
+    }
+}
+
+static void dash_event_cb(lv_event_t *e)
+{
+    dash_draw_t *d = lv_event_get_user_data(e);
+
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_SIZE_CHANGED:
+        dash_layout(d);
+        lv_obj_invalidate(d->obj);
+        break;
+    case LV_EVENT_DELETE:
+        if (s_live == d) {
+            s_live = NULL;
+        }
+        for (int i = 0; i < DASH_TILES; i++) {
+            app_icons_release(d->tiles[i].icon_img);
+        }
+        lv_free(d);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Invalidate only the tile, and only when its text changed */
+static void dash_set_text(dash_draw_t *d, int i, const dash_text_t *text)
+{
+    dash_tile_t *t = &d->tiles[i];
+    if (memcmp(&t->text, text, sizeof(*text)) == 0) {
+        return;
+    }
+    if (text->has_icon != t->text.has_icon || text->icon != t->text.icon || !t->icon_img) {
+        app_icons_release(t->icon_img);
+        t->icon_img = text->has_icon ? app_icons_acquire(text->icon, DASH_ICON_SIZE) : NULL;
+    }
+    t->text = *text;
+    lv_area_t coords;
+    lv_area_t a = t->area;
+    lv_obj_get_coords(d->obj, &coords);
+    lv_area_move(&a, coords.x1, coords.y1);
+    lv_obj_invalidate_area(d->obj, &a);
+}
+
+static dash_draw_t *dash_create(lv_obj_t *parent)
+{
+    dash_draw_t *d = lv_malloc(sizeof(dash_draw_t));
+    ESP_RETURN_ON_FALSE(d, NULL, TAG, "no memory for the dashboard");
+    memset(d, 0, sizeof(*d));
+
+    d->obj = lv_obj_create(parent);
+    lv_obj_remove_style_all(d->obj);
+    lv_obj_remove_flag(d->obj, LV_OBJ_FLAG_CLICKABLE | LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_size(d->obj, LV_PCT(100), dash_height());
+    lv_obj_align(d->obj, LV_ALIGN_TOP_MID, 0, 0);
+    lv_obj_add_event_cb(d->obj, dash_draw_cb, LV_EVENT_DRAW_MAIN, d);
+    lv_obj_add_event_cb(d->obj, dash_event_cb, LV_EVENT_SIZE_CHANGED, d);
+    lv_obj_add_event_cb(d->obj, dash_event_cb, LV_EVENT_DELETE, d);
+    for (int i = 0; i < DASH_TILES; i++) {
+        dash_tile_text(i, NULL, NULL, &d->tiles[i].text);
+    }
+    return d;
+}
+
+lv_obj_t *app_dashboard_draw_create(lv_obj_t *parent)
+{
+    dash_draw_t *d = dash_create(parent);
+    if (!d) {
+        return NULL;
+    }
+    s_live = d;
+    return d->obj;
+}
+
+void app_dashboard_draw_apply(const app_weather_snapshot_t *weather, const app_weather_snapshot_t *prev_weather,
+                              const app_sensor_snapshot_t *sensors, const app_sensor_snapshot_t *prev_sensors)
+{
+    dash_draw_t *d = s_live;
+    dash_text_t text;
+    if (!d) {
+        return;
+    }
+
+    /* The other cities are picked up together with the first one */
+    if (weather) {
+        dash_tile_text(0, weather, NULL, &text);
+        dash_set_text(d, 0, &text);
+        for (int i = DASH_FIRST_CITY; i < DASH_TILES; i++) {
+            dash_tile_text(i, dash_city_weather(i, weather), NULL, &text);
+            dash_set_text(d, i, &text);
+        }
+    }
+    if (sensors) {
+        for (int i = DASH_FIRST_SENSOR; i < DASH_FIRST_CITY; i++) {
+            dash_tile_text(i, NULL, sensors, &text);
+            dash_set_text(d, i, &text);
+        }
+    }
+}
+
+/* The conventional build of the same tiles, kept for the benchmark: a container per tile
+ * with a header row, labels and a flex layout. Children: header (title, icon), value, sub. */
+typedef struct {
+    lv_obj_t *root;
+    lv_obj_t *tiles[DASH_TILES];
+} dash_tree_t;
+
+static lv_obj_t *dash_tree_create(lv_obj_t *parent, dash_tree_t *tree)
+{
+    static lv_style_t tile_style;
+    static lv_style_t sub_style;
+    static bool styles_ready;
+    if (!styles_ready) {
+        lv_style_init(&tile_style);
+        lv_style_set_bg_color(&tile_style, lv_color_white());
+        lv_style_set_radius(&tile_style, DASH_RADIUS);
+        lv_style_set_border_width(&tile_style, 1);
+        lv_style_set_border_color(&tile_style, lv_palette_lighten(LV_PALETTE_GREY, 2));
+        lv_style_set_pad_all(&tile_style, DASH_PAD);
+        lv_style_set_pad_row(&tile_style, DASH_LINE_GAP);
+        lv_style_init(&sub_style);
+        lv_style_set_text_font(&sub_style, dash_sub_font());
+        lv_style_set_text_color(&sub_style, lv_palette_darken(LV_PALETTE_GREY, 2));
+        styles_ready = true;
+    }
+
+    int32_t cols = (DASH_TILES + DASH_ROWS - 1) / DASH_ROWS;
+    tree->root = lv_obj_create(parent);
+    lv_obj_remove_style_all(tree->root);
+    lv_obj_set_size(tree->root, LV_PCT(100), dash_height());
+    lv_obj_align(tree->root, LV_ALIGN_TOP_MID, 0, 0);
+    lv_obj_set_style_pad_gap(tree->root, DASH_GAP, 0);
+    lv_obj_set_flex_flow(tree->root, LV_FLEX_FLOW_ROW_WRAP);
+
+    for (int i = 0; i < DASH_TILES; i++) {
+        lv_obj_t *tile = lv_obj_create(tree->root);
+        lv_obj_remove_style_all(tile);
+        lv_obj_add_style(tile, &tile_style, 0);
+        lv_obj_set_size(tile, (lv_obj_get_width(parent) - (cols - 1) * DASH_GAP) / cols, dash_tile_height());
+        lv_obj_set_flex_flow(tile, LV_FLEX_FLOW_COLUMN);
+
+        lv_obj_t *header = lv_obj_create(tile);
+        lv_obj_remove_style_all(header);
+        lv_obj_set_size(header, LV_PCT(100), LV_SIZE_CONTENT);
+        lv_obj_set_flex_flow(header, LV_FLEX_FLOW_ROW);
+        lv_obj_set_flex_align(header, LV_FLEX_ALIGN_SPACE_BETWEEN, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
+        lv_obj_t *title = lv_label_create(header);
+        lv_obj_add_style(title, &sub_style, 0);
+        lv_obj_set_style_text_font(title, dash_title_font(), 0);
+        app_icons_create(header, DASH_ICON_SIZE);
+
+        lv_obj_t *value = lv_label_create(tile);
+        lv_obj_set_style_text_font(value, &HarmonyMedium, 0);
+        lv_obj_t *sub = lv_label_create(tile);
+        lv_obj_add_style(sub, &sub_style, 0);
+        tree->tiles[i] = tile;
+    }
+    return tree->root;
+}
+
+/* Like app_bind, a label is only set when its text changed */
+static void dash_tree_set_label(lv_obj_t *label, const char *text)
+{
+    if (strcmp(lv_label_get_text(label), text) != 0) {
+        lv_label_set_text(label, text);
+    }
+}
+
+static void dash_tree_set_text(dash_tree_t *tree, int i, const dash_text_t *text)
+{
+    lv_obj_t *tile = tree->tiles[i];
+    lv_obj_t *header = lv_obj_get_child(tile, 0);
+    lv_obj_t *icon = lv_obj_get_child(header, 1);
+    dash_tree_set_label(lv_obj_get_child(header, 0), text->title);
+    dash_tree_set_label(lv_obj_get_child(tile, 1), text->value);
+    dash_tree_set_label(lv_obj_get_child(tile, 2), text->sub);
+    if (text->has_icon) {
+        app_icons_set(icon, text->icon, text->icon_color);
+        lv_obj_remove_flag(icon, LV_OBJ_FLAG_HIDDEN);
+    } else {
+        lv_obj_add_flag(icon, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
+typedef struct {
+    dash_draw_t *draw;              /* One of the two is set */
+    dash_tree_t *tree;
+    lv_obj_t *screen;
+    uint32_t frame;
+    uint32_t layouts;
+    uint64_t layout_sum_us;
+    app_weather_snapshot_t weather[APP_MODEL_MAX_CITIES];
+    app_sensor_snapshot_t sensors;
+} dash_bench_t;
+
+/* Every value moves a little each frame, as if a weather refresh and a sensor reading came in */
+static void dash_bench_frame(void *arg)
+{
+    dash_bench_t *b = arg;
+    static const char *const conditions[] = { "Sunny", "Cloudy", "Overcast", "Light rain" };
+    b->frame++;
+    for (int c = 0; c < APP_MODEL_MAX_CITIES; c++) {
+        app_weather_snapshot_t *w = &b->weather[c];
+        snprintf(w->city_name, sizeof(w->city_name), "City %d", c + 1);
+        strlcpy(w->condition, conditions[(b->frame / 8 + c) % 4], sizeof(w->condition));
+        w->icon = (uint8_t)((b->frame / 8 + c) % 4 == 3 ? 7 : (b->frame / 8 + c) % 4);
+        w->temp_c10 = (int16_t)(150 + c * 10 + b->frame % 50);
+        w->temp_low_c10 = (int16_t)(100 + c * 10);
+        w->temp_high_c10 = (int16_t)(250 + c * 10);
+        w->updated_us = 1;
+    }
+    for (int q = 0; q < APP_SENSOR_QUANTITY_MAX; q++) {
+        b->sensors.value[q] = 10.0f * (q + 1) + (b->frame % 20) * 0.1f;
+    }
+    b->sensors.valid_mask = (1u << APP_SENSOR_QUANTITY_MAX) - 1;
+
+    dash_text_t text;
+    for (int i = 0; i < DASH_TILES; i++) {
+        int city = i == 0 ? 0 : i - DASH_FIRST_CITY + 1;
+        dash_tile_text(i, i == 0 || i >= DASH_FIRST_CITY ? &b->weather[city] : NULL, &b->sensors, &text);
+        if (b->draw) {
+            dash_set_text(b->draw, i, &text);
+        } else {
+            dash_tree_set_text(b->tree, i, &text);
+        }
+    }
+
+    /* Timed on its own here, lv_refr_now() then finds nothing left to lay out */
+    int64_t start = esp_timer_get_time();
+    lv_obj_update_layout(b->screen);
+    b->layout_sum_us += esp_timer_get_time() - start;
+    b->layouts++;
+}
+
+static uint32_t dash_count_objects(lv_obj_t *obj)
+{
+    uint32_t n = 1;
+    for (uint32_t i = 0; i < lv_obj_get_child_count(obj); i++) {
+        n += dash_count_objects(lv_obj_get_child(obj, i));
+    }
+    return n;
+}
+
+static size_t dash_lvgl_used(void)
+{
+#if CONFIG_LV_USE_BUILTIN_MALLOC
+    lv_mem_monitor_t mon;
+    lv_mem_monitor(&mon);
+    return mon.total_size - mon.free_size;
+#else
+    return 0;
+#endif
+}
+
+esp_err_t app_dashboard_draw_bench(lv_display_t *disp, uint32_t frames)
+{
+    ESP_RETURN_ON_FALSE(disp && frames, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    lv_obj_t *prev = lv_display_get_screen_active(disp);
+    esp_err_t ret = ESP_OK;
+    static dash_tree_t tree;
+
+    for (int widget = 0; widget < 2 && ret == ESP_OK; widget++) {
+        dash_bench_t bench = { 0 };
+        size_t used_before = dash_lvgl_used();
+        bench.screen = lv_obj_create(NULL);
+        lv_screen_load(bench.screen);
+        if (widget) {
+            bench.draw = dash_create(bench.screen);
+            ESP_GOTO_ON_FALSE(bench.draw, ESP_ERR_NO_MEM, next, TAG, "no memory for the widget");
+        } else {
+            dash_tree_create(bench.screen, &tree);
+            bench.tree = &tree;
+        }
+        dash_bench_frame(&bench);
+        uint32_t build_layout_us = (uint32_t)bench.layout_sum_us;
+        lv_refr_now(disp);
+        size_t used = dash_lvgl_used() - used_before;
+        uint32_t objects = dash_count_objects(bench.screen);
+
+        bench.layout_sum_us = 0;
+        bench.layouts = 0;
+        app_render_bench_result_t res;
+        ret = app_render_bench_frames(disp, frames, dash_bench_frame, &bench, &res);
+        if (ret == ESP_OK) {
+            ESP_LOGI(TAG, "bench %s tiles=%d objects=%"PRIu32" lvgl_bytes=%u build_layout_us=%"PRIu32
+                     " layout_avg_us=%"PRIu32" frames=%"PRIu32" render_avg_us=%"PRIu32" render_max_us=%"PRIu32
+                     " frame_avg_us=%"PRIu32, widget ? "widget" : "tree", DASH_TILES, objects, (unsigned)used,
+                     build_layout_us, (uint32_t)(bench.layout_sum_us / bench.layouts), res.frames,
+                     res.render_avg_us, res.render_max_us, res.frame_avg_us);
+        }
+next:
+        lv_screen_load(prev);
+        lv_obj_delete(bench.screen);
+    }
+    lv_obj_invalidate(prev);
+    return ret;
+}
@@ -0,0 +1,42 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+#include "app_model.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Build the dashboard tiles as one widget on top of `parent`
+ *
+ * The weather of every city and each sensor quantity get a tile. Their geometry is computed
+ * when the widget is resized, and the draw callback paints them straight from the last
+ * applied values, without an object per tile or label. Must be called with the LVGL lock held.
+ */
+lv_obj_t *app_dashboard_draw_create(lv_obj_t *parent);
+
+/**
+ * @brief Take over the snapshots and invalidate the tiles whose text changed, matches app_model_apply_cb_t
+ */
+void app_dashboard_draw_apply(const app_weather_snapshot_t *weather, const app_weather_snapshot_t *prev_weather,
+                              const app_sensor_snapshot_t *sensors, const app_sensor_snapshot_t *prev_sensors);
+
+/**
+ * @brief Compare the widget against the same tiles built from containers and labels
+ *
+ * Each variant is built on a screen of its own and updated with new values every frame for
+ * `frames` frames. Logs one parseable line per variant with its object count, the LVGL heap
+ * it took, layout time and render time. Must be called with the LVGL lock held.
+ */
+esp_err_t app_dashboard_draw_bench(lv_display_t *disp, uint32_t frames);
+
+#ifdef __cplusplus
+}
+#endif
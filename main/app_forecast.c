@@ -0,0 +1,323 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_console.h"
+#include "esp_lvgl_port.h"
+#include "app_render.h"
+#include "app_vlist.h"
+#include "app_dashboard.h"
+#include "app_icons.h"
+#include "app_forecast.h"
+
+#define FORECAST_ROW_HEIGHT     (44)
+#define FORECAST_MARGIN_ROWS    (2)
+#define FORECAST_ICON_SIZE      (24)
+#define FORECAST_BENCH_STEP     (6)     /* Pixels per frame, a slow drag */
+
+static const char *TAG = "forecast";
+
+typedef struct {
+    app_forecast_row_t *rows;
+    int count;
+    bool daily;
+} forecast_source_t;
+
+static struct {
+    app_forecast_row_t hourly[APP_FORECAST_HOURS];
+    app_forecast_row_t daily[APP_FORECAST_DAYS];
+    forecast_source_t hourly_src;
+    forecast_source_t daily_src;
+    lv_obj_t *hourly_list;          /* NULL until created, and again once deleted */
+    lv_obj_t *daily_list;
+    app_forecast_ready_cb_t ready;  /* Cleared once called */
+} s_forecast = {
+    .hourly_src = { .rows = s_forecast.hourly },
+    .daily_src = { .rows = s_forecast.daily, .daily = true },
+};
+
+static void forecast_format_c10(char *buf, size_t len, int32_t c10)
+{
+    if (c10 == APP_WEATHER_TEMP_NONE) {
+        snprintf(buf, len, "--");
+    } else {
+        snprintf(buf, len, "%s%d.%d", c10 < 0 ? "-" : "", (int)abs(c10) / 10, (int)abs(c10) % 10);
+    }
+}
+
+/* Children in bind order: label, icon, temperature, condition */
+static void forecast_create_row(lv_obj_t *row, void *user_data)
+{
+    lv_obj_set_style_radius(row, 0, 0);
+    lv_obj_set_style_border_side(row, LV_BORDER_SIDE_BOTTOM, 0);
+    lv_obj_set_style_pad_ver(row, 0, 0);
+    lv_obj_set_flex_flow(row, LV_FLEX_FLOW_ROW);
+    lv_obj_set_flex_align(row, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
+
+    lv_obj_t *label = lv_label_create(row);
+    lv_obj_set_width(label, 84);
+
+    app_icons_create(row, FORECAST_ICON_SIZE);
+
+    lv_obj_t *temp = lv_label_create(row);
+    lv_obj_set_width(temp, 110);
+
+    lv_obj_t *condition = lv_label_create(row);
+    lv_obj_set_flex_grow(condition, 1);
+    lv_label_set_long_mode(condition, LV_LABEL_LONG_DOT);
+}
+
+static void forecast_bind_row(lv_obj_t *row, uint32_t index, void *user_data)
+{
+    const forecast_source_t *src = user_data;
+    const app_forecast_row_t *item = &src->rows[index];
+    char high[8];
+    char low[8];
+    char temp[24];
+
+    forecast_format_c10(high, sizeof(high), item->temp_c10);
+    if (src->daily) {
+        forecast_format_c10(low, sizeof(low), item->temp_low_c10);
+        snprintf(temp, sizeof(temp), "%s/%sC", low, high);
+    } else {
+        snprintf(temp, sizeof(temp), "%sC", high);
+    }
+    lv_label_set_text(lv_obj_get_child(row, 0), item->label);
+    app_icons_set(lv_obj_get_child(row, 1), item->icon, app_dashboard_icon_color(item->icon));
+    lv_label_set_text(lv_obj_get_child(row, 2), temp);
+    lv_label_set_text(lv_obj_get_child(row, 3), item->condition);
+}
+
+static void forecast_list_delete_cb(lv_event_t *e)
+{
+    lv_obj_t **list = lv_event_get_user_data(e);
+    *list = NULL;
+}
+
+static lv_obj_t *forecast_create_list(lv_obj_t *parent, forecast_source_t *src, lv_obj_t **slot)
+{
+    const app_vlist_config_t config = {
+        .row_height = FORECAST_ROW_HEIGHT,
+        .margin_rows = FORECAST_MARGIN_ROWS,
+        .create_row = forecast_create_row,
+        .bind_row = forecast_bind_row,
+        .user_data = src,
+    };
+    lv_obj_t *list = app_vlist_create(parent, &config);
+    if (list) {
+        lv_obj_set_height(list, LV_PCT(100));
+        lv_obj_set_flex_grow(list, 1);
+        lv_obj_add_event_cb(list, forecast_list_delete_cb, LV_EVENT_DELETE, slot);
+        app_vlist_set_count(list, src->count);
+        *slot = list;
+    }
+    return list;
+}
+
+static lv_obj_t *forecast_create_box(lv_obj_t *parent)
+{
+    LV_FONT_DECLARE(HarmonyMedium);
+    lv_obj_t *box = lv_obj_create(parent);
+    lv_obj_remove_style_all(box);
+    lv_obj_set_size(box, LV_PCT(100), LV_PCT(100));
+    lv_obj_set_style_text_font(box, &HarmonyMedium, 0);
+    lv_obj_set_style_pad_column(box, 8, 0);
+    lv_obj_set_flex_flow(box, LV_FLEX_FLOW_ROW);
+    return box;
+}
+
+void app_forecast_create(lv_obj_t *parent, app_forecast_ready_cb_t ready)
+{
+    lv_obj_t *box = forecast_create_box(parent);
+    forecast_create_list(box, &s_forecast.hourly_src, &s_forecast.hourly_list);
+    forecast_create_list(box, &s_forecast.daily_src, &s_forecast.daily_list);
+    s_forecast.ready = ready;
+}
+
+static void forecast_set(forecast_source_t *src, lv_obj_t *list, const app_forecast_row_t *rows, int count, int max)
+{
+    src->count = LV_MIN(count, max);
+    if (rows != src->rows) {
+        memcpy(src->rows, rows, src->count * sizeof(app_forecast_row_t));
+    }
+    if (list) {
+        app_vlist_set_count(list, src->count);
+        if (src->count && s_forecast.ready) {
+            app_forecast_ready_cb_t ready = s_forecast.ready;
+            s_forecast.ready = NULL;
+            ready(lv_obj_get_screen(list));
+        }
+    }
+}
+
+void app_forecast_set_hourly(const app_forecast_row_t *rows, int count)
+{
+    forecast_set(&s_forecast.hourly_src, s_forecast.hourly_list, rows, count, APP_FORECAST_HOURS);
+}
+
+void app_forecast_set_daily(const app_forecast_row_t *rows, int count)
+{
+    forecast_set(&s_forecast.daily_src, s_forecast.daily_list, rows, count, APP_FORECAST_DAYS);
+}
+
+/* The same rows as plain children of a scrolling column, every one built up front */
+static lv_obj_t *forecast_create_plain_list(lv_obj_t *parent, forecast_source_t *src)
+{
+    lv_obj_t *list = lv_obj_create(parent);
+    lv_obj_set_height(list, LV_PCT(100));
+    lv_obj_set_flex_grow(list, 1);
+    lv_obj_set_style_pad_row(list, 0, 0);
+    lv_obj_set_flex_flow(list, LV_FLEX_FLOW_COLUMN);
+    for (int i = 0; i < src->count; i++) {
+        lv_obj_t *row = lv_obj_create(list);
+        lv_obj_set_size(row, LV_PCT(100), FORECAST_ROW_HEIGHT);
+        lv_obj_remove_flag(row, LV_OBJ_FLAG_SCROLLABLE);
+        forecast_create_row(row, src);
+        forecast_bind_row(row, i, src);
+    }
+    return list;
+}
+
+static uint32_t forecast_count_objects(lv_obj_t *obj)
+{
+    uint32_t n = 1;
+    for (uint32_t i = 0; i < lv_obj_get_child_count(obj); i++) {
+        n += forecast_count_objects(lv_obj_get_child(obj, i));
+    }
+    return n;
+}
+
+static size_t forecast_lvgl_used(void)
+{
+#if CONFIG_LV_USE_BUILTIN_MALLOC
+    lv_mem_monitor_t mon;
+    lv_mem_monitor(&mon);
+    return mon.total_size - mon.free_size;
+#else
+    return 0;
+#endif
+}
+
+/* Made up rows, for the benchmark and the "forecast demo" command */
+static void forecast_fill_demo(void)
+{
+    /* HarmonyMedium only has the glyphs of a few Chinese words, made up conditions stay in ASCII */
+    static const char *const conditions[] = { "Sunny", "Cloudy", "Overcast", "Light rain", "Thunderstorm", "Snow", "Fog" };
+    static const uint8_t icons[] = { 0, 1, 2, 7, 4, 15, 18 };
+    static const char *const weekdays[] = { "Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun" };
+    app_forecast_row_t row;
+
+    for (int i = 0; i < APP_FORECAST_HOURS; i++) {
+        int c = (i / 5) % 7;
+        row = (app_forecast_row_t) {
+            .icon = icons[c],
+            .temp_c10 = (int16_t)(260 - 8 * abs(i % 24 - 14)),     /* Warmest at two in the afternoon */
+            .temp_low_c10 = APP_WEATHER_TEMP_NONE,
+        };
+        snprintf(row.label, sizeof(row.label), "%02d:00", i % 24);
+        strlcpy(row.condition, conditions[c], sizeof(row.condition));
+        s_forecast.hourly[i] = row;
+    }
+    for (int i = 0; i < APP_FORECAST_DAYS; i++) {
+        int c = (i * 3) % 7;
+        row = (app_forecast_row_t) {
+            .icon = icons[c],
+            .temp_c10 = (int16_t)(240 + 10 * (i % 5)),
+            .temp_low_c10 = (int16_t)(120 + 10 * (i % 4)),
+        };
+        snprintf(row.label, sizeof(row.label), "%s %d", weekdays[i % 7], i + 1);
+        strlcpy(row.condition, conditions[c], sizeof(row.condition));
+        s_forecast.daily[i] = row;
+    }
+    s_forecast.hourly_src.count = APP_FORECAST_HOURS;
+    s_forecast.daily_src.count = APP_FORECAST_DAYS;
+}
+
+esp_err_t app_forecast_bench(lv_display_t *disp, uint32_t frames)
+{
+    ESP_RETURN_ON_FALSE(disp && frames, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(!s_forecast.hourly_list, ESP_ERR_INVALID_STATE, TAG, "the forecast is on screen");
+
+    lv_obj_t *prev = lv_display_get_screen_active(disp);
+    esp_err_t ret = ESP_OK;
+    forecast_fill_demo();
+
+    for (int recycled = 0; recycled < 2 && ret == ESP_OK; recycled++) {
+        size_t used_before = forecast_lvgl_used();
+        lv_obj_t *scr = lv_obj_create(NULL);
+        lv_obj_t *hourly;
+        if (recycled) {
+            app_forecast_create(scr, NULL);
+            hourly = s_forecast.hourly_list;
+        } else {
+            lv_obj_t *box = forecast_create_box(scr);
+            hourly = forecast_create_plain_list(box, &s_forecast.hourly_src);
+            forecast_create_plain_list(box, &s_forecast.daily_src);
+        }
+        lv_screen_load(scr);
+        lv_refr_now(disp);
+        size_t used = forecast_lvgl_used() - used_before;
+        uint32_t objects = forecast_count_objects(scr);
+
+        app_render_bench_result_t res;
+        ret = app_render_bench_scroll(disp, hourly, FORECAST_BENCH_STEP, frames, &res);
+        if (ret == ESP_OK) {
+            app_vlist_stats_t vstats = { 0 };
+            if (recycled) {
+                app_vlist_get_stats(hourly, &vstats);
+            }
+            ESP_LOGI(TAG, "bench %s rows=%d objects=%"PRIu32" lvgl_bytes=%u binds=%"PRIu32" frames=%"PRIu32
+                     " render_avg_us=%"PRIu32" render_max_us=%"PRIu32" frame_avg_us=%"PRIu32,
+                     recycled ? "recycled" : "plain", APP_FORECAST_HOURS + APP_FORECAST_DAYS, objects,
+                     (unsigned)used, vstats.binds, res.frames, res.render_avg_us, res.render_max_us, res.frame_avg_us);
+        }
+        lv_screen_load(prev);
+        lv_obj_delete(scr);
+    }
+
+    /* Made up rows are not kept for the real lists */
+    s_forecast.hourly_src.count = 0;
+    s_forecast.daily_src.count = 0;
+    lv_obj_invalidate(prev);
+    return ret;
+}
+
+static int forecast_cmd(int argc, char **argv)
+{
+    if (argc == 2 && (strcmp(argv[1], "demo") == 0 || strcmp(argv[1], "clear") == 0)) {
+        lvgl_port_lock(0);
+        if (strcmp(argv[1], "demo") == 0) {
+            forecast_fill_demo();
+        } else {
+            s_forecast.hourly_src.count = 0;
+            s_forecast.daily_src.count = 0;
+        }
+        forecast_set(&s_forecast.hourly_src, s_forecast.hourly_list, s_forecast.hourly, s_forecast.hourly_src.count,
+                     APP_FORECAST_HOURS);
+        forecast_set(&s_forecast.daily_src, s_forecast.daily_list, s_forecast.daily, s_forecast.daily_src.count,
+                     APP_FORECAST_DAYS);
+        lvgl_port_unlock();
+    } else if (argc != 1) {
+        printf("usage: forecast [demo|clear]\n");
+        return 1;
+    }
+    printf("forecast: hourly=%d daily=%d\n", s_forecast.hourly_src.count, s_forecast.daily_src.count);
+    return 0;
+}
+
+esp_err_t app_forecast_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "forecast",
+        .help = "Show the forecast row counts, or fill the lists with made up rows: forecast [demo|clear]",
+        .func = forecast_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
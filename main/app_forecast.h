@@ -0,0 +1,71 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+#include "app_model.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_FORECAST_HOURS      (48)
+#define APP_FORECAST_DAYS       (15)
+
+/**
+ * @brief One hour or one day of the forecast
+ */
+typedef struct {
+    char label[12];             /*!< "14:00" or "Mon 3/11" */
+    char condition[24];         /*!< Human readable condition, UTF-8 */
+    uint8_t icon;               /*!< Condition code, as app_weather_snapshot_t */
+    int16_t temp_c10;           /*!< Temperature of the hour, high of the day */
+    int16_t temp_low_c10;       /*!< Low of the day, APP_WEATHER_TEMP_NONE for hours */
+} app_forecast_row_t;
+
+/**
+ * @brief Called once, with the screen of the lists, when the forecast first gets rows
+ */
+typedef void (*app_forecast_ready_cb_t)(lv_obj_t *screen);
+
+/**
+ * @brief Build the hourly and daily forecast lists side by side on `parent`
+ *
+ * Both are app_vlist lists, only the rows in view exist. `ready` may be NULL, else it is
+ * called from the first app_forecast_set_hourly() or app_forecast_set_daily() with rows, so
+ * the screen is only offered as a page once there is something on it. Must be called with
+ * the LVGL lock held.
+ */
+void app_forecast_create(lv_obj_t *parent, app_forecast_ready_cb_t ready);
+
+/**
+ * @brief Replace the hourly or daily forecast, at most APP_FORECAST_HOURS or APP_FORECAST_DAYS rows
+ *
+ * Nothing fetches a forecast yet, app_weather only gets the current conditions. Until then the
+ * lists stay empty unless filled with made up rows by the "forecast demo" command.
+ * Must be called with the LVGL lock held.
+ */
+void app_forecast_set_hourly(const app_forecast_row_t *rows, int count);
+void app_forecast_set_daily(const app_forecast_row_t *rows, int count);
+
+/**
+ * @brief Compare the lists against one object tree per row, as demo_widget() builds its widgets
+ *
+ * Each variant is built on a screen of its own with made up rows, then the hourly list is
+ * scrolled for `frames` frames. Logs one parseable line per variant with its object count,
+ * the LVGL heap it took and the render time per frame. Must be called with the LVGL lock held.
+ */
+esp_err_t app_forecast_bench(lv_display_t *disp, uint32_t frames);
+
+/**
+ * @brief Add the "forecast" console command
+ */
+esp_err_t app_forecast_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
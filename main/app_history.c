@@ -0,0 +1,251 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <sys/param.h>
+#include <stdatomic.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "app_history.h"
+
+/* Oldest minutes a reader leaves alone: the writer closes at most one minute per reading,
+ * so a block handed out stays intact for this many minutes */
+#define HISTORY_MARGIN          (16)
+#define HISTORY_US_PER_MINUTE   (60LL * 1000 * 1000)
+
+static const char *TAG = "history";
+
+typedef struct {
+    app_history_rollup_t *ring;             /* CONFIG_APP_HISTORY_MINUTES closed minutes */
+    _Atomic uint32_t stored;                /* Minutes closed since boot, only the writer adds */
+    /* Open minute and latest reading, under s_history.lock */
+    uint32_t open_minute;
+    float open_min;
+    float open_max;
+    double open_sum;
+    uint32_t open_count;
+    float latest;
+    int64_t latest_us;
+} history_quantity_t;
+
+static struct {
+    history_quantity_t q[APP_SENSOR_QUANTITY_MAX];
+    portMUX_TYPE lock;
+} s_history = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static const char *const s_quantity_names[APP_SENSOR_QUANTITY_MAX] = {
+    [APP_SENSOR_TEMPERATURE] = "temperature",
+    [APP_SENSOR_HUMIDITY] = "humidity",
+    [APP_SENSOR_PRESSURE] = "pressure",
+    [APP_SENSOR_LIGHT] = "light",
+    [APP_SENSOR_AIR_QUALITY] = "air_quality",
+};
+
+static uint32_t history_minute(int64_t us)
+{
+    return (uint32_t)(us / HISTORY_US_PER_MINUTE);
+}
+
+static void history_open_to_rollup(const history_quantity_t *hq, app_history_rollup_t *out)
+{
+    *out = (app_history_rollup_t) {
+        .minute = hq->open_minute,
+        .min = hq->open_min,
+        .max = hq->open_max,
+        .mean = (float)(hq->open_sum / hq->open_count),
+        .count = hq->open_count,
+    };
+}
+
+/* Sensor task: the only writer of the rings */
+static void history_listener(app_sensor_handle_t sensor, const app_sensor_reading_t *reading, void *arg)
+{
+    uint32_t minute = history_minute(reading->timestamp_us);
+
+    for (int i = 0; i < reading->channels; i++) {
+        if (reading->quantity[i] >= APP_SENSOR_QUANTITY_MAX) {
+            continue;
+        }
+        history_quantity_t *hq = &s_history.q[reading->quantity[i]];
+        float value = reading->value[i];
+        app_history_rollup_t closed = { 0 };
+
+        portENTER_CRITICAL(&s_history.lock);
+        if (hq->open_count && hq->open_minute != minute) {
+            history_open_to_rollup(hq, &closed);
+            hq->open_count = 0;
+        }
+        if (!hq->open_count) {
+            hq->open_minute = minute;
+            hq->open_min = value;
+            hq->open_max = value;
+            hq->open_sum = 0;
+        }
+        hq->open_min = MIN(hq->open_min, value);
+        hq->open_max = MAX(hq->open_max, value);
+        hq->open_sum += value;
+        hq->open_count++;
+        hq->latest = value;
+        hq->latest_us = reading->timestamp_us;
+        portEXIT_CRITICAL(&s_history.lock);
+
+        if (closed.count) {
+            uint32_t stored = atomic_load_explicit(&hq->stored, memory_order_relaxed);
+            hq->ring[stored % CONFIG_APP_HISTORY_MINUTES] = closed;
+            atomic_store_explicit(&hq->stored, stored + 1, memory_order_release);
+        }
+    }
+}
+
+esp_err_t app_history_init(void)
+{
+    size_t ring_size = CONFIG_APP_HISTORY_MINUTES * sizeof(app_history_rollup_t);
+    for (int i = 0; i < APP_SENSOR_QUANTITY_MAX; i++) {
+        history_quantity_t *hq = &s_history.q[i];
+        ESP_RETURN_ON_FALSE(!hq->ring, ESP_ERR_INVALID_STATE, TAG, "already initialized");
+        hq->ring = heap_caps_malloc(ring_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!hq->ring) {
+            hq->ring = heap_caps_malloc(ring_size, MALLOC_CAP_8BIT);
+        }
+        ESP_RETURN_ON_FALSE(hq->ring, ESP_ERR_NO_MEM, TAG, "no memory for %s", s_quantity_names[i]);
+    }
+    ESP_RETURN_ON_ERROR(app_sensor_add_listener(history_listener, NULL), TAG, "add sensor listener failed");
+    ESP_LOGI(TAG, "minutes=%d bytes=%u", CONFIG_APP_HISTORY_MINUTES,
+             (unsigned)(ring_size * APP_SENSOR_QUANTITY_MAX));
+    return ESP_OK;
+}
+
+bool app_history_latest(app_sensor_quantity_t q, float *value, int64_t *timestamp_us)
+{
+    if (q >= APP_SENSOR_QUANTITY_MAX) {
+        return false;
+    }
+    history_quantity_t *hq = &s_history.q[q];
+    portENTER_CRITICAL(&s_history.lock);
+    bool valid = hq->latest_us != 0;
+    *value = hq->latest;
+    if (timestamp_us) {
+        *timestamp_us = hq->latest_us;
+    }
+    portEXIT_CRITICAL(&s_history.lock);
+    return valid;
+}
+
+/* First logical index in [lo, hi) whose minute is >= `minute`, the ring is sorted by minute */
+static uint32_t history_lower_bound(const history_quantity_t *hq, uint32_t lo, uint32_t hi, uint32_t minute)
+{
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (hq->ring[mid % CONFIG_APP_HISTORY_MINUTES].minute < minute) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+esp_err_t app_history_read(app_sensor_quantity_t q, uint32_t from_minute, uint32_t to_minute,
+                           app_history_block_cb_t cb, void *arg)
+{
+    ESP_RETURN_ON_FALSE(q < APP_SENSOR_QUANTITY_MAX && cb, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    const history_quantity_t *hq = &s_history.q[q];
+    ESP_RETURN_ON_FALSE(hq->ring, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+
+    uint32_t stored = atomic_load_explicit(&hq->stored, memory_order_acquire);
+    uint32_t oldest = stored > CONFIG_APP_HISTORY_MINUTES - HISTORY_MARGIN ?
+                      stored - (CONFIG_APP_HISTORY_MINUTES - HISTORY_MARGIN) : 0;
+    uint32_t begin = history_lower_bound(hq, oldest, stored, from_minute);
+    uint32_t end = to_minute == UINT32_MAX ? stored : history_lower_bound(hq, begin, stored, to_minute + 1);
+
+    while (begin < end) {
+        uint32_t slot = begin % CONFIG_APP_HISTORY_MINUTES;
+        size_t count = MIN(end - begin, CONFIG_APP_HISTORY_MINUTES - slot);
+        /* E.g. the client went away, the caller reports it */
+        esp_err_t ret = cb(&hq->ring[slot], count, arg);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        begin += count;
+    }
+    return ESP_OK;
+}
+
+typedef struct {
+    float min;
+    float max;
+    double sum;
+    uint32_t count;
+    uint32_t oldest;
+    uint32_t newest;
+} history_summary_t;
+
+static void history_summary_add(history_summary_t *sum, const app_history_rollup_t *r)
+{
+    if (!sum->count) {
+        sum->min = r->min;
+        sum->max = r->max;
+        sum->oldest = r->minute;
+    }
+    sum->min = MIN(sum->min, r->min);
+    sum->max = MAX(sum->max, r->max);
+    sum->sum += (double)r->mean * r->count;
+    sum->count += r->count;
+    sum->oldest = MIN(sum->oldest, r->minute);
+    sum->newest = MAX(sum->newest, r->minute);
+}
+
+static esp_err_t history_summary_block(const app_history_rollup_t *records, size_t count, void *arg)
+{
+    for (size_t i = 0; i < count; i++) {
+        history_summary_add(arg, &records[i]);
+    }
+    return ESP_OK;
+}
+
+void app_history_summary(app_sensor_quantity_t q, uint32_t minutes, app_history_rollup_t *out)
+{
+    history_summary_t sum = { 0 };
+    uint32_t now = app_history_now_minute();
+    uint32_t from = minutes && now >= minutes - 1 ? now - (minutes - 1) : 0;
+
+    if (q < APP_SENSOR_QUANTITY_MAX) {
+        app_history_rollup_t open = { 0 };
+        history_quantity_t *hq = &s_history.q[q];
+        portENTER_CRITICAL(&s_history.lock);
+        if (hq->open_count) {
+            history_open_to_rollup(hq, &open);
+        }
+        portEXIT_CRITICAL(&s_history.lock);
+
+        app_history_read(q, from, UINT32_MAX, history_summary_block, &sum);
+        /* Unless the open minute got closed into the ring in the meantime */
+        if (open.count && open.minute >= from && (!sum.count || open.minute > sum.newest)) {
+            history_summary_add(&sum, &open);
+        }
+    }
+
+    *out = (app_history_rollup_t) {
+        .minute = sum.count ? sum.oldest : now,
+        .min = sum.min,
+        .max = sum.max,
+        .mean = sum.count ? (float)(sum.sum / sum.count) : 0,
+        .count = sum.count,
+    };
+}
+
+uint32_t app_history_now_minute(void)
+{
+    return history_minute(esp_timer_get_time());
+}
+
+const char *app_history_quantity_name(app_sensor_quantity_t q)
+{
+    return q < APP_SENSOR_QUANTITY_MAX ? s_quantity_names[q] : "unknown";
+}
@@ -0,0 +1,79 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "app_sensor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief One minute of one quantity
+ */
+typedef struct {
+    uint32_t minute;            /*!< Minutes since boot */
+    float min;
+    float max;
+    float mean;
+    uint32_t count;             /*!< Readings in the minute */
+} app_history_rollup_t;
+
+/**
+ * @brief Gets stored minutes straight from the ring, oldest first
+ *
+ * `records` points into the ring itself and is only valid during the call.
+ */
+typedef esp_err_t (*app_history_block_cb_t)(const app_history_rollup_t *records, size_t count, void *arg);
+
+/**
+ * @brief Allocate the rings in PSRAM and start recording every sensor reading
+ *
+ * Keeps CONFIG_APP_HISTORY_MINUTES minutes per quantity. Call after app_sensor_scheduler_init().
+ */
+esp_err_t app_history_init(void);
+
+/**
+ * @brief Latest reading of `q`
+ *
+ * @return false when `q` was never read
+ */
+bool app_history_latest(app_sensor_quantity_t q, float *value, int64_t *timestamp_us);
+
+/**
+ * @brief Min, max and mean of `q` over the last `minutes` minutes, the current one included
+ *
+ * `out->minute` is the oldest minute that contributed, `out->count` is 0 without any reading.
+ */
+void app_history_summary(app_sensor_quantity_t q, uint32_t minutes, app_history_rollup_t *out);
+
+/**
+ * @brief Pass the stored minutes of `q` from `from_minute` to `to_minute` to `cb`, block by block
+ *
+ * No copy is made: each block is a contiguous run of the ring. The oldest minutes, next
+ * in line to be overwritten, are left out so a block stays intact for several minutes
+ * after it was handed out. The open minute is not stored yet. An error from `cb` stops
+ * the walk and is returned.
+ */
+esp_err_t app_history_read(app_sensor_quantity_t q, uint32_t from_minute, uint32_t to_minute,
+                           app_history_block_cb_t cb, void *arg);
+
+/**
+ * @brief Current minute since boot, in the time base of the rollups
+ */
+uint32_t app_history_now_minute(void);
+
+/**
+ * @brief Name of `q`, e.g. "temperature"
+ */
+const char *app_history_quantity_name(app_sensor_quantity_t q);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,162 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_console.h"
+#include "lvgl.h"
+#include "app_hotset.h"
+
+#define HOTSET_FN_SLOTS         (2048)
+#define HOTSET_GLYPH_SLOTS      (512)
+#define HOTSET_MAX_FONTS        (8)
+#define HOTSET_MAX_PROBE        (16)
+#define HOTSET_TASK_STACK       (3072)
+
+/* Glyph keys pack the font index above the 21 bit code point */
+#define HOTSET_GLYPH_KEY(font_idx, unicode)     ((((uint32_t)(font_idx) + 1) << 21) | ((unicode) & 0x1FFFFF))
+
+#define NO_INSTRUMENT   __attribute__((no_instrument_function))
+
+static const char *TAG = "hotset";
+
+typedef struct {
+    uint32_t key;                   /* 0 while the slot is free */
+    uint32_t count;
+} hotset_slot_t;
+
+/* Filled from every core and from ISRs that call into LVGL, so slots are claimed and counted atomically */
+static DRAM_ATTR hotset_slot_t s_fn[HOTSET_FN_SLOTS];
+static DRAM_ATTR hotset_slot_t s_glyph[HOTSET_GLYPH_SLOTS];
+static DRAM_ATTR const lv_font_t *s_fonts[HOTSET_MAX_FONTS];
+static DRAM_ATTR uint32_t s_dropped;
+static portMUX_TYPE s_font_lock = portMUX_INITIALIZER_UNLOCKED;
+
+bool __real_lv_font_get_glyph_dsc_fmt_txt(const lv_font_t *font, lv_font_glyph_dsc_t *dsc_out,
+                                          uint32_t unicode_letter, uint32_t unicode_letter_next);
+
+static IRAM_ATTR NO_INSTRUMENT void hotset_count(hotset_slot_t *table, uint32_t mask, uint32_t key)
+{
+    uint32_t idx = (key * 2654435761u) & mask;
+    for (int probe = 0; probe < HOTSET_MAX_PROBE; probe++, idx = (idx + 1) & mask) {
+        uint32_t cur = __atomic_load_n(&table[idx].key, __ATOMIC_RELAXED);
+        if (cur == 0) {
+            uint32_t expected = 0;
+            if (__atomic_compare_exchange_n(&table[idx].key, &expected, key, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                cur = key;
+            } else {
+                cur = expected;
+            }
+        }
+        if (cur == key) {
+            __atomic_fetch_add(&table[idx].count, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+    __atomic_fetch_add(&s_dropped, 1, __ATOMIC_RELAXED);
+}
+
+/* Called on entry of every function of the LVGL component, built with -finstrument-functions */
+IRAM_ATTR NO_INSTRUMENT void __cyg_profile_func_enter(void *fn, void *call_site)
+{
+    hotset_count(s_fn, HOTSET_FN_SLOTS - 1, (uint32_t)(uintptr_t)fn);
+}
+
+IRAM_ATTR NO_INSTRUMENT void __cyg_profile_func_exit(void *fn, void *call_site)
+{
+}
+
+static int hotset_font_index(const lv_font_t *font)
+{
+    for (int i = 0; i < HOTSET_MAX_FONTS; i++) {
+        const lv_font_t *f = __atomic_load_n(&s_fonts[i], __ATOMIC_ACQUIRE);
+        if (f == font) {
+            return i;
+        }
+        if (!f) {
+            break;
+        }
+    }
+
+    int idx = -1;
+    portENTER_CRITICAL_SAFE(&s_font_lock);
+    for (int i = 0; i < HOTSET_MAX_FONTS; i++) {
+        if (!s_fonts[i] || s_fonts[i] == font) {
+            __atomic_store_n(&s_fonts[i], font, __ATOMIC_RELEASE);
+            idx = i;
+            break;
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&s_font_lock);
+    return idx;
+}
+
+/* Every glyph lookup of a font converted with lv_font_conv goes through here */
+bool __wrap_lv_font_get_glyph_dsc_fmt_txt(const lv_font_t *font, lv_font_glyph_dsc_t *dsc_out,
+                                          uint32_t unicode_letter, uint32_t unicode_letter_next)
+{
+    int font_idx = hotset_font_index(font);
+    if (font_idx >= 0) {
+        hotset_count(s_glyph, HOTSET_GLYPH_SLOTS - 1, HOTSET_GLYPH_KEY(font_idx, unicode_letter));
+    } else {
+        __atomic_fetch_add(&s_dropped, 1, __ATOMIC_RELAXED);
+    }
+    return __real_lv_font_get_glyph_dsc_fmt_txt(font, dsc_out, unicode_letter, unicode_letter_next);
+}
+
+void app_hotset_dump(void)
+{
+    /* Plain printf so the lines are easy to parse from a monitor capture */
+    printf("hotset: begin dropped=%"PRIu32"\n", s_dropped);
+    for (int i = 0; i < HOTSET_FN_SLOTS; i++) {
+        if (s_fn[i].key) {
+            printf("hotset: fn 0x%08"PRIx32" %"PRIu32"\n", s_fn[i].key, s_fn[i].count);
+        }
+    }
+    for (int i = 0; i < HOTSET_GLYPH_SLOTS; i++) {
+        uint32_t key = s_glyph[i].key;
+        if (key) {
+            printf("hotset: glyph %p U+%04"PRIX32" %"PRIu32"\n", s_fonts[(key >> 21) - 1], key & 0x1FFFFF, s_glyph[i].count);
+        }
+    }
+    printf("hotset: end\n");
+}
+
+static void hotset_task(void *arg)
+{
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_APP_HOTSET_PROFILE_SECONDS * 1000));
+    app_hotset_dump();
+    vTaskDelete(NULL);
+}
+
+esp_err_t app_hotset_start(void)
+{
+    ESP_LOGI(TAG, "Profiling LVGL calls and glyph lookups, dump in %d s", CONFIG_APP_HOTSET_PROFILE_SECONDS);
+    BaseType_t ret = xTaskCreate(hotset_task, "hotset", HOTSET_TASK_STACK, NULL, 1, NULL);
+    ESP_RETURN_ON_FALSE(ret == pdPASS, ESP_ERR_NO_MEM, TAG, "create task failed");
+    return ESP_OK;
+}
+
+static int hotset_cmd(int argc, char **argv)
+{
+    app_hotset_dump();
+    return 0;
+}
+
+esp_err_t app_hotset_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "hotset",
+        .help = "Print call counts of LVGL functions and lookup counts of glyphs",
+        .func = hotset_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,33 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Dump the profile once CONFIG_APP_HOTSET_PROFILE_SECONDS have passed
+ *
+ * Calls into LVGL and glyph lookups are counted from boot, this only schedules the dump.
+ * build_hotset.js turns a captured dump into main/hotset.lf.
+ */
+esp_err_t app_hotset_start(void);
+
+/**
+ * @brief Print the profile collected so far, between "hotset: begin" and "hotset: end"
+ */
+void app_hotset_dump(void);
+
+/**
+ * @brief Add the "hotset" console command printing the profile
+ */
+esp_err_t app_hotset_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
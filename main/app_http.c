@@ -0,0 +1,707 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_console.h"
+#include "esp_tls.h"
+#if !CONFIG_ESP_TLS_SKIP_SERVER_CERT_VERIFY
+#include "esp_crt_bundle.h"
+#endif
+#include "app_http.h"
+
+#define HTTP_POOL_SIZE          (CONFIG_APP_HTTP_POOL_SIZE)
+#define HTTP_HOST_MAX           (64)
+#define HTTP_REQUEST_MAX        (512)
+#define HTTP_LINE_MAX           (256)
+#define HTTP_RX_BUF_SIZE        (512)
+#define HTTP_BODY_MIN           (1024)
+
+static const char *TAG = "http";
+
+typedef struct {
+    char host[HTTP_HOST_MAX];
+    uint16_t port;
+    bool https;
+} http_origin_t;
+
+typedef struct {
+    http_origin_t origin;
+    esp_tls_t *tls;                 /* NULL while not connected */
+    bool in_use;
+    bool session_saved;             /* The session of this connection is in the cache */
+    int64_t last_used_us;
+    int64_t deadline_us;            /* Of the request in progress */
+    uint8_t rx[HTTP_RX_BUF_SIZE];
+    size_t rx_len;
+    size_t rx_pos;
+} http_conn_t;
+
+#if CONFIG_APP_HTTP_TLS_RESUME
+typedef struct {
+    http_origin_t origin;
+    esp_tls_client_session_t *session;
+    int users;                      /* Handshakes offering this session right now */
+    int64_t saved_us;
+} http_session_t;
+#endif
+
+typedef struct {
+    app_arena_handle_t arena;
+    app_http_body_cb_t cb;          /* Streams the body instead of storing it when set */
+    void *cb_arg;
+    char *buf;
+    size_t len;
+    size_t cap;
+} http_body_t;
+
+static struct {
+    http_conn_t conns[HTTP_POOL_SIZE];
+#if CONFIG_APP_HTTP_TLS_RESUME
+    http_session_t sessions[HTTP_POOL_SIZE];
+#endif
+    SemaphoreHandle_t free_conns;   /* Counts connections not in use */
+    SemaphoreHandle_t lock;         /* Protects conns and sessions */
+    app_http_stats_t stats;
+    portMUX_TYPE stats_lock;
+} s_http = {
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static bool http_origin_eq(const http_origin_t *a, const http_origin_t *b)
+{
+    return a->port == b->port && a->https == b->https && strcmp(a->host, b->host) == 0;
+}
+
+static esp_err_t http_parse_url(const char *url, http_origin_t *origin, const char **path)
+{
+    const char *p;
+
+    if (strncmp(url, "https://", 8) == 0) {
+        origin->https = true;
+        origin->port = 443;
+        p = url + 8;
+    } else if (strncmp(url, "http://", 7) == 0) {
+        origin->https = false;
+        origin->port = 80;
+        p = url + 7;
+    } else {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t host_len = strcspn(p, ":/");
+    ESP_RETURN_ON_FALSE(host_len && host_len < sizeof(origin->host), ESP_ERR_INVALID_ARG, TAG, "bad host in %s", url);
+    memcpy(origin->host, p, host_len);
+    origin->host[host_len] = '\0';
+    p += host_len;
+
+    if (*p == ':') {
+        char *end;
+        long port = strtol(p + 1, &end, 10);
+        ESP_RETURN_ON_FALSE(end != p + 1 && port > 0 && port <= 65535, ESP_ERR_INVALID_ARG, TAG, "bad port in %s", url);
+        origin->port = (uint16_t)port;
+        p = end;
+    }
+    ESP_RETURN_ON_FALSE(!*p || *p == '/', ESP_ERR_INVALID_ARG, TAG, "bad path in %s", url);
+    *path = *p ? p : "/";
+    return ESP_OK;
+}
+
+static void http_conn_close(http_conn_t *c)
+{
+    if (c->tls) {
+        esp_tls_conn_destroy(c->tls);
+        c->tls = NULL;
+    }
+    c->session_saved = false;
+    c->rx_len = 0;
+    c->rx_pos = 0;
+}
+
+/* Prefers an idle connection to the same origin, then an unused slot, then evicts the least recently used */
+static http_conn_t *http_acquire(const http_origin_t *origin)
+{
+    if (xSemaphoreTake(s_http.free_conns, pdMS_TO_TICKS(CONFIG_APP_HTTP_TIMEOUT_MS)) != pdTRUE) {
+        return NULL;
+    }
+
+    int64_t now = esp_timer_get_time();
+    http_conn_t *match = NULL;
+    http_conn_t *empty = NULL;
+    http_conn_t *oldest = NULL;
+
+    xSemaphoreTake(s_http.lock, portMAX_DELAY);
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        http_conn_t *c = &s_http.conns[i];
+        if (c->in_use) {
+            continue;
+        }
+        if (c->tls && now - c->last_used_us > CONFIG_APP_HTTP_IDLE_TIMEOUT_S * 1000000LL) {
+            http_conn_close(c);
+        }
+        if (c->tls && http_origin_eq(&c->origin, origin)) {
+            match = c;
+            break;
+        }
+        if (!c->tls) {
+            empty = empty ? empty : c;
+        } else if (!oldest || c->last_used_us < oldest->last_used_us) {
+            oldest = c;
+        }
+    }
+
+    /* Taking free_conns guarantees one of them */
+    http_conn_t *c = match ? match : empty ? empty : oldest;
+    if (c != match) {
+        http_conn_close(c);
+        c->origin = *origin;
+    }
+    c->in_use = true;
+    xSemaphoreGive(s_http.lock);
+    return c;
+}
+
+static void http_release(http_conn_t *c, bool keep)
+{
+    if (!keep) {
+        http_conn_close(c);
+    }
+    xSemaphoreTake(s_http.lock, portMAX_DELAY);
+    c->in_use = false;
+    c->last_used_us = esp_timer_get_time();
+    xSemaphoreGive(s_http.lock);
+    xSemaphoreGive(s_http.free_conns);
+}
+
+#if CONFIG_APP_HTTP_TLS_RESUME
+static http_session_t *http_find_session(const http_origin_t *origin)
+{
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        if (s_http.sessions[i].session && http_origin_eq(&s_http.sessions[i].origin, origin)) {
+            return &s_http.sessions[i];
+        }
+    }
+    return NULL;
+}
+
+/* A session being offered in a handshake is never freed, a newer one is dropped instead */
+static void http_save_session(http_conn_t *c)
+{
+    esp_tls_client_session_t *session = esp_tls_get_client_session(c->tls);
+    if (!session) {
+        return;
+    }
+
+    xSemaphoreTake(s_http.lock, portMAX_DELAY);
+    http_session_t *slot = http_find_session(&c->origin);
+    for (int i = 0; !slot && i < HTTP_POOL_SIZE; i++) {
+        http_session_t *s = &s_http.sessions[i];
+        if (!s->users && (!slot || s->saved_us < slot->saved_us)) {
+            slot = s;
+        }
+    }
+    if (slot && !slot->users) {
+        if (slot->session) {
+            esp_tls_free_client_session(slot->session);
+        }
+        slot->origin = c->origin;
+        slot->session = session;
+        slot->saved_us = esp_timer_get_time();
+        session = NULL;
+    }
+    xSemaphoreGive(s_http.lock);
+
+    if (session) {
+        esp_tls_free_client_session(session);
+    }
+    c->session_saved = true;
+}
+#endif
+
+static void http_account(app_http_stats_t *delta)
+{
+    portENTER_CRITICAL(&s_http.stats_lock);
+    s_http.stats.requests += delta->requests;
+    s_http.stats.reused += delta->reused;
+    s_http.stats.handshakes += delta->handshakes;
+    s_http.stats.ticket_offers += delta->ticket_offers;
+    s_http.stats.retries += delta->retries;
+    s_http.stats.failures += delta->failures;
+    s_http.stats.handshake_max_ms = MAX(s_http.stats.handshake_max_ms, delta->handshake_max_ms);
+    s_http.stats.handshake_sum_ms += delta->handshake_sum_ms;
+    s_http.stats.fetch_max_ms = MAX(s_http.stats.fetch_max_ms, delta->fetch_max_ms);
+    s_http.stats.fetch_sum_ms += delta->fetch_sum_ms;
+    portEXIT_CRITICAL(&s_http.stats_lock);
+}
+
+static esp_err_t http_connect(http_conn_t *c, app_http_stats_t *delta)
+{
+    esp_tls_cfg_t cfg = {
+        .timeout_ms = CONFIG_APP_HTTP_TIMEOUT_MS,
+        .is_plain_tcp = !c->origin.https,
+    };
+#if !CONFIG_ESP_TLS_SKIP_SERVER_CERT_VERIFY
+    if (c->origin.https) {
+        cfg.crt_bundle_attach = esp_crt_bundle_attach;
+    }
+#endif
+
+#if CONFIG_APP_HTTP_TLS_RESUME
+    http_session_t *session = NULL;
+    if (c->origin.https) {
+        xSemaphoreTake(s_http.lock, portMAX_DELAY);
+        session = http_find_session(&c->origin);
+        if (session) {
+            session->users++;
+            cfg.client_session = session->session;
+            delta->ticket_offers++;
+        }
+        xSemaphoreGive(s_http.lock);
+    }
+#endif
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = ESP_OK;
+    c->tls = esp_tls_init();
+    if (!c->tls) {
+        ret = ESP_ERR_NO_MEM;
+    } else if (esp_tls_conn_new_sync(c->origin.host, strlen(c->origin.host), c->origin.port, &cfg, c->tls) != 1) {
+        ESP_LOGD(TAG, "connect to %s:%u failed", c->origin.host, c->origin.port);
+        http_conn_close(c);
+        ret = ESP_FAIL;
+    }
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+
+#if CONFIG_APP_HTTP_TLS_RESUME
+    if (session) {
+        xSemaphoreTake(s_http.lock, portMAX_DELAY);
+        session->users--;
+        xSemaphoreGive(s_http.lock);
+    }
+#endif
+
+    if (ret == ESP_OK) {
+        delta->handshakes++;
+        delta->handshake_sum_ms += ms;
+        delta->handshake_max_ms = MAX(delta->handshake_max_ms, ms);
+    }
+    return ret;
+}
+
+static esp_err_t http_write_all(http_conn_t *c, const char *data, size_t len)
+{
+    while (len) {
+        ssize_t n = esp_tls_conn_write(c->tls, data, len);
+        if (n > 0) {
+            data += n;
+            len -= n;
+        } else if (n != ESP_TLS_ERR_SSL_WANT_READ && n != ESP_TLS_ERR_SSL_WANT_WRITE) {
+            return ESP_FAIL;
+        } else if (esp_timer_get_time() > c->deadline_us) {
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+    return ESP_OK;
+}
+
+/* 1 with new data in rx, 0 when the server closed the connection, -1 on error or timeout */
+static int http_fill(http_conn_t *c)
+{
+    c->rx_pos = 0;
+    c->rx_len = 0;
+    while (1) {
+        ssize_t n = esp_tls_conn_read(c->tls, c->rx, sizeof(c->rx));
+        if (n > 0) {
+            c->rx_len = n;
+            return 1;
+        }
+        if (n == 0) {
+            return 0;
+        }
+        if (n != ESP_TLS_ERR_SSL_WANT_READ && n != ESP_TLS_ERR_SSL_WANT_WRITE) {
+            return -1;
+        }
+        if (esp_timer_get_time() > c->deadline_us) {
+            return -1;
+        }
+    }
+}
+
+/* Reads one line without the CRLF, the rest of a line longer than `size` is dropped */
+static int http_read_line(http_conn_t *c, char *line, size_t size)
+{
+    size_t len = 0;
+    while (1) {
+        if (c->rx_pos == c->rx_len && http_fill(c) <= 0) {
+            return -1;
+        }
+        char ch = (char)c->rx[c->rx_pos++];
+        if (ch == '\n') {
+            break;
+        }
+        if (len + 1 < size) {
+            line[len++] = ch;
+        }
+    }
+    if (len && line[len - 1] == '\r') {
+        len--;
+    }
+    line[len] = '\0';
+    return (int)len;
+}
+
+static esp_err_t http_body_reserve(http_body_t *body, size_t extra)
+{
+    size_t need = body->len + extra + 1;
+    if (!body->arena || need <= body->cap) {
+        return ESP_OK;
+    }
+    size_t cap = MAX(need, MAX(body->cap * 2, HTTP_BODY_MIN));
+    char *buf = body->buf ? app_arena_extend(body->arena, body->buf, cap) : NULL;
+    if (!buf) {
+        /* Another request allocated from the arena meanwhile, move the body up */
+        buf = app_arena_alloc(body->arena, cap);
+        ESP_RETURN_ON_FALSE(buf, ESP_ERR_NO_MEM, TAG, "body of %u bytes does not fit the arena", (unsigned)need);
+        if (body->len) {
+            memcpy(buf, body->buf, body->len);
+        }
+    }
+    body->buf = buf;
+    body->cap = cap;
+    return ESP_OK;
+}
+
+/* Appends up to `len` bytes, stops early only when the server closed the connection */
+static esp_err_t http_body_read(http_conn_t *c, http_body_t *body, size_t len, bool until_close)
+{
+    while (len) {
+        if (c->rx_pos == c->rx_len) {
+            int ret = http_fill(c);
+            if (ret == 0 && until_close) {
+                return ESP_OK;
+            }
+            if (ret <= 0) {
+                return ESP_FAIL;
+            }
+        }
+        size_t n = MIN(len, c->rx_len - c->rx_pos);
+        if (body->cb) {
+            ESP_RETURN_ON_ERROR(body->cb(c->rx + c->rx_pos, n, body->cb_arg), TAG, "body callback failed");
+            /* A streamed body may take long as a whole, only a stall times out */
+            c->deadline_us = esp_timer_get_time() + CONFIG_APP_HTTP_TIMEOUT_MS * 1000LL;
+        } else {
+            esp_err_t err = http_body_reserve(body, n);
+            if (err != ESP_OK) {
+                return err;
+            }
+            if (body->arena) {
+                memcpy(body->buf + body->len, c->rx + c->rx_pos, n);
+            }
+        }
+        body->len += n;
+        c->rx_pos += n;
+        if (!until_close) {
+            len -= n;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t http_read_chunked(http_conn_t *c, http_body_t *body)
+{
+    char line[HTTP_LINE_MAX];
+
+    while (1) {
+        ESP_RETURN_ON_FALSE(http_read_line(c, line, sizeof(line)) >= 0, ESP_FAIL, TAG, "connection lost at a chunk");
+        /* Hex size, optionally followed by chunk extensions after a ';' */
+        char *end;
+        size_t size = strtoul(line, &end, 16);
+        bool valid = isxdigit((unsigned char)line[0]) && (!*end || *end == ';' || *end == ' ' || *end == '\t');
+        ESP_RETURN_ON_FALSE(valid, ESP_ERR_INVALID_RESPONSE, TAG, "bad chunk size \"%s\"", line);
+        if (size == 0) {
+            break;
+        }
+        ESP_RETURN_ON_ERROR(http_body_read(c, body, size, false), TAG, "chunk of %u bytes cut short", (unsigned)size);
+        ESP_RETURN_ON_FALSE(http_read_line(c, line, sizeof(line)) == 0, ESP_ERR_INVALID_RESPONSE, TAG, "bad chunk");
+    }
+
+    /* Trailers up to the empty line */
+    int n;
+    while ((n = http_read_line(c, line, sizeof(line))) > 0) {
+    }
+    return n == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static const char *http_header_value(const char *line, const char *name)
+{
+    size_t len = strlen(name);
+    if (strncasecmp(line, name, len) != 0 || line[len] != ':') {
+        return NULL;
+    }
+    line += len + 1;
+    while (*line == ' ' || *line == '\t') {
+        line++;
+    }
+    return line;
+}
+
+static esp_err_t http_read_response(http_conn_t *c, const http_body_t *sink, app_http_response_t *resp,
+                                    bool *keep_alive, bool *got_any)
+{
+    char line[HTTP_LINE_MAX];
+    int minor = 1;
+
+    if (http_read_line(c, line, sizeof(line)) < 0) {
+        return ESP_FAIL;
+    }
+    *got_any = true;
+    ESP_RETURN_ON_FALSE(sscanf(line, "HTTP/1.%d %d", &minor, &resp->status) == 2, ESP_ERR_INVALID_RESPONSE, TAG,
+                        "bad status line");
+    *keep_alive = minor > 0;
+
+    long content_length = -1;
+    bool chunked = false;
+    int n;
+    while ((n = http_read_line(c, line, sizeof(line))) > 0) {
+        const char *value;
+        if ((value = http_header_value(line, "Content-Length"))) {
+            content_length = strtol(value, NULL, 10);
+        } else if ((value = http_header_value(line, "Transfer-Encoding"))) {
+            chunked = strncasecmp(value, "chunked", 7) == 0;
+        } else if ((value = http_header_value(line, "Connection"))) {
+            if (strncasecmp(value, "close", 5) == 0) {
+                *keep_alive = false;
+            } else if (strncasecmp(value, "keep-alive", 10) == 0) {
+                *keep_alive = true;
+            }
+        }
+    }
+    ESP_RETURN_ON_FALSE(n == 0, ESP_FAIL, TAG, "connection lost in the headers");
+
+    http_body_t body = *sink;
+    if (resp->status < 200 || resp->status >= 300) {
+        body.cb = NULL;     /* Only successful bodies are streamed, others are dropped */
+    }
+    esp_err_t ret = ESP_OK;
+    if (resp->status == 204 || resp->status == 304 || (resp->status >= 100 && resp->status < 200)) {
+        /* No body */
+    } else if (chunked) {
+        ret = http_read_chunked(c, &body);
+    } else if (content_length >= 0) {
+        ret = http_body_reserve(&body, content_length);
+        if (ret == ESP_OK) {
+            ret = http_body_read(c, &body, content_length, false);
+        }
+    } else {
+        *keep_alive = false;
+        ret = http_body_read(c, &body, SIZE_MAX, true);
+    }
+    ESP_RETURN_ON_ERROR(ret, TAG, "reading the body of status %d failed", resp->status);
+
+    if (body.buf) {
+        body.buf[body.len] = '\0';
+    } else if (body.arena) {
+        /* Empty body, still hand out a string */
+        body.buf = app_arena_alloc(body.arena, 1);
+        ESP_RETURN_ON_FALSE(body.buf, ESP_ERR_NO_MEM, TAG, "arena full");
+        body.buf[0] = '\0';
+    }
+    resp->body = body.buf;
+    resp->body_len = body.len;
+    return ESP_OK;
+}
+
+static esp_err_t http_send_request(http_conn_t *c, const char *path, const char *const *headers)
+{
+    char req[HTTP_REQUEST_MAX];
+    bool default_port = c->origin.port == (c->origin.https ? 443 : 80);
+    int len = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: %s", path, c->origin.host);
+    if (!default_port && len < sizeof(req)) {
+        len += snprintf(req + len, sizeof(req) - len, ":%u", c->origin.port);
+    }
+    if (len < sizeof(req)) {
+        len += snprintf(req + len, sizeof(req) - len, "\r\nConnection: keep-alive\r\nUser-Agent: esp32-weather\r\n");
+    }
+    for (int i = 0; headers && headers[i] && len < sizeof(req); i++) {
+        len += snprintf(req + len, sizeof(req) - len, "%s\r\n", headers[i]);
+    }
+    if (len < sizeof(req)) {
+        len += snprintf(req + len, sizeof(req) - len, "\r\n");
+    }
+    ESP_RETURN_ON_FALSE(len < sizeof(req), ESP_ERR_INVALID_SIZE, TAG, "request too long");
+    return http_write_all(c, req, len);
+}
+
+static esp_err_t http_get(const char *url, const char *const *headers, const http_body_t *sink,
+                          app_http_response_t *resp)
+{
+    ESP_RETURN_ON_FALSE(url && resp, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    /* Callers log the status of a failed request too */
+    memset(resp, 0, sizeof(*resp));
+    ESP_RETURN_ON_FALSE(s_http.lock, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+
+    http_origin_t origin;
+    const char *path;
+    ESP_RETURN_ON_ERROR(http_parse_url(url, &origin, &path), TAG, "unsupported URL %s", url);
+
+    app_http_stats_t delta = { .requests = 1 };
+    int64_t start = esp_timer_get_time();
+    http_conn_t *c = http_acquire(&origin);
+    if (!c) {
+        delta.failures++;
+        http_account(&delta);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    esp_err_t ret;
+    bool keep_alive = false;
+    for (int attempt = 0; ; attempt++) {
+        bool reused = c->tls != NULL;
+        if (!reused) {
+            ret = http_connect(c, &delta);
+            if (ret != ESP_OK) {
+                break;
+            }
+        }
+
+        bool got_any = false;
+        c->deadline_us = esp_timer_get_time() + CONFIG_APP_HTTP_TIMEOUT_MS * 1000LL;
+        ret = http_send_request(c, path, headers);
+        if (ret == ESP_OK) {
+            ret = http_read_response(c, sink, resp, &keep_alive, &got_any);
+        }
+        if (ret == ESP_OK) {
+            delta.reused += reused;
+            break;
+        }
+
+        /* The server may close a kept-alive connection at any time, try once more on a new one */
+        http_conn_close(c);
+        if (!reused || got_any || attempt) {
+            break;
+        }
+        delta.retries++;
+    }
+
+#if CONFIG_APP_HTTP_TLS_RESUME
+    /* TLS 1.3 tickets arrive after the handshake, so the session is taken after the first response */
+    if (ret == ESP_OK && c->origin.https && !c->session_saved) {
+        http_save_session(c);
+    }
+#endif
+    http_release(c, ret == ESP_OK && keep_alive);
+
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+    delta.failures += ret != ESP_OK;
+    delta.fetch_sum_ms = ms;
+    delta.fetch_max_ms = ms;
+    http_account(&delta);
+    ESP_LOGD(TAG, "GET %s: %s, status %d, %u bytes in %"PRIu32" ms", url, esp_err_to_name(ret), resp->status,
+             (unsigned)resp->body_len, ms);
+    return ret;
+}
+
+esp_err_t app_http_get(const char *url, const char *const *headers, app_arena_handle_t arena,
+                       app_http_response_t *resp)
+{
+    const http_body_t sink = { .arena = arena };
+    return http_get(url, headers, &sink, resp);
+}
+
+esp_err_t app_http_get_stream(const char *url, const char *const *headers, app_http_body_cb_t body_cb, void *arg,
+                              app_http_response_t *resp)
+{
+    ESP_RETURN_ON_FALSE(body_cb, ESP_ERR_INVALID_ARG, TAG, "body callback is required");
+    const http_body_t sink = { .cb = body_cb, .cb_arg = arg };
+    return http_get(url, headers, &sink, resp);
+}
+
+void app_http_close_idle(void)
+{
+    if (!s_http.lock) {
+        return;
+    }
+    xSemaphoreTake(s_http.lock, portMAX_DELAY);
+    for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+        if (!s_http.conns[i].in_use) {
+            http_conn_close(&s_http.conns[i]);
+        }
+    }
+    xSemaphoreGive(s_http.lock);
+}
+
+esp_err_t app_http_init(void)
+{
+    ESP_RETURN_ON_FALSE(!s_http.lock, ESP_ERR_INVALID_STATE, TAG, "already initialized");
+    s_http.free_conns = xSemaphoreCreateCounting(HTTP_POOL_SIZE, HTTP_POOL_SIZE);
+    ESP_RETURN_ON_FALSE(s_http.free_conns, ESP_ERR_NO_MEM, TAG, "no memory for semaphore");
+    s_http.lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_http.lock, ESP_ERR_NO_MEM, TAG, "no memory for mutex");
+    return ESP_OK;
+}
+
+void app_http_get_stats(app_http_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_http.stats_lock);
+    *stats = s_http.stats;
+    memset(&s_http.stats, 0, sizeof(s_http.stats));
+    portEXIT_CRITICAL(&s_http.stats_lock);
+}
+
+void app_http_log_stats(void)
+{
+    app_http_stats_t st;
+    app_http_get_stats(&st);
+    ESP_LOGI(TAG, "requests=%"PRIu32" reused=%"PRIu32" handshakes=%"PRIu32" ticket_offers=%"PRIu32" retries=%"PRIu32
+             " failures=%"PRIu32" handshake_avg_ms=%"PRIu32" handshake_max_ms=%"PRIu32" fetch_avg_ms=%"PRIu32
+             " fetch_max_ms=%"PRIu32, st.requests, st.reused, st.handshakes, st.ticket_offers, st.retries, st.failures,
+             st.handshakes ? (uint32_t)(st.handshake_sum_ms / st.handshakes) : 0, st.handshake_max_ms,
+             st.requests ? (uint32_t)(st.fetch_sum_ms / st.requests) : 0, st.fetch_max_ms);
+}
+
+static int http_cmd_fetch(int argc, char **argv)
+{
+    if (argc < 2 || argc > 4 || (argc == 4 && strcmp(argv[3], "close") != 0)) {
+        printf("usage: fetch <url> [count] [close]\n");
+        return 1;
+    }
+    int count = argc > 2 ? atoi(argv[2]) : 1;
+    bool close_between = argc == 4;
+
+    app_http_stats_t discard;
+    app_http_get_stats(&discard);   /* Start from clear counters */
+    for (int i = 0; i < count; i++) {
+        if (close_between) {
+            app_http_close_idle();
+        }
+        app_http_response_t resp;
+        int64_t start = esp_timer_get_time();
+        esp_err_t ret = app_http_get(argv[1], NULL, NULL, &resp);
+        printf("fetch: %s status=%d len=%u ms=%u\n", esp_err_to_name(ret), resp.status, (unsigned)resp.body_len,
+               (unsigned)((esp_timer_get_time() - start) / 1000));
+    }
+    app_http_log_stats();
+    return 0;
+}
+
+esp_err_t app_http_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "fetch",
+        .help = "GET a URL <count> times over the connection pool and show the counters: fetch <url> [count] [close]",
+        .func = http_cmd_fetch,
+    };
+    return esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,94 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "app_mem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int status;                 /*!< HTTP status code */
+    char *body;                 /*!< NUL terminated, from the arena, NULL when the body was discarded */
+    size_t body_len;
+} app_http_response_t;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t reused;            /*!< Requests sent on a kept-alive connection */
+    uint32_t handshakes;        /*!< New TCP (and TLS) connections */
+    uint32_t ticket_offers;     /*!< TLS handshakes that offered a saved session ticket */
+    uint32_t retries;           /*!< Kept-alive connections the server had closed meanwhile */
+    uint32_t failures;
+    uint32_t handshake_max_ms;
+    uint64_t handshake_sum_ms;
+    uint32_t fetch_max_ms;      /*!< Whole request, including waiting for a pooled connection */
+    uint64_t fetch_sum_ms;
+} app_http_stats_t;
+
+/**
+ * @brief Takes the next piece of a streamed body, any error aborts the request
+ */
+typedef esp_err_t (*app_http_body_cb_t)(const uint8_t *data, size_t len, void *arg);
+
+/**
+ * @brief Create the connection pool, up to CONFIG_APP_HTTP_POOL_SIZE connections
+ */
+esp_err_t app_http_init(void);
+
+/**
+ * @brief GET `url` over a pooled keep-alive connection, reusing the TLS session of the host
+ *
+ * Blocks until the whole body is read. Safe to call from several tasks at once, each
+ * request holds one pooled connection. A request on a connection the server closed
+ * meanwhile is retried once on a new one.
+ *
+ * @param url       "http://" or "https://" URL
+ * @param headers   NULL terminated extra header lines without CRLF, e.g. "Referer: ...", or NULL
+ * @param arena     Arena the body is allocated from, NULL to read and drop it
+ * @param resp      Cleared first, so its status is 0 when the request failed before a response
+ */
+esp_err_t app_http_get(const char *url, const char *const *headers, app_arena_handle_t arena,
+                       app_http_response_t *resp);
+
+/**
+ * @brief Like app_http_get(), handing the body to `body_cb` piece by piece as it arrives
+ *
+ * The body is never held as a whole, so it may be larger than any arena. The response
+ * timeout applies to each piece rather than to the whole body. Only the body of a 2xx
+ * response reaches `body_cb`, `resp->body` stays NULL and `resp->body_len` counts the bytes.
+ */
+esp_err_t app_http_get_stream(const char *url, const char *const *headers, app_http_body_cb_t body_cb, void *arg,
+                              app_http_response_t *resp);
+
+/**
+ * @brief Close the connections no request is using
+ *
+ * Saved TLS sessions are kept, so the next connection still skips the full handshake.
+ */
+void app_http_close_idle(void);
+
+/**
+ * @brief Get the counters and clear them
+ */
+void app_http_get_stats(app_http_stats_t *stats);
+
+/**
+ * @brief Log the counters as "http: requests= ..." and clear them
+ */
+void app_http_log_stats(void);
+
+/**
+ * @brief Add the "fetch" console command
+ */
+esp_err_t app_http_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,410 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_lcd_panel_io_interface.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "driver/i2c_master.h"
+#endif
+#include "app_i2c_bus.h"
+#include "app_trace.h"
+
+#define I2C_BUS_TASK_STACK      (3072)
+#define I2C_PANEL_IO_TIMEOUT_MS (50)
+#define I2C_PANEL_IO_BUF_LEN    (32)
+
+static const char *TAG = "i2c_bus";
+
+struct app_i2c_dev_t {
+    void *backend_dev;
+    uint16_t addr;
+    app_i2c_prio_t prio;
+    SemaphoreHandle_t sync_lock;    /* Serializes blocking callers of this device */
+    SemaphoreHandle_t sync_done;
+    esp_err_t sync_err;
+};
+
+typedef struct {
+    app_i2c_dev_handle_t dev;
+    const app_i2c_xfer_t *xfers;
+    size_t count;
+    size_t next;                    /* First transfer not run yet, kept when preempted */
+    app_i2c_done_cb_t cb;
+    void *arg;
+    int timeout_ms;
+    int64_t t_submit;
+} i2c_req_t;
+
+typedef struct {
+    esp_lcd_panel_io_t base;
+    app_i2c_dev_handle_t dev;
+    int cmd_bytes;
+} i2c_panel_io_t;
+
+static struct {
+    app_i2c_backend_t backend;
+    QueueHandle_t queues[APP_I2C_PRIO_MAX];
+    SemaphoreHandle_t pending;      /* Counts requests over all queues */
+    TaskHandle_t task;
+    portMUX_TYPE stats_lock;
+    app_i2c_bus_stats_t stats;
+    int64_t window_start;
+} s_bus = {
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+#if !CONFIG_IDF_TARGET_LINUX
+static esp_err_t hw_add_device(void *ctx, uint16_t addr, uint32_t scl_speed_hz, void **ret_dev)
+{
+    const i2c_device_config_t dev_conf = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = addr,
+        .scl_speed_hz = scl_speed_hz,
+    };
+    return i2c_master_bus_add_device((i2c_master_bus_handle_t)ctx, &dev_conf, (i2c_master_dev_handle_t *)ret_dev);
+}
+
+static esp_err_t hw_transfer(void *ctx, void *dev, const app_i2c_xfer_t *xfer, int timeout_ms)
+{
+    if (xfer->tx_len && xfer->rx_len) {
+        return i2c_master_transmit_receive(dev, xfer->tx, xfer->tx_len, xfer->rx, xfer->rx_len, timeout_ms);
+    } else if (xfer->tx_len) {
+        return i2c_master_transmit(dev, xfer->tx, xfer->tx_len, timeout_ms);
+    }
+    return i2c_master_receive(dev, xfer->rx, xfer->rx_len, timeout_ms);
+}
+
+static esp_err_t hw_backend_init(const app_i2c_bus_config_t *config, app_i2c_backend_t *backend)
+{
+    const i2c_master_bus_config_t bus_conf = {
+        .i2c_port = config->port,
+        .sda_io_num = config->sda_io_num,
+        .scl_io_num = config->scl_io_num,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = config->enable_internal_pullup,
+    };
+    i2c_master_bus_handle_t bus = NULL;
+    ESP_RETURN_ON_ERROR(i2c_new_master_bus(&bus_conf, &bus), TAG, "I2C master bus creation failed");
+
+    backend->add_device = hw_add_device;
+    backend->transfer = hw_transfer;
+    backend->ctx = bus;
+    return ESP_OK;
+}
+#endif
+
+static bool bus_higher_prio_pending(app_i2c_prio_t prio)
+{
+    for (int p = 0; p < prio; p++) {
+        if (uxQueueMessagesWaiting(s_bus.queues[p])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool bus_take_request(i2c_req_t *req)
+{
+    for (int p = 0; p < APP_I2C_PRIO_MAX; p++) {
+        if (xQueueReceive(s_bus.queues[p], req, 0) == pdTRUE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void bus_account(app_i2c_prio_t prio, int64_t t_start, int64_t t_end, uint32_t wait_us,
+                        bool back_to_back, esp_err_t err)
+{
+    portENTER_CRITICAL(&s_bus.stats_lock);
+    s_bus.stats.xfers[prio]++;
+    s_bus.stats.busy_us += t_end - t_start;
+    s_bus.stats.max_wait_us[prio] = MAX(s_bus.stats.max_wait_us[prio], wait_us);
+    s_bus.stats.back_to_back += back_to_back;
+    s_bus.stats.errors += err != ESP_OK;
+    portEXIT_CRITICAL(&s_bus.stats_lock);
+}
+
+/* Runs the remaining transfers of a request, returns false if it was put back for a higher priority one */
+static bool bus_run_request(i2c_req_t *req, bool *back_to_back, esp_err_t *err)
+{
+    app_i2c_dev_handle_t dev = req->dev;
+
+    while (req->next < req->count) {
+        const app_i2c_xfer_t *xfer = &req->xfers[req->next];
+        APP_TRACE_BEGIN(APP_TRACE_I2C_XFER, dev->addr | dev->prio << 8 | (xfer->tx_len + xfer->rx_len) << 16);
+        int64_t t_start = esp_timer_get_time();
+        *err = s_bus.backend.transfer(s_bus.backend.ctx, dev->backend_dev, xfer, req->timeout_ms);
+        int64_t t_end = esp_timer_get_time();
+        APP_TRACE_END(APP_TRACE_I2C_XFER, *err);
+        bus_account(dev->prio, t_start, t_end, req->next ? 0 : (uint32_t)(t_start - req->t_submit), *back_to_back,
+                    *err);
+        *back_to_back = true;
+        req->next++;
+        if (*err != ESP_OK) {
+            ESP_LOGD(TAG, "0x%02x transfer %d failed: %s", dev->addr, (int)req->next - 1, esp_err_to_name(*err));
+            return true;
+        }
+
+        /* Yield the bus between two transfers, the rest of the request runs next.
+         * If a submitter took the freed slot meanwhile, just carry on. */
+        if (req->next < req->count && bus_higher_prio_pending(dev->prio) &&
+                xQueueSendToFront(s_bus.queues[dev->prio], req, 0) == pdTRUE) {
+            xSemaphoreGive(s_bus.pending);
+            portENTER_CRITICAL(&s_bus.stats_lock);
+            s_bus.stats.preemptions++;
+            portEXIT_CRITICAL(&s_bus.stats_lock);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void bus_task(void *arg)
+{
+    i2c_req_t req;
+
+    while (1) {
+        xSemaphoreTake(s_bus.pending, portMAX_DELAY);
+        bool back_to_back = false;
+        do {
+            if (!bus_take_request(&req)) {
+                continue;
+            }
+            esp_err_t err = ESP_OK;
+            if (bus_run_request(&req, &back_to_back, &err) && req.cb) {
+                req.cb(req.dev, err, req.arg);
+            }
+            /* Keep draining without sleeping. Each transfer still runs on its own, only the wake-up is shared */
+        } while (xSemaphoreTake(s_bus.pending, 0) == pdTRUE);
+    }
+}
+
+esp_err_t app_i2c_bus_init(const app_i2c_bus_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(config, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(!s_bus.task, ESP_ERR_INVALID_STATE, TAG, "bus already initialized");
+
+    if (config->backend) {
+        s_bus.backend = *config->backend;
+    } else {
+#if CONFIG_IDF_TARGET_LINUX
+        ESP_RETURN_ON_FALSE(false, ESP_ERR_NOT_SUPPORTED, TAG, "no I2C hardware on this target, use the mock backend");
+#else
+        ESP_RETURN_ON_ERROR(hw_backend_init(config, &s_bus.backend), TAG, "I2C master init failed");
+#endif
+    }
+
+    for (int p = 0; p < APP_I2C_PRIO_MAX; p++) {
+        s_bus.queues[p] = xQueueCreate(CONFIG_APP_I2C_BUS_QUEUE_LEN, sizeof(i2c_req_t));
+        ESP_RETURN_ON_FALSE(s_bus.queues[p], ESP_ERR_NO_MEM, TAG, "no memory for queue");
+    }
+    s_bus.pending = xSemaphoreCreateCounting(CONFIG_APP_I2C_BUS_QUEUE_LEN * APP_I2C_PRIO_MAX, 0);
+    ESP_RETURN_ON_FALSE(s_bus.pending, ESP_ERR_NO_MEM, TAG, "no memory for semaphore");
+    s_bus.window_start = esp_timer_get_time();
+
+    BaseType_t res = xTaskCreatePinnedToCore(bus_task, "i2c_bus", I2C_BUS_TASK_STACK, NULL,
+                                             CONFIG_APP_I2C_BUS_TASK_PRIORITY, &s_bus.task,
+                                             CONFIG_APP_I2C_BUS_TASK_CORE < 0 ? tskNO_AFFINITY : CONFIG_APP_I2C_BUS_TASK_CORE);
+    ESP_RETURN_ON_FALSE(res == pdPASS, ESP_ERR_NO_MEM, TAG, "bus task creation failed");
+    return ESP_OK;
+}
+
+esp_err_t app_i2c_bus_add_device(uint16_t addr, uint32_t scl_speed_hz, app_i2c_prio_t prio,
+                                 app_i2c_dev_handle_t *ret_dev)
+{
+    esp_err_t ret = ESP_OK;
+    ESP_RETURN_ON_FALSE(s_bus.task, ESP_ERR_INVALID_STATE, TAG, "bus not initialized");
+    ESP_RETURN_ON_FALSE(ret_dev && prio < APP_I2C_PRIO_MAX, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    app_i2c_dev_handle_t dev = calloc(1, sizeof(struct app_i2c_dev_t));
+    ESP_RETURN_ON_FALSE(dev, ESP_ERR_NO_MEM, TAG, "no memory for device");
+    dev->addr = addr;
+    dev->prio = prio;
+    dev->sync_lock = xSemaphoreCreateMutex();
+    dev->sync_done = xSemaphoreCreateBinary();
+    ESP_GOTO_ON_FALSE(dev->sync_lock && dev->sync_done, ESP_ERR_NO_MEM, err, TAG, "no memory for semaphores");
+    ESP_GOTO_ON_ERROR(s_bus.backend.add_device(s_bus.backend.ctx, addr, scl_speed_hz, &dev->backend_dev), err, TAG,
+                      "add device 0x%02x failed", addr);
+
+    *ret_dev = dev;
+    return ESP_OK;
+
+err:
+    if (dev->sync_lock) {
+        vSemaphoreDelete(dev->sync_lock);
+    }
+    if (dev->sync_done) {
+        vSemaphoreDelete(dev->sync_done);
+    }
+    free(dev);
+    return ret;
+}
+
+esp_err_t app_i2c_submit(app_i2c_dev_handle_t dev, const app_i2c_xfer_t *xfers, size_t count,
+                         app_i2c_done_cb_t cb, void *arg, int timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(dev && xfers && count, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    const i2c_req_t req = {
+        .dev = dev,
+        .xfers = xfers,
+        .count = count,
+        .cb = cb,
+        .arg = arg,
+        .timeout_ms = timeout_ms,
+        .t_submit = esp_timer_get_time(),
+    };
+    const TickType_t ticks = timeout_ms < 0 ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+    if (xQueueSend(s_bus.queues[dev->prio], &req, ticks) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreGive(s_bus.pending);
+    return ESP_OK;
+}
+
+static void sync_done_cb(app_i2c_dev_handle_t dev, esp_err_t err, void *arg)
+{
+    dev->sync_err = err;
+    xSemaphoreGive(dev->sync_done);
+}
+
+esp_err_t app_i2c_transfer(app_i2c_dev_handle_t dev, const app_i2c_xfer_t *xfers, size_t count, int timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(dev, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    xSemaphoreTake(dev->sync_lock, portMAX_DELAY);
+    esp_err_t ret = app_i2c_submit(dev, xfers, count, sync_done_cb, NULL, timeout_ms);
+    if (ret == ESP_OK) {
+        /* The request refers to the caller's buffers, so always wait for it to finish */
+        xSemaphoreTake(dev->sync_done, portMAX_DELAY);
+        ret = dev->sync_err;
+    }
+    xSemaphoreGive(dev->sync_lock);
+    return ret;
+}
+
+esp_err_t app_i2c_write(app_i2c_dev_handle_t dev, const uint8_t *buf, size_t len, int timeout_ms)
+{
+    const app_i2c_xfer_t xfer = {
+        .tx = buf,
+        .tx_len = len,
+    };
+    return app_i2c_transfer(dev, &xfer, 1, timeout_ms);
+}
+
+esp_err_t app_i2c_write_read(app_i2c_dev_handle_t dev, const uint8_t *tx, size_t tx_len,
+                             uint8_t *rx, size_t rx_len, int timeout_ms)
+{
+    const app_i2c_xfer_t xfer = {
+        .tx = tx,
+        .tx_len = tx_len,
+        .rx = rx,
+        .rx_len = rx_len,
+    };
+    return app_i2c_transfer(dev, &xfer, 1, timeout_ms);
+}
+
+void app_i2c_bus_get_stats(app_i2c_bus_stats_t *stats)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&s_bus.stats_lock);
+    *stats = s_bus.stats;
+    memset(&s_bus.stats, 0, sizeof(s_bus.stats));
+    portEXIT_CRITICAL(&s_bus.stats_lock);
+
+    stats->window_us = now - s_bus.window_start;
+    stats->utilization_pct = stats->window_us ? MIN(100, stats->busy_us * 100 / stats->window_us) : 0;
+    s_bus.window_start = now;
+}
+
+static size_t panel_io_encode_cmd(const i2c_panel_io_t *pio, int lcd_cmd, uint8_t *buf)
+{
+    if (lcd_cmd < 0) {
+        return 0;
+    }
+    for (int i = 0; i < pio->cmd_bytes; i++) {
+        buf[i] = (lcd_cmd >> (8 * (pio->cmd_bytes - 1 - i))) & 0xFF;
+    }
+    return pio->cmd_bytes;
+}
+
+static esp_err_t panel_io_rx_param(esp_lcd_panel_io_t *io, int lcd_cmd, void *param, size_t param_size)
+{
+    i2c_panel_io_t *pio = __containerof(io, i2c_panel_io_t, base);
+    uint8_t cmd[4];
+    size_t cmd_len = panel_io_encode_cmd(pio, lcd_cmd, cmd);
+
+    return app_i2c_write_read(pio->dev, cmd, cmd_len, param, param_size, I2C_PANEL_IO_TIMEOUT_MS);
+}
+
+static esp_err_t panel_io_tx_param(esp_lcd_panel_io_t *io, int lcd_cmd, const void *param, size_t param_size)
+{
+    i2c_panel_io_t *pio = __containerof(io, i2c_panel_io_t, base);
+    uint8_t stack_buf[I2C_PANEL_IO_BUF_LEN];
+    uint8_t *buf = stack_buf;
+
+    if (param_size + pio->cmd_bytes > sizeof(stack_buf)) {
+        buf = malloc(param_size + pio->cmd_bytes);
+        ESP_RETURN_ON_FALSE(buf, ESP_ERR_NO_MEM, TAG, "no memory for transfer");
+    }
+    size_t len = panel_io_encode_cmd(pio, lcd_cmd, buf);
+    if (param_size) {
+        memcpy(buf + len, param, param_size);
+        len += param_size;
+    }
+    esp_err_t ret = app_i2c_write(pio->dev, buf, len, I2C_PANEL_IO_TIMEOUT_MS);
+
+    if (buf != stack_buf) {
+        free(buf);
+    }
+    return ret;
+}
+
+static esp_err_t panel_io_register_event_callbacks(esp_lcd_panel_io_t *io, const esp_lcd_panel_io_callbacks_t *cbs,
+                                                   void *user_ctx)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static esp_err_t panel_io_del(esp_lcd_panel_io_t *io)
+{
+    free(__containerof(io, i2c_panel_io_t, base));
+    return ESP_OK;
+}
+
+esp_err_t app_i2c_bus_new_panel_io(app_i2c_dev_handle_t dev, const esp_lcd_panel_io_i2c_config_t *io_config,
+                                   esp_lcd_panel_io_handle_t *ret_io)
+{
+    ESP_RETURN_ON_FALSE(dev && io_config && ret_io, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(io_config->flags.disable_control_phase, ESP_ERR_NOT_SUPPORTED, TAG,
+                        "control phase not supported");
+    ESP_RETURN_ON_FALSE(io_config->lcd_cmd_bits % 8 == 0 && io_config->lcd_cmd_bits <= 32, ESP_ERR_INVALID_ARG, TAG,
+                        "unsupported command width");
+
+    i2c_panel_io_t *pio = calloc(1, sizeof(i2c_panel_io_t));
+    ESP_RETURN_ON_FALSE(pio, ESP_ERR_NO_MEM, TAG, "no memory for panel IO");
+    pio->dev = dev;
+    pio->cmd_bytes = io_config->lcd_cmd_bits / 8;
+    pio->base.rx_param = panel_io_rx_param;
+    pio->base.tx_param = panel_io_tx_param;
+    pio->base.tx_color = panel_io_tx_param;
+    pio->base.del = panel_io_del;
+    pio->base.register_event_callbacks = panel_io_register_event_callbacks;
+
+    *ret_io = &pio->base;
+    return ESP_OK;
+}
@@ -0,0 +1,129 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_lcd_panel_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Transaction priority, lower value runs first
+ *
+ * A queued request of higher priority preempts a lower one between two transfers.
+ */
+typedef enum {
+    APP_I2C_PRIO_TOUCH = 0,     /*!< Touch controller reads, latency critical */
+    APP_I2C_PRIO_IO,            /*!< IO expander / control writes */
+    APP_I2C_PRIO_SENSOR,        /*!< Environmental sensor polling */
+    APP_I2C_PRIO_MAX,
+} app_i2c_prio_t;
+
+typedef struct app_i2c_dev_t *app_i2c_dev_handle_t;
+
+/**
+ * @brief One bus transfer: write `tx`, then read `rx` with a repeated start
+ *
+ * Either side may be empty but not both.
+ */
+typedef struct {
+    const uint8_t *tx;
+    size_t tx_len;
+    uint8_t *rx;
+    size_t rx_len;
+} app_i2c_xfer_t;
+
+/**
+ * @brief Completion callback of an asynchronous request, called from the bus task
+ */
+typedef void (*app_i2c_done_cb_t)(app_i2c_dev_handle_t dev, esp_err_t err, void *arg);
+
+/**
+ * @brief Low level bus access, implemented by the i2c_master driver or by a mock
+ */
+typedef struct {
+    esp_err_t (*add_device)(void *ctx, uint16_t addr, uint32_t scl_speed_hz, void **ret_dev);
+    esp_err_t (*transfer)(void *ctx, void *dev, const app_i2c_xfer_t *xfer, int timeout_ms);
+    void *ctx;
+} app_i2c_backend_t;
+
+typedef struct {
+    int port;                           /*!< I2C port number, hardware backend only */
+    int sda_io_num;                     /*!< SDA GPIO, hardware backend only */
+    int scl_io_num;                     /*!< SCL GPIO, hardware backend only */
+    bool enable_internal_pullup;        /*!< Hardware backend only */
+    const app_i2c_backend_t *backend;   /*!< NULL selects the i2c_master driver */
+} app_i2c_bus_config_t;
+
+typedef struct {
+    uint32_t xfers[APP_I2C_PRIO_MAX];       /*!< Transfers completed per priority */
+    uint32_t max_wait_us[APP_I2C_PRIO_MAX]; /*!< Longest submit-to-start wait per priority */
+    uint32_t back_to_back;                  /*!< Transfers started without the bus task sleeping, never merged */
+    uint32_t preemptions;                   /*!< Requests paused for a higher priority one */
+    uint32_t errors;                        /*!< Failed transfers */
+    uint64_t busy_us;                       /*!< Time spent inside transfers */
+    uint64_t window_us;                     /*!< Length of the measurement window */
+    uint8_t utilization_pct;                /*!< busy_us / window_us */
+} app_i2c_bus_stats_t;
+
+/**
+ * @brief Create the bus and its worker task
+ */
+esp_err_t app_i2c_bus_init(const app_i2c_bus_config_t *config);
+
+/**
+ * @brief Attach a 7-bit address device with a fixed priority
+ */
+esp_err_t app_i2c_bus_add_device(uint16_t addr, uint32_t scl_speed_hz, app_i2c_prio_t prio,
+                                 app_i2c_dev_handle_t *ret_dev);
+
+/**
+ * @brief Queue `count` transfers to run back-to-back, `cb` is called once all are done
+ *
+ * `xfers` and the buffers it points to must stay valid until `cb` runs.
+ *
+ * @return ESP_ERR_TIMEOUT if the queue stayed full for `timeout_ms`
+ */
+esp_err_t app_i2c_submit(app_i2c_dev_handle_t dev, const app_i2c_xfer_t *xfers, size_t count,
+                         app_i2c_done_cb_t cb, void *arg, int timeout_ms);
+
+/**
+ * @brief Queue transfers and wait for them to complete
+ *
+ * `timeout_ms` bounds the queueing and each transfer on the wire.
+ */
+esp_err_t app_i2c_transfer(app_i2c_dev_handle_t dev, const app_i2c_xfer_t *xfers, size_t count, int timeout_ms);
+
+/**
+ * @brief Write `len` bytes, blocking
+ */
+esp_err_t app_i2c_write(app_i2c_dev_handle_t dev, const uint8_t *buf, size_t len, int timeout_ms);
+
+/**
+ * @brief Write then read with a repeated start, blocking
+ */
+esp_err_t app_i2c_write_read(app_i2c_dev_handle_t dev, const uint8_t *tx, size_t tx_len,
+                             uint8_t *rx, size_t rx_len, int timeout_ms);
+
+/**
+ * @brief Read statistics and start a new measurement window
+ */
+void app_i2c_bus_get_stats(app_i2c_bus_stats_t *stats);
+
+/**
+ * @brief Wrap a device into an esp_lcd panel IO so that drivers such as the GT911 run through the bus queue
+ *
+ * Uses `lcd_cmd_bits` of `io_config`; the control phase is not supported.
+ */
+esp_err_t app_i2c_bus_new_panel_io(app_i2c_dev_handle_t dev, const esp_lcd_panel_io_i2c_config_t *io_config,
+                                   esp_lcd_panel_io_handle_t *ret_io);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,363 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+#include "esp_crc.h"
+#include "esp_console.h"
+#include "app_icons.h"
+
+#define ICONS_MAGIC                 (0x41495753)    /* "SWIA" */
+#define ICONS_VERSION               (1)
+#define ICONS_PARTITION_SUBTYPE     (0x42)
+#define ICONS_PARTITION_LABEL       "icons"
+#define ICONS_MAX_SIZES             (4)
+#define ICONS_RLE_RUN               (0x80)          /* Run of one byte, else a literal byte count */
+#define ICONS_RLE_MAX               (0x7F)
+#define ICONS_CACHE_BYTES           (CONFIG_APP_ICONS_CACHE_KB * 1024)
+
+static const char *TAG = "icons";
+
+/* Start of the "icons" partition, followed by `data_len` bytes: the entries, the code map padded
+ * to 4 bytes and the RLE data. Kept in sync with build_icons.js */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t glyphs;
+    uint8_t num_sizes;
+    uint8_t sizes[ICONS_MAX_SIZES]; /* Ascending */
+    uint16_t codes;                 /* Condition codes in the code map */
+    uint16_t reserved;
+    uint32_t data_len;
+    uint32_t crc;                   /* esp_crc32_le() of the data */
+} icons_header_t;
+
+/* Glyph `g` at size `s` is entry g * num_sizes + s, glyph 0 stands for unknown codes */
+typedef struct {
+    uint16_t w;
+    uint16_t h;
+    uint8_t size;
+    uint8_t cf;                     /* lv_color_format_t, LV_COLOR_FORMAT_A8 */
+    uint16_t reserved;
+    uint32_t offset;                /* From the start of the RLE data */
+    uint32_t len;
+} icons_entry_t;
+
+typedef struct {
+    lv_image_dsc_t dsc;             /* data is NULL until decoded */
+    uint32_t last_use;
+    uint16_t refs;
+} icons_slot_t;
+
+static struct {
+    const icons_header_t *hdr;      /* NULL without a valid atlas */
+    const icons_entry_t *entries;
+    const uint8_t *code_map;
+    const uint8_t *rle;
+    esp_partition_mmap_handle_t map_handle;
+    icons_slot_t *slots;
+    int num_slots;
+    uint32_t tick;
+    size_t raw_bytes;
+    portMUX_TYPE stats_lock;
+    app_icons_stats_t stats;
+    uint64_t decode_sum_us;
+} s_icons = {
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static bool icons_rle_decode(const uint8_t *in, size_t in_len, uint8_t *out, size_t out_len)
+{
+    size_t i = 0;
+    size_t o = 0;
+    while (i < in_len) {
+        size_t n = in[i] & ICONS_RLE_MAX;
+        bool run = in[i++] & ICONS_RLE_RUN;
+        if (o + n > out_len || i + (run ? 1 : n) > in_len) {
+            return false;
+        }
+        if (run) {
+            memset(out + o, in[i++], n);
+        } else {
+            memcpy(out + o, in + i, n);
+            i += n;
+        }
+        o += n;
+    }
+    return o == out_len;
+}
+
+static bool icons_check_atlas(const icons_header_t *hdr, size_t part_size)
+{
+    if (hdr->magic != ICONS_MAGIC || hdr->version != ICONS_VERSION || !hdr->glyphs || !hdr->num_sizes ||
+            hdr->num_sizes > ICONS_MAX_SIZES || hdr->data_len > part_size - sizeof(*hdr)) {
+        return false;
+    }
+    size_t tables = hdr->glyphs * hdr->num_sizes * sizeof(icons_entry_t) + ((hdr->codes + 3) & ~3);
+    if (tables > hdr->data_len) {
+        return false;
+    }
+    const icons_entry_t *entries = (const icons_entry_t *)(hdr + 1);
+    size_t limit = hdr->data_len - tables;
+    for (int i = 0; i < hdr->glyphs * hdr->num_sizes; i++) {
+        /* Compared without adding, a corrupt offset near the type's maximum must not wrap */
+        if (entries[i].cf != LV_COLOR_FORMAT_A8 || entries[i].offset > limit ||
+                entries[i].len > limit - entries[i].offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+esp_err_t app_icons_init(void)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ICONS_PARTITION_SUBTYPE,
+                                                           ICONS_PARTITION_LABEL);
+    if (!part) {
+        ESP_LOGW(TAG, "No %s partition, conditions are shown as dots", ICONS_PARTITION_LABEL);
+        return ESP_OK;
+    }
+
+    /* Stays mapped, icons are decoded straight from flash */
+    const void *map = NULL;
+    ESP_RETURN_ON_ERROR(esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &map, &s_icons.map_handle),
+                        TAG, "map %s partition failed", ICONS_PARTITION_LABEL);
+    const icons_header_t *hdr = map;
+    if (!icons_check_atlas(hdr, part->size) || esp_crc32_le(0, (const uint8_t *)(hdr + 1), hdr->data_len) != hdr->crc) {
+        ESP_LOGW(TAG, "No valid icon atlas, run build_icons.js and flash it");
+        esp_partition_munmap(s_icons.map_handle);
+        return ESP_OK;
+    }
+
+    s_icons.num_slots = hdr->glyphs * hdr->num_sizes;
+    s_icons.slots = heap_caps_calloc(s_icons.num_slots, sizeof(icons_slot_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!s_icons.slots) {
+        esp_partition_munmap(s_icons.map_handle);
+        ESP_LOGE(TAG, "no memory for the icon cache");
+        return ESP_ERR_NO_MEM;
+    }
+    s_icons.entries = (const icons_entry_t *)(hdr + 1);
+    s_icons.code_map = (const uint8_t *)(s_icons.entries + s_icons.num_slots);
+    s_icons.rle = s_icons.code_map + ((hdr->codes + 3) & ~3);
+    for (int i = 0; i < s_icons.num_slots; i++) {
+        s_icons.raw_bytes += s_icons.entries[i].w * s_icons.entries[i].h;
+    }
+    s_icons.hdr = hdr;
+
+    size_t flash = sizeof(*hdr) + hdr->data_len;
+    /* Against the A8 glyphs the cache decodes to, what the RLE saves */
+    ESP_LOGI(TAG, "atlas glyphs=%d sizes=%d flash_bytes=%u raw_a8_bytes=%u saved_pct=%d", hdr->glyphs,
+             hdr->num_sizes, (unsigned)flash, (unsigned)s_icons.raw_bytes,
+             s_icons.raw_bytes ? 100 - (int)(flash * 100 / s_icons.raw_bytes) : 0);
+    return ESP_OK;
+}
+
+static int icons_slot_index(uint8_t code, uint8_t size)
+{
+    const icons_header_t *hdr = s_icons.hdr;
+    int glyph = code < hdr->codes ? s_icons.code_map[code] : 0;
+    if (glyph >= hdr->glyphs) {
+        glyph = 0;
+    }
+    int s = 0;
+    while (s < hdr->num_sizes - 1 && hdr->sizes[s] < size) {
+        s++;
+    }
+    return glyph * hdr->num_sizes + s;
+}
+
+static icons_slot_t *icons_slot_of(const lv_image_dsc_t *icon)
+{
+    if (!s_icons.slots || (const void *)icon < (const void *)s_icons.slots ||
+            (const void *)icon >= (const void *)(s_icons.slots + s_icons.num_slots)) {
+        return NULL;
+    }
+    return (icons_slot_t *)icon;
+}
+
+static size_t icons_cached_bytes(void)
+{
+    size_t bytes = 0;
+    for (int i = 0; i < s_icons.num_slots; i++) {
+        if (s_icons.slots[i].dsc.data) {
+            bytes += s_icons.slots[i].dsc.data_size;
+        }
+    }
+    return bytes;
+}
+
+/* Free the least recently used icons nobody holds until `need` more bytes fit */
+static void icons_evict(size_t need)
+{
+    size_t cached = icons_cached_bytes();
+    while (cached + need > ICONS_CACHE_BYTES) {
+        icons_slot_t *lru = NULL;
+        for (int i = 0; i < s_icons.num_slots; i++) {
+            icons_slot_t *slot = &s_icons.slots[i];
+            if (slot->dsc.data && !slot->refs && (!lru || slot->last_use < lru->last_use)) {
+                lru = slot;
+            }
+        }
+        if (!lru) {
+            return;
+        }
+        lv_image_cache_drop(&lru->dsc);
+        cached -= lru->dsc.data_size;
+        heap_caps_free((void *)lru->dsc.data);
+        lru->dsc.data = NULL;
+        portENTER_CRITICAL(&s_icons.stats_lock);
+        s_icons.stats.evictions++;
+        portEXIT_CRITICAL(&s_icons.stats_lock);
+    }
+}
+
+static bool icons_decode(icons_slot_t *slot, const icons_entry_t *entry)
+{
+    size_t len = entry->w * entry->h;
+    icons_evict(len);
+
+    int64_t start = esp_timer_get_time();
+    uint8_t *px = heap_caps_malloc(len, MALLOC_CAP_SPIRAM);
+    if (!px) {
+        ESP_LOGW(TAG, "no memory for a %dx%d icon", entry->w, entry->h);
+        return false;
+    }
+    if (!icons_rle_decode(s_icons.rle + entry->offset, entry->len, px, len)) {
+        heap_caps_free(px);
+        ESP_LOGW(TAG, "icon at %"PRIu32" does not decode", entry->offset);
+        return false;
+    }
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+
+    slot->dsc = (lv_image_dsc_t) {
+        .header = {
+            .magic = LV_IMAGE_HEADER_MAGIC,
+            .cf = LV_COLOR_FORMAT_A8,
+            .w = entry->w,
+            .h = entry->h,
+            .stride = entry->w,
+        },
+        .data_size = len,
+        .data = px,
+    };
+    portENTER_CRITICAL(&s_icons.stats_lock);
+    s_icons.stats.decodes++;
+    s_icons.decode_sum_us += us;
+    s_icons.stats.decode_max_us = MAX(s_icons.stats.decode_max_us, us);
+    portEXIT_CRITICAL(&s_icons.stats_lock);
+    return true;
+}
+
+const lv_image_dsc_t *app_icons_acquire(uint8_t code, uint8_t size)
+{
+    if (!s_icons.hdr) {
+        return NULL;
+    }
+    int index = icons_slot_index(code, size);
+    icons_slot_t *slot = &s_icons.slots[index];
+    bool hit = slot->dsc.data != NULL;
+
+    portENTER_CRITICAL(&s_icons.stats_lock);
+    s_icons.stats.lookups++;
+    s_icons.stats.hits += hit;
+    portEXIT_CRITICAL(&s_icons.stats_lock);
+
+    if (!hit && !icons_decode(slot, &s_icons.entries[index])) {
+        return NULL;
+    }
+    slot->last_use = ++s_icons.tick;
+    slot->refs++;
+    return &slot->dsc;
+}
+
+void app_icons_release(const lv_image_dsc_t *icon)
+{
+    icons_slot_t *slot = icons_slot_of(icon);
+    if (slot && slot->refs) {
+        slot->refs--;
+    }
+}
+
+static void icons_delete_cb(lv_event_t *e)
+{
+    app_icons_release(lv_image_get_src(lv_event_get_target(e)));
+}
+
+lv_obj_t *app_icons_create(lv_obj_t *parent, uint8_t size)
+{
+    lv_obj_t *icon;
+    if (s_icons.hdr) {
+        icon = lv_image_create(parent);
+        lv_obj_set_style_image_recolor_opa(icon, LV_OPA_COVER, 0);
+        lv_obj_add_event_cb(icon, icons_delete_cb, LV_EVENT_DELETE, NULL);
+    } else {
+        /* Placeholder: a dot in the colour of the condition group */
+        icon = lv_obj_create(parent);
+        lv_obj_remove_style_all(icon);
+        lv_obj_set_style_radius(icon, LV_RADIUS_CIRCLE, 0);
+        lv_obj_set_style_bg_opa(icon, LV_OPA_COVER, 0);
+    }
+    lv_obj_set_size(icon, size, size);
+    return icon;
+}
+
+void app_icons_set(lv_obj_t *icon, uint8_t code, lv_color_t color)
+{
+    if (!lv_obj_check_type(icon, &lv_image_class)) {
+        lv_obj_set_style_bg_color(icon, color, 0);
+        return;
+    }
+    const lv_image_dsc_t *prev = lv_image_get_src(icon);
+    const lv_image_dsc_t *dsc = app_icons_acquire(code, (uint8_t)lv_obj_get_style_width(icon, LV_PART_MAIN));
+    if (dsc != prev) {
+        lv_image_set_src(icon, dsc);
+    }
+    app_icons_release(prev);
+    lv_obj_set_style_image_recolor(icon, color, 0);
+}
+
+void app_icons_get_stats(app_icons_stats_t *stats)
+{
+    size_t cached = s_icons.slots ? icons_cached_bytes() : 0;
+    portENTER_CRITICAL(&s_icons.stats_lock);
+    *stats = s_icons.stats;
+    stats->decode_avg_us = stats->decodes ? (uint32_t)(s_icons.decode_sum_us / stats->decodes) : 0;
+    memset(&s_icons.stats, 0, sizeof(s_icons.stats));
+    s_icons.decode_sum_us = 0;
+    portEXIT_CRITICAL(&s_icons.stats_lock);
+    stats->cached_bytes = cached;
+    stats->flash_bytes = s_icons.hdr ? sizeof(icons_header_t) + s_icons.hdr->data_len : 0;
+    stats->raw_bytes = s_icons.raw_bytes;
+}
+
+static int icons_cmd(int argc, char **argv)
+{
+    app_icons_stats_t st;
+    app_icons_get_stats(&st);
+    printf("icons: lookups=%" PRIu32 " hits=%" PRIu32 " hit_pct=%" PRIu32 " decodes=%" PRIu32 " decode_avg_us=%" PRIu32
+           " decode_max_us=%" PRIu32 " evictions=%" PRIu32 " cached_bytes=%u flash_bytes=%u raw_bytes=%u\n",
+           st.lookups, st.hits, st.lookups ? st.hits * 100 / st.lookups : 0, st.decodes, st.decode_avg_us,
+           st.decode_max_us, st.evictions, (unsigned)st.cached_bytes, (unsigned)st.flash_bytes,
+           (unsigned)st.raw_bytes);
+    return 0;
+}
+
+esp_err_t app_icons_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "icons",
+        .help = "Show the icon cache hit rate and decode time since the last call",
+        .func = icons_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,77 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t lookups;               /*!< Icons asked for */
+    uint32_t hits;                  /*!< Of those, already decoded */
+    uint32_t decodes;
+    uint32_t decode_avg_us;         /*!< Per icon, RLE in flash to A8 in PSRAM */
+    uint32_t decode_max_us;
+    uint32_t evictions;
+    size_t cached_bytes;            /*!< Decoded icons held now */
+    size_t flash_bytes;             /*!< Size of the atlas in flash */
+    size_t raw_bytes;               /*!< All icons decoded as A8 */
+} app_icons_stats_t;
+
+/**
+ * @brief Map the icon atlas written by build_icons.js to the "icons" partition
+ *
+ * Without a valid atlas the icons stay dots in the colour of the condition, which is not an error.
+ */
+esp_err_t app_icons_init(void);
+
+/**
+ * @brief Decoded icon for weather condition code `code`, held until app_icons_release()
+ *
+ * The icon is decoded into PSRAM on first use and stays cached until the least recently used
+ * icons nobody holds are evicted to fit CONFIG_APP_ICONS_CACHE_KB. `size` picks the smallest
+ * atlas size not below it. The image is A8, drawn in its recolour. Only call from the LVGL task.
+ *
+ * @return NULL without an atlas or memory
+ */
+const lv_image_dsc_t *app_icons_acquire(uint8_t code, uint8_t size);
+
+/**
+ * @brief Let go of an icon from app_icons_acquire(), NULL is ignored
+ */
+void app_icons_release(const lv_image_dsc_t *icon);
+
+/**
+ * @brief Create a `size` x `size` icon object: an image, or a dot when there is no atlas
+ *
+ * Must be called with the LVGL lock held.
+ */
+lv_obj_t *app_icons_create(lv_obj_t *parent, uint8_t size);
+
+/**
+ * @brief Show condition `code` in `color` on an object from app_icons_create()
+ *
+ * The object holds the icon until it shows another one or is deleted. Must be called with the LVGL lock held.
+ */
+void app_icons_set(lv_obj_t *icon, uint8_t code, lv_color_t color);
+
+/**
+ * @brief Read the cache counters and clear them
+ */
+void app_icons_get_stats(app_icons_stats_t *stats);
+
+/**
+ * @brief Add the "icons" console command
+ */
+esp_err_t app_icons_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,242 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "app_latency.h"
+
+#define LATENCY_REDRAW_TIMEOUT_US   (500 * 1000)
+#define LATENCY_SYNTH_HOLD_MS       (60)
+
+static const char *TAG = "latency";
+
+typedef enum {
+    TAP_IDLE = 0,       /* Waiting for a touch-down sample */
+    TAP_SAMPLED,        /* Touch-down seen by the driver, waiting for LVGL to dispatch it */
+    TAP_DISPATCHED,     /* LV_EVENT_PRESSED sent, waiting for an invalidation */
+    TAP_INVALIDATED,    /* Area invalidated, waiting for the render to finish */
+    TAP_RENDERED,       /* Render ready, waiting for the flush to present the frame */
+} tap_state_t;
+
+typedef struct {
+    tap_state_t state;
+    bool touching;          /* Driver reported at least one point on the last poll */
+    int64_t t_sample;
+    int64_t t_dispatch;
+    int64_t t_invalidate;
+    int64_t t_rendered;
+} tap_t;
+
+typedef struct {
+    bool pressed;
+    uint32_t last_change;
+    uint32_t period_ms;
+    lv_point_t point;
+} synth_tap_t;
+
+static tap_t s_tap;
+static app_latency_stats_t s_stats;
+
+static void latency_reset_stats(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.min_us = UINT32_MAX;
+}
+
+static void latency_tap_begin(void)
+{
+    if (s_tap.state != TAP_IDLE) {
+        /* Previous tap never reached the panel */
+        s_stats.no_redraw++;
+    }
+    s_tap.state = TAP_SAMPLED;
+    s_tap.t_sample = esp_timer_get_time();
+}
+
+static void latency_tap_complete(int64_t t_present)
+{
+    uint32_t total = (uint32_t)(t_present - s_tap.t_sample);
+    uint32_t bucket = total / (CONFIG_APP_LATENCY_BUCKET_MS * 1000);
+    if (bucket >= APP_LATENCY_HIST_BUCKETS) {
+        bucket = APP_LATENCY_HIST_BUCKETS - 1;
+    }
+
+    s_stats.taps++;
+    s_stats.sum_us += total;
+    s_stats.min_us = total < s_stats.min_us ? total : s_stats.min_us;
+    s_stats.max_us = total > s_stats.max_us ? total : s_stats.max_us;
+    s_stats.stage_sum_us[0] += s_tap.t_dispatch - s_tap.t_sample;
+    s_stats.stage_sum_us[1] += s_tap.t_invalidate - s_tap.t_dispatch;
+    s_stats.stage_sum_us[2] += s_tap.t_rendered - s_tap.t_invalidate;
+    s_stats.stage_sum_us[3] += t_present - s_tap.t_rendered;
+    s_stats.hist[bucket]++;
+
+    s_tap.state = TAP_IDLE;
+}
+
+void app_latency_touch_sample_cb(esp_lcd_touch_handle_t tp, uint16_t *x, uint16_t *y, uint16_t *strength,
+                                 uint8_t *point_num, uint8_t max_point_num)
+{
+    bool touching = *point_num > 0;
+    if (touching && !s_tap.touching) {
+        latency_tap_begin();
+    }
+    s_tap.touching = touching;
+}
+
+static void latency_indev_event_cb(lv_event_t *e)
+{
+    if (s_tap.state == TAP_SAMPLED) {
+        s_tap.t_dispatch = esp_timer_get_time();
+        s_tap.state = TAP_DISPATCHED;
+    }
+}
+
+static void latency_disp_event_cb(lv_event_t *e)
+{
+    if (s_tap.state < TAP_DISPATCHED) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_INVALIDATE_AREA:
+        if (s_tap.state == TAP_DISPATCHED) {
+            s_tap.t_invalidate = now;
+            s_tap.state = TAP_INVALIDATED;
+        }
+        break;
+    case LV_EVENT_RENDER_READY:
+        if (s_tap.state == TAP_INVALIDATED) {
+            s_tap.t_rendered = now;
+            s_tap.state = TAP_RENDERED;
+        }
+        break;
+    case LV_EVENT_FLUSH_FINISH:
+        /* esp_lvgl_port waits for VSYNC inside the flush callback when avoiding tearing,
+         * so the end of the flush is the moment the frame is scanned out */
+        if (s_tap.state == TAP_RENDERED) {
+            latency_tap_complete(now);
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (s_tap.state == TAP_DISPATCHED && now - s_tap.t_dispatch > LATENCY_REDRAW_TIMEOUT_US) {
+        /* The tap did not change anything on screen */
+        s_stats.no_redraw++;
+        s_tap.state = TAP_IDLE;
+    }
+}
+
+static void latency_report_timer_cb(lv_timer_t *timer)
+{
+    app_latency_report();
+}
+
+static void synth_tap_read_cb(lv_indev_t *indev, lv_indev_data_t *data)
+{
+    synth_tap_t *synth = lv_indev_get_user_data(indev);
+    uint32_t elapsed = lv_tick_elaps(synth->last_change);
+
+    if (!synth->pressed && elapsed >= synth->period_ms) {
+        synth->pressed = true;
+        synth->last_change = lv_tick_get();
+        latency_tap_begin();
+    } else if (synth->pressed && elapsed >= LATENCY_SYNTH_HOLD_MS) {
+        synth->pressed = false;
+        synth->last_change = lv_tick_get();
+    }
+
+    data->point = synth->point;
+    data->state = synth->pressed ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+}
+
+esp_err_t app_latency_init(lv_display_t *disp, lv_indev_t *indev)
+{
+    ESP_RETURN_ON_FALSE(disp, ESP_ERR_INVALID_ARG, TAG, "display is required");
+
+    memset(&s_tap, 0, sizeof(s_tap));
+    latency_reset_stats();
+
+    if (indev) {
+        lv_indev_add_event_cb(indev, latency_indev_event_cb, LV_EVENT_PRESSED, NULL);
+    }
+    lv_display_add_event_cb(disp, latency_disp_event_cb, LV_EVENT_ALL, NULL);
+    lv_timer_create(latency_report_timer_cb, CONFIG_APP_LATENCY_REPORT_PERIOD_S * 1000, NULL);
+
+    ESP_LOGI(TAG, "Following taps, report every %d s", CONFIG_APP_LATENCY_REPORT_PERIOD_S);
+    return ESP_OK;
+}
+
+lv_indev_t *app_latency_start_synthetic_taps(lv_display_t *disp, int32_t x, int32_t y, uint32_t period_ms)
+{
+    static synth_tap_t synth;
+    synth.pressed = false;
+    synth.last_change = lv_tick_get();
+    synth.period_ms = period_ms;
+    synth.point.x = x;
+    synth.point.y = y;
+
+    lv_indev_t *indev = lv_indev_create();
+    ESP_RETURN_ON_FALSE(indev, NULL, TAG, "synthetic indev create failed");
+    lv_indev_set_type(indev, LV_INDEV_TYPE_POINTER);
+    lv_indev_set_read_cb(indev, synth_tap_read_cb);
+    lv_indev_set_display(indev, disp);
+    lv_indev_set_user_data(indev, &synth);
+    lv_indev_add_event_cb(indev, latency_indev_event_cb, LV_EVENT_PRESSED, NULL);
+
+    ESP_LOGI(TAG, "Synthetic taps at (%"PRId32", %"PRId32") every %"PRIu32" ms", x, y, period_ms);
+    return indev;
+}
+
+void app_latency_get_stats(app_latency_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+/* Upper edge of the bucket holding the requested percentile */
+static uint32_t latency_percentile_us(const app_latency_stats_t *stats, uint32_t pct)
+{
+    if (stats->taps == 0) {
+        return 0;
+    }
+    uint32_t target = (stats->taps * pct + 99) / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < APP_LATENCY_HIST_BUCKETS; i++) {
+        seen += stats->hist[i];
+        if (seen >= target) {
+            return i == APP_LATENCY_HIST_BUCKETS - 1 ? stats->max_us : (i + 1) * CONFIG_APP_LATENCY_BUCKET_MS * 1000;
+        }
+    }
+    return stats->max_us;
+}
+
+void app_latency_report(void)
+{
+    const app_latency_stats_t *st = &s_stats;
+    uint32_t n = st->taps ? st->taps : 1;
+    char hist[APP_LATENCY_HIST_BUCKETS * 11];
+    int len = 0;
+
+    for (int i = 0; i < APP_LATENCY_HIST_BUCKETS; i++) {
+        len += snprintf(hist + len, sizeof(hist) - len, i ? ",%"PRIu32 : "%"PRIu32, st->hist[i]);
+    }
+
+    ESP_LOGI(TAG, "taps=%"PRIu32" nored=%"PRIu32" min=%"PRIu32" avg=%"PRIu32" p50=%"PRIu32" p90=%"PRIu32" p99=%"PRIu32
+             " max=%"PRIu32" stages=%"PRIu32"/%"PRIu32"/%"PRIu32"/%"PRIu32" bucket_ms=%d hist=%s",
+             st->taps, st->no_redraw, st->taps ? st->min_us : 0, (uint32_t)(st->sum_us / n),
+             latency_percentile_us(st, 50), latency_percentile_us(st, 90), latency_percentile_us(st, 99), st->max_us,
+             (uint32_t)(st->stage_sum_us[0] / n), (uint32_t)(st->stage_sum_us[1] / n),
+             (uint32_t)(st->stage_sum_us[2] / n), (uint32_t)(st->stage_sum_us[3] / n),
+             CONFIG_APP_LATENCY_BUCKET_MS, hist);
+
+    latency_reset_stats();
+}
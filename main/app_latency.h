@@ -0,0 +1,72 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+#include "esp_lcd_touch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Number of histogram buckets, the last one collects everything above range */
+#define APP_LATENCY_HIST_BUCKETS    (16)
+
+/**
+ * @brief Touch-to-photon latency statistics
+ *
+ * A tap is followed through five stages: touch sample (GT911 poll),
+ * event dispatch (LV_EVENT_PRESSED on the input device), first invalidation,
+ * render start and the flush that hands the frame to the panel.
+ * All times are in microseconds.
+ */
+typedef struct {
+    uint32_t taps;                  /*!< Taps followed up to the presented frame */
+    uint32_t no_redraw;             /*!< Taps that did not cause a redraw in time */
+    uint32_t min_us;                /*!< Shortest sample-to-present latency */
+    uint32_t max_us;                /*!< Longest sample-to-present latency */
+    uint64_t sum_us;                /*!< Sum of sample-to-present latencies */
+    uint64_t stage_sum_us[4];       /*!< Sums of: sample->dispatch, dispatch->invalidate, invalidate->render ready, render ready->present */
+    uint32_t hist[APP_LATENCY_HIST_BUCKETS]; /*!< Latency histogram, CONFIG_APP_LATENCY_BUCKET_MS wide buckets */
+} app_latency_stats_t;
+
+/**
+ * @brief Start following taps on the given display and touch input
+ *
+ * Must be called with the LVGL lock held. All tracking happens in the LVGL
+ * task context, so no extra locking is needed afterwards.
+ */
+esp_err_t app_latency_init(lv_display_t *disp, lv_indev_t *indev);
+
+/**
+ * @brief esp_lcd_touch `process_coordinates` hook that timestamps touch samples
+ *
+ * Plug into `esp_lcd_touch_config_t::process_coordinates`. Coordinates are not modified.
+ */
+void app_latency_touch_sample_cb(esp_lcd_touch_handle_t tp, uint16_t *x, uint16_t *y, uint16_t *strength,
+                                 uint8_t *point_num, uint8_t max_point_num);
+
+/**
+ * @brief Create a virtual pointer that taps (x, y) periodically
+ *
+ * Used to produce the latency report without a finger on the panel (CI runs).
+ */
+lv_indev_t *app_latency_start_synthetic_taps(lv_display_t *disp, int32_t x, int32_t y, uint32_t period_ms);
+
+/**
+ * @brief Copy the current statistics
+ */
+void app_latency_get_stats(app_latency_stats_t *stats);
+
+/**
+ * @brief Print the statistics as one parseable log line and reset them
+ */
+void app_latency_report(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,49 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "app_mailbox.h"
+
+#define APP_MAILBOX_FRESH   (0x4u)
+#define APP_MAILBOX_INDEX   (0x3u)
+
+void app_mailbox_init(app_mailbox_t *mb, void *storage, size_t size, const void *initial)
+{
+    for (int i = 0; i < 3; i++) {
+        mb->slots[i] = (uint8_t *)storage + i * size;
+        if (initial) {
+            memcpy(mb->slots[i], initial, size);
+        } else {
+            memset(mb->slots[i], 0, size);
+        }
+    }
+    mb->size = size;
+    mb->front = 0;
+    atomic_init(&mb->middle, 1);
+    mb->back = 2;
+}
+
+void *app_mailbox_back(app_mailbox_t *mb)
+{
+    return mb->slots[mb->back];
+}
+
+void app_mailbox_publish(app_mailbox_t *mb)
+{
+    unsigned prev = atomic_exchange_explicit(&mb->middle, mb->back | APP_MAILBOX_FRESH, memory_order_acq_rel);
+    mb->back = prev & APP_MAILBOX_INDEX;
+}
+
+const void *app_mailbox_latest(app_mailbox_t *mb, bool *fresh)
+{
+    bool is_fresh = atomic_load_explicit(&mb->middle, memory_order_acquire) & APP_MAILBOX_FRESH;
+    if (is_fresh) {
+        unsigned prev = atomic_exchange_explicit(&mb->middle, mb->front, memory_order_acq_rel);
+        mb->front = prev & APP_MAILBOX_INDEX;
+    }
+    if (fresh) {
+        *fresh = is_fresh;
+    }
+    return mb->slots[mb->front];
+}
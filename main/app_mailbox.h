@@ -0,0 +1,57 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Lock-free single-producer single-consumer "latest value" mailbox
+ *
+ * Triple buffer: the producer fills the back slot and swaps it with the middle one,
+ * the consumer swaps the middle slot with its front slot when a new value is waiting.
+ * Neither side ever waits for the other; intermediate values may be skipped.
+ */
+typedef struct {
+    uint8_t *slots[3];
+    size_t size;
+    atomic_uint middle;     /* Slot index, APP_MAILBOX_FRESH set while not consumed yet */
+    unsigned back;          /* Owned by the producer */
+    unsigned front;         /* Owned by the consumer */
+} app_mailbox_t;
+
+/**
+ * @brief Set up a mailbox over `storage`, which must hold 3 * `size` bytes
+ *
+ * All three slots start as a copy of `initial` when it is not NULL.
+ */
+void app_mailbox_init(app_mailbox_t *mb, void *storage, size_t size, const void *initial);
+
+/**
+ * @brief Slot the producer may fill, valid until app_mailbox_publish()
+ */
+void *app_mailbox_back(app_mailbox_t *mb);
+
+/**
+ * @brief Make the back slot the latest value
+ */
+void app_mailbox_publish(app_mailbox_t *mb);
+
+/**
+ * @brief Latest published value, `fresh` tells whether it changed since the last call
+ *
+ * The returned slot stays valid until the next call.
+ */
+const void *app_mailbox_latest(app_mailbox_t *mb, bool *fresh);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,353 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <assert.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_heap_caps.h"
+#include "esp_console.h"
+#include "lvgl.h"
+#include "app_sensor.h"
+#include "app_mem.h"
+
+/* One fetch arena per weather worker, and a few for the rest */
+#define MEM_MAX_ARENAS      (CONFIG_APP_WEATHER_CONCURRENCY + 3)
+#define MEM_MAX_POOLS       (4)
+#define MEM_ALIGN           (8)
+
+#if CONFIG_APP_MEM_FETCH_ARENA_PSRAM
+#define MEM_FETCH_CAPS      (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#else
+#define MEM_FETCH_CAPS      (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#endif
+
+#if CONFIG_APP_MEM_LVGL_POOL_PSRAM
+#define MEM_LVGL_CAPS       (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#else
+#define MEM_LVGL_CAPS       (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#endif
+
+static const char *TAG = "mem";
+
+struct app_arena_t {
+    const char *name;
+    uint32_t caps;
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    size_t last;                    /* Offset of the latest allocation, the only one that can be extended */
+    size_t high_water;
+    uint32_t failures;
+};
+
+struct app_pool_t {
+    const char *name;
+    uint32_t caps;
+    uint8_t *base;
+    size_t block_size;
+    size_t count;
+    void *free_list;                /* Each free block starts with the pointer to the next one */
+    size_t in_use;
+    size_t high_water;
+    uint32_t failures;
+};
+
+static struct {
+    struct app_arena_t arenas[MEM_MAX_ARENAS];
+    int arena_count;
+    struct app_pool_t pools[MEM_MAX_POOLS];
+    int pool_count;
+    app_arena_handle_t fetch[CONFIG_APP_WEATHER_CONCURRENCY];
+    app_pool_handle_t sensor;
+    uint32_t heap_failures_int;     /* Failed general heap allocations */
+    uint32_t heap_failures_psram;
+    portMUX_TYPE lock;
+} s_mem = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static const char *mem_where(uint32_t caps)
+{
+    return (caps & MALLOC_CAP_SPIRAM) ? "psram" : "int";
+}
+
+static void mem_alloc_failed_cb(size_t size, uint32_t caps, const char *function_name)
+{
+    portENTER_CRITICAL_SAFE(&s_mem.lock);
+    if (caps & MALLOC_CAP_SPIRAM) {
+        s_mem.heap_failures_psram++;
+    } else {
+        s_mem.heap_failures_int++;
+    }
+    portEXIT_CRITICAL_SAFE(&s_mem.lock);
+}
+
+esp_err_t app_arena_create(const char *name, size_t size, uint32_t caps, app_arena_handle_t *ret_arena)
+{
+    ESP_RETURN_ON_FALSE(name && size && ret_arena, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(s_mem.arena_count < MEM_MAX_ARENAS, ESP_ERR_NO_MEM, TAG, "too many arenas");
+
+    uint8_t *base = heap_caps_malloc(size, caps);
+    ESP_RETURN_ON_FALSE(base, ESP_ERR_NO_MEM, TAG, "no memory for arena %s", name);
+
+    struct app_arena_t *arena = &s_mem.arenas[s_mem.arena_count++];
+    *arena = (struct app_arena_t) {
+        .name = name,
+        .caps = caps,
+        .base = base,
+        .size = size,
+    };
+    *ret_arena = arena;
+    return ESP_OK;
+}
+
+void *app_arena_alloc(app_arena_handle_t arena, size_t size)
+{
+    void *ptr = NULL;
+    size = (size + MEM_ALIGN - 1) & ~(size_t)(MEM_ALIGN - 1);
+
+    portENTER_CRITICAL(&s_mem.lock);
+    if (size <= arena->size - arena->used) {
+        ptr = arena->base + arena->used;
+        arena->last = arena->used;
+        arena->used += size;
+        arena->high_water = MAX(arena->high_water, arena->used);
+    } else {
+        arena->failures++;
+    }
+    portEXIT_CRITICAL(&s_mem.lock);
+    return ptr;
+}
+
+void *app_arena_extend(app_arena_handle_t arena, void *ptr, size_t size)
+{
+    void *ret = NULL;
+    size = (size + MEM_ALIGN - 1) & ~(size_t)(MEM_ALIGN - 1);
+
+    portENTER_CRITICAL(&s_mem.lock);
+    size_t start = (uint8_t *)ptr - arena->base;
+    if (!ptr || start != arena->last || start >= arena->used) {
+        /* Something else was allocated since, the caller has to copy */
+    } else if (size <= arena->size - start) {
+        arena->used = start + size;
+        arena->high_water = MAX(arena->high_water, arena->used);
+        ret = ptr;
+    } else {
+        arena->failures++;
+    }
+    portEXIT_CRITICAL(&s_mem.lock);
+    return ret;
+}
+
+void app_arena_reset(app_arena_handle_t arena)
+{
+    portENTER_CRITICAL(&s_mem.lock);
+    arena->used = 0;
+    arena->last = 0;
+    portEXIT_CRITICAL(&s_mem.lock);
+}
+
+esp_err_t app_pool_create(const char *name, size_t block_size, size_t count, uint32_t caps, app_pool_handle_t *ret_pool)
+{
+    ESP_RETURN_ON_FALSE(name && block_size && count && ret_pool, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(s_mem.pool_count < MEM_MAX_POOLS, ESP_ERR_NO_MEM, TAG, "too many pools");
+
+    block_size = (MAX(block_size, sizeof(void *)) + MEM_ALIGN - 1) & ~(size_t)(MEM_ALIGN - 1);
+    uint8_t *base = heap_caps_malloc(block_size * count, caps);
+    ESP_RETURN_ON_FALSE(base, ESP_ERR_NO_MEM, TAG, "no memory for pool %s", name);
+
+    struct app_pool_t *pool = &s_mem.pools[s_mem.pool_count++];
+    *pool = (struct app_pool_t) {
+        .name = name,
+        .caps = caps,
+        .base = base,
+        .block_size = block_size,
+        .count = count,
+    };
+    for (size_t i = count; i-- > 0;) {
+        void **block = (void **)(base + i * block_size);
+        *block = pool->free_list;
+        pool->free_list = block;
+    }
+    *ret_pool = pool;
+    return ESP_OK;
+}
+
+void *app_pool_alloc(app_pool_handle_t pool)
+{
+    portENTER_CRITICAL(&s_mem.lock);
+    void **block = pool->free_list;
+    if (block) {
+        pool->free_list = *block;
+        pool->in_use++;
+        pool->high_water = MAX(pool->high_water, pool->in_use);
+    } else {
+        pool->failures++;
+    }
+    portEXIT_CRITICAL(&s_mem.lock);
+    return block;
+}
+
+void app_pool_free(app_pool_handle_t pool, void *block)
+{
+    if (!block) {
+        return;
+    }
+    assert((uint8_t *)block >= pool->base && (uint8_t *)block < pool->base + pool->block_size * pool->count);
+
+    portENTER_CRITICAL(&s_mem.lock);
+    *(void **)block = pool->free_list;
+    pool->free_list = block;
+    pool->in_use--;
+    portEXIT_CRITICAL(&s_mem.lock);
+}
+
+esp_err_t app_mem_init(void)
+{
+    ESP_RETURN_ON_ERROR(heap_caps_register_failed_alloc_callback(mem_alloc_failed_cb), TAG, "register alloc hook failed");
+
+    static const char *const fetch_names[] = { "fetch0", "fetch1", "fetch2", "fetch3",
+                                               "fetch4", "fetch5", "fetch6", "fetch7" };
+    _Static_assert(CONFIG_APP_WEATHER_CONCURRENCY <= sizeof(fetch_names) / sizeof(fetch_names[0]), "name the fetch arenas");
+    for (int i = 0; i < CONFIG_APP_WEATHER_CONCURRENCY; i++) {
+        ESP_RETURN_ON_ERROR(app_arena_create(fetch_names[i], CONFIG_APP_MEM_FETCH_ARENA_KB * 1024, MEM_FETCH_CAPS,
+                                             &s_mem.fetch[i]),
+                            TAG, "create fetch arena failed");
+    }
+    ESP_RETURN_ON_ERROR(app_pool_create("sensor", sizeof(app_sensor_reading_t), CONFIG_APP_MEM_SENSOR_POOL_RECORDS,
+                                        MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, &s_mem.sensor),
+                        TAG, "create sensor pool failed");
+
+#if CONFIG_LV_USE_BUILTIN_MALLOC
+    /* The built-in heap starts with the static CONFIG_LV_MEM_SIZE_KILOBYTES block in internal RAM,
+     * the rest of LVGL's memory comes from a pool placed by configuration */
+    if (CONFIG_APP_MEM_LVGL_POOL_KB) {
+        void *lvgl_pool = heap_caps_malloc(CONFIG_APP_MEM_LVGL_POOL_KB * 1024, MEM_LVGL_CAPS);
+        ESP_RETURN_ON_FALSE(lvgl_pool, ESP_ERR_NO_MEM, TAG, "no memory for LVGL pool");
+        ESP_RETURN_ON_FALSE(lv_mem_add_pool(lvgl_pool, CONFIG_APP_MEM_LVGL_POOL_KB * 1024), ESP_FAIL, TAG,
+                            "LVGL rejected the pool");
+    }
+#endif
+    return ESP_OK;
+}
+
+app_arena_handle_t app_mem_fetch_arena(int worker)
+{
+    assert(worker >= 0 && worker < CONFIG_APP_WEATHER_CONCURRENCY);
+    return s_mem.fetch[worker];
+}
+
+app_pool_handle_t app_mem_sensor_pool(void)
+{
+    return s_mem.sensor;
+}
+
+static void mem_heap_stats(app_mem_stats_t *st, const char *name, uint32_t caps, uint32_t failures)
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, caps);
+    size_t total = heap_caps_get_total_size(caps);
+
+    *st = (app_mem_stats_t) {
+        .name = name,
+        .kind = "heap",
+        .where = mem_where(caps),
+        .capacity = total,
+        .used = total - info.total_free_bytes,
+        .high_water = total - info.minimum_free_bytes,
+        .failures = failures,
+        .frag_pct = info.total_free_bytes ? 100 - info.largest_free_block * 100 / info.total_free_bytes : 0,
+    };
+}
+
+size_t app_mem_get_stats(app_mem_stats_t *stats, size_t max)
+{
+    size_t n = 0;
+
+    /* A bump arena and a block pool are never fragmented: their free space is one run, or any block */
+    portENTER_CRITICAL(&s_mem.lock);
+    for (int i = 0; i < s_mem.arena_count && n < max; i++, n++) {
+        const struct app_arena_t *a = &s_mem.arenas[i];
+        stats[n] = (app_mem_stats_t) {
+            .name = a->name,
+            .kind = "arena",
+            .where = mem_where(a->caps),
+            .capacity = a->size,
+            .used = a->used,
+            .high_water = a->high_water,
+            .failures = a->failures,
+        };
+    }
+    for (int i = 0; i < s_mem.pool_count && n < max; i++, n++) {
+        const struct app_pool_t *p = &s_mem.pools[i];
+        stats[n] = (app_mem_stats_t) {
+            .name = p->name,
+            .kind = "pool",
+            .where = mem_where(p->caps),
+            .capacity = p->block_size * p->count,
+            .used = p->block_size * p->in_use,
+            .high_water = p->block_size * p->high_water,
+            .failures = p->failures,
+        };
+    }
+    portEXIT_CRITICAL(&s_mem.lock);
+
+#if CONFIG_LV_USE_BUILTIN_MALLOC
+    if (n < max) {
+        lv_mem_monitor_t mon;
+        lv_mem_monitor(&mon);
+        stats[n++] = (app_mem_stats_t) {
+            .name = "lvgl",
+            .kind = "lvgl",
+            .where = CONFIG_APP_MEM_LVGL_POOL_KB ? mem_where(MEM_LVGL_CAPS) : "int",
+            .capacity = mon.total_size,
+            .used = mon.total_size - mon.free_size,
+            .high_water = mon.max_used,
+            .frag_pct = mon.frag_pct,
+        };
+    }
+#endif
+    if (n < max) {
+        mem_heap_stats(&stats[n++], "general", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, s_mem.heap_failures_int);
+    }
+#if CONFIG_SPIRAM
+    if (n < max) {
+        mem_heap_stats(&stats[n++], "general", MALLOC_CAP_SPIRAM, s_mem.heap_failures_psram);
+    }
+#endif
+    return n;
+}
+
+void app_mem_log_report(void)
+{
+    app_mem_stats_t stats[MEM_MAX_ARENAS + MEM_MAX_POOLS + 3];
+    size_t n = app_mem_get_stats(stats, sizeof(stats) / sizeof(stats[0]));
+
+    ESP_LOGI(TAG, "%-8s %-5s %-5s %9s %9s %9s %5s %4s", "name", "kind", "where", "size", "used", "peak", "fail", "frag");
+    for (size_t i = 0; i < n; i++) {
+        const app_mem_stats_t *st = &stats[i];
+        ESP_LOGI(TAG, "%-8s %-5s %-5s %9u %9u %9u %5u %3u%%", st->name, st->kind, st->where, (unsigned)st->capacity,
+                 (unsigned)st->used, (unsigned)st->high_water, (unsigned)st->failures, st->frag_pct);
+    }
+}
+
+static int mem_cmd_heap(int argc, char **argv)
+{
+    app_mem_log_report();
+    return 0;
+}
+
+esp_err_t app_mem_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "heap",
+        .help = "Show size, use, high-water mark and fragmentation of every memory arena",
+        .func = mem_cmd_heap,
+    };
+    return esp_console_cmd_register(&cmd);
+}
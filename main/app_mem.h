@@ -0,0 +1,111 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Bump arena: allocations are only released all at once by app_arena_reset()
+ */
+typedef struct app_arena_t *app_arena_handle_t;
+
+/**
+ * @brief Pool of equally sized blocks
+ */
+typedef struct app_pool_t *app_pool_handle_t;
+
+typedef struct {
+    const char *name;
+    const char *kind;           /*!< "arena", "pool", "lvgl" or "heap" */
+    const char *where;          /*!< "int" or "psram" */
+    size_t capacity;            /*!< Bytes */
+    size_t used;                /*!< Bytes in use now */
+    size_t high_water;          /*!< Most bytes ever in use */
+    uint32_t failures;          /*!< Allocations that did not fit */
+    uint8_t frag_pct;           /*!< 100 - largest free block * 100 / free bytes */
+} app_mem_stats_t;
+
+/**
+ * @brief Create the application arenas and give LVGL its configured pool
+ *
+ * Must be called after LVGL is initialized and before any widget is created.
+ */
+esp_err_t app_mem_init(void);
+
+/**
+ * @brief Arena of weather fetch worker `worker`, reset by the worker once each response is parsed
+ *
+ * Each worker has its own, so concurrent fetches never interleave allocations.
+ */
+app_arena_handle_t app_mem_fetch_arena(int worker);
+
+/**
+ * @brief Pool of app_sensor_reading_t records for consumers keeping readings past the listener call
+ */
+app_pool_handle_t app_mem_sensor_pool(void);
+
+/**
+ * @brief Create a bump arena of `size` bytes from memory with `caps`
+ */
+esp_err_t app_arena_create(const char *name, size_t size, uint32_t caps, app_arena_handle_t *ret_arena);
+
+/**
+ * @brief Allocate `size` bytes aligned to 8, NULL when the arena is full
+ */
+void *app_arena_alloc(app_arena_handle_t arena, size_t size);
+
+/**
+ * @brief Resize the latest allocation of the arena in place
+ *
+ * @return `ptr`, or NULL when `ptr` is not the latest allocation or the arena is full
+ */
+void *app_arena_extend(app_arena_handle_t arena, void *ptr, size_t size);
+
+/**
+ * @brief Release everything allocated from the arena
+ */
+void app_arena_reset(app_arena_handle_t arena);
+
+/**
+ * @brief Create a pool of `count` blocks of `block_size` bytes from memory with `caps`
+ */
+esp_err_t app_pool_create(const char *name, size_t block_size, size_t count, uint32_t caps, app_pool_handle_t *ret_pool);
+
+/**
+ * @brief Take one block, NULL when the pool is exhausted
+ */
+void *app_pool_alloc(app_pool_handle_t pool);
+
+/**
+ * @brief Return a block taken from the same pool
+ */
+void app_pool_free(app_pool_handle_t pool, void *block);
+
+/**
+ * @brief Statistics of every arena, pool, the LVGL heap and the system heaps
+ *
+ * @return Number of entries written to `stats`
+ */
+size_t app_mem_get_stats(app_mem_stats_t *stats, size_t max);
+
+/**
+ * @brief Log app_mem_get_stats() as a table
+ */
+void app_mem_log_report(void);
+
+/**
+ * @brief Add the "heap" console command printing the report
+ */
+esp_err_t app_mem_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,491 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_console.h"
+#include "lwip/sockets.h"
+#include "app_render.h"
+#include "app_mirror.h"
+
+#define MIRROR_TASK_STACK           (3072)
+#define MIRROR_QUEUE_SIZE           (CONFIG_APP_MIRROR_QUEUE_KB * 1024)
+#define MIRROR_BAND_SIZE            (8 * 1024)      /* Largest RECT message, bounds the work between budget checks */
+#define MIRROR_SEND_CHUNK           (4096)
+#define MIRROR_IDLE_MS              (1000)          /* Look for a closed viewer this often when nothing changes */
+#define MIRROR_AREAS_MAX            (16)
+#define MIRROR_TIMER_MS             (50)
+#define MIRROR_RLE_RUN              (0x8000)        /* Same encoding as the cached boot frame */
+#define MIRROR_RLE_MAX              (0x7FFF)
+#define MIRROR_AUTH_MS              (2000)          /* For the viewer to send its token */
+
+static const char *TAG = "mirror";
+
+typedef struct {
+    lv_area_t area[MIRROR_AREAS_MAX];
+    int count;
+} mirror_areas_t;
+
+static struct {
+    lv_display_t *disp;
+    RingbufHandle_t queue;
+    uint8_t *band;                  /* One RECT message being encoded */
+    /* Only used by the LVGL task */
+    mirror_areas_t dirty;           /* Invalidated since the last refresh */
+    mirror_areas_t owed;            /* Not streamed, to redraw on the next timer tick */
+    int64_t refresh_us;             /* Encoding time spent in the current refresh */
+    bool encoded;                   /* The current refresh queued something */
+    /* Set by the sender task */
+    volatile bool connected;
+    volatile bool resync;           /* A new viewer needs the whole screen */
+    app_mirror_stats_t stats;
+    portMUX_TYPE stats_lock;
+} s_mirror = {
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static void mirror_screen_area(lv_area_t *area)
+{
+    *area = (lv_area_t) {
+        .x1 = 0,
+        .y1 = 0,
+        .x2 = lv_display_get_horizontal_resolution(s_mirror.disp) - 1,
+        .y2 = lv_display_get_vertical_resolution(s_mirror.disp) - 1,
+    };
+}
+
+static bool mirror_area_clip(lv_area_t *res, const lv_area_t *a, const lv_area_t *b)
+{
+    res->x1 = LV_MAX(a->x1, b->x1);
+    res->y1 = LV_MAX(a->y1, b->y1);
+    res->x2 = LV_MIN(a->x2, b->x2);
+    res->y2 = LV_MIN(a->y2, b->y2);
+    return res->x1 <= res->x2 && res->y1 <= res->y2;
+}
+
+static void mirror_area_join(lv_area_t *res, const lv_area_t *a, const lv_area_t *b)
+{
+    res->x1 = LV_MIN(a->x1, b->x1);
+    res->y1 = LV_MIN(a->y1, b->y1);
+    res->x2 = LV_MAX(a->x2, b->x2);
+    res->y2 = LV_MAX(a->y2, b->y2);
+}
+
+static bool mirror_area_contains(const lv_area_t *outer, const lv_area_t *inner)
+{
+    return inner->x1 >= outer->x1 && inner->y1 >= outer->y1 && inner->x2 <= outer->x2 && inner->y2 <= outer->y2;
+}
+
+/* When the set is full the new area is merged into the one it grows least */
+static void mirror_areas_add(mirror_areas_t *set, const lv_area_t *area)
+{
+    lv_area_t screen;
+    lv_area_t a;
+    mirror_screen_area(&screen);
+    if (!mirror_area_clip(&a, area, &screen)) {
+        return;
+    }
+    for (int i = 0; i < set->count; i++) {
+        if (mirror_area_contains(&set->area[i], &a)) {
+            return;
+        }
+    }
+    if (set->count < MIRROR_AREAS_MAX) {
+        set->area[set->count++] = a;
+        return;
+    }
+
+    int best = 0;
+    uint32_t best_growth = UINT32_MAX;
+    for (int i = 0; i < set->count; i++) {
+        lv_area_t joined;
+        mirror_area_join(&joined, &set->area[i], &a);
+        uint32_t growth = lv_area_get_size(&joined) - lv_area_get_size(&set->area[i]);
+        if (growth < best_growth) {
+            best_growth = growth;
+            best = i;
+        }
+    }
+    mirror_area_join(&set->area[best], &set->area[best], &a);
+}
+
+/* Runs of 3 or more equal pixels become (MIRROR_RLE_RUN | n, pixel), anything else (n, pixels...).
+ * Writes at most count + 1 words. */
+static size_t mirror_rle_row(const uint16_t *px, size_t count, uint16_t *out)
+{
+    size_t i = 0;
+    size_t o = 0;
+    while (i < count) {
+        size_t run = 1;
+        while (i + run < count && run < MIRROR_RLE_MAX && px[i + run] == px[i]) {
+            run++;
+        }
+        if (run >= 3) {
+            out[o++] = MIRROR_RLE_RUN | run;
+            out[o++] = px[i];
+            i += run;
+            continue;
+        }
+
+        size_t lit = 0;
+        while (i + lit < count && lit < MIRROR_RLE_MAX &&
+                !(i + lit + 2 < count && px[i + lit] == px[i + lit + 1] && px[i + lit] == px[i + lit + 2])) {
+            lit++;
+        }
+        out[o++] = lit;
+        memcpy(&out[o], &px[i], lit * sizeof(uint16_t));
+        o += lit;
+        i += lit;
+    }
+    return o;
+}
+
+static bool mirror_queue_msg(const app_mirror_msg_t *msg)
+{
+    size_t len = sizeof(*msg) + msg->len;
+    if (xRingbufferSend(s_mirror.queue, msg, len, 0) != pdTRUE) {
+        return false;
+    }
+    portENTER_CRITICAL(&s_mirror.stats_lock);
+    s_mirror.stats.bytes += len;
+    if (msg->type == APP_MIRROR_MSG_RECT) {
+        s_mirror.stats.rects++;
+        s_mirror.stats.pixels += (uint32_t)msg->w * msg->h;
+    }
+    portEXIT_CRITICAL(&s_mirror.stats_lock);
+    return true;
+}
+
+/* Queue the rows of `area` band by band. Stops at the deadline or when the queue is full,
+ * with `area` shrunk to the rows left. `px` is the pixel at (x0, y0) of the rendered buffer. */
+static bool mirror_encode_area(lv_area_t *area, const uint8_t *px, int32_t x0, int32_t y0, uint32_t stride,
+                               int64_t deadline)
+{
+    int32_t w = lv_area_get_width(area);
+    app_mirror_msg_t *msg = (app_mirror_msg_t *)s_mirror.band;
+    uint16_t *out = (uint16_t *)(msg + 1);
+    size_t cap = (MIRROR_BAND_SIZE - sizeof(*msg)) / sizeof(uint16_t);
+
+    while (area->y1 <= area->y2) {
+        if (esp_timer_get_time() >= deadline) {
+            return false;
+        }
+        size_t words = 0;
+        int32_t y = area->y1;
+        while (y <= area->y2 && words + w + 1 <= cap) {
+            const uint16_t *row = (const uint16_t *)(px + (y - y0) * stride) + (area->x1 - x0);
+            words += mirror_rle_row(row, w, out + words);
+            y++;
+        }
+        *msg = (app_mirror_msg_t) {
+            .type = APP_MIRROR_MSG_RECT,
+            .x = area->x1,
+            .y = area->y1,
+            .w = w,
+            .h = y - area->y1,
+            .len = words * sizeof(uint16_t),
+        };
+        if (!mirror_queue_msg(msg)) {
+            return false;
+        }
+        s_mirror.encoded = true;
+        area->y1 = y;
+    }
+    return true;
+}
+
+static void mirror_invalidate_cb(lv_event_t *e)
+{
+    if (s_mirror.connected) {
+        mirror_areas_add(&s_mirror.dirty, lv_event_get_param(e));
+    }
+}
+
+/* Runs in the LVGL task once per flushed area, while the buffer holds its rendered pixels */
+static void mirror_flush_start_cb(lv_event_t *e)
+{
+    bool last = lv_display_flush_is_last(s_mirror.disp);
+    if (!s_mirror.connected) {
+        s_mirror.dirty.count = 0;
+        s_mirror.refresh_us = 0;
+        return;
+    }
+
+    int64_t start = esp_timer_get_time();
+    const lv_area_t *flushed = lv_event_get_param(e);
+    const lv_draw_buf_t *buf = lv_display_get_buf_active(s_mirror.disp);
+    lv_area_t screen;
+    mirror_screen_area(&screen);
+
+    /* Direct and full refresh render into a buffer covering the screen, partial refresh into
+     * one just as large as the flushed area */
+    int32_t x0 = flushed->x1;
+    int32_t y0 = flushed->y1;
+    if (buf->header.w == lv_area_get_width(&screen) && buf->header.h == lv_area_get_height(&screen)) {
+        x0 = 0;
+        y0 = 0;
+    }
+
+    /* Full refresh flushes the whole screen, only what was invalidated changed. Without any
+     * invalidated area, e.g. right after connecting, stream what was flushed. */
+    mirror_areas_t todo = { .count = 0 };
+    if (!s_mirror.dirty.count) {
+        todo.area[todo.count++] = *flushed;
+    }
+    for (int i = 0; i < s_mirror.dirty.count; i++) {
+        if (mirror_area_clip(&todo.area[todo.count], &s_mirror.dirty.area[i], flushed)) {
+            todo.count++;
+        }
+    }
+
+    int64_t deadline = start + CONFIG_APP_MIRROR_FLUSH_BUDGET_US - s_mirror.refresh_us;
+    bool ok = true;
+    for (int i = 0; i < todo.count; i++) {
+        if (ok) {
+            ok = mirror_encode_area(&todo.area[i], buf->data, x0, y0, buf->header.stride, deadline);
+        }
+        if (!ok) {
+            mirror_areas_add(&s_mirror.owed, &todo.area[i]);
+            portENTER_CRITICAL(&s_mirror.stats_lock);
+            s_mirror.stats.deferred++;
+            portEXIT_CRITICAL(&s_mirror.stats_lock);
+        }
+    }
+    s_mirror.refresh_us += esp_timer_get_time() - start;
+
+    if (!last) {
+        return;
+    }
+    if (s_mirror.encoded) {
+        const app_mirror_msg_t frame = {
+            .type = APP_MIRROR_MSG_FRAME,
+            .w = lv_area_get_width(&screen),
+            .h = lv_area_get_height(&screen),
+        };
+        mirror_queue_msg(&frame);
+    }
+    portENTER_CRITICAL(&s_mirror.stats_lock);
+    s_mirror.stats.frames++;
+    s_mirror.stats.flush_sum_us += s_mirror.refresh_us;
+    if (s_mirror.refresh_us > s_mirror.stats.flush_max_us) {
+        s_mirror.stats.flush_max_us = s_mirror.refresh_us;
+    }
+    portEXIT_CRITICAL(&s_mirror.stats_lock);
+    s_mirror.dirty.count = 0;
+    s_mirror.refresh_us = 0;
+    s_mirror.encoded = false;
+}
+
+/* Areas cannot be invalidated while rendering, so what was left over is redrawn from here */
+static void mirror_timer_cb(lv_timer_t *timer)
+{
+    if (!s_mirror.connected) {
+        s_mirror.owed.count = 0;
+        return;
+    }
+    if (s_mirror.resync) {
+        s_mirror.resync = false;
+        s_mirror.owed.count = 0;
+        lv_obj_invalidate(lv_screen_active());
+        return;
+    }
+    for (int i = 0; i < s_mirror.owed.count; i++) {
+        lv_obj_invalidate_area(lv_screen_active(), &s_mirror.owed.area[i]);
+    }
+    s_mirror.owed.count = 0;
+}
+
+static bool mirror_send_all(int sock, const uint8_t *data, size_t len)
+{
+    while (len) {
+        int n = send(sock, data, len, 0);
+        if (n < 0) {
+            ESP_LOGW(TAG, "send failed: errno %d", errno);
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static void mirror_discard_queue(void)
+{
+    size_t len;
+    void *data;
+    while ((data = xRingbufferReceiveUpTo(s_mirror.queue, &len, 0, MIRROR_QUEUE_SIZE))) {
+        vRingbufferReturnItem(s_mirror.queue, data);
+    }
+}
+
+static void mirror_stream(int sock)
+{
+    while (1) {
+        size_t len;
+        uint8_t *data = xRingbufferReceiveUpTo(s_mirror.queue, &len, pdMS_TO_TICKS(MIRROR_IDLE_MS), MIRROR_SEND_CHUNK);
+        if (!data) {
+            /* The viewer never sends anything, a read returning 0 means it went away */
+            char c;
+            int n = recv(sock, &c, sizeof(c), MSG_DONTWAIT);
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                return;
+            }
+            continue;
+        }
+        bool ok = mirror_send_all(sock, data, len);
+        vRingbufferReturnItem(s_mirror.queue, data);
+        if (!ok) {
+            return;
+        }
+    }
+}
+
+/* The first line from the viewer must be the token, compared without bailing out early */
+static bool mirror_check_token(int sock)
+{
+    const char *token = CONFIG_APP_MIRROR_TOKEN;
+    size_t token_len = strlen(token);
+    struct timeval tv = { .tv_sec = MIRROR_AUTH_MS / 1000, .tv_usec = (MIRROR_AUTH_MS % 1000) * 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    char line[64];
+    size_t len = 0;
+    while (len < sizeof(line)) {
+        int n = recv(sock, &line[len], 1, 0);
+        if (n <= 0) {
+            return false;
+        }
+        if (line[len] == '\n') {
+            break;
+        }
+        len++;
+    }
+    if (len == sizeof(line) || len != token_len) {
+        return false;
+    }
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; i++) {
+        diff |= line[i] ^ token[i];
+    }
+    return diff == 0;
+}
+
+static void mirror_task(void *arg)
+{
+    int listener = (intptr_t)arg;
+    while (1) {
+        struct sockaddr_in peer;
+        socklen_t peer_len = sizeof(peer);
+        int sock = accept(listener, (struct sockaddr *)&peer, &peer_len);
+        if (sock < 0) {
+            ESP_LOGW(TAG, "accept failed: errno %d", errno);
+            vTaskDelay(pdMS_TO_TICKS(MIRROR_IDLE_MS));
+            continue;
+        }
+        if (!mirror_check_token(sock)) {
+            ESP_LOGW(TAG, "rejected viewer=%s", inet_ntoa(peer.sin_addr));
+            close(sock);
+            continue;
+        }
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        /* Whatever is queued belongs to the previous viewer */
+        mirror_discard_queue();
+        s_mirror.resync = true;
+        s_mirror.connected = true;
+        ESP_LOGI(TAG, "viewer=%s", inet_ntoa(peer.sin_addr));
+
+        mirror_stream(sock);
+
+        s_mirror.connected = false;
+        close(sock);
+        ESP_LOGI(TAG, "viewer closed");
+    }
+}
+
+esp_err_t app_mirror_start(lv_display_t *disp)
+{
+    ESP_RETURN_ON_FALSE(disp, ESP_ERR_INVALID_ARG, TAG, "display is required");
+    ESP_RETURN_ON_FALSE(!s_mirror.disp, ESP_ERR_INVALID_STATE, TAG, "already started");
+    if (!strlen(CONFIG_APP_MIRROR_TOKEN)) {
+        ESP_LOGW(TAG, "No viewer token set, the mirror stays off");
+        return ESP_OK;
+    }
+
+    s_mirror.band = heap_caps_malloc(MIRROR_BAND_SIZE, MALLOC_CAP_SPIRAM);
+    ESP_RETURN_ON_FALSE(s_mirror.band, ESP_ERR_NO_MEM, TAG, "no memory for the encoder");
+    s_mirror.queue = xRingbufferCreateWithCaps(MIRROR_QUEUE_SIZE, RINGBUF_TYPE_BYTEBUF, MALLOC_CAP_SPIRAM);
+    ESP_RETURN_ON_FALSE(s_mirror.queue, ESP_ERR_NO_MEM, TAG, "no memory for the queue");
+
+    int listener = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    ESP_RETURN_ON_FALSE(listener >= 0, ESP_FAIL, TAG, "socket failed: errno %d", errno);
+    const struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_APP_MIRROR_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(listener, (const struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0) {
+        ESP_LOGE(TAG, "listen on port %d failed: errno %d", CONFIG_APP_MIRROR_PORT, errno);
+        close(listener);
+        return ESP_FAIL;
+    }
+    BaseType_t res = xTaskCreatePinnedToCore(mirror_task, "mirror", MIRROR_TASK_STACK, (void *)(intptr_t)listener, 2,
+                                             NULL, app_render_background_core());
+    ESP_RETURN_ON_FALSE(res == pdPASS, ESP_ERR_NO_MEM, TAG, "create task failed");
+
+    s_mirror.disp = disp;
+    lv_display_add_event_cb(disp, mirror_invalidate_cb, LV_EVENT_INVALIDATE_AREA, NULL);
+    lv_display_add_event_cb(disp, mirror_flush_start_cb, LV_EVENT_FLUSH_START, NULL);
+    lv_timer_create(mirror_timer_cb, MIRROR_TIMER_MS, NULL);
+    ESP_LOGI(TAG, "listening port=%d queue=%d budget_us=%d", CONFIG_APP_MIRROR_PORT, MIRROR_QUEUE_SIZE,
+             CONFIG_APP_MIRROR_FLUSH_BUDGET_US);
+    return ESP_OK;
+}
+
+esp_err_t app_mirror_get_stats(app_mirror_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    portENTER_CRITICAL(&s_mirror.stats_lock);
+    *stats = s_mirror.stats;
+    memset(&s_mirror.stats, 0, sizeof(s_mirror.stats));
+    portEXIT_CRITICAL(&s_mirror.stats_lock);
+    stats->viewer = s_mirror.connected;
+    return ESP_OK;
+}
+
+static int mirror_cmd(int argc, char **argv)
+{
+    app_mirror_stats_t st;
+    app_mirror_get_stats(&st);
+    printf("mirror: viewer=%d frames=%" PRIu32 " rects=%" PRIu32 " pixels=%" PRIu64 " bytes=%" PRIu64
+           " bytes_per_frame=%" PRIu32 " ratio=%.1f flush_avg_us=%" PRIu32 " flush_max_us=%" PRIu32 " deferred=%" PRIu32 "\n",
+           st.viewer, st.frames, st.rects, st.pixels, st.bytes, st.frames ? (uint32_t)(st.bytes / st.frames) : 0,
+           st.bytes ? (double)(st.pixels * sizeof(uint16_t)) / st.bytes : 0.0,
+           st.frames ? (uint32_t)(st.flush_sum_us / st.frames) : 0, st.flush_max_us, st.deferred);
+    return 0;
+}
+
+esp_err_t app_mirror_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "mirror",
+        .help = "Show what the display mirror streamed and the flush time it added since the last call",
+        .func = mirror_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
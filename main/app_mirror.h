@@ -0,0 +1,69 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Stream layout, shared with mirror_view.js: a sequence of messages, each this header followed
+ * by `len` bytes. A RECT carries the pixels of the rectangle (x, y, w, h) in the same RLE as the
+ * cached boot frame: per row, a word with bit 15 set is a run of (word & 0x7FFF) copies of the
+ * next word, else a count of literal RGB565 pixels that follow. A FRAME closes a refresh, its w
+ * and h are the screen size, and has no data. All integers are little endian. */
+#define APP_MIRROR_MSG_RECT         (1)
+#define APP_MIRROR_MSG_FRAME        (2)
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t x;
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+    uint32_t len;
+} app_mirror_msg_t;
+
+typedef struct {
+    uint32_t frames;                /*!< Refreshes streamed */
+    uint32_t rects;                 /*!< RECT messages, a large dirty area is split into bands */
+    uint64_t pixels;
+    uint64_t bytes;                 /*!< Messages queued for the viewer, headers included */
+    uint32_t deferred;              /*!< Areas left for a later refresh, over budget or queue full */
+    uint64_t flush_sum_us;          /*!< Time added to the flushes of the streamed refreshes */
+    uint32_t flush_max_us;          /*!< Most time added to one refresh */
+    bool viewer;                    /*!< A viewer is connected */
+} app_mirror_stats_t;
+
+/**
+ * @brief Stream what the panel shows to one viewer on TCP port CONFIG_APP_MIRROR_PORT
+ *
+ * Only areas LVGL redraws are encoded, in the flush path, and queued for the sender task.
+ * A refresh spends at most CONFIG_APP_MIRROR_FLUSH_BUDGET_US on encoding; what is left over,
+ * or does not fit the queue, is redrawn and sent on a later refresh. A new viewer gets the
+ * whole screen first. Nothing is encoded while no viewer is connected.
+ * A viewer must send CONFIG_APP_MIRROR_TOKEN and a newline before anything is streamed to it;
+ * without a token the mirror is not started, which is not an error.
+ * Must be called with the LVGL lock held.
+ */
+esp_err_t app_mirror_start(lv_display_t *disp);
+
+/**
+ * @brief Read the statistics since the last call and clear them
+ */
+esp_err_t app_mirror_get_stats(app_mirror_stats_t *stats);
+
+/**
+ * @brief Add the "mirror" console command
+ */
+esp_err_t app_mirror_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,203 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_lvgl_port.h"
+#include "app_mailbox.h"
+#include "app_timeline.h"
+#include "app_model.h"
+
+static const char *TAG = "model";
+
+static struct {
+    app_mailbox_t weather_mb[APP_MODEL_MAX_CITIES];
+    app_weather_snapshot_t weather_slots[APP_MODEL_MAX_CITIES][3];
+    app_mailbox_t sensor_mb;
+    app_sensor_snapshot_t sensor_slots[3];
+    app_sensor_snapshot_t sensor_work;          /* Owned by the sensor task */
+    app_weather_snapshot_t weather_applied[APP_MODEL_MAX_CITIES];  /* Owned by the UI */
+    app_sensor_snapshot_t sensor_applied;       /* Owned by the UI */
+    app_model_apply_cb_t apply_cb;
+    portMUX_TYPE stats_lock;
+    app_model_stats_t stats;
+    int64_t next_log;
+} s_model = {
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static void model_account_publish(int64_t stall_us)
+{
+    portENTER_CRITICAL(&s_model.stats_lock);
+    s_model.stats.publishes++;
+    s_model.stats.producer_stall_max_us = MAX(s_model.stats.producer_stall_max_us, (uint32_t)stall_us);
+    s_model.stats.producer_stall_sum_us += stall_us;
+    portEXIT_CRITICAL(&s_model.stats_lock);
+}
+
+static void model_account_apply(int64_t hold_us)
+{
+    portENTER_CRITICAL(&s_model.stats_lock);
+    s_model.stats.applies++;
+    s_model.stats.lock_hold_max_us = MAX(s_model.stats.lock_hold_max_us, (uint32_t)hold_us);
+    s_model.stats.lock_hold_sum_us += hold_us;
+    portEXIT_CRITICAL(&s_model.stats_lock);
+}
+
+/* Runs with the LVGL lock held, `weather` is the dashboard city */
+static void model_apply(const app_weather_snapshot_t *weather, const app_sensor_snapshot_t *sensors)
+{
+    if (weather && memcmp(weather, &s_model.weather_applied[0], sizeof(*weather)) == 0) {
+        weather = NULL;
+    }
+    if (sensors && memcmp(sensors, &s_model.sensor_applied, sizeof(*sensors)) == 0) {
+        sensors = NULL;
+    }
+    if (!weather && !sensors) {
+        return;
+    }
+
+    int64_t start = esp_timer_get_time();
+    s_model.apply_cb(weather, weather ? &s_model.weather_applied[0] : NULL,
+                     sensors, sensors ? &s_model.sensor_applied : NULL);
+    if (weather) {
+        s_model.weather_applied[0] = *weather;
+        app_timeline_mark(APP_TIMELINE_FIRST_WEATHER);
+    }
+    if (sensors) {
+        s_model.sensor_applied = *sensors;
+    }
+    model_account_apply(esp_timer_get_time() - start);
+}
+
+#if CONFIG_APP_MODEL_DIRECT_LOCK
+#define MODEL_MODE  "direct"
+#else
+#define MODEL_MODE  "snapshot"
+#endif
+
+static void model_log_stats(void)
+{
+    app_model_stats_t st;
+    app_model_get_stats(&st);
+    ESP_LOGI(TAG, "%s publishes=%"PRIu32" stall_avg=%"PRIu32" stall_max=%"PRIu32" applies=%"PRIu32
+             " hold_avg=%"PRIu32" hold_max=%"PRIu32, MODEL_MODE,
+             st.publishes, st.publishes ? (uint32_t)(st.producer_stall_sum_us / st.publishes) : 0,
+             st.producer_stall_max_us, st.applies, st.applies ? (uint32_t)(st.lock_hold_sum_us / st.applies) : 0,
+             st.lock_hold_max_us);
+}
+
+static void model_frame_cb(lv_timer_t *timer)
+{
+#if !CONFIG_APP_MODEL_DIRECT_LOCK
+    bool weather_fresh = false;
+    bool sensors_fresh = false;
+    const app_weather_snapshot_t *weather = app_mailbox_latest(&s_model.weather_mb[0], &weather_fresh);
+    const app_sensor_snapshot_t *sensors = app_mailbox_latest(&s_model.sensor_mb, &sensors_fresh);
+
+    /* Cities off the dashboard are only kept for app_model_get_weather() */
+    for (int i = 1; i < APP_MODEL_MAX_CITIES; i++) {
+        bool fresh = false;
+        const app_weather_snapshot_t *other = app_mailbox_latest(&s_model.weather_mb[i], &fresh);
+        if (fresh) {
+            s_model.weather_applied[i] = *other;
+        }
+    }
+    model_apply(weather_fresh ? weather : NULL, sensors_fresh ? sensors : NULL);
+#endif
+
+    if (CONFIG_APP_MODEL_STATS_PERIOD_S && esp_timer_get_time() >= s_model.next_log) {
+        model_log_stats();
+        s_model.next_log = esp_timer_get_time() + CONFIG_APP_MODEL_STATS_PERIOD_S * 1000000LL;
+    }
+}
+
+esp_err_t app_model_init(app_model_apply_cb_t apply_cb)
+{
+    ESP_RETURN_ON_FALSE(apply_cb, ESP_ERR_INVALID_ARG, TAG, "apply callback is required");
+
+    s_model.apply_cb = apply_cb;
+    for (int i = 0; i < APP_MODEL_MAX_CITIES; i++) {
+        app_mailbox_init(&s_model.weather_mb[i], s_model.weather_slots[i], sizeof(app_weather_snapshot_t), NULL);
+    }
+    app_mailbox_init(&s_model.sensor_mb, s_model.sensor_slots, sizeof(app_sensor_snapshot_t), NULL);
+    s_model.next_log = esp_timer_get_time() + CONFIG_APP_MODEL_STATS_PERIOD_S * 1000000LL;
+
+    /* Pick up the latest snapshots once per frame */
+    lv_timer_t *timer = lv_timer_create(model_frame_cb, LV_DEF_REFR_PERIOD, NULL);
+    ESP_RETURN_ON_FALSE(timer, ESP_ERR_NO_MEM, TAG, "no memory for timer");
+    return ESP_OK;
+}
+
+#if CONFIG_APP_MODEL_DIRECT_LOCK
+/* Legacy path kept for comparison: the producer takes the LVGL lock and updates widgets itself */
+static void model_publish_direct(int city, const app_weather_snapshot_t *weather, const app_sensor_snapshot_t *sensors)
+{
+    if (!s_model.apply_cb) {
+        return;
+    }
+    int64_t start = esp_timer_get_time();
+    lvgl_port_lock(0);
+    if (city > 0) {
+        s_model.weather_applied[city] = *weather;
+        weather = NULL;
+    }
+    model_apply(weather, sensors);
+    lvgl_port_unlock();
+    model_account_publish(esp_timer_get_time() - start);
+}
+#endif
+
+void app_model_publish_weather(int city, const app_weather_snapshot_t *weather)
+{
+    if (city < 0 || city >= APP_MODEL_MAX_CITIES) {
+        return;
+    }
+#if CONFIG_APP_MODEL_DIRECT_LOCK
+    model_publish_direct(city, weather, NULL);
+#else
+    int64_t start = esp_timer_get_time();
+    memcpy(app_mailbox_back(&s_model.weather_mb[city]), weather, sizeof(*weather));
+    app_mailbox_publish(&s_model.weather_mb[city]);
+    model_account_publish(esp_timer_get_time() - start);
+#endif
+}
+
+void app_model_publish_sensor_reading(app_sensor_handle_t sensor, const app_sensor_reading_t *reading, void *arg)
+{
+    app_sensor_snapshot_t *work = &s_model.sensor_work;
+    for (int i = 0; i < reading->channels; i++) {
+        work->value[reading->quantity[i]] = reading->value[i];
+        work->valid_mask |= 1u << reading->quantity[i];
+    }
+    work->updated_us = reading->timestamp_us;
+
+#if CONFIG_APP_MODEL_DIRECT_LOCK
+    model_publish_direct(0, NULL, work);
+#else
+    int64_t start = esp_timer_get_time();
+    memcpy(app_mailbox_back(&s_model.sensor_mb), work, sizeof(*work));
+    app_mailbox_publish(&s_model.sensor_mb);
+    model_account_publish(esp_timer_get_time() - start);
+#endif
+}
+
+const app_weather_snapshot_t *app_model_get_weather(int city)
+{
+    return &s_model.weather_applied[city];
+}
+
+void app_model_get_stats(app_model_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_model.stats_lock);
+    *stats = s_model.stats;
+    memset(&s_model.stats, 0, sizeof(s_model.stats));
+    portEXIT_CRITICAL(&s_model.stats_lock);
+}
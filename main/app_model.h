@@ -0,0 +1,99 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "app_sensor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_MODEL_MAX_CITIES        CONFIG_APP_WEATHER_MAX_CITIES
+#define APP_WEATHER_TEMP_NONE       INT16_MIN   /*!< The weather source gave no such temperature */
+
+/**
+ * @brief Current weather of one city, as parsed from the weather source
+ */
+typedef struct {
+    char city_code[12];         /*!< e.g. "101250101" */
+    char city_name[24];
+    char condition[24];         /*!< Human readable condition, UTF-8 */
+    uint8_t icon;               /*!< Condition code used to pick an icon */
+    int16_t temp_c10;           /*!< Temperature in 0.1 degree Celsius */
+    int16_t temp_high_c10;
+    int16_t temp_low_c10;
+    uint8_t humidity_pct;
+    int64_t updated_us;         /*!< esp_timer time of the fetch, 0 if never fetched */
+} app_weather_snapshot_t;
+
+/**
+ * @brief Latest value of every local sensor quantity
+ */
+typedef struct {
+    float value[APP_SENSOR_QUANTITY_MAX];
+    uint32_t valid_mask;        /*!< Bit per app_sensor_quantity_t that has a value */
+    int64_t updated_us;
+} app_sensor_snapshot_t;
+
+/**
+ * @brief Applies changed fields to the widgets, runs in the LVGL task
+ *
+ * `prev_*` is the snapshot applied last time (all zero on the first call), so the
+ * implementation can touch only the widgets whose fields differ. A NULL pointer pair
+ * means that part did not change.
+ */
+typedef void (*app_model_apply_cb_t)(const app_weather_snapshot_t *weather, const app_weather_snapshot_t *prev_weather,
+                                     const app_sensor_snapshot_t *sensors, const app_sensor_snapshot_t *prev_sensors);
+
+typedef struct {
+    uint32_t publishes;                 /*!< Snapshots published by producers */
+    uint32_t producer_stall_max_us;     /*!< Longest time a producer spent publishing */
+    uint64_t producer_stall_sum_us;
+    uint32_t applies;                   /*!< Times the UI applied changes */
+    uint32_t lock_hold_max_us;          /*!< Longest time the UI lock was held for applying */
+    uint64_t lock_hold_sum_us;
+} app_model_stats_t;
+
+/**
+ * @brief Create the mailboxes and start picking up snapshots once per LVGL frame
+ *
+ * Must be called with the LVGL lock held.
+ */
+esp_err_t app_model_init(app_model_apply_cb_t apply_cb);
+
+/**
+ * @brief Publish the weather of city `city`, only one task at a time may publish a given city
+ *
+ * City 0 is the one shown on the dashboard, the others are kept for app_model_get_weather().
+ * Never waits for the UI.
+ */
+void app_model_publish_weather(int city, const app_weather_snapshot_t *weather);
+
+/**
+ * @brief Weather of city `city` as last picked up by the UI, all zero if none yet
+ *
+ * Must be called with the LVGL lock held.
+ */
+const app_weather_snapshot_t *app_model_get_weather(int city);
+
+/**
+ * @brief Merge a sensor reading into the sensor snapshot, only call from the sensor task
+ *
+ * Never waits for the UI. Matches app_sensor_listener_t.
+ */
+void app_model_publish_sensor_reading(app_sensor_handle_t sensor, const app_sensor_reading_t *reading, void *arg);
+
+/**
+ * @brief Read statistics and clear them
+ */
+void app_model_get_stats(app_model_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,404 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_console.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_ota_ops.h"
+#include "esp_app_format.h"
+#include "mbedtls/sha256.h"
+#include "miniz.h"
+#include "app_http.h"
+#include "app_ota.h"
+
+#define OTA_BLOCK_SIZE          (4096)
+#define OTA_RECORD_SIZE         (12)
+
+static const char *TAG = "ota";
+
+/* Fixed working set of one update, the largest part is the inflate window */
+typedef struct {
+    tinfl_decompressor inflator;
+    uint8_t window[TINFL_LZ_DICT_SIZE];     /* Inflate output wraps around in here */
+    uint8_t old[OTA_BLOCK_SIZE];            /* Cached block of the running image */
+    uint8_t out[OTA_BLOCK_SIZE];            /* New image bytes not written yet */
+} ota_buffers_t;
+
+typedef struct {
+    ota_buffers_t *buf;
+    const esp_partition_t *running;
+    const esp_partition_t *target;
+    esp_ota_handle_t handle;
+    mbedtls_sha256_context sha;             /* Of the new image */
+    bool started;
+    bool delta;
+    size_t received;
+    size_t written;                         /* New image bytes, including those still in `out` */
+    size_t out_len;
+    /* Patch state */
+    app_ota_patch_header_t hdr;
+    size_t hdr_len;
+    size_t window_pos;
+    bool inflate_done;
+    uint8_t record[OTA_RECORD_SIZE];
+    size_t record_len;
+    uint32_t diff_left;
+    uint32_t extra_left;
+    int32_t seek;
+    int64_t old_pos;
+    size_t old_start;                       /* Offset of buf->old in the running image */
+    size_t old_len;
+} ota_job_t;
+
+static uint32_t ota_le32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static esp_err_t ota_flush(ota_job_t *job)
+{
+    if (!job->out_len) {
+        return ESP_OK;
+    }
+    mbedtls_sha256_update(&job->sha, job->buf->out, job->out_len);
+    esp_err_t ret = esp_ota_write(job->handle, job->buf->out, job->out_len);
+    job->out_len = 0;
+    return ret;
+}
+
+/* Space left in the output block, flushing it first when it is full */
+static esp_err_t ota_out_space(ota_job_t *job, size_t *space)
+{
+    if (job->out_len == OTA_BLOCK_SIZE) {
+        ESP_RETURN_ON_ERROR(ota_flush(job), TAG, "write to %s failed", job->target->label);
+    }
+    *space = OTA_BLOCK_SIZE - job->out_len;
+    return ESP_OK;
+}
+
+static esp_err_t ota_emit(ota_job_t *job, const uint8_t *data, size_t len)
+{
+    while (len) {
+        size_t n;
+        esp_err_t ret = ota_out_space(job, &n);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        n = MIN(n, len);
+        memcpy(job->buf->out + job->out_len, data, n);
+        job->out_len += n;
+        job->written += n;
+        data += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+/* Old image bytes from old_pos on, as many as are contiguous in the cached block */
+static esp_err_t ota_old_bytes(ota_job_t *job, const uint8_t **data, size_t *avail)
+{
+    size_t pos = (size_t)job->old_pos;
+    if (pos < job->old_start || pos >= job->old_start + job->old_len) {
+        job->old_start = pos;
+        job->old_len = MIN(OTA_BLOCK_SIZE, job->hdr.old_size - pos);
+        ESP_RETURN_ON_ERROR(esp_partition_read(job->running, pos, job->buf->old, job->old_len), TAG,
+                            "read of the running image failed");
+    }
+    *data = job->buf->old + (pos - job->old_start);
+    *avail = job->old_start + job->old_len - pos;
+    return ESP_OK;
+}
+
+static esp_err_t ota_check_record(ota_job_t *job)
+{
+    job->diff_left = ota_le32(job->record);
+    job->extra_left = ota_le32(job->record + 4);
+    job->seek = (int32_t)ota_le32(job->record + 8);
+    job->record_len = 0;
+
+    ESP_RETURN_ON_FALSE((uint64_t)job->written + job->diff_left + job->extra_left <= job->hdr.new_size,
+                        ESP_ERR_INVALID_RESPONSE, TAG, "patch writes past the new image");
+    ESP_RETURN_ON_FALSE(job->old_pos + job->diff_left <= job->hdr.old_size, ESP_ERR_INVALID_RESPONSE, TAG,
+                        "patch reads past the old image");
+    return ESP_OK;
+}
+
+/* Runs the inflated patch records */
+static esp_err_t ota_apply(ota_job_t *job, const uint8_t *p, size_t len)
+{
+    while (len) {
+        if (!job->diff_left && !job->extra_left) {
+            size_t n = MIN(len, OTA_RECORD_SIZE - job->record_len);
+            memcpy(job->record + job->record_len, p, n);
+            job->record_len += n;
+            p += n;
+            len -= n;
+            if (job->record_len == OTA_RECORD_SIZE) {
+                esp_err_t ret = ota_check_record(job);
+                if (ret != ESP_OK) {
+                    return ret;
+                }
+            } else {
+                continue;
+            }
+        } else if (job->diff_left) {
+            /* The new bytes are the old ones at the cursor plus the patch bytes, so code
+             * that only moved to other addresses becomes runs of small values */
+            const uint8_t *old;
+            size_t space;
+            size_t avail;
+            esp_err_t ret = ota_out_space(job, &space);
+            if (ret == ESP_OK) {
+                ret = ota_old_bytes(job, &old, &avail);
+            }
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            size_t n = MIN(MIN(len, job->diff_left), MIN(space, avail));
+            uint8_t *out = job->buf->out + job->out_len;
+            for (size_t i = 0; i < n; i++) {
+                out[i] = old[i] + p[i];
+            }
+            job->out_len += n;
+            job->written += n;
+            job->old_pos += n;
+            job->diff_left -= n;
+            p += n;
+            len -= n;
+        } else {
+            size_t n = MIN(len, job->extra_left);
+            esp_err_t ret = ota_emit(job, p, n);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            job->extra_left -= n;
+            p += n;
+            len -= n;
+        }
+
+        if (!job->diff_left && !job->extra_left) {
+            job->old_pos += job->seek;
+            job->seek = 0;
+            ESP_RETURN_ON_FALSE(job->old_pos >= 0 && job->old_pos <= job->hdr.old_size, ESP_ERR_INVALID_RESPONSE,
+                                TAG, "patch seeks outside the old image");
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t ota_inflate(ota_job_t *job, const uint8_t *in, size_t len)
+{
+    while (!job->inflate_done) {
+        size_t in_size = len;
+        size_t out_size = TINFL_LZ_DICT_SIZE - job->window_pos;
+        uint8_t *out = job->buf->window + job->window_pos;
+        tinfl_status status = tinfl_decompress(&job->buf->inflator, in, &in_size, job->buf->window, out, &out_size,
+                                               TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+        ESP_RETURN_ON_FALSE(status >= TINFL_STATUS_DONE, ESP_ERR_INVALID_RESPONSE, TAG, "corrupt patch (%d)", status);
+        in += in_size;
+        len -= in_size;
+        esp_err_t ret = ota_apply(job, out, out_size);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        job->window_pos = (job->window_pos + out_size) & (TINFL_LZ_DICT_SIZE - 1);
+
+        if (status == TINFL_STATUS_DONE) {
+            job->inflate_done = true;
+        } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT) {
+            break;
+        }
+    }
+    ESP_RETURN_ON_FALSE(!len, ESP_ERR_INVALID_RESPONSE, TAG, "data after the end of the patch");
+    return ESP_OK;
+}
+
+/* The patch only fits the exact image it was made from */
+static esp_err_t ota_check_header(ota_job_t *job)
+{
+    const app_ota_patch_header_t *hdr = &job->hdr;
+    ESP_RETURN_ON_FALSE(hdr->magic == APP_OTA_PATCH_MAGIC, ESP_ERR_INVALID_VERSION, TAG, "unknown patch format");
+    ESP_RETURN_ON_FALSE(hdr->old_size <= job->running->size, ESP_ERR_INVALID_SIZE, TAG, "patch for a larger image");
+    ESP_RETURN_ON_FALSE(hdr->new_size <= job->target->size, ESP_ERR_INVALID_SIZE, TAG, "new image does not fit %s",
+                        job->target->label);
+
+    mbedtls_sha256_context sha;
+    uint8_t digest[32];
+    esp_err_t ret = ESP_OK;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    for (size_t pos = 0; pos < hdr->old_size && ret == ESP_OK; pos += OTA_BLOCK_SIZE) {
+        size_t n = MIN(OTA_BLOCK_SIZE, hdr->old_size - pos);
+        ret = esp_partition_read(job->running, pos, job->buf->old, n);
+        mbedtls_sha256_update(&sha, job->buf->old, n);
+    }
+    mbedtls_sha256_finish(&sha, digest);
+    mbedtls_sha256_free(&sha);
+    ESP_RETURN_ON_ERROR(ret, TAG, "read of the running image failed");
+    ESP_RETURN_ON_FALSE(memcmp(digest, hdr->old_sha256, sizeof(digest)) == 0, ESP_ERR_INVALID_CRC, TAG,
+                        "patch was made for another image than the running one");
+
+    tinfl_init(&job->buf->inflator);
+    return ESP_OK;
+}
+
+static esp_err_t ota_body_cb(const uint8_t *data, size_t len, void *arg)
+{
+    ota_job_t *job = arg;
+
+    if (!job->started) {
+        job->started = true;
+        job->delta = data[0] != ESP_IMAGE_HEADER_MAGIC;
+    }
+    job->received += len;
+    if (!job->delta) {
+        return ota_emit(job, data, len);
+    }
+
+    if (job->hdr_len < sizeof(job->hdr)) {
+        size_t n = MIN(len, sizeof(job->hdr) - job->hdr_len);
+        memcpy((uint8_t *)&job->hdr + job->hdr_len, data, n);
+        job->hdr_len += n;
+        data += n;
+        len -= n;
+        if (job->hdr_len < sizeof(job->hdr)) {
+            return ESP_OK;
+        }
+        esp_err_t ret = ota_check_header(job);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    return len ? ota_inflate(job, data, len) : ESP_OK;
+}
+
+/* Everything the download produced has to add up to the image the patch promised */
+static esp_err_t ota_finish(ota_job_t *job)
+{
+    uint8_t digest[32];
+    ESP_RETURN_ON_FALSE(job->started, ESP_ERR_INVALID_SIZE, TAG, "empty download");
+    ESP_RETURN_ON_ERROR(ota_flush(job), TAG, "write to %s failed", job->target->label);
+    mbedtls_sha256_finish(&job->sha, digest);
+    if (job->delta) {
+        ESP_RETURN_ON_FALSE(job->inflate_done && job->written == job->hdr.new_size && !job->diff_left &&
+                            !job->extra_left, ESP_ERR_INVALID_SIZE, TAG, "patch ended early");
+        ESP_RETURN_ON_FALSE(memcmp(digest, job->hdr.new_sha256, sizeof(digest)) == 0, ESP_ERR_INVALID_CRC, TAG,
+                            "patched image does not match");
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_ota_update(const char *url, app_ota_result_t *result)
+{
+    ESP_RETURN_ON_FALSE(url && result, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    ota_job_t job = {
+        .running = esp_ota_get_running_partition(),
+    };
+    job.target = esp_ota_get_next_update_partition(NULL);
+    ESP_RETURN_ON_FALSE(job.target, ESP_ERR_NOT_FOUND, TAG, "no OTA slot to write to");
+
+    /* Large and only needed while updating, so it comes from PSRAM when there is some */
+    job.buf = heap_caps_malloc(sizeof(ota_buffers_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!job.buf) {
+        job.buf = heap_caps_malloc(sizeof(ota_buffers_t), MALLOC_CAP_8BIT);
+    }
+    ESP_RETURN_ON_FALSE(job.buf, ESP_ERR_NO_MEM, TAG, "no memory for buffers");
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = esp_ota_begin(job.target, OTA_WITH_SEQUENTIAL_WRITES, &job.handle);
+    if (ret != ESP_OK) {
+        heap_caps_free(job.buf);
+        ESP_LOGE(TAG, "begin on %s failed: %s", job.target->label, esp_err_to_name(ret));
+        return ret;
+    }
+    mbedtls_sha256_init(&job.sha);
+    mbedtls_sha256_starts(&job.sha, 0);
+
+    app_http_response_t resp;
+    ret = app_http_get_stream(url, NULL, ota_body_cb, &job, &resp);
+    if (ret == ESP_OK && resp.status != 200) {
+        ESP_LOGE(TAG, "GET %s: status %d", url, resp.status);
+        ret = ESP_ERR_NOT_FOUND;
+    }
+    if (ret == ESP_OK) {
+        ret = ota_finish(&job);
+    }
+    mbedtls_sha256_free(&job.sha);
+    heap_caps_free(job.buf);
+
+    /* esp_ota_end() checks the image itself, whichever way it was written */
+    if (ret == ESP_OK) {
+        ret = esp_ota_end(job.handle);
+    } else {
+        esp_ota_abort(job.handle);
+    }
+    if (ret == ESP_OK) {
+        ret = esp_ota_set_boot_partition(job.target);
+    }
+    ESP_RETURN_ON_ERROR(ret, TAG, "update from %s failed", url);
+
+    *result = (app_ota_result_t) {
+        .delta = job.delta,
+        .download_bytes = job.received,
+        .image_bytes = job.written,
+        .ms = (uint32_t)((esp_timer_get_time() - start) / 1000),
+        .ram_bytes = sizeof(ota_buffers_t),
+    };
+    return ESP_OK;
+}
+
+void app_ota_confirm(void)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(running, &state) == ESP_OK && state == ESP_OTA_IMG_PENDING_VERIFY) {
+        esp_ota_mark_app_valid_cancel_rollback();
+        ESP_LOGI(TAG, "running %s, new image accepted", running->label);
+    } else {
+        ESP_LOGI(TAG, "running %s", running->label);
+    }
+}
+
+static int ota_cmd(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3 || (argc == 3 && strcmp(argv[2], "reboot") != 0)) {
+        printf("usage: ota <url> [reboot]\n");
+        return 1;
+    }
+
+    app_ota_result_t res;
+    esp_err_t ret = app_ota_update(argv[1], &res);
+    if (ret != ESP_OK) {
+        printf("ota: %s\n", esp_err_to_name(ret));
+        return 1;
+    }
+    ESP_LOGI(TAG, "%s download_bytes=%u image_bytes=%u ratio=%u%% ms=%"PRIu32" ram_bytes=%u",
+             res.delta ? "delta" : "full", (unsigned)res.download_bytes, (unsigned)res.image_bytes,
+             res.image_bytes ? (unsigned)(res.download_bytes * 100 / res.image_bytes) : 0, res.ms,
+             (unsigned)res.ram_bytes);
+    ESP_LOGI(TAG, "ready, %s boots next", esp_ota_get_next_update_partition(NULL)->label);
+    if (argc == 3) {
+        esp_restart();
+    }
+    return 0;
+}
+
+esp_err_t app_ota_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "ota",
+        .help = "Update from a full image or a build_patch.js patch: ota <url> [reboot]",
+        .func = ota_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,62 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Patch layout, shared with build_patch.js: the header, then a zlib stream of records
+ * { u32 diff_len, u32 extra_len, i32 seek } each followed by diff_len bytes added to the
+ * old image at the old cursor, then extra_len bytes taken as they are. The old cursor
+ * moves by diff_len, then by seek. All integers are little endian. */
+#define APP_OTA_PATCH_MAGIC     (0x31504457)    /*!< "WDP1" */
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t old_size;              /*!< Bytes of the running image the patch applies to */
+    uint32_t new_size;
+    uint8_t old_sha256[32];
+    uint8_t new_sha256[32];
+} app_ota_patch_header_t;
+
+typedef struct {
+    bool delta;                     /*!< A patch was applied, rather than a full image written */
+    size_t download_bytes;
+    size_t image_bytes;             /*!< Size of the new image */
+    uint32_t ms;
+    size_t ram_bytes;               /*!< Working memory held during the update */
+} app_ota_result_t;
+
+/**
+ * @brief Download `url` into the inactive slot and boot it next time
+ *
+ * A body starting with APP_OTA_PATCH_MAGIC is a patch from build_patch.js against the
+ * running image. It is applied while it downloads, reading the old image from the running
+ * slot, so neither the patch nor the new image is ever held in RAM. Anything else is
+ * written as a full image.
+ */
+esp_err_t app_ota_update(const char *url, app_ota_result_t *result);
+
+/**
+ * @brief Log the running slot and accept it, so the bootloader does not roll back
+ *
+ * Call once the application came up healthy.
+ */
+void app_ota_confirm(void);
+
+/**
+ * @brief Add the "ota" console command
+ */
+esp_err_t app_ota_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,163 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "app_render.h"
+
+/* Name LVGL's FreeRTOS port gives every draw unit thread */
+#define LVGL_DRAW_THREAD_NAME   "lvglDraw"
+
+static const char *TAG = "render";
+
+typedef struct {
+    int64_t t_start;
+    uint32_t frames;
+    uint64_t sum_us;
+    uint32_t min_us;
+    uint32_t max_us;
+} render_bench_t;
+
+int app_render_lvgl_task_core(void)
+{
+#if CONFIG_APP_RESERVED_CORE >= 0
+    return !CONFIG_APP_RESERVED_CORE;
+#else
+    return CONFIG_APP_LVGL_TASK_CORE;
+#endif
+}
+
+int app_render_background_core(void)
+{
+#if CONFIG_APP_RESERVED_CORE >= 0
+    return CONFIG_APP_RESERVED_CORE;
+#else
+    return tskNO_AFFINITY;
+#endif
+}
+
+#if CONFIG_APP_LVGL_PIN_DRAW_UNITS
+/* LVGL creates its draw unit threads with plain xTaskCreate(). The component links with
+ * --wrap=xTaskCreate, so they land here and get spread over the cores we may use. */
+BaseType_t __wrap_xTaskCreate(TaskFunction_t code, const char *const name, const uint32_t stack_depth,
+                              void *const params, UBaseType_t priority, TaskHandle_t *const created_task)
+{
+    static int s_draw_units;
+    BaseType_t core = tskNO_AFFINITY;
+
+    if (name && strcmp(name, LVGL_DRAW_THREAD_NAME) == 0) {
+#if CONFIG_APP_RESERVED_CORE >= 0
+        core = !CONFIG_APP_RESERVED_CORE;
+#else
+        core = s_draw_units % portNUM_PROCESSORS;
+#endif
+        ESP_LOGI(TAG, "Draw unit %d pinned to core %d", s_draw_units, (int)core);
+        s_draw_units++;
+    }
+    return xTaskCreatePinnedToCore(code, name, stack_depth, params, priority, created_task, core);
+}
+#endif
+
+static void bench_disp_event_cb(lv_event_t *e)
+{
+    render_bench_t *bench = lv_event_get_user_data(e);
+    int64_t now = esp_timer_get_time();
+
+    if (lv_event_get_code(e) == LV_EVENT_RENDER_START) {
+        bench->t_start = now;
+    } else if (bench->t_start) {
+        uint32_t us = (uint32_t)(now - bench->t_start);
+        bench->frames++;
+        bench->sum_us += us;
+        bench->min_us = us < bench->min_us ? us : bench->min_us;
+        bench->max_us = us > bench->max_us ? us : bench->max_us;
+        bench->t_start = 0;
+    }
+}
+
+esp_err_t app_render_bench_frames(lv_display_t *disp, uint32_t frames, app_render_bench_frame_cb_t frame, void *arg,
+                                  app_render_bench_result_t *result)
+{
+    ESP_RETURN_ON_FALSE(disp && frames && frame && result, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    render_bench_t bench = {
+        .min_us = UINT32_MAX,
+    };
+    lv_display_add_event_cb(disp, bench_disp_event_cb, LV_EVENT_RENDER_START, &bench);
+    lv_display_add_event_cb(disp, bench_disp_event_cb, LV_EVENT_RENDER_READY, &bench);
+
+    int64_t t_begin = esp_timer_get_time();
+    for (uint32_t i = 0; i < frames; i++) {
+        frame(arg);
+        lv_refr_now(disp);
+    }
+    int64_t t_total = esp_timer_get_time() - t_begin;
+
+    lv_display_remove_event_cb_with_user_data(disp, bench_disp_event_cb, &bench);
+    ESP_RETURN_ON_FALSE(bench.frames, ESP_ERR_INVALID_STATE, TAG, "no frame was rendered");
+
+    *result = (app_render_bench_result_t) {
+        .frames = bench.frames,
+        .render_avg_us = (uint32_t)(bench.sum_us / bench.frames),
+        .render_min_us = bench.min_us,
+        .render_max_us = bench.max_us,
+        .frame_avg_us = (uint32_t)(t_total / frames),
+    };
+    return ESP_OK;
+}
+
+static void bench_invalidate_frame(void *arg)
+{
+    lv_obj_invalidate(lv_display_get_screen_active(arg));
+}
+
+typedef struct {
+    lv_obj_t *obj;
+    int32_t dy;
+} bench_scroll_t;
+
+static void bench_scroll_frame(void *arg)
+{
+    bench_scroll_t *scroll = arg;
+    /* A negative dy shows what is further down */
+    if (scroll->dy < 0 && lv_obj_get_scroll_bottom(scroll->obj) <= 0) {
+        scroll->dy = -scroll->dy;
+    } else if (scroll->dy > 0 && lv_obj_get_scroll_top(scroll->obj) <= 0) {
+        scroll->dy = -scroll->dy;
+    }
+    lv_obj_scroll_by_bounded(scroll->obj, 0, scroll->dy, LV_ANIM_OFF);
+}
+
+esp_err_t app_render_bench_full_redraw(lv_display_t *disp, uint32_t frames, app_render_bench_result_t *result)
+{
+    ESP_RETURN_ON_FALSE(disp && frames, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    app_render_bench_result_t res;
+    ESP_RETURN_ON_ERROR(app_render_bench_frames(disp, frames, bench_invalidate_frame, disp, &res), TAG, "bench failed");
+    ESP_LOGI(TAG, "full redraw units=%d frames=%"PRIu32" render_avg_us=%"PRIu32" render_min_us=%"PRIu32
+             " render_max_us=%"PRIu32" frame_avg_us=%"PRIu32" hotset=%d", CONFIG_LV_DRAW_SW_DRAW_UNIT_CNT, res.frames,
+             res.render_avg_us, res.render_min_us, res.render_max_us, res.frame_avg_us, APP_HOTSET_PLACED);
+    if (result) {
+        *result = res;
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_render_bench_scroll(lv_display_t *disp, lv_obj_t *obj, int32_t step, uint32_t frames,
+                                  app_render_bench_result_t *result)
+{
+    ESP_RETURN_ON_FALSE(disp && obj && step > 0 && frames && result, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    bench_scroll_t scroll = {
+        .obj = obj,
+        .dy = -step,
+    };
+    return app_render_bench_frames(disp, frames, bench_scroll_frame, &scroll, result);
+}
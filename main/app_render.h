@@ -0,0 +1,71 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t frames;
+    uint32_t render_avg_us;     /*!< LV_EVENT_RENDER_START to LV_EVENT_RENDER_READY */
+    uint32_t render_min_us;
+    uint32_t render_max_us;
+    uint32_t frame_avg_us;      /*!< Whole lv_refr_now(), including the flush */
+} app_render_bench_result_t;
+
+/**
+ * @brief Change what the next benchmark frame shows
+ */
+typedef void (*app_render_bench_frame_cb_t)(void *arg);
+
+/**
+ * @brief Core the LVGL task should be pinned to, -1 for no affinity
+ *
+ * Follows CONFIG_APP_RESERVED_CORE: when a core is kept for networking and sensors,
+ * the LVGL task and its draw units run on the other one.
+ */
+int app_render_lvgl_task_core(void);
+
+/**
+ * @brief Core for networking, sensor and bookkeeping tasks to be pinned to
+ *
+ * CONFIG_APP_RESERVED_CORE when a core is reserved, so that they stay off the render core,
+ * tskNO_AFFINITY otherwise.
+ */
+int app_render_background_core(void);
+
+/**
+ * @brief Redraw the whole screen `frames` times and measure render and frame time
+ *
+ * Must be called with the LVGL lock held. Logs one parseable line.
+ */
+esp_err_t app_render_bench_full_redraw(lv_display_t *disp, uint32_t frames, app_render_bench_result_t *result);
+
+/**
+ * @brief Call `frame` and render the display, `frames` times, and measure render and frame time
+ *
+ * Must be called with the LVGL lock held. Logs nothing.
+ */
+esp_err_t app_render_bench_frames(lv_display_t *disp, uint32_t frames, app_render_bench_frame_cb_t frame, void *arg,
+                                  app_render_bench_result_t *result);
+
+/**
+ * @brief Scroll `obj` by `step` pixels per frame for `frames` frames, turning around at either end,
+ *        and measure render and frame time
+ *
+ * Must be called with the LVGL lock held. Only the area the scroll invalidated is redrawn,
+ * as when dragged by a finger. Logs nothing, the caller reports what it compared.
+ */
+esp_err_t app_render_bench_scroll(lv_display_t *disp, lv_obj_t *obj, int32_t step, uint32_t frames,
+                                  app_render_bench_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
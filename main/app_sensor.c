@@ -0,0 +1,272 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "app_sensor.h"
+#include "app_trace.h"
+
+#define SENSOR_TASK_STACK       (3072)
+#define SENSOR_IDLE_WAIT_US     (1000 * 1000)
+#define SENSOR_MAX_LISTENERS    (4)
+
+static const char *TAG = "sensor";
+
+struct app_sensor_t {
+    const app_sensor_driver_t *driver;
+    int64_t deadline_us;            /* Next scheduled trigger */
+    int64_t ready_us;               /* Conversion done at, 0 while idle */
+    app_sensor_stats_t stats;
+};
+
+static struct {
+    struct app_sensor_t sensors[CONFIG_APP_SENSOR_MAX_SENSORS];
+    int count;
+    portMUX_TYPE lock;
+    TaskHandle_t task;
+    struct {
+        app_sensor_listener_t cb;
+        void *arg;
+    } listeners[SENSOR_MAX_LISTENERS];
+    int listener_count;
+} s_sched = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static void sensor_account(app_sensor_handle_t sensor, esp_err_t err, int64_t bus_us)
+{
+    portENTER_CRITICAL(&s_sched.lock);
+    sensor->stats.errors += err != ESP_OK;
+    sensor->stats.bus_us += bus_us;
+    portEXIT_CRITICAL(&s_sched.lock);
+}
+
+/* Idle sensor with the earliest deadline not later than `limit`, NULL if none */
+static app_sensor_handle_t sched_earliest_due(int count, int64_t limit)
+{
+    app_sensor_handle_t best = NULL;
+    for (int i = 0; i < count; i++) {
+        app_sensor_handle_t s = &s_sched.sensors[i];
+        if (!s->ready_us && s->deadline_us <= limit && (!best || s->deadline_us < best->deadline_us)) {
+            best = s;
+        }
+    }
+    return best;
+}
+
+/* Converting sensor finishing first, not later than `limit`, NULL if none */
+static app_sensor_handle_t sched_earliest_ready(int count, int64_t limit)
+{
+    app_sensor_handle_t best = NULL;
+    for (int i = 0; i < count; i++) {
+        app_sensor_handle_t s = &s_sched.sensors[i];
+        if (s->ready_us && s->ready_us <= limit && (!best || s->ready_us < best->ready_us)) {
+            best = s;
+        }
+    }
+    return best;
+}
+
+static void sched_trigger(app_sensor_handle_t sensor)
+{
+    const app_sensor_driver_t *drv = sensor->driver;
+    const int64_t period_us = (int64_t)drv->period_ms * 1000;
+    int64_t now = esp_timer_get_time();
+    uint32_t jitter = (uint32_t)llabs(now - sensor->deadline_us);
+    uint32_t skipped = 0;
+
+    /* Drop the periods we could not serve instead of bursting to catch up */
+    while (sensor->deadline_us + period_us <= now) {
+        sensor->deadline_us += period_us;
+        skipped++;
+    }
+    sensor->deadline_us += period_us;
+
+    esp_err_t err = drv->trigger ? drv->trigger(drv->ctx) : ESP_OK;
+    int64_t done = esp_timer_get_time();
+    if (err == ESP_OK) {
+        sensor->ready_us = MAX(done + (int64_t)drv->conversion_ms * 1000, 1);
+    } else {
+        ESP_LOGD(TAG, "%s trigger failed: %s", drv->name, esp_err_to_name(err));
+    }
+
+    portENTER_CRITICAL(&s_sched.lock);
+    sensor->stats.overruns += skipped;
+    sensor->stats.jitter_max_us = MAX(sensor->stats.jitter_max_us, jitter);
+    sensor->stats.jitter_sum_us += jitter;
+    portEXIT_CRITICAL(&s_sched.lock);
+    sensor_account(sensor, err, done - now);
+}
+
+static void sched_read(app_sensor_handle_t sensor)
+{
+    const app_sensor_driver_t *drv = sensor->driver;
+    app_sensor_reading_t reading = { 0 };
+
+    APP_TRACE_BEGIN(APP_TRACE_SENSOR_READ, 0);
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = drv->read(drv->ctx, &reading);
+    int64_t done = esp_timer_get_time();
+    APP_TRACE_END(APP_TRACE_SENSOR_READ, err);
+    sensor->ready_us = 0;
+    sensor_account(sensor, err, done - start);
+
+    if (err != ESP_OK) {
+        ESP_LOGD(TAG, "%s read failed: %s", drv->name, esp_err_to_name(err));
+        return;
+    }
+    portENTER_CRITICAL(&s_sched.lock);
+    sensor->stats.reads++;
+    portEXIT_CRITICAL(&s_sched.lock);
+
+    reading.timestamp_us = done;
+    portENTER_CRITICAL(&s_sched.lock);
+    int listeners = s_sched.listener_count;
+    portEXIT_CRITICAL(&s_sched.lock);
+    for (int i = 0; i < listeners; i++) {
+        s_sched.listeners[i].cb(sensor, &reading, s_sched.listeners[i].arg);
+    }
+}
+
+static void sched_task(void *arg)
+{
+    const int64_t coalesce_us = CONFIG_APP_SENSOR_COALESCE_MS * 1000;
+    int64_t next_log = esp_timer_get_time() + CONFIG_APP_SENSOR_STATS_PERIOD_S * 1000000LL;
+
+    while (1) {
+        portENTER_CRITICAL(&s_sched.lock);
+        int count = s_sched.count;
+        portEXIT_CRITICAL(&s_sched.lock);
+
+        int64_t now = esp_timer_get_time();
+        app_sensor_handle_t sensor;
+
+        /* Collect finished conversions first, they free the bus for the triggers below */
+        while ((sensor = sched_earliest_ready(count, now)) != NULL) {
+            sched_read(sensor);
+        }
+
+        /* Trigger everything falling due within the coalescing window in deadline order,
+         * so that their conversions run in parallel and share one wake-up */
+        now = esp_timer_get_time();
+        while ((sensor = sched_earliest_due(count, now + coalesce_us)) != NULL) {
+            sched_trigger(sensor);
+        }
+
+        now = esp_timer_get_time();
+        if (CONFIG_APP_SENSOR_STATS_PERIOD_S && now >= next_log) {
+            app_sensor_log_stats();
+            next_log = now + CONFIG_APP_SENSOR_STATS_PERIOD_S * 1000000LL;
+        }
+
+        /* Sleep until the next read or trigger, a registration wakes us early */
+        int64_t wake = now + SENSOR_IDLE_WAIT_US;
+        for (int i = 0; i < count; i++) {
+            sensor = &s_sched.sensors[i];
+            wake = MIN(wake, sensor->ready_us ? sensor->ready_us : sensor->deadline_us);
+        }
+        if (wake > now) {
+            /* Round up so we never wake before the conversion is done */
+            TickType_t ticks = (wake - now + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000);
+            ulTaskNotifyTake(pdTRUE, ticks);
+        }
+    }
+}
+
+esp_err_t app_sensor_scheduler_init(app_sensor_listener_t listener, void *arg)
+{
+    ESP_RETURN_ON_FALSE(!s_sched.task, ESP_ERR_INVALID_STATE, TAG, "scheduler already running");
+
+    if (listener) {
+        ESP_RETURN_ON_ERROR(app_sensor_add_listener(listener, arg), TAG, "add listener failed");
+    }
+    BaseType_t res = xTaskCreatePinnedToCore(sched_task, "sensors", SENSOR_TASK_STACK, NULL,
+                                             CONFIG_APP_SENSOR_TASK_PRIORITY, &s_sched.task,
+                                             CONFIG_APP_SENSOR_TASK_CORE < 0 ? tskNO_AFFINITY : CONFIG_APP_SENSOR_TASK_CORE);
+    ESP_RETURN_ON_FALSE(res == pdPASS, ESP_ERR_NO_MEM, TAG, "sensor task creation failed");
+    return ESP_OK;
+}
+
+esp_err_t app_sensor_register(const app_sensor_driver_t *driver, app_sensor_handle_t *ret_sensor)
+{
+    ESP_RETURN_ON_FALSE(driver && driver->read && driver->period_ms, ESP_ERR_INVALID_ARG, TAG, "invalid driver");
+
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    app_sensor_handle_t sensor = NULL;
+    portENTER_CRITICAL(&s_sched.lock);
+    if (s_sched.count < CONFIG_APP_SENSOR_MAX_SENSORS) {
+        sensor = &s_sched.sensors[s_sched.count];
+        memset(sensor, 0, sizeof(*sensor));
+        sensor->driver = driver;
+        sensor->deadline_us = esp_timer_get_time();
+        s_sched.count++;
+        ret = ESP_OK;
+    }
+    portEXIT_CRITICAL(&s_sched.lock);
+    ESP_RETURN_ON_ERROR(ret, TAG, "too many sensors, raise CONFIG_APP_SENSOR_MAX_SENSORS");
+
+    if (s_sched.task) {
+        xTaskNotifyGive(s_sched.task);
+    }
+    if (ret_sensor) {
+        *ret_sensor = sensor;
+    }
+    ESP_LOGI(TAG, "%s: every %"PRIu32" ms, conversion %"PRIu32" ms", driver->name, driver->period_ms,
+             driver->conversion_ms);
+    return ESP_OK;
+}
+
+esp_err_t app_sensor_add_listener(app_sensor_listener_t listener, void *arg)
+{
+    ESP_RETURN_ON_FALSE(listener, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&s_sched.lock);
+    if (s_sched.listener_count < SENSOR_MAX_LISTENERS) {
+        s_sched.listeners[s_sched.listener_count].cb = listener;
+        s_sched.listeners[s_sched.listener_count].arg = arg;
+        s_sched.listener_count++;
+        ret = ESP_OK;
+    }
+    portEXIT_CRITICAL(&s_sched.lock);
+    ESP_RETURN_ON_ERROR(ret, TAG, "too many listeners");
+    return ESP_OK;
+}
+
+const char *app_sensor_get_name(app_sensor_handle_t sensor)
+{
+    return sensor->driver->name;
+}
+
+esp_err_t app_sensor_get_stats(app_sensor_handle_t sensor, app_sensor_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(sensor && stats, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    portENTER_CRITICAL(&s_sched.lock);
+    *stats = sensor->stats;
+    memset(&sensor->stats, 0, sizeof(sensor->stats));
+    portEXIT_CRITICAL(&s_sched.lock);
+    return ESP_OK;
+}
+
+void app_sensor_log_stats(void)
+{
+    for (int i = 0; i < s_sched.count; i++) {
+        app_sensor_handle_t sensor = &s_sched.sensors[i];
+        app_sensor_stats_t st;
+        app_sensor_get_stats(sensor, &st);
+        uint32_t n = st.reads + st.errors;
+        ESP_LOGI(TAG, "%s: reads=%"PRIu32" err=%"PRIu32" overrun=%"PRIu32" jitter_avg=%"PRIu32" jitter_max=%"PRIu32
+                 " bus_us=%"PRIu64, sensor->driver->name, st.reads, st.errors, st.overruns,
+                 n ? (uint32_t)(st.jitter_sum_us / n) : 0, st.jitter_max_us, st.bus_us);
+    }
+}
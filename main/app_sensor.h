@@ -0,0 +1,108 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_SENSOR_MAX_CHANNELS     (3)
+
+typedef enum {
+    APP_SENSOR_TEMPERATURE = 0,     /*!< Degrees Celsius */
+    APP_SENSOR_HUMIDITY,            /*!< Percent relative humidity */
+    APP_SENSOR_PRESSURE,            /*!< Hectopascal */
+    APP_SENSOR_LIGHT,               /*!< Lux */
+    APP_SENSOR_AIR_QUALITY,         /*!< Index, higher is worse */
+    APP_SENSOR_QUANTITY_MAX,
+} app_sensor_quantity_t;
+
+typedef struct app_sensor_t *app_sensor_handle_t;
+
+/**
+ * @brief One sample, up to APP_SENSOR_MAX_CHANNELS quantities measured together
+ */
+typedef struct {
+    app_sensor_quantity_t quantity[APP_SENSOR_MAX_CHANNELS];
+    float value[APP_SENSOR_MAX_CHANNELS];
+    uint8_t channels;
+    int64_t timestamp_us;           /*!< Filled in by the scheduler */
+} app_sensor_reading_t;
+
+/**
+ * @brief Sensor plugin
+ *
+ * A read happens in two steps: `trigger` starts a conversion and `read` collects the
+ * result `conversion_ms` later. The scheduler overlaps the conversion waits of all
+ * sensors, so neither callback may sleep for the conversion itself.
+ */
+typedef struct {
+    const char *name;
+    uint32_t period_ms;             /*!< Sampling cadence */
+    uint32_t conversion_ms;         /*!< Delay between trigger and read */
+    esp_err_t (*trigger)(void *ctx);                                /*!< Start a conversion, may be NULL */
+    esp_err_t (*read)(void *ctx, app_sensor_reading_t *reading);    /*!< Fetch the converted values */
+    void *ctx;
+} app_sensor_driver_t;
+
+typedef struct {
+    uint32_t reads;                 /*!< Successful reads */
+    uint32_t errors;                /*!< Failed triggers or reads */
+    uint32_t overruns;              /*!< Periods skipped because the scheduler fell behind */
+    uint32_t jitter_max_us;         /*!< Largest trigger delay past the deadline */
+    uint64_t jitter_sum_us;         /*!< Sum of trigger delays */
+    uint64_t bus_us;                /*!< Time spent inside trigger and read */
+} app_sensor_stats_t;
+
+/**
+ * @brief Called from the scheduler task for every new reading, must not block
+ */
+typedef void (*app_sensor_listener_t)(app_sensor_handle_t sensor, const app_sensor_reading_t *reading, void *arg);
+
+/**
+ * @brief Start the scheduler task, `listener` may be NULL
+ */
+esp_err_t app_sensor_scheduler_init(app_sensor_listener_t listener, void *arg);
+
+/**
+ * @brief Also pass every reading to `listener`, listeners are called in the order they were added
+ */
+esp_err_t app_sensor_add_listener(app_sensor_listener_t listener, void *arg);
+
+/**
+ * @brief Add a sensor, its first read is due immediately
+ *
+ * `driver` must stay valid for the lifetime of the sensor.
+ */
+esp_err_t app_sensor_register(const app_sensor_driver_t *driver, app_sensor_handle_t *ret_sensor);
+
+/**
+ * @brief Name given by the driver
+ */
+const char *app_sensor_get_name(app_sensor_handle_t sensor);
+
+/**
+ * @brief Read statistics of one sensor and clear them
+ */
+esp_err_t app_sensor_get_stats(app_sensor_handle_t sensor, app_sensor_stats_t *stats);
+
+/**
+ * @brief Log the statistics of every sensor and clear them
+ */
+void app_sensor_log_stats(void);
+
+/**
+ * @brief Register simulated temperature/humidity, pressure, light and air quality sensors
+ *
+ * Each has its own cadence and conversion delay, for running without hardware.
+ */
+esp_err_t app_sensor_sim_register_all(void);
+
+#ifdef __cplusplus
+}
+#endif
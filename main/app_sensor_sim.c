@@ -0,0 +1,134 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "app_sensor.h"
+
+typedef struct {
+    app_sensor_quantity_t quantity[APP_SENSOR_MAX_CHANNELS];
+    float base[APP_SENSOR_MAX_CHANNELS];
+    float swing[APP_SENSOR_MAX_CHANNELS];
+    uint8_t channels;
+    uint32_t bus_us;            /* Busy time of one simulated bus transfer */
+    uint32_t day_s;             /* Length of one simulated day */
+    bool converting;
+} sim_sensor_t;
+
+static const char *TAG = "sensor_sim";
+
+static sim_sensor_t s_temp_hum = {
+    .quantity = { APP_SENSOR_TEMPERATURE, APP_SENSOR_HUMIDITY },
+    .base = { 22.0f, 55.0f },
+    .swing = { 6.0f, -15.0f },
+    .channels = 2,
+    .bus_us = 180,
+    .day_s = 600,
+};
+
+static sim_sensor_t s_pressure = {
+    .quantity = { APP_SENSOR_PRESSURE, APP_SENSOR_TEMPERATURE },
+    .base = { 1013.0f, 23.0f },
+    .swing = { 4.0f, 5.0f },
+    .channels = 2,
+    .bus_us = 250,
+    .day_s = 1800,
+};
+
+static sim_sensor_t s_light = {
+    .quantity = { APP_SENSOR_LIGHT },
+    .base = { 400.0f },
+    .swing = { 380.0f },
+    .channels = 1,
+    .bus_us = 90,
+    .day_s = 600,
+};
+
+static sim_sensor_t s_air = {
+    .quantity = { APP_SENSOR_AIR_QUALITY },
+    .base = { 60.0f },
+    .swing = { 30.0f },
+    .channels = 1,
+    .bus_us = 400,
+    .day_s = 300,
+};
+
+/* Hold the CPU like a blocking bus transfer would */
+static void sim_bus_busy(uint32_t us)
+{
+    int64_t end = esp_timer_get_time() + us;
+    while (esp_timer_get_time() < end) {
+    }
+}
+
+static esp_err_t sim_trigger(void *ctx)
+{
+    sim_sensor_t *sim = ctx;
+    ESP_RETURN_ON_FALSE(!sim->converting, ESP_ERR_INVALID_STATE, TAG, "conversion already running");
+    sim_bus_busy(sim->bus_us / 2);
+    sim->converting = true;
+    return ESP_OK;
+}
+
+static esp_err_t sim_read(void *ctx, app_sensor_reading_t *reading)
+{
+    sim_sensor_t *sim = ctx;
+    ESP_RETURN_ON_FALSE(sim->converting, ESP_ERR_INVALID_STATE, TAG, "read without trigger");
+    sim_bus_busy(sim->bus_us);
+    sim->converting = false;
+
+    float phase = 2.0f * (float)M_PI * (float)(esp_timer_get_time() / 1000000 % sim->day_s) / (float)sim->day_s;
+    for (int i = 0; i < sim->channels; i++) {
+        reading->quantity[i] = sim->quantity[i];
+        reading->value[i] = sim->base[i] + sim->swing[i] * sinf(phase);
+    }
+    reading->channels = sim->channels;
+    return ESP_OK;
+}
+
+static const app_sensor_driver_t s_sim_drivers[] = {
+    {
+        .name = "sim_temp_hum",
+        .period_ms = 2000,
+        .conversion_ms = 80,    /* AHT20 / SHT3x class */
+        .trigger = sim_trigger,
+        .read = sim_read,
+        .ctx = &s_temp_hum,
+    },
+    {
+        .name = "sim_pressure",
+        .period_ms = 5000,
+        .conversion_ms = 40,    /* BMP280 class, high resolution */
+        .trigger = sim_trigger,
+        .read = sim_read,
+        .ctx = &s_pressure,
+    },
+    {
+        .name = "sim_light",
+        .period_ms = 1000,
+        .conversion_ms = 120,   /* BH1750 class, high resolution mode */
+        .trigger = sim_trigger,
+        .read = sim_read,
+        .ctx = &s_light,
+    },
+    {
+        .name = "sim_air",
+        .period_ms = 10000,
+        .conversion_ms = 30,    /* SGP30 class */
+        .trigger = sim_trigger,
+        .read = sim_read,
+        .ctx = &s_air,
+    },
+};
+
+esp_err_t app_sensor_sim_register_all(void)
+{
+    for (int i = 0; i < sizeof(s_sim_drivers) / sizeof(s_sim_drivers[0]); i++) {
+        ESP_RETURN_ON_ERROR(app_sensor_register(&s_sim_drivers[i], NULL), TAG, "register %s failed",
+                            s_sim_drivers[i].name);
+    }
+    return ESP_OK;
+}
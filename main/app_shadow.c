@@ -0,0 +1,498 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_console.h"
+#include "app_render.h"
+#include "app_shadow.h"
+
+#define SHADOW_ENTRIES              (CONFIG_APP_SHADOW_CACHE_SIZE)
+#define SHADOW_STRIP                (32)    /* Length of the edge strips, tiled along the edges */
+
+static const char *TAG = "shadow";
+
+typedef enum {
+    SHADOW_TOP_LEFT,
+    SHADOW_TOP_RIGHT,
+    SHADOW_BOTTOM_LEFT,
+    SHADOW_BOTTOM_RIGHT,
+    SHADOW_TOP,
+    SHADOW_BOTTOM,
+    SHADOW_LEFT,
+    SHADOW_RIGHT,
+    SHADOW_PARTS,
+} shadow_part_t;
+
+/* The masks of one shadow width and corner radius. A corner is `corner` x `corner` pixels from
+ * the outer edge of the blur, so it holds the whole curve and the inner half of the blur */
+typedef struct shadow_entry {
+    uint16_t width;
+    uint16_t radius;
+    uint16_t corner;
+    uint32_t last_use;
+    uint8_t *buf;                   /* All parts, A8 */
+    size_t bytes;
+    lv_image_dsc_t part[SHADOW_PARTS];
+    struct shadow_entry *next;      /* In the retired list */
+} shadow_entry_t;
+
+/* What the shadow of an object needs to be drawn, from its style */
+typedef struct {
+    lv_area_t outer;                /* Shape moved and spread, grown by half the width */
+    int32_t width;
+    int32_t radius;                 /* Of the shape, at most half its short side */
+    lv_color_t color;
+    lv_opa_t opa;
+} shadow_geom_t;
+
+static struct {
+    shadow_entry_t *entries[SHADOW_ENTRIES];
+    shadow_entry_t *retired;        /* Evicted, freed once the frame that may draw them is done */
+    lv_display_t *disp;
+    uint32_t tick;
+    portMUX_TYPE stats_lock;
+    app_shadow_stats_t stats;
+    uint64_t build_sum_us;
+} s_shadow = {
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static void shadow_free(shadow_entry_t *entry)
+{
+    for (int i = 0; i < SHADOW_PARTS; i++) {
+        lv_image_cache_drop(&entry->part[i]);
+    }
+    heap_caps_free(entry->buf);
+    heap_caps_free(entry);
+}
+
+/* Draw tasks of the frame being built may still point at retired masks */
+static void shadow_refr_ready_cb(lv_event_t *e)
+{
+    while (s_shadow.retired) {
+        shadow_entry_t *entry = s_shadow.retired;
+        s_shadow.retired = entry->next;
+        shadow_free(entry);
+    }
+}
+
+/* Smoothstep over the blur, `sd` is the signed distance from the shape, negative inside */
+static uint8_t shadow_alpha(float sd, int32_t width)
+{
+    float t = 0.5f - sd / width;
+    if (t <= 0.0f) {
+        return 0;
+    }
+    if (t >= 1.0f) {
+        return LV_OPA_COVER;
+    }
+    return (uint8_t)lroundf(t * t * (3.0f - 2.0f * t) * LV_OPA_COVER);
+}
+
+static void shadow_set_part(shadow_entry_t *entry, shadow_part_t part, uint8_t *data, int32_t w, int32_t h)
+{
+    entry->part[part] = (lv_image_dsc_t) {
+        .header = {
+            .magic = LV_IMAGE_HEADER_MAGIC,
+            .cf = LV_COLOR_FORMAT_A8,
+            .w = w,
+            .h = h,
+            .stride = w,
+        },
+        .data_size = w * h,
+        .data = data,
+    };
+}
+
+static shadow_entry_t *shadow_build(int32_t width, int32_t radius)
+{
+    int64_t start = esp_timer_get_time();
+    int32_t half = (width + 1) / 2;
+    int32_t c = half + MAX(radius, half);
+    size_t corner_bytes = c * c;
+    size_t strip_bytes = SHADOW_STRIP * c;
+
+    shadow_entry_t *entry = heap_caps_calloc(1, sizeof(*entry), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!entry) {
+        return NULL;
+    }
+    entry->bytes = 4 * corner_bytes + 4 * strip_bytes;
+    entry->buf = heap_caps_malloc(entry->bytes, MALLOC_CAP_SPIRAM);
+    if (!entry->buf) {
+        heap_caps_free(entry);
+        ESP_LOGW(TAG, "no memory for a %"PRIi32" px shadow", width);
+        return NULL;
+    }
+    entry->width = width;
+    entry->radius = radius;
+    entry->corner = c;
+
+    uint8_t *tl = entry->buf;
+    uint8_t *tr = tl + corner_bytes;
+    uint8_t *bl = tr + corner_bytes;
+    uint8_t *br = bl + corner_bytes;
+    uint8_t *top = br + corner_bytes;
+    uint8_t *bottom = top + strip_bytes;
+    uint8_t *left = bottom + strip_bytes;
+    uint8_t *right = left + strip_bytes;
+
+    /* Top left corner around the centre of its arc, the others are mirrored from it */
+    float centre = half + radius;
+    for (int32_t y = 0; y < c; y++) {
+        float qy = centre - (y + 0.5f);
+        for (int32_t x = 0; x < c; x++) {
+            float qx = centre - (x + 0.5f);
+            float ox = MAX(qx, 0.0f);
+            float oy = MAX(qy, 0.0f);
+            float sd = sqrtf(ox * ox + oy * oy) + MIN(MAX(qx, qy), 0.0f) - radius;
+            uint8_t a = shadow_alpha(sd, width);
+            tl[y * c + x] = a;
+            tr[y * c + c - 1 - x] = a;
+            bl[(c - 1 - y) * c + x] = a;
+            br[(c - 1 - y) * c + c - 1 - x] = a;
+        }
+    }
+
+    /* Straight edges only fade across them */
+    for (int32_t i = 0; i < c; i++) {
+        uint8_t a = shadow_alpha(half - (i + 0.5f), width);
+        memset(top + i * SHADOW_STRIP, a, SHADOW_STRIP);
+        memset(bottom + (c - 1 - i) * SHADOW_STRIP, a, SHADOW_STRIP);
+        for (int32_t j = 0; j < SHADOW_STRIP; j++) {
+            left[j * c + i] = a;
+            right[j * c + c - 1 - i] = a;
+        }
+    }
+
+    shadow_set_part(entry, SHADOW_TOP_LEFT, tl, c, c);
+    shadow_set_part(entry, SHADOW_TOP_RIGHT, tr, c, c);
+    shadow_set_part(entry, SHADOW_BOTTOM_LEFT, bl, c, c);
+    shadow_set_part(entry, SHADOW_BOTTOM_RIGHT, br, c, c);
+    shadow_set_part(entry, SHADOW_TOP, top, SHADOW_STRIP, c);
+    shadow_set_part(entry, SHADOW_BOTTOM, bottom, SHADOW_STRIP, c);
+    shadow_set_part(entry, SHADOW_LEFT, left, c, SHADOW_STRIP);
+    shadow_set_part(entry, SHADOW_RIGHT, right, c, SHADOW_STRIP);
+
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+    portENTER_CRITICAL(&s_shadow.stats_lock);
+    s_shadow.stats.builds++;
+    s_shadow.build_sum_us += us;
+    s_shadow.stats.build_max_us = MAX(s_shadow.stats.build_max_us, us);
+    portEXIT_CRITICAL(&s_shadow.stats_lock);
+    return entry;
+}
+
+/* Cached masks for `width` and `radius`, built in the free or least recently used slot */
+static shadow_entry_t *shadow_lookup(int32_t width, int32_t radius)
+{
+    int slot = 0;
+    shadow_entry_t *found = NULL;
+    for (int i = 0; i < SHADOW_ENTRIES; i++) {
+        shadow_entry_t *entry = s_shadow.entries[i];
+        if (entry && entry->width == width && entry->radius == radius) {
+            found = entry;
+            break;
+        }
+        if (!entry || (s_shadow.entries[slot] && entry->last_use < s_shadow.entries[slot]->last_use)) {
+            slot = i;
+        }
+    }
+
+    portENTER_CRITICAL(&s_shadow.stats_lock);
+    s_shadow.stats.draws++;
+    s_shadow.stats.hits += found != NULL;
+    portEXIT_CRITICAL(&s_shadow.stats_lock);
+
+    if (!found) {
+        found = shadow_build(width, radius);
+        if (!found) {
+            return NULL;
+        }
+        shadow_entry_t *old = s_shadow.entries[slot];
+        if (old) {
+            old->next = s_shadow.retired;
+            s_shadow.retired = old;
+            portENTER_CRITICAL(&s_shadow.stats_lock);
+            s_shadow.stats.evictions++;
+            portEXIT_CRITICAL(&s_shadow.stats_lock);
+        }
+        s_shadow.entries[slot] = found;
+    }
+    found->last_use = ++s_shadow.tick;
+    return found;
+}
+
+static void shadow_geom(lv_obj_t *obj, lv_opa_t opa, shadow_geom_t *g)
+{
+    lv_area_t shape;
+    lv_obj_get_coords(obj, &shape);
+    int32_t spread = lv_obj_get_style_shadow_spread(obj, LV_PART_MAIN);
+    lv_area_increase(&shape, spread, spread);
+    lv_area_move(&shape, lv_obj_get_style_shadow_offset_x(obj, LV_PART_MAIN),
+                 lv_obj_get_style_shadow_offset_y(obj, LV_PART_MAIN));
+
+    int32_t short_side = MIN(lv_area_get_width(&shape), lv_area_get_height(&shape));
+    g->width = lv_obj_get_style_shadow_width(obj, LV_PART_MAIN);
+    g->radius = MIN(lv_obj_get_style_radius(obj, LV_PART_MAIN), short_side / 2);
+    g->color = lv_obj_get_style_shadow_color(obj, LV_PART_MAIN);
+    g->opa = LV_OPA_MIX2(opa, lv_obj_get_style_opa_recursive(obj, LV_PART_MAIN));
+    g->outer = shape;
+    lv_area_increase(&g->outer, (g->width + 1) / 2, (g->width + 1) / 2);
+}
+
+static void shadow_draw_part(lv_layer_t *layer, lv_draw_image_dsc_t *dsc, const lv_image_dsc_t *part,
+                             int32_t x1, int32_t y1, int32_t x2, int32_t y2)
+{
+    if (x2 < x1 || y2 < y1) {
+        return;
+    }
+    lv_area_t area = { x1, y1, x2, y2 };
+    dsc->src = part;
+    lv_draw_image(layer, dsc, &area);
+}
+
+/* With a blur wider than the shape the inner halves of opposite edges overlap, LVGL handles that */
+static void shadow_draw_fallback(lv_obj_t *obj, lv_layer_t *layer, lv_opa_t opa)
+{
+    lv_draw_rect_dsc_t dsc;
+    lv_draw_rect_dsc_init(&dsc);
+    dsc.bg_opa = LV_OPA_TRANSP;
+    dsc.border_opa = LV_OPA_TRANSP;
+    dsc.outline_opa = LV_OPA_TRANSP;
+    dsc.radius = lv_obj_get_style_radius(obj, LV_PART_MAIN);
+    dsc.shadow_width = lv_obj_get_style_shadow_width(obj, LV_PART_MAIN);
+    dsc.shadow_spread = lv_obj_get_style_shadow_spread(obj, LV_PART_MAIN);
+    dsc.shadow_offset_x = lv_obj_get_style_shadow_offset_x(obj, LV_PART_MAIN);
+    dsc.shadow_offset_y = lv_obj_get_style_shadow_offset_y(obj, LV_PART_MAIN);
+    dsc.shadow_color = lv_obj_get_style_shadow_color(obj, LV_PART_MAIN);
+    dsc.shadow_opa = LV_OPA_MIX2(opa, lv_obj_get_style_opa_recursive(obj, LV_PART_MAIN));
+    lv_area_t coords;
+    lv_obj_get_coords(obj, &coords);
+    lv_draw_rect(layer, &dsc, &coords);
+
+    portENTER_CRITICAL(&s_shadow.stats_lock);
+    s_shadow.stats.fallbacks++;
+    portEXIT_CRITICAL(&s_shadow.stats_lock);
+}
+
+/* Under the object's own background, which LVGL draws next */
+static void shadow_draw_cb(lv_event_t *e)
+{
+    lv_obj_t *obj = lv_event_get_target(e);
+    lv_layer_t *layer = lv_event_get_layer(e);
+    lv_opa_t opa = (lv_opa_t)(uintptr_t)lv_event_get_user_data(e);
+
+    shadow_geom_t g;
+    shadow_geom(obj, opa, &g);
+    if (g.width == 0 || g.opa <= LV_OPA_MIN) {
+        return;
+    }
+    int32_t half = (g.width + 1) / 2;
+    int32_t c = half + MAX(g.radius, half);
+    if (g.width < 2 || 2 * c > MIN(lv_area_get_width(&g.outer), lv_area_get_height(&g.outer))) {
+        shadow_draw_fallback(obj, layer, opa);
+        return;
+    }
+    shadow_entry_t *entry = shadow_lookup(g.width, g.radius);
+    if (!entry) {
+        shadow_draw_fallback(obj, layer, opa);
+        return;
+    }
+
+    lv_draw_image_dsc_t dsc;
+    lv_draw_image_dsc_init(&dsc);
+    dsc.recolor = g.color;
+    dsc.recolor_opa = LV_OPA_COVER;
+    dsc.opa = g.opa;
+    const lv_area_t *o = &g.outer;
+    const lv_image_dsc_t *part = entry->part;
+
+    shadow_draw_part(layer, &dsc, &part[SHADOW_TOP_LEFT], o->x1, o->y1, o->x1 + c - 1, o->y1 + c - 1);
+    shadow_draw_part(layer, &dsc, &part[SHADOW_TOP_RIGHT], o->x2 - c + 1, o->y1, o->x2, o->y1 + c - 1);
+    shadow_draw_part(layer, &dsc, &part[SHADOW_BOTTOM_LEFT], o->x1, o->y2 - c + 1, o->x1 + c - 1, o->y2);
+    shadow_draw_part(layer, &dsc, &part[SHADOW_BOTTOM_RIGHT], o->x2 - c + 1, o->y2 - c + 1, o->x2, o->y2);
+    dsc.tile = 1;
+    shadow_draw_part(layer, &dsc, &part[SHADOW_TOP], o->x1 + c, o->y1, o->x2 - c, o->y1 + c - 1);
+    shadow_draw_part(layer, &dsc, &part[SHADOW_BOTTOM], o->x1 + c, o->y2 - c + 1, o->x2 - c, o->y2);
+    shadow_draw_part(layer, &dsc, &part[SHADOW_LEFT], o->x1, o->y1 + c, o->x1 + c - 1, o->y2 - c);
+    shadow_draw_part(layer, &dsc, &part[SHADOW_RIGHT], o->x2 - c + 1, o->y1 + c, o->x2, o->y2 - c);
+
+    /* The inside is flat, and usually hidden by an opaque background anyway */
+    lv_area_t inside = { o->x1 + c, o->y1 + c, o->x2 - c, o->y2 - c };
+    lv_area_t coords;
+    lv_obj_get_coords(obj, &coords);
+    bool covered = lv_obj_get_style_bg_opa(obj, LV_PART_MAIN) >= LV_OPA_MAX &&
+                   lv_area_is_in(&inside, &coords, lv_obj_get_style_radius(obj, LV_PART_MAIN));
+    if (!covered && inside.x2 >= inside.x1 && inside.y2 >= inside.y1) {
+        lv_draw_rect_dsc_t fill;
+        lv_draw_rect_dsc_init(&fill);
+        fill.bg_color = g.color;
+        fill.bg_opa = g.opa;
+        lv_draw_rect(layer, &fill, &inside);
+    }
+}
+
+static void shadow_ext_draw_size_cb(lv_event_t *e)
+{
+    lv_obj_t *obj = lv_event_get_target(e);
+    int32_t width = lv_obj_get_style_shadow_width(obj, LV_PART_MAIN);
+    if (width == 0) {
+        return;
+    }
+    int32_t ofs = MAX(LV_ABS(lv_obj_get_style_shadow_offset_x(obj, LV_PART_MAIN)),
+                      LV_ABS(lv_obj_get_style_shadow_offset_y(obj, LV_PART_MAIN)));
+    lv_event_set_ext_draw_size(e, width / 2 + 1 + lv_obj_get_style_shadow_spread(obj, LV_PART_MAIN) + ofs);
+}
+
+void app_shadow_attach(lv_obj_t *obj)
+{
+    lv_opa_t opa = lv_obj_get_style_shadow_opa(obj, LV_PART_MAIN);
+    if (lv_obj_get_style_shadow_width(obj, LV_PART_MAIN) == 0 || opa <= LV_OPA_MIN) {
+        return;
+    }
+    if (!s_shadow.disp) {
+        s_shadow.disp = lv_obj_get_display(obj);
+        lv_display_add_event_cb(s_shadow.disp, shadow_refr_ready_cb, LV_EVENT_REFR_READY, NULL);
+    }
+
+    /* LVGL skips a transparent shadow and leaves its extra draw area to the callback below */
+    lv_obj_set_style_shadow_opa(obj, LV_OPA_TRANSP, 0);
+    lv_obj_add_event_cb(obj, shadow_draw_cb, LV_EVENT_DRAW_MAIN_BEGIN, (void *)(uintptr_t)opa);
+    lv_obj_add_event_cb(obj, shadow_ext_draw_size_cb, LV_EVENT_REFR_EXT_DRAW_SIZE, NULL);
+    lv_obj_refresh_ext_draw_size(obj);
+}
+
+void app_shadow_get_stats(app_shadow_stats_t *stats)
+{
+    uint32_t entries = 0;
+    size_t bytes = 0;
+    for (int i = 0; i < SHADOW_ENTRIES; i++) {
+        if (s_shadow.entries[i]) {
+            entries++;
+            bytes += s_shadow.entries[i]->bytes;
+        }
+    }
+    portENTER_CRITICAL(&s_shadow.stats_lock);
+    *stats = s_shadow.stats;
+    stats->build_avg_us = stats->builds ? (uint32_t)(s_shadow.build_sum_us / stats->builds) : 0;
+    memset(&s_shadow.stats, 0, sizeof(s_shadow.stats));
+    s_shadow.build_sum_us = 0;
+    portEXIT_CRITICAL(&s_shadow.stats_lock);
+    stats->entries = entries;
+    stats->cached_bytes = bytes;
+}
+
+/* A typical dashboard: two rows of shadowed cards and a dialog on top */
+#define SHADOW_BENCH_COLS           (4)
+#define SHADOW_BENCH_ROWS           (2)
+
+static void shadow_bench_style(lv_obj_t *obj, int32_t radius, int32_t width, int32_t spread, int32_t ofs_y)
+{
+    lv_obj_set_style_radius(obj, radius, 0);
+    lv_obj_set_style_shadow_width(obj, width, 0);
+    lv_obj_set_style_shadow_spread(obj, spread, 0);
+    lv_obj_set_style_shadow_offset_y(obj, ofs_y, 0);
+    lv_obj_set_style_shadow_opa(obj, LV_OPA_40, 0);
+    lv_obj_set_style_shadow_color(obj, lv_color_black(), 0);
+}
+
+static void shadow_bench_build(lv_obj_t *screen, bool cached)
+{
+    int32_t w = lv_obj_get_width(screen);
+    int32_t h = lv_obj_get_height(screen);
+    int32_t card_w = (w - 40) / SHADOW_BENCH_COLS - 20;
+    int32_t card_h = (h - 40) / SHADOW_BENCH_ROWS - 20;
+    for (int r = 0; r < SHADOW_BENCH_ROWS; r++) {
+        for (int c = 0; c < SHADOW_BENCH_COLS; c++) {
+            lv_obj_t *card = lv_obj_create(screen);
+            lv_obj_remove_flag(card, LV_OBJ_FLAG_SCROLLABLE);
+            lv_obj_set_size(card, card_w, card_h);
+            lv_obj_set_pos(card, 30 + c * (card_w + 20), 30 + r * (card_h + 20));
+            shadow_bench_style(card, 12, 24, 0, 6);
+            lv_label_set_text_fmt(lv_label_create(card), "Card %d", r * SHADOW_BENCH_COLS + c + 1);
+            if (cached) {
+                app_shadow_attach(card);
+            }
+        }
+    }
+    /* Like the login dialog of demo_widget() */
+    lv_obj_t *dialog = lv_obj_create(screen);
+    lv_obj_remove_flag(dialog, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_size(dialog, 300, 200);
+    lv_obj_center(dialog);
+    shadow_bench_style(dialog, 16, 30, 2, 8);
+    if (cached) {
+        app_shadow_attach(dialog);
+    }
+}
+
+/* Full refresh redraws everything anyway, this keeps it so with partial refresh too */
+static void shadow_bench_frame(void *arg)
+{
+    lv_obj_invalidate(arg);
+}
+
+esp_err_t app_shadow_bench(lv_display_t *disp, uint32_t frames)
+{
+    ESP_RETURN_ON_FALSE(disp && frames, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    lv_obj_t *prev = lv_display_get_screen_active(disp);
+    esp_err_t ret = ESP_OK;
+    app_shadow_stats_t st;
+
+    for (int cached = 0; cached < 2 && ret == ESP_OK; cached++) {
+        lv_obj_t *screen = lv_obj_create(NULL);
+        lv_screen_load(screen);
+        app_shadow_get_stats(&st);
+        shadow_bench_build(screen, cached);
+        lv_refr_now(disp);
+
+        app_render_bench_result_t res;
+        ret = app_render_bench_frames(disp, frames, shadow_bench_frame, screen, &res);
+        app_shadow_get_stats(&st);
+        if (ret == ESP_OK) {
+            ESP_LOGI(TAG, "bench %s cards=%d frames=%"PRIu32" render_avg_us=%"PRIu32" render_max_us=%"PRIu32
+                     " frame_avg_us=%"PRIu32" draws=%"PRIu32" hits=%"PRIu32" builds=%"PRIu32" cached_bytes=%u",
+                     cached ? "cached" : "lvgl", SHADOW_BENCH_COLS * SHADOW_BENCH_ROWS + 1, res.frames,
+                     res.render_avg_us, res.render_max_us, res.frame_avg_us, st.draws, st.hits, st.builds,
+                     (unsigned)st.cached_bytes);
+        }
+        lv_screen_load(prev);
+        lv_obj_delete(screen);
+    }
+    lv_obj_invalidate(prev);
+    return ret;
+}
+
+static int shadow_cmd(int argc, char **argv)
+{
+    app_shadow_stats_t st;
+    app_shadow_get_stats(&st);
+    printf("shadow: draws=%" PRIu32 " hits=%" PRIu32 " hit_pct=%" PRIu32 " builds=%" PRIu32 " build_avg_us=%" PRIu32
+           " build_max_us=%" PRIu32 " evictions=%" PRIu32 " fallbacks=%" PRIu32 " entries=%" PRIu32
+           " cached_bytes=%u\n",
+           st.draws, st.hits, st.draws ? st.hits * 100 / st.draws : 0, st.builds, st.build_avg_us,
+           st.build_max_us, st.evictions, st.fallbacks, st.entries, (unsigned)st.cached_bytes);
+    return 0;
+}
+
+esp_err_t app_shadow_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "shadow",
+        .help = "Show the shadow mask cache hit rate and build time since the last call",
+        .func = shadow_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
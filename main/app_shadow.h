@@ -0,0 +1,60 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t draws;                 /*!< Shadows drawn from the cache */
+    uint32_t hits;                  /*!< Of those, masks already built */
+    uint32_t builds;
+    uint32_t build_avg_us;          /*!< Per entry, corners and edge strips */
+    uint32_t build_max_us;
+    uint32_t evictions;
+    uint32_t fallbacks;             /*!< Shadows too thin or too wide for their object, drawn by LVGL */
+    uint32_t entries;               /*!< Held now */
+    size_t cached_bytes;
+} app_shadow_stats_t;
+
+/**
+ * @brief Draw the shadow of `obj` from cached masks instead of having LVGL blur it every frame
+ *
+ * The shadow is cut into four corners and four edge strips that only depend on the shadow width
+ * and the corner radius, so objects of any size and spread with the same two share them. The
+ * strips are tiled along the edges and the inside is a plain fill. The shadow opacity of `obj`
+ * is taken over, so attach after styling it. Does nothing for objects without a shadow. Must be
+ * called with the LVGL lock held.
+ */
+void app_shadow_attach(lv_obj_t *obj);
+
+/**
+ * @brief Read the cache counters and clear them
+ */
+void app_shadow_get_stats(app_shadow_stats_t *stats);
+
+/**
+ * @brief Compare LVGL's shadows against the cached ones on a screen of shadowed cards
+ *
+ * The same cards and dialog are built on a screen of their own once with LVGL's shadows and
+ * once attached, then redrawn for `frames` frames. Logs one parseable line per variant with
+ * its render time. Must be called with the LVGL lock held.
+ */
+esp_err_t app_shadow_bench(lv_display_t *disp, uint32_t frames);
+
+/**
+ * @brief Add the "shadow" console command
+ */
+esp_err_t app_shadow_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,285 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_partition.h"
+#include "esp_crc.h"
+#include "app_spool.h"
+
+#define SPOOL_PARTITION_SUBTYPE     (0x41)
+#define SPOOL_PARTITION_LABEL       "spool"
+#define SPOOL_MAGIC                 (0x5354)        /* "TS" */
+#define SPOOL_STATE_PENDING         (0xFF)
+#define SPOOL_STATE_SENT            (0x00)          /* Cleared in place, no erase needed */
+
+static const char *TAG = "spool";
+
+/* Every record starts on a 4 byte boundary and never crosses a sector */
+typedef struct {
+    uint16_t magic;
+    uint16_t len;
+    uint32_t seq;
+    uint32_t crc;                   /* esp_crc32_le() of the data */
+    uint8_t state;
+    uint8_t reserved[3];
+} spool_header_t;
+
+static struct {
+    const esp_partition_t *part;
+    uint32_t sector;
+    uint32_t head;                  /* Where the next record goes */
+    uint32_t tail;                  /* Oldest pending record, head when none */
+    uint32_t cursor;                /* Next record app_spool_read_next() looks at */
+    uint32_t pending;
+    size_t pending_bytes;
+    uint32_t dropped;
+    uint32_t next_seq;
+} s_spool;
+
+static uint32_t spool_record_size(size_t len)
+{
+    return sizeof(spool_header_t) + ((len + 3) & ~3);
+}
+
+static uint32_t spool_next_sector(uint32_t off)
+{
+    return (off / s_spool.sector + 1) * s_spool.sector % s_spool.part->size;
+}
+
+/* Move past the end of a sector that has no room left for a header */
+static uint32_t spool_normalize(uint32_t off)
+{
+    if (off >= s_spool.part->size) {
+        return 0;
+    }
+    if (s_spool.sector - off % s_spool.sector < sizeof(spool_header_t) + 4) {
+        return spool_next_sector(off);
+    }
+    return off;
+}
+
+/* False for erased flash and torn headers, the rest of the sector is then unused */
+static bool spool_read_header(uint32_t off, spool_header_t *hdr)
+{
+    if (esp_partition_read(s_spool.part, off, hdr, sizeof(*hdr)) != ESP_OK) {
+        return false;
+    }
+    return hdr->magic == SPOOL_MAGIC && off % s_spool.sector + spool_record_size(hdr->len) <= s_spool.sector;
+}
+
+static uint32_t spool_step(uint32_t off, const spool_header_t *hdr)
+{
+    return spool_normalize(off + spool_record_size(hdr->len));
+}
+
+static void spool_advance_tail(void)
+{
+    if (!s_spool.pending) {
+        s_spool.tail = s_spool.cursor = s_spool.head;
+        return;
+    }
+    while (s_spool.tail != s_spool.head) {
+        spool_header_t hdr;
+        if (!spool_read_header(s_spool.tail, &hdr)) {
+            s_spool.tail = spool_next_sector(s_spool.tail);
+        } else if (hdr.state == SPOOL_STATE_PENDING) {
+            break;
+        } else {
+            s_spool.tail = spool_step(s_spool.tail, &hdr);
+        }
+    }
+}
+
+static void spool_forget(uint32_t off, const spool_header_t *hdr)
+{
+    const uint8_t sent = SPOOL_STATE_SENT;
+    esp_partition_write(s_spool.part, off + offsetof(spool_header_t, state), &sent, 1);
+    s_spool.pending--;
+    s_spool.pending_bytes -= hdr->len;
+}
+
+/* The ring wrapped onto the sector at `off`: drop what is still pending there, then erase it */
+static esp_err_t spool_take_sector(uint32_t off)
+{
+    if (s_spool.pending && s_spool.tail / s_spool.sector == off / s_spool.sector) {
+        uint32_t pos = s_spool.tail;
+        uint32_t dropped = 0;
+        spool_header_t hdr;
+        while (pos / s_spool.sector == off / s_spool.sector && spool_read_header(pos, &hdr)) {
+            if (hdr.state == SPOOL_STATE_PENDING) {
+                s_spool.pending--;
+                s_spool.pending_bytes -= hdr.len;
+                dropped++;
+            }
+            pos = spool_step(pos, &hdr);
+        }
+        s_spool.dropped += dropped;
+        ESP_LOGW(TAG, "spool full, dropped %" PRIu32 " oldest records", dropped);
+
+        bool cursor_in_sector = s_spool.cursor / s_spool.sector == off / s_spool.sector;
+        s_spool.tail = spool_next_sector(off);
+        if (cursor_in_sector) {
+            s_spool.cursor = s_spool.tail;
+        }
+        spool_advance_tail();
+    }
+    return esp_partition_erase_range(s_spool.part, off, s_spool.sector);
+}
+
+esp_err_t app_spool_init(void)
+{
+    s_spool.part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, SPOOL_PARTITION_SUBTYPE, SPOOL_PARTITION_LABEL);
+    ESP_RETURN_ON_FALSE(s_spool.part, ESP_ERR_NOT_FOUND, TAG, "no %s partition", SPOOL_PARTITION_LABEL);
+    s_spool.sector = s_spool.part->erase_size;
+
+    /* The newest record tells where to go on, the oldest pending one where to resume sending */
+    bool any = false;
+    uint32_t newest_off = 0;
+    uint32_t newest_seq = 0;
+    uint32_t oldest_pending_seq = UINT32_MAX;
+    for (uint32_t sector = 0; sector < s_spool.part->size; sector += s_spool.sector) {
+        uint32_t off = sector;
+        spool_header_t hdr;
+        while (off - sector + sizeof(hdr) <= s_spool.sector && spool_read_header(off, &hdr)) {
+            if (!any || hdr.seq > newest_seq) {
+                newest_seq = hdr.seq;
+                newest_off = off;
+            }
+            if (hdr.state == SPOOL_STATE_PENDING) {
+                s_spool.pending++;
+                s_spool.pending_bytes += hdr.len;
+                if (hdr.seq < oldest_pending_seq) {
+                    oldest_pending_seq = hdr.seq;
+                    s_spool.tail = off;
+                }
+            }
+            any = true;
+            off += spool_record_size(hdr.len);
+        }
+    }
+
+    /* The rest of the newest sector may hold a torn write, so start on a fresh one */
+    s_spool.head = any ? spool_next_sector(newest_off) : 0;
+    s_spool.next_seq = any ? newest_seq + 1 : 0;
+    if (!s_spool.pending) {
+        s_spool.tail = s_spool.head;
+    }
+    s_spool.cursor = s_spool.tail;
+    ESP_LOGI(TAG, "size=%" PRIu32 " pending=%" PRIu32 " bytes=%u next_seq=%" PRIu32,
+             s_spool.part->size, s_spool.pending, (unsigned)s_spool.pending_bytes, s_spool.next_seq);
+    return ESP_OK;
+}
+
+esp_err_t app_spool_append(const void *data, size_t len, app_spool_record_t *record)
+{
+    ESP_RETURN_ON_FALSE(s_spool.part, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    ESP_RETURN_ON_FALSE(data && len && spool_record_size(len) <= s_spool.sector, ESP_ERR_INVALID_SIZE, TAG,
+                        "record of %u bytes does not fit a sector", (unsigned)len);
+
+    uint32_t off = s_spool.head;
+    if (off % s_spool.sector + spool_record_size(len) > s_spool.sector) {
+        off = spool_next_sector(off);
+    }
+    if (off % s_spool.sector == 0) {
+        ESP_RETURN_ON_ERROR(spool_take_sector(off), TAG, "erase failed");
+    }
+
+    /* The header goes last, so an interrupted write leaves no valid record behind */
+    spool_header_t hdr = {
+        .magic = SPOOL_MAGIC,
+        .len = len,
+        .seq = s_spool.next_seq,
+        .crc = esp_crc32_le(0, data, len),
+        .state = SPOOL_STATE_PENDING,
+        .reserved = { 0xFF, 0xFF, 0xFF },
+    };
+    ESP_RETURN_ON_ERROR(esp_partition_write(s_spool.part, off + sizeof(hdr), data, len), TAG, "write failed");
+    ESP_RETURN_ON_ERROR(esp_partition_write(s_spool.part, off, &hdr, sizeof(hdr)), TAG, "write failed");
+
+    if (!s_spool.pending) {
+        s_spool.tail = s_spool.cursor = off;
+    }
+    s_spool.head = spool_step(off, &hdr);
+    s_spool.pending++;
+    s_spool.pending_bytes += len;
+    s_spool.next_seq++;
+    if (record) {
+        *record = (app_spool_record_t) {
+            .offset = off,
+            .seq = hdr.seq,
+        };
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_spool_read_next(void *buf, size_t size, size_t *len, app_spool_record_t *record)
+{
+    ESP_RETURN_ON_FALSE(s_spool.part, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+
+    while (s_spool.pending && s_spool.cursor != s_spool.head) {
+        uint32_t off = s_spool.cursor;
+        spool_header_t hdr;
+        if (!spool_read_header(off, &hdr)) {
+            s_spool.cursor = spool_next_sector(off);
+            continue;
+        }
+        s_spool.cursor = spool_step(off, &hdr);
+        if (hdr.state != SPOOL_STATE_PENDING) {
+            continue;
+        }
+        if (hdr.len > size || esp_partition_read(s_spool.part, off + sizeof(hdr), buf, hdr.len) != ESP_OK ||
+                esp_crc32_le(0, buf, hdr.len) != hdr.crc) {
+            ESP_LOGW(TAG, "discarding corrupt record seq=%" PRIu32, hdr.seq);
+            spool_forget(off, &hdr);
+            spool_advance_tail();
+            continue;
+        }
+        *len = hdr.len;
+        *record = (app_spool_record_t) {
+            .offset = off,
+            .seq = hdr.seq,
+        };
+        return ESP_OK;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t app_spool_mark_sent(const app_spool_record_t *record)
+{
+    ESP_RETURN_ON_FALSE(s_spool.part, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+
+    spool_header_t hdr;
+    if (!spool_read_header(record->offset, &hdr) || hdr.seq != record->seq || hdr.state != SPOOL_STATE_PENDING) {
+        return ESP_OK;      /* Dropped, or sent twice */
+    }
+    spool_forget(record->offset, &hdr);
+    spool_advance_tail();
+    return ESP_OK;
+}
+
+void app_spool_rewind(void)
+{
+    s_spool.cursor = s_spool.tail;
+}
+
+uint32_t app_spool_next_seq(void)
+{
+    return s_spool.next_seq;
+}
+
+void app_spool_get_info(app_spool_info_t *info)
+{
+    *info = (app_spool_info_t) {
+        .pending = s_spool.pending,
+        .pending_bytes = s_spool.pending_bytes,
+        .capacity = s_spool.part ? s_spool.part->size : 0,
+        .dropped = s_spool.dropped,
+        .next_seq = s_spool.next_seq,
+    };
+}
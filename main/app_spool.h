@@ -0,0 +1,76 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Where a record lives, the sequence number tells it from a later record at the same offset
+ */
+typedef struct {
+    uint32_t offset;
+    uint32_t seq;
+} app_spool_record_t;
+
+typedef struct {
+    uint32_t pending;               /*!< Records appended and not marked sent */
+    size_t pending_bytes;
+    size_t capacity;                /*!< Partition size */
+    uint32_t dropped;               /*!< Pending records erased to make room, since boot */
+    uint32_t next_seq;              /*!< Sequence number of the next record */
+} app_spool_info_t;
+
+/**
+ * @brief Open the "spool" partition and find the records left pending by earlier boots
+ *
+ * The spool is a ring of records in flash. Each record is written once and flagged sent
+ * later by clearing one byte, so a record is only erased with its whole sector once the
+ * ring wraps around. When it wraps onto pending records, the oldest sector is dropped.
+ * Only one task may use the spool.
+ */
+esp_err_t app_spool_init(void);
+
+/**
+ * @brief Append `len` bytes as one record
+ *
+ * @return ESP_ERR_INVALID_SIZE when the record does not fit in one flash sector
+ */
+esp_err_t app_spool_append(const void *data, size_t len, app_spool_record_t *record);
+
+/**
+ * @brief Read the oldest pending record not handed out since the last app_spool_rewind()
+ *
+ * @return ESP_ERR_NOT_FOUND when every pending record was handed out
+ */
+esp_err_t app_spool_read_next(void *buf, size_t size, size_t *len, app_spool_record_t *record);
+
+/**
+ * @brief Flag a record sent, so it is neither handed out again nor kept after a reboot
+ *
+ * A record that was dropped in the meantime is ignored.
+ */
+esp_err_t app_spool_mark_sent(const app_spool_record_t *record);
+
+/**
+ * @brief Hand out the pending records again, starting from the oldest
+ */
+void app_spool_rewind(void);
+
+/**
+ * @brief Sequence number the next record gets, increasing across reboots while the spool holds records
+ */
+uint32_t app_spool_next_seq(void);
+
+void app_spool_get_info(app_spool_info_t *info);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,249 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_console.h"
+#include "app_render.h"
+#include "app_taskmon.h"
+
+#define TASKMON_TASK_STACK      (3072)
+#define TASKMON_PROBE_STACK     (2048)
+
+static const char *TAG = "taskmon";
+
+typedef struct {
+    TaskHandle_t task;
+    volatile int64_t t_wake;        /* Set by the timer right before the notification */
+    uint32_t samples;
+    uint64_t sum_us;
+    uint32_t max_us;
+} taskmon_probe_t;
+
+static struct {
+    TaskStatus_t *status;           /* Scratch for uxTaskGetSystemState() */
+    TaskHandle_t prev_task[CONFIG_APP_TASKMON_MAX_TASKS];
+    configRUN_TIME_COUNTER_TYPE prev_runtime[CONFIG_APP_TASKMON_MAX_TASKS];
+    size_t prev_count;
+    configRUN_TIME_COUNTER_TYPE prev_total;
+    int64_t prev_time_us;
+    taskmon_probe_t probes[portNUM_PROCESSORS];
+    esp_timer_handle_t probe_timer;
+    app_taskmon_summary_t summary;  /* Last complete window, under lock */
+    portMUX_TYPE lock;
+} s_mon = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static void probe_timer_cb(void *arg)
+{
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        s_mon.probes[core].t_wake = esp_timer_get_time();
+        xTaskNotifyGive(s_mon.probes[core].task);
+    }
+}
+
+static void probe_task(void *arg)
+{
+    taskmon_probe_t *probe = arg;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        uint32_t wait_us = (uint32_t)(esp_timer_get_time() - probe->t_wake);
+        portENTER_CRITICAL(&s_mon.lock);
+        probe->samples++;
+        probe->sum_us += wait_us;
+        probe->max_us = MAX(probe->max_us, wait_us);
+        portEXIT_CRITICAL(&s_mon.lock);
+    }
+}
+
+static configRUN_TIME_COUNTER_TYPE taskmon_prev_runtime(TaskHandle_t task)
+{
+    for (size_t i = 0; i < s_mon.prev_count; i++) {
+        if (s_mon.prev_task[i] == task) {
+            return s_mon.prev_runtime[i];
+        }
+    }
+    return 0;
+}
+
+static int taskmon_cmp_cpu(const void *a, const void *b)
+{
+    const app_taskmon_task_t *ta = a;
+    const app_taskmon_task_t *tb = b;
+    return (int)tb->cpu_permille - (int)ta->cpu_permille;
+}
+
+static void taskmon_sample(void)
+{
+    app_taskmon_summary_t *sum = calloc(1, sizeof(app_taskmon_summary_t));
+    if (!sum) {
+        ESP_LOGW(TAG, "no memory for the summary");
+        return;
+    }
+
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t n = uxTaskGetSystemState(s_mon.status, CONFIG_APP_TASKMON_MAX_TASKS, &total);
+    if (n == 0) {
+        /* Nothing was filled in, not even the total, keep the last summary and merge this window into the next */
+        ESP_LOGW(TAG, "more than %d tasks, raise CONFIG_APP_TASKMON_MAX_TASKS", CONFIG_APP_TASKMON_MAX_TASKS);
+        free(sum);
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    /* Counters are in run time clock units, so shares are taken against the total of the same clock */
+    configRUN_TIME_COUNTER_TYPE window = MAX(total - s_mon.prev_total, 1);
+    sum->window_ms = (uint32_t)((now - s_mon.prev_time_us) / 1000);
+
+    for (UBaseType_t i = 0; i < n; i++) {
+        const TaskStatus_t *st = &s_mon.status[i];
+        configRUN_TIME_COUNTER_TYPE ran = st->ulRunTimeCounter - taskmon_prev_runtime(st->xHandle);
+        uint16_t permille = (uint16_t)MIN((uint64_t)ran * 1000 / window, 1000);
+        BaseType_t core = xTaskGetCoreID(st->xHandle);
+
+        for (int c = 0; c < portNUM_PROCESSORS; c++) {
+            if (st->xHandle == xTaskGetIdleTaskHandleForCore(c)) {
+                sum->load_permille[c] = 1000 - permille;
+            }
+        }
+
+        app_taskmon_task_t *t = &sum->tasks[sum->task_count++];
+        strlcpy(t->name, st->pcTaskName, sizeof(t->name));
+        t->priority = st->uxCurrentPriority;
+        t->core = core;
+        t->cpu_permille = permille;
+        t->stack_free = st->usStackHighWaterMark;
+
+        s_mon.prev_task[i] = st->xHandle;
+        s_mon.prev_runtime[i] = st->ulRunTimeCounter;
+    }
+    s_mon.prev_count = n;
+    s_mon.prev_total = total;
+    s_mon.prev_time_us = now;
+    qsort(sum->tasks, sum->task_count, sizeof(sum->tasks[0]), taskmon_cmp_cpu);
+
+    portENTER_CRITICAL(&s_mon.lock);
+    for (int c = 0; c < portNUM_PROCESSORS; c++) {
+        taskmon_probe_t *probe = &s_mon.probes[c];
+        sum->wake_samples[c] = probe->samples;
+        sum->wake_avg_us[c] = probe->samples ? (uint32_t)(probe->sum_us / probe->samples) : 0;
+        sum->wake_max_us[c] = probe->max_us;
+        probe->samples = 0;
+        probe->sum_us = 0;
+        probe->max_us = 0;
+    }
+    s_mon.summary = *sum;
+    portEXIT_CRITICAL(&s_mon.lock);
+    free(sum);
+}
+
+esp_err_t app_taskmon_get_summary(app_taskmon_summary_t *summary)
+{
+    ESP_RETURN_ON_FALSE(summary, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(s_mon.status, ESP_ERR_INVALID_STATE, TAG, "monitor not started");
+    portENTER_CRITICAL(&s_mon.lock);
+    *summary = s_mon.summary;
+    portEXIT_CRITICAL(&s_mon.lock);
+    return ESP_OK;
+}
+
+void app_taskmon_log_summary(void)
+{
+    app_taskmon_summary_t *sum = malloc(sizeof(app_taskmon_summary_t));
+    if (!sum || app_taskmon_get_summary(sum) != ESP_OK) {
+        free(sum);
+        return;
+    }
+
+    for (int c = 0; c < portNUM_PROCESSORS; c++) {
+        ESP_LOGI(TAG, "core%d load=%u.%u%% wake_avg_us=%"PRIu32" wake_max_us=%"PRIu32" samples=%"PRIu32, c,
+                 sum->load_permille[c] / 10, sum->load_permille[c] % 10, sum->wake_avg_us[c], sum->wake_max_us[c],
+                 sum->wake_samples[c]);
+    }
+    ESP_LOGI(TAG, "%-16s %4s %4s %6s %10s  window_ms=%"PRIu32, "task", "core", "prio", "cpu", "stack_free",
+             sum->window_ms);
+    for (size_t i = 0; i < sum->task_count; i++) {
+        const app_taskmon_task_t *t = &sum->tasks[i];
+        ESP_LOGI(TAG, "%-16s %4d %4u %3u.%u%% %10"PRIu32, t->name, t->core == tskNO_AFFINITY ? -1 : (int)t->core,
+                 (unsigned)t->priority, t->cpu_permille / 10, t->cpu_permille % 10, t->stack_free);
+    }
+    free(sum);
+}
+
+static void taskmon_task(void *arg)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (1) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(CONFIG_APP_TASKMON_PERIOD_S * 1000));
+        taskmon_sample();
+#if CONFIG_APP_TASKMON_LOG
+        app_taskmon_log_summary();
+#endif
+    }
+}
+
+esp_err_t app_taskmon_start(void)
+{
+    ESP_RETURN_ON_FALSE(!s_mon.status, ESP_ERR_INVALID_STATE, TAG, "monitor already started");
+    s_mon.status = calloc(CONFIG_APP_TASKMON_MAX_TASKS, sizeof(TaskStatus_t));
+    ESP_RETURN_ON_FALSE(s_mon.status, ESP_ERR_NO_MEM, TAG, "no memory for task status");
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        char name[configMAX_TASK_NAME_LEN];
+        snprintf(name, sizeof(name), "wake_probe%d", core);
+        BaseType_t ret = xTaskCreatePinnedToCore(probe_task, name, TASKMON_PROBE_STACK, &s_mon.probes[core],
+                                                 CONFIG_APP_TASKMON_PROBE_PRIORITY, &s_mon.probes[core].task, core);
+        ESP_RETURN_ON_FALSE(ret == pdPASS, ESP_ERR_NO_MEM, TAG, "create probe task failed");
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = probe_timer_cb,
+        .name = "wake_probe",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &s_mon.probe_timer), TAG, "create probe timer failed");
+    ESP_RETURN_ON_ERROR(esp_timer_start_periodic(s_mon.probe_timer, CONFIG_APP_TASKMON_PROBE_PERIOD_MS * 1000), TAG,
+                        "start probe timer failed");
+
+    /* First window starts now */
+    s_mon.prev_time_us = esp_timer_get_time();
+    UBaseType_t n = uxTaskGetSystemState(s_mon.status, CONFIG_APP_TASKMON_MAX_TASKS, &s_mon.prev_total);
+    for (UBaseType_t i = 0; i < n; i++) {
+        s_mon.prev_task[i] = s_mon.status[i].xHandle;
+        s_mon.prev_runtime[i] = s_mon.status[i].ulRunTimeCounter;
+    }
+    s_mon.prev_count = n;
+
+    BaseType_t ret = xTaskCreatePinnedToCore(taskmon_task, "taskmon", TASKMON_TASK_STACK, NULL, 1, NULL,
+                                             app_render_background_core());
+    ESP_RETURN_ON_FALSE(ret == pdPASS, ESP_ERR_NO_MEM, TAG, "create task failed");
+    ESP_LOGI(TAG, "Monitoring tasks every %d s, probing wake latency at priority %d every %d ms",
+             CONFIG_APP_TASKMON_PERIOD_S, CONFIG_APP_TASKMON_PROBE_PRIORITY, CONFIG_APP_TASKMON_PROBE_PERIOD_MS);
+    return ESP_OK;
+}
+
+static int taskmon_cmd(int argc, char **argv)
+{
+    app_taskmon_log_summary();
+    return 0;
+}
+
+esp_err_t app_taskmon_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "tasks",
+        .help = "Show CPU share, stack headroom and wake latency of the last monitor window",
+        .func = taskmon_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,62 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    UBaseType_t priority;
+    BaseType_t core;                /*!< tskNO_AFFINITY when the task is not pinned */
+    uint16_t cpu_permille;          /*!< Share of one core over the window */
+    uint32_t stack_free;            /*!< Stack bytes never used since the task started */
+} app_taskmon_task_t;
+
+typedef struct {
+    uint32_t window_ms;                                 /*!< 0 until the first window completed */
+    uint16_t load_permille[portNUM_PROCESSORS];         /*!< Non-idle time of each core */
+    uint32_t wake_samples[portNUM_PROCESSORS];          /*!< Probe wake-ups in the window */
+    uint32_t wake_avg_us[portNUM_PROCESSORS];           /*!< Notify to run of the probe task of each core */
+    uint32_t wake_max_us[portNUM_PROCESSORS];
+    size_t task_count;
+    app_taskmon_task_t tasks[CONFIG_APP_TASKMON_MAX_TASKS];  /*!< Busiest first */
+} app_taskmon_summary_t;
+
+/**
+ * @brief Start sampling run time stats and stack marks, and the wake latency probes
+ *
+ * A summary is taken every CONFIG_APP_TASKMON_PERIOD_S, and logged as "taskmon:" lines
+ * with CONFIG_APP_TASKMON_LOG.
+ * One probe task per core, at CONFIG_APP_TASKMON_PROBE_PRIORITY, is woken every
+ * CONFIG_APP_TASKMON_PROBE_PERIOD_MS and measures how long it waited to run.
+ */
+esp_err_t app_taskmon_start(void);
+
+/**
+ * @brief Copy the summary of the last complete window
+ */
+esp_err_t app_taskmon_get_summary(app_taskmon_summary_t *summary);
+
+/**
+ * @brief Log the summary of the last complete window
+ */
+void app_taskmon_log_summary(void);
+
+/**
+ * @brief Add the "tasks" console command printing the summary
+ */
+esp_err_t app_taskmon_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
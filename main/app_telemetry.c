@@ -0,0 +1,645 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "esp_mac.h"
+#include "esp_console.h"
+#include "mqtt_client.h"
+#include "app_config.h"
+#include "app_sensor.h"
+#include "app_mem.h"
+#include "app_render.h"
+#include "app_spool.h"
+#include "app_telemetry.h"
+
+#define TELEMETRY_TASK_STACK        (4096)
+#define TELEMETRY_QUEUE_LEN         (32)
+#define TELEMETRY_INFLIGHT          (4)         /* Frames published and not acknowledged yet */
+#define TELEMETRY_ACK_TIMEOUT_US    (30 * 1000 * 1000)
+#define TELEMETRY_RETRY_US          (1000 * 1000)
+#define TELEMETRY_DRAIN_TICK_MS     (100)
+#define TELEMETRY_TOPIC_MAX         (64)
+#define TELEMETRY_FRAME_MAX         (CONFIG_APP_TELEMETRY_FRAME_MAX)
+/* Longest record: dt, quantity mask and one value per quantity, each varint at most 5 bytes */
+#define TELEMETRY_RECORD_MAX        (5 + 1 + 5 * APP_SENSOR_QUANTITY_MAX)
+
+static const char *TAG = "telemetry";
+
+typedef enum {
+    TELEMETRY_EV_READING,
+    TELEMETRY_EV_CONNECTED,
+    TELEMETRY_EV_DISCONNECTED,
+    TELEMETRY_EV_PUBLISHED,
+    TELEMETRY_EV_FLUSH,
+} telemetry_event_type_t;
+
+typedef struct {
+    telemetry_event_type_t type;
+    int msg_id;
+    app_sensor_reading_t *reading;  /* From app_mem_sensor_pool() */
+} telemetry_event_t;
+
+typedef struct {
+    int msg_id;                     /* -1 while the slot is free */
+    bool spooled;                   /* Else `data` holds the frame until it is acknowledged */
+    app_spool_record_t record;
+    int64_t sent_us;
+    size_t len;
+    uint8_t *data;
+} telemetry_inflight_t;
+
+/* Frame being filled, owned by the telemetry task */
+typedef struct {
+    uint8_t buf[TELEMETRY_FRAME_MAX];
+    size_t len;
+    uint16_t records;
+    uint32_t samples;
+    int64_t first_us;
+    uint32_t last_ms;
+    int32_t last_value[APP_SENSOR_QUANTITY_MAX];
+} telemetry_frame_t;
+
+static struct {
+    QueueHandle_t events;
+    esp_mqtt_client_handle_t client;
+    char topic[TELEMETRY_TOPIC_MAX];
+    bool spool_ok;
+    bool connected;
+    uint32_t boot_id;
+    uint32_t next_seq;
+    telemetry_frame_t frame;
+    telemetry_inflight_t inflight[TELEMETRY_INFLIGHT];
+    uint8_t *read_buf;              /* One frame read back from the spool */
+    int64_t retry_us;               /* No publishing before, after a failed publish */
+    double tokens;                  /* Drain budget in bytes */
+    int64_t tokens_us;
+    int64_t drain_start_us;         /* 0 while the spool is not being drained */
+    uint32_t drain_frames;
+    size_t drain_bytes;
+    app_telemetry_stats_t stats;
+    app_spool_info_t spool_info;    /* Copied by the telemetry task, the spool is its own */
+    portMUX_TYPE stats_lock;
+} s_tel = {
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static size_t telemetry_put_varint(uint8_t *out, uint32_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    out[n++] = v;
+    return n;
+}
+
+static size_t telemetry_varint_len(uint32_t v)
+{
+    size_t n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static uint32_t telemetry_zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+/* PUBLISH at QoS 1 with its PUBACK */
+static size_t telemetry_wire_bytes(size_t payload)
+{
+    size_t remaining = 2 + strlen(s_tel.topic) + 2 + payload;
+    return 1 + telemetry_varint_len(remaining) + remaining + 4;
+}
+
+#define TELEMETRY_COUNT(field, n) do {          \
+        portENTER_CRITICAL(&s_tel.stats_lock);  \
+        s_tel.stats.field += (n);               \
+        portEXIT_CRITICAL(&s_tel.stats_lock);   \
+    } while (0)
+
+/* Sensor task: hand the reading over, never block */
+static void telemetry_listener(app_sensor_handle_t sensor, const app_sensor_reading_t *reading, void *arg)
+{
+    bool wanted = false;
+    for (int i = 0; i < reading->channels; i++) {
+        wanted |= reading->quantity[i] < APP_SENSOR_QUANTITY_MAX &&
+                  (CONFIG_APP_TELEMETRY_QUANTITIES & (1 << reading->quantity[i]));
+    }
+    if (!wanted) {
+        return;
+    }
+    telemetry_event_t ev = {
+        .type = TELEMETRY_EV_READING,
+        .reading = app_pool_alloc(app_mem_sensor_pool()),
+    };
+    if (!ev.reading) {
+        TELEMETRY_COUNT(lost, 1);
+        return;
+    }
+    *ev.reading = *reading;
+    if (xQueueSend(s_tel.events, &ev, 0) != pdTRUE) {
+        app_pool_free(app_mem_sensor_pool(), ev.reading);
+        TELEMETRY_COUNT(lost, 1);
+    }
+}
+
+static void telemetry_mqtt_handler(void *arg, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    esp_mqtt_event_handle_t event = event_data;
+    telemetry_event_t ev = { 0 };
+
+    switch ((esp_mqtt_event_id_t)event_id) {
+    case MQTT_EVENT_CONNECTED:
+        ev.type = TELEMETRY_EV_CONNECTED;
+        break;
+    case MQTT_EVENT_DISCONNECTED:
+        ev.type = TELEMETRY_EV_DISCONNECTED;
+        break;
+    case MQTT_EVENT_PUBLISHED:
+        ev.type = TELEMETRY_EV_PUBLISHED;
+        ev.msg_id = event->msg_id;
+        break;
+    default:
+        return;
+    }
+    /* A lost acknowledgement only delays the frame until TELEMETRY_ACK_TIMEOUT_US */
+    xQueueSend(s_tel.events, &ev, pdMS_TO_TICKS(10));
+}
+
+static telemetry_inflight_t *telemetry_free_slot(void)
+{
+    for (int i = 0; i < TELEMETRY_INFLIGHT; i++) {
+        if (s_tel.inflight[i].msg_id < 0) {
+            return &s_tel.inflight[i];
+        }
+    }
+    return NULL;
+}
+
+static bool telemetry_spooled_inflight(void)
+{
+    for (int i = 0; i < TELEMETRY_INFLIGHT; i++) {
+        if (s_tel.inflight[i].msg_id >= 0 && s_tel.inflight[i].spooled) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t telemetry_backlog(void)
+{
+    app_spool_info_t info;
+    app_spool_get_info(&info);
+    return info.pending;
+}
+
+static void telemetry_spool(const uint8_t *data, size_t len)
+{
+    if (s_tel.spool_ok && app_spool_append(data, len, NULL) == ESP_OK) {
+        TELEMETRY_COUNT(spooled, 1);
+    } else {
+        TELEMETRY_COUNT(lost, 1);
+    }
+}
+
+/* Nothing in flight will be acknowledged: keep the live frames in the spool and send the
+ * spooled ones again. The broker may have got some of them, delivery is at least once. */
+static void telemetry_requeue_inflight(void)
+{
+    for (int i = 0; i < TELEMETRY_INFLIGHT; i++) {
+        telemetry_inflight_t *slot = &s_tel.inflight[i];
+        if (slot->msg_id >= 0 && !slot->spooled) {
+            telemetry_spool(slot->data, slot->len);
+        }
+        slot->msg_id = -1;
+    }
+    if (s_tel.spool_ok) {
+        app_spool_rewind();
+    }
+}
+
+static bool telemetry_publish(telemetry_inflight_t *slot, const uint8_t *data, size_t len)
+{
+    int msg_id = esp_mqtt_client_publish(s_tel.client, s_tel.topic, (const char *)data, len, 1, 0);
+    if (msg_id < 0) {
+        ESP_LOGW(TAG, "publish failed (%d), retrying later", msg_id);
+        s_tel.retry_us = esp_timer_get_time() + TELEMETRY_RETRY_US;
+        return false;
+    }
+    slot->msg_id = msg_id;
+    slot->len = len;
+    slot->sent_us = esp_timer_get_time();
+    return true;
+}
+
+static bool telemetry_can_publish(void)
+{
+    return s_tel.connected && esp_timer_get_time() >= s_tel.retry_us;
+}
+
+static void telemetry_close_frame(void)
+{
+    telemetry_frame_t *f = &s_tel.frame;
+    if (!f->records) {
+        return;
+    }
+    app_telemetry_frame_header_t hdr = {
+        .version = APP_TELEMETRY_FRAME_VERSION,
+        .records = f->records,
+        .seq = s_tel.next_seq++,
+        .boot_id = s_tel.boot_id,
+        .base_ms = (uint32_t)(f->first_us / 1000),
+    };
+    memcpy(f->buf, &hdr, sizeof(hdr));
+
+    portENTER_CRITICAL(&s_tel.stats_lock);
+    s_tel.stats.frames++;
+    s_tel.stats.samples += f->samples;
+    s_tel.stats.payload_bytes += f->len;
+    s_tel.stats.wire_bytes += telemetry_wire_bytes(f->len);
+    portEXIT_CRITICAL(&s_tel.stats_lock);
+
+    /* Straight out only when nothing older waits in the spool, so frames arrive in order */
+    telemetry_inflight_t *slot = telemetry_free_slot();
+    bool sent = false;
+    if (slot && telemetry_can_publish() && !telemetry_backlog()) {
+        memcpy(slot->data, f->buf, f->len);
+        slot->spooled = false;
+        sent = telemetry_publish(slot, slot->data, f->len);
+    }
+    if (sent) {
+        TELEMETRY_COUNT(live, 1);
+    } else if (app_config_get()->telemetry_broker[0]) {
+        telemetry_spool(f->buf, f->len);
+    } else {
+        /* Never configured: spooling would only wear the flash and send stale data later */
+        TELEMETRY_COUNT(lost, 1);
+    }
+    f->len = 0;
+    f->records = 0;
+    f->samples = 0;
+}
+
+static void telemetry_add_reading(const app_sensor_reading_t *reading)
+{
+    telemetry_frame_t *f = &s_tel.frame;
+    if (f->len + TELEMETRY_RECORD_MAX > sizeof(f->buf)) {
+        telemetry_close_frame();
+    }
+    if (!f->records) {
+        f->len = sizeof(app_telemetry_frame_header_t);
+        f->first_us = reading->timestamp_us;
+        f->last_ms = reading->timestamp_us / 1000;
+        memset(f->last_value, 0, sizeof(f->last_value));
+    }
+
+    /* Channels of one reading, in quantity order */
+    int32_t values[APP_SENSOR_QUANTITY_MAX];
+    uint8_t mask = 0;
+    for (int i = 0; i < reading->channels; i++) {
+        app_sensor_quantity_t q = reading->quantity[i];
+        if (q < APP_SENSOR_QUANTITY_MAX && (CONFIG_APP_TELEMETRY_QUANTITIES & (1 << q))) {
+            values[q] = lroundf(reading->value[i] * 100);
+            mask |= 1 << q;
+        }
+    }
+
+    uint32_t now_ms = MAX(reading->timestamp_us / 1000, f->last_ms);
+    f->len += telemetry_put_varint(&f->buf[f->len], now_ms - f->last_ms);
+    f->buf[f->len++] = mask;
+    f->last_ms = now_ms;
+    uint64_t single = 0;
+    for (int q = 0; q < APP_SENSOR_QUANTITY_MAX; q++) {
+        if (mask & (1 << q)) {
+            f->len += telemetry_put_varint(&f->buf[f->len], telemetry_zigzag(values[q] - f->last_value[q]));
+            f->last_value[q] = values[q];
+            f->samples++;
+            single += telemetry_wire_bytes(sizeof(app_telemetry_frame_header_t) + 2 +
+                                           telemetry_varint_len(telemetry_zigzag(values[q])));
+        }
+    }
+    f->records++;
+    TELEMETRY_COUNT(single_wire_bytes, single);
+}
+
+static void telemetry_acked(int msg_id)
+{
+    for (int i = 0; i < TELEMETRY_INFLIGHT; i++) {
+        telemetry_inflight_t *slot = &s_tel.inflight[i];
+        if (slot->msg_id != msg_id) {
+            continue;
+        }
+        slot->msg_id = -1;
+        TELEMETRY_COUNT(acked, 1);
+        if (slot->spooled) {
+            app_spool_mark_sent(&slot->record);
+            TELEMETRY_COUNT(drained, 1);
+            s_tel.drain_frames++;
+            s_tel.drain_bytes += slot->len;
+        }
+        break;
+    }
+
+    if (s_tel.drain_start_us && !telemetry_backlog() && !telemetry_spooled_inflight()) {
+        uint32_t ms = (esp_timer_get_time() - s_tel.drain_start_us) / 1000;
+        ESP_LOGI(TAG, "drained frames=%" PRIu32 " bytes=%u ms=%" PRIu32 " bytes_per_s=%" PRIu32,
+                 s_tel.drain_frames, (unsigned)s_tel.drain_bytes, ms,
+                 ms ? (uint32_t)((uint64_t)s_tel.drain_bytes * 1000 / ms) : 0);
+        s_tel.drain_start_us = 0;
+    }
+}
+
+/* Publish spooled frames while the token bucket allows, oldest first */
+static void telemetry_drain(void)
+{
+    int64_t now = esp_timer_get_time();
+    s_tel.tokens = MIN(s_tel.tokens + (now - s_tel.tokens_us) * CONFIG_APP_TELEMETRY_DRAIN_BPS / 1e6,
+                       MAX(CONFIG_APP_TELEMETRY_DRAIN_BPS, TELEMETRY_FRAME_MAX));
+    s_tel.tokens_us = now;
+
+    telemetry_inflight_t *slot;
+    while (s_tel.tokens > 0 && telemetry_can_publish() && (slot = telemetry_free_slot())) {
+        size_t len;
+        app_spool_record_t record;
+        if (app_spool_read_next(s_tel.read_buf, TELEMETRY_FRAME_MAX, &len, &record) != ESP_OK) {
+            break;
+        }
+        if (!s_tel.drain_start_us) {
+            s_tel.drain_start_us = now;
+            s_tel.drain_frames = 0;
+            s_tel.drain_bytes = 0;
+        }
+        slot->spooled = true;
+        slot->record = record;
+        if (!telemetry_publish(slot, s_tel.read_buf, len)) {
+            app_spool_rewind();
+            break;
+        }
+        s_tel.tokens -= len;    /* May go below 0: the next frame waits for the debt */
+    }
+}
+
+static void telemetry_check_timeouts(void)
+{
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < TELEMETRY_INFLIGHT; i++) {
+        if (s_tel.inflight[i].msg_id >= 0 && now - s_tel.inflight[i].sent_us > TELEMETRY_ACK_TIMEOUT_US) {
+            ESP_LOGW(TAG, "no acknowledgement for msg_id=%d, sending again", s_tel.inflight[i].msg_id);
+            telemetry_requeue_inflight();
+            return;
+        }
+    }
+}
+
+static TickType_t telemetry_wait_ticks(void)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t wait_us = INT64_MAX;
+    if (s_tel.frame.records) {
+        wait_us = s_tel.frame.first_us + CONFIG_APP_TELEMETRY_BATCH_S * 1000000LL - now;
+    }
+    for (int i = 0; i < TELEMETRY_INFLIGHT; i++) {
+        if (s_tel.inflight[i].msg_id >= 0) {
+            wait_us = MIN(wait_us, s_tel.inflight[i].sent_us + TELEMETRY_ACK_TIMEOUT_US - now);
+        }
+    }
+    if (s_tel.connected && s_tel.spool_ok && telemetry_backlog()) {
+        wait_us = MIN(wait_us, TELEMETRY_DRAIN_TICK_MS * 1000);
+    }
+    if (wait_us == INT64_MAX) {
+        return portMAX_DELAY;
+    }
+    return wait_us > 0 ? pdMS_TO_TICKS(wait_us / 1000) + 1 : 0;
+}
+
+static void telemetry_task(void *arg)
+{
+    while (1) {
+        telemetry_event_t ev;
+        if (xQueueReceive(s_tel.events, &ev, telemetry_wait_ticks()) == pdTRUE) {
+            switch (ev.type) {
+            case TELEMETRY_EV_READING:
+                telemetry_add_reading(ev.reading);
+                app_pool_free(app_mem_sensor_pool(), ev.reading);
+                break;
+            case TELEMETRY_EV_CONNECTED:
+                ESP_LOGI(TAG, "connected, backlog=%" PRIu32, telemetry_backlog());
+                s_tel.connected = true;
+                s_tel.retry_us = 0;
+                s_tel.tokens = 0;   /* The backlog starts at the drain rate, no burst */
+                s_tel.tokens_us = esp_timer_get_time();
+                break;
+            case TELEMETRY_EV_DISCONNECTED:
+                if (s_tel.connected) {
+                    ESP_LOGI(TAG, "disconnected");
+                }
+                s_tel.connected = false;
+                s_tel.drain_start_us = 0;
+                telemetry_requeue_inflight();
+                break;
+            case TELEMETRY_EV_PUBLISHED:
+                telemetry_acked(ev.msg_id);
+                break;
+            case TELEMETRY_EV_FLUSH:
+                telemetry_close_frame();
+                break;
+            }
+        }
+
+        if (s_tel.frame.records &&
+                esp_timer_get_time() - s_tel.frame.first_us >= CONFIG_APP_TELEMETRY_BATCH_S * 1000000LL) {
+            telemetry_close_frame();
+        }
+        telemetry_check_timeouts();
+        if (s_tel.spool_ok && telemetry_can_publish()) {
+            telemetry_drain();
+        }
+
+        app_spool_info_t info;
+        app_spool_get_info(&info);
+        portENTER_CRITICAL(&s_tel.stats_lock);
+        s_tel.spool_info = info;
+        portEXIT_CRITICAL(&s_tel.stats_lock);
+    }
+}
+
+static void telemetry_stop(void)
+{
+    /* The client may not report its own stop */
+    esp_mqtt_client_stop(s_tel.client);
+    telemetry_event_t ev = { .type = TELEMETRY_EV_DISCONNECTED };
+    xQueueSend(s_tel.events, &ev, portMAX_DELAY);
+}
+
+static esp_err_t telemetry_connect(const char *uri)
+{
+    if (s_tel.client) {
+        telemetry_stop();
+        ESP_RETURN_ON_ERROR(esp_mqtt_client_set_uri(s_tel.client, uri), TAG, "bad broker URL");
+        return esp_mqtt_client_start(s_tel.client);
+    }
+
+    const esp_mqtt_client_config_t config = {
+        .broker.address.uri = uri,
+        .credentials.client_id = s_tel.topic,   /* Unique per unit, like the topic */
+        .session.keepalive = 60,
+        .outbox.limit = TELEMETRY_INFLIGHT * 2 * TELEMETRY_FRAME_MAX,
+    };
+    esp_mqtt_client_handle_t client = esp_mqtt_client_init(&config);
+    ESP_RETURN_ON_FALSE(client, ESP_ERR_NO_MEM, TAG, "MQTT client init failed");
+    ESP_RETURN_ON_ERROR(esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, telemetry_mqtt_handler, NULL),
+                        TAG, "register MQTT events failed");
+    s_tel.client = client;
+    return esp_mqtt_client_start(client);
+}
+
+/* The tel_broker setting changed, from the "telemetry broker" command or elsewhere */
+static void telemetry_config_changed(uint32_t changed, void *arg)
+{
+    if (!(changed & (1u << APP_CONFIG_TELEMETRY_BROKER))) {
+        return;
+    }
+    const char *uri = app_config_get()->telemetry_broker;
+    if (!uri[0]) {
+        if (s_tel.client) {
+            telemetry_stop();
+        }
+    } else if (telemetry_connect(uri) != ESP_OK) {
+        ESP_LOGW(TAG, "connecting to %s failed", uri);
+    }
+}
+
+esp_err_t app_telemetry_start(void)
+{
+    ESP_RETURN_ON_FALSE(!s_tel.events, ESP_ERR_INVALID_STATE, TAG, "already started");
+
+    uint8_t mac[6];
+    ESP_RETURN_ON_ERROR(esp_read_mac(mac, ESP_MAC_WIFI_STA), TAG, "read MAC failed");
+    char id[13];
+    snprintf(id, sizeof(id), "%02x%02x%02x%02x%02x%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    snprintf(s_tel.topic, sizeof(s_tel.topic), CONFIG_APP_TELEMETRY_TOPIC, id);
+
+    /* Without the spool frames still go out while connected, they are only lost while not */
+    s_tel.spool_ok = app_spool_init() == ESP_OK;
+    s_tel.boot_id = esp_random();
+    s_tel.next_seq = s_tel.spool_ok ? app_spool_next_seq() : 0;
+
+    uint8_t *bufs = heap_caps_malloc((TELEMETRY_INFLIGHT + 1) * TELEMETRY_FRAME_MAX, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!bufs) {
+        bufs = heap_caps_malloc((TELEMETRY_INFLIGHT + 1) * TELEMETRY_FRAME_MAX, MALLOC_CAP_8BIT);
+    }
+    ESP_RETURN_ON_FALSE(bufs, ESP_ERR_NO_MEM, TAG, "no memory for frames");
+    for (int i = 0; i < TELEMETRY_INFLIGHT; i++) {
+        s_tel.inflight[i].msg_id = -1;
+        s_tel.inflight[i].data = bufs + i * TELEMETRY_FRAME_MAX;
+    }
+    s_tel.read_buf = bufs + TELEMETRY_INFLIGHT * TELEMETRY_FRAME_MAX;
+
+    s_tel.events = xQueueCreate(TELEMETRY_QUEUE_LEN, sizeof(telemetry_event_t));
+    ESP_RETURN_ON_FALSE(s_tel.events, ESP_ERR_NO_MEM, TAG, "create queue failed");
+    BaseType_t res = xTaskCreatePinnedToCore(telemetry_task, "telemetry", TELEMETRY_TASK_STACK, NULL, 2, NULL,
+                                             app_render_background_core());
+    ESP_RETURN_ON_FALSE(res == pdPASS, ESP_ERR_NO_MEM, TAG, "create task failed");
+    ESP_RETURN_ON_ERROR(app_sensor_add_listener(telemetry_listener, NULL), TAG, "add sensor listener failed");
+
+    const char *uri = app_config_get()->telemetry_broker;
+    if (uri[0]) {
+        ESP_RETURN_ON_ERROR(telemetry_connect(uri), TAG, "connect to %s failed", uri);
+    }
+    ESP_RETURN_ON_ERROR(app_config_add_listener(telemetry_config_changed, NULL), TAG, "add config listener failed");
+    ESP_LOGI(TAG, "topic=%s batch_s=%d drain_bps=%d", s_tel.topic, CONFIG_APP_TELEMETRY_BATCH_S,
+             CONFIG_APP_TELEMETRY_DRAIN_BPS);
+    return ESP_OK;
+}
+
+esp_err_t app_telemetry_get_stats(app_telemetry_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(stats, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+
+    portENTER_CRITICAL(&s_tel.stats_lock);
+    *stats = s_tel.stats;
+    memset(&s_tel.stats, 0, sizeof(s_tel.stats));
+    portEXIT_CRITICAL(&s_tel.stats_lock);
+    return ESP_OK;
+}
+
+static int telemetry_cmd(int argc, char **argv)
+{
+    if (!s_tel.events) {
+        printf("telemetry: not started\n");
+        return 1;
+    }
+    if (argc == 3 && strcmp(argv[1], "broker") == 0) {
+        /* Kept for the next boot, connects once the setting is applied */
+        if (app_config_set_str(APP_CONFIG_TELEMETRY_BROKER, argv[2]) != ESP_OK) {
+            printf("telemetry: bad broker URL\n");
+            return 1;
+        }
+        return 0;
+    }
+    if (argc == 2 && (strcmp(argv[1], "offline") == 0 || strcmp(argv[1], "online") == 0)) {
+        if (!s_tel.client) {
+            printf("telemetry: no broker, use \"telemetry broker <url>\"\n");
+            return 1;
+        }
+        if (strcmp(argv[1], "offline") == 0) {
+            telemetry_stop();
+        } else {
+            esp_mqtt_client_start(s_tel.client);
+        }
+        return 0;
+    }
+    if (argc == 2 && strcmp(argv[1], "flush") == 0) {
+        telemetry_event_t ev = { .type = TELEMETRY_EV_FLUSH };
+        xQueueSend(s_tel.events, &ev, portMAX_DELAY);
+        return 0;
+    }
+    if (argc != 1) {
+        printf("usage: telemetry [broker <url> | offline | online | flush]\n");
+        return 1;
+    }
+
+    app_telemetry_stats_t st;
+    app_telemetry_get_stats(&st);
+    portENTER_CRITICAL(&s_tel.stats_lock);
+    app_spool_info_t spool = s_tel.spool_info;
+    portEXIT_CRITICAL(&s_tel.stats_lock);
+    uint32_t samples = MAX(st.samples, 1);
+    printf("telemetry: samples=%" PRIu32 " frames=%" PRIu32 " bytes_per_sample=%.2f wire_bytes_per_sample=%.2f "
+           "single_wire_bytes_per_sample=%.2f live=%" PRIu32 " spooled=%" PRIu32 " drained=%" PRIu32
+           " acked=%" PRIu32 " lost=%" PRIu32 " backlog=%" PRIu32 " backlog_bytes=%u spool_dropped=%" PRIu32 "\n",
+           st.samples, st.frames, (double)st.payload_bytes / samples, (double)st.wire_bytes / samples,
+           (double)st.single_wire_bytes / samples, st.live, st.spooled, st.drained, st.acked, st.lost,
+           spool.pending, (unsigned)spool.pending_bytes, spool.dropped);
+    return 0;
+}
+
+esp_err_t app_telemetry_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "telemetry",
+        .help = "Show and clear the telemetry counters, set the broker, or take it offline: "
+                "telemetry [broker <url> | offline | online | flush]",
+        .func = telemetry_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
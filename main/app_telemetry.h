@@ -0,0 +1,69 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Frame layout, shared with telemetry_decode.js: the header, then `records` records. A record
+ * is a varint of the milliseconds since the previous record (since base_ms for the first), a
+ * byte with bit n set for each app_sensor_quantity_t n it carries, then for each set bit, lowest
+ * first, the zigzag varint change of the value in hundredths against the previous value of that
+ * quantity in the frame (against 0 for the first). All integers are little endian. */
+#define APP_TELEMETRY_FRAME_VERSION     (1)
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t reserved;
+    uint16_t records;
+    uint32_t seq;                   /*!< Frame number, tells duplicates and gaps apart */
+    uint32_t boot_id;               /*!< Random per boot, seq restarts with it */
+    uint32_t base_ms;               /*!< Milliseconds since boot of the first record */
+} app_telemetry_frame_header_t;
+
+typedef struct {
+    uint32_t samples;               /*!< Values encoded, one reading may carry several */
+    uint32_t frames;
+    uint64_t payload_bytes;
+    uint64_t wire_bytes;            /*!< MQTT PUBLISH and PUBACK packets of the frames */
+    uint64_t single_wire_bytes;     /*!< What publishing every sample in its own frame would have cost */
+    uint32_t live;                  /*!< Frames published as soon as they closed */
+    uint32_t spooled;               /*!< Frames written to flash while offline or behind */
+    uint32_t drained;               /*!< Spooled frames acknowledged by the broker */
+    uint32_t acked;                 /*!< All frames acknowledged */
+    uint32_t lost;                  /*!< Frames with nowhere to go, and readings the queue could not take */
+} app_telemetry_stats_t;
+
+/**
+ * @brief Batch sensor readings into frames and publish them at QoS 1 to the broker of the tel_broker setting
+ *
+ * Readings of the quantities in CONFIG_APP_TELEMETRY_QUANTITIES are collected for
+ * CONFIG_APP_TELEMETRY_BATCH_S, or until a frame is full. Frames that cannot be published
+ * right away go to the "spool" partition and are sent again, oldest first and at most
+ * CONFIG_APP_TELEMETRY_DRAIN_BPS, once the broker is back. Delivery is at least once.
+ * With an empty broker URL nothing connects until the "telemetry broker" command, which
+ * keeps the URL in the setting, and closed frames are dropped instead of spooled.
+ * Call after app_config_init().
+ */
+esp_err_t app_telemetry_start(void);
+
+/**
+ * @brief Read the statistics since the last call and clear them
+ */
+esp_err_t app_telemetry_get_stats(app_telemetry_stats_t *stats);
+
+/**
+ * @brief Add the "telemetry" console command
+ */
+esp_err_t app_telemetry_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
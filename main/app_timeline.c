@@ -0,0 +1,72 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "app_timeline.h"
+
+static const char *TAG = "timeline";
+
+/* Names double as the keys of the log line parsed by pytest_rgb_panel_lvgl.py */
+static const char *const s_stage_names[APP_TIMELINE_STAGE_MAX] = {
+    [APP_TIMELINE_PANEL_UP] = "panel",
+    [APP_TIMELINE_TOUCH_UP] = "touch",
+    [APP_TIMELINE_LVGL_READY] = "lvgl",
+    [APP_TIMELINE_FIRST_FRAME] = "first_frame",
+    [APP_TIMELINE_INTERACTIVE] = "interactive",
+    [APP_TIMELINE_WIFI_CONNECTED] = "wifi",
+    [APP_TIMELINE_FIRST_WEATHER] = "weather",
+};
+
+static int64_t s_stamps[APP_TIMELINE_STAGE_MAX];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void app_timeline_mark(app_timeline_stage_t stage)
+{
+    if (stage >= APP_TIMELINE_STAGE_MAX) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    bool first = false;
+    portENTER_CRITICAL(&s_lock);
+    if (!s_stamps[stage]) {
+        s_stamps[stage] = now;
+        first = true;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    if (first && stage >= APP_TIMELINE_INTERACTIVE) {
+        app_timeline_log();
+    }
+}
+
+int64_t app_timeline_get(app_timeline_stage_t stage)
+{
+    if (stage >= APP_TIMELINE_STAGE_MAX) {
+        return 0;
+    }
+    portENTER_CRITICAL(&s_lock);
+    int64_t stamp = s_stamps[stage];
+    portEXIT_CRITICAL(&s_lock);
+    return stamp;
+}
+
+void app_timeline_log(void)
+{
+    char line[160];
+    int len = 0;
+    for (int i = 0; i < APP_TIMELINE_STAGE_MAX && len < sizeof(line); i++) {
+        int64_t stamp = app_timeline_get(i);
+        if (stamp) {
+            len += snprintf(line + len, sizeof(line) - len, "%s%s=%"PRId64, i ? " " : "", s_stage_names[i], stamp / 1000);
+        } else {
+            len += snprintf(line + len, sizeof(line) - len, "%s%s=-", i ? " " : "", s_stage_names[i]);
+        }
+    }
+    ESP_LOGI(TAG, "%s", line);
+}
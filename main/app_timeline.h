@@ -0,0 +1,47 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Milestones, in the order they are expected
+ */
+typedef enum {
+    APP_TIMELINE_PANEL_UP = 0,      /*!< RGB panel initialized */
+    APP_TIMELINE_TOUCH_UP,          /*!< GT911 answering on the I2C bus */
+    APP_TIMELINE_LVGL_READY,        /*!< LVGL task running with the display added */
+    APP_TIMELINE_FIRST_FRAME,       /*!< First frame flushed to the panel */
+    APP_TIMELINE_INTERACTIVE,       /*!< UI built and taking touch input */
+    APP_TIMELINE_WIFI_CONNECTED,    /*!< Got an IP address */
+    APP_TIMELINE_FIRST_WEATHER,     /*!< First weather data applied to the UI */
+    APP_TIMELINE_STAGE_MAX,
+} app_timeline_stage_t;
+
+/**
+ * @brief Stamp `stage` with esp_timer_get_time(), only the first call per stage counts
+ *
+ * Safe from any task. From APP_TIMELINE_INTERACTIVE on, every new stamp logs the whole
+ * timeline with app_timeline_log().
+ */
+void app_timeline_mark(app_timeline_stage_t stage);
+
+/**
+ * @brief Time of `stage` in microseconds since boot, 0 if not reached yet
+ */
+int64_t app_timeline_get(app_timeline_stage_t stage);
+
+/**
+ * @brief Log "timeline: panel=<ms> touch=<ms> ...", "-" for stages not reached yet
+ */
+void app_timeline_log(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,203 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "esp_freertos_hooks.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_console.h"
+#include "app_trace.h"
+
+#define TRACE_EVENTS            (CONFIG_APP_TRACE_EVENTS_PER_CORE)
+#define TRACE_BENCH_EVENTS      (256)
+#define TRACE_EVENTS_PER_LINE   (8)
+
+_Static_assert((TRACE_EVENTS & (TRACE_EVENTS - 1)) == 0, "APP_TRACE_EVENTS_PER_CORE must be a power of two");
+
+static const char *TAG = "trace";
+
+/* Layout is decoded by trace_to_chrome.js, keep both in sync */
+typedef struct {
+    uint32_t cycles;                /* CPU cycle counter of the recording core */
+    uint32_t tag;                   /* app_trace_id_t | app_trace_phase_t << 16, one store */
+    uint32_t payload;
+    uint32_t task;                  /* Handle of the running task, spans only nest within one task */
+} trace_event_t;
+
+_Static_assert(sizeof(trace_event_t) == 16, "trace event layout changed");
+
+typedef struct {
+    uint32_t head;                  /* Events ever recorded, the slot is head modulo TRACE_EVENTS */
+    uint32_t ticks;                 /* Ticks since the last sync event */
+    trace_event_t events[TRACE_EVENTS];
+} trace_ring_t;
+
+static const char *const s_names[APP_TRACE_ID_MAX] = {
+    [APP_TRACE_SYNC] = "sync",
+    [APP_TRACE_LVGL_REFR] = "lvgl_refr",
+    [APP_TRACE_LVGL_RENDER] = "lvgl_render",
+    [APP_TRACE_LVGL_FLUSH] = "lvgl_flush",
+    [APP_TRACE_TOUCH_READ] = "touch_read",
+    [APP_TRACE_I2C_XFER] = "i2c_xfer",
+    [APP_TRACE_SENSOR_READ] = "sensor_read",
+    [APP_TRACE_NET_FETCH] = "net_fetch",
+};
+
+/* Each core only writes its own ring, with interrupts masked, so no lock is needed */
+static DRAM_ATTR trace_ring_t s_rings[portNUM_PROCESSORS];
+static DRAM_ATTR volatile bool s_enabled;
+
+IRAM_ATTR void app_trace_record(app_trace_id_t id, app_trace_phase_t phase, uint32_t payload)
+{
+    if (!s_enabled) {
+        return;
+    }
+    /* Masked before reading the core id, the task cannot migrate in between */
+    UBaseType_t state = portSET_INTERRUPT_MASK_FROM_ISR();
+    int core = esp_cpu_get_core_id();
+    trace_ring_t *ring = &s_rings[core];
+    trace_event_t *ev = &ring->events[ring->head++ & (TRACE_EVENTS - 1)];
+    ev->cycles = esp_cpu_get_cycle_count();
+    ev->tag = id | phase << 16;
+    ev->payload = payload;
+    ev->task = (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandleForCore(core);
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(state);
+}
+
+/* The cycle counters of the cores are not aligned and wrap every few seconds,
+ * a sync event per second lets the host map them to a common time base */
+static IRAM_ATTR void trace_tick_hook(void)
+{
+    trace_ring_t *ring = &s_rings[esp_cpu_get_core_id()];
+    if (++ring->ticks >= configTICK_RATE_HZ) {
+        ring->ticks = 0;
+        app_trace_record(APP_TRACE_SYNC, APP_TRACE_PH_INSTANT, (uint32_t)esp_timer_get_time());
+    }
+}
+
+static void trace_display_event_cb(lv_event_t *e)
+{
+    const lv_area_t *area;
+
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_REFR_START:
+        APP_TRACE_BEGIN(APP_TRACE_LVGL_REFR, 0);
+        break;
+    case LV_EVENT_REFR_READY:
+        APP_TRACE_END(APP_TRACE_LVGL_REFR, 0);
+        break;
+    case LV_EVENT_RENDER_START:
+        APP_TRACE_BEGIN(APP_TRACE_LVGL_RENDER, 0);
+        break;
+    case LV_EVENT_RENDER_READY:
+        APP_TRACE_END(APP_TRACE_LVGL_RENDER, 0);
+        break;
+    case LV_EVENT_FLUSH_START:
+        area = lv_event_get_param(e);
+        APP_TRACE_BEGIN(APP_TRACE_LVGL_FLUSH, area ? lv_area_get_size(area) : 0);
+        break;
+    case LV_EVENT_FLUSH_FINISH:
+        APP_TRACE_END(APP_TRACE_LVGL_FLUSH, 0);
+        break;
+    default:
+        break;
+    }
+}
+
+esp_err_t app_trace_attach_display(lv_display_t *disp)
+{
+    ESP_RETURN_ON_FALSE(disp, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    lv_display_add_event_cb(disp, trace_display_event_cb, LV_EVENT_ALL, NULL);
+    return ESP_OK;
+}
+
+esp_err_t app_trace_init(void)
+{
+    /* Nothing else records yet, so the benchmark events can simply be dropped again */
+    s_enabled = true;
+    uint32_t start = esp_cpu_get_cycle_count();
+    for (int i = 0; i < TRACE_BENCH_EVENTS; i++) {
+        app_trace_record(APP_TRACE_SYNC, APP_TRACE_PH_INSTANT, i);
+    }
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        s_rings[core].head = 0;
+    }
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        ESP_RETURN_ON_ERROR(esp_register_freertos_tick_hook_for_cpu(trace_tick_hook, core), TAG, "register tick hook failed");
+    }
+    ESP_LOGI(TAG, "%d events per core, %"PRIu32" ns per event", TRACE_EVENTS,
+             cycles * 1000 / esp_rom_get_cpu_ticks_per_us() / TRACE_BENCH_EVENTS);
+    return ESP_OK;
+}
+
+void app_trace_dump(void)
+{
+    /* Let a record running on the other core finish before reading its ring */
+    s_enabled = false;
+    vTaskDelay(1);
+
+    /* Plain printf so the lines are easy to parse from a monitor capture */
+    printf("trace: begin cores=%d cpu_mhz=%"PRIu32" event_size=%d\n", portNUM_PROCESSORS,
+           esp_rom_get_cpu_ticks_per_us(), (int)sizeof(trace_event_t));
+    for (int id = 0; id < APP_TRACE_ID_MAX; id++) {
+        printf("trace: name %d %s\n", id, s_names[id]);
+    }
+    /* Tasks deleted since they recorded are shown by their handle only */
+    UBaseType_t max_tasks = uxTaskGetNumberOfTasks() + 4;
+    TaskStatus_t *tasks = malloc(max_tasks * sizeof(TaskStatus_t));
+    if (tasks) {
+        UBaseType_t n = uxTaskGetSystemState(tasks, max_tasks, NULL);
+        for (UBaseType_t i = 0; i < n; i++) {
+            printf("trace: task %08"PRIx32" %s\n", (uint32_t)(uintptr_t)tasks[i].xHandle, tasks[i].pcTaskName);
+        }
+        free(tasks);
+    }
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        const trace_ring_t *ring = &s_rings[core];
+        uint32_t count = MIN(ring->head, TRACE_EVENTS);
+        printf("trace: core %d events=%"PRIu32" overwritten=%"PRIu32"\n", core, count, ring->head - count);
+        for (uint32_t n = 0; n < count; n += TRACE_EVENTS_PER_LINE) {
+            printf("trace: data %d ", core);
+            for (uint32_t i = n; i < MIN(n + TRACE_EVENTS_PER_LINE, count); i++) {
+                const uint8_t *ev = (const uint8_t *)&ring->events[(ring->head - count + i) & (TRACE_EVENTS - 1)];
+                for (int b = 0; b < sizeof(trace_event_t); b++) {
+                    printf("%02x", ev[b]);
+                }
+            }
+            printf("\n");
+        }
+    }
+    printf("trace: end\n");
+
+    s_enabled = true;
+}
+
+static int trace_cmd(int argc, char **argv)
+{
+    app_trace_dump();
+    return 0;
+}
+
+esp_err_t app_trace_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "trace",
+        .help = "Print the per-core event rings, convert them with trace_to_chrome.js",
+        .func = trace_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
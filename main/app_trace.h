@@ -0,0 +1,83 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Traced events, trace_to_chrome.js gets the names from the dump
+ */
+typedef enum {
+    APP_TRACE_SYNC,             /*!< Once a second per core, payload is esp_timer time in us (low 32 bits) */
+    APP_TRACE_LVGL_REFR,        /*!< Display refresh, from REFR_START to REFR_READY */
+    APP_TRACE_LVGL_RENDER,      /*!< Rendering of one draw buffer */
+    APP_TRACE_LVGL_FLUSH,       /*!< Draw buffer handed to the panel until flush_ready, payload is the area in px */
+    APP_TRACE_TOUCH_READ,       /*!< GT911 read, payload of the end is the esp_err_t */
+    APP_TRACE_I2C_XFER,         /*!< One bus transfer, payload is addr | prio << 8 | length << 16 */
+    APP_TRACE_SENSOR_READ,      /*!< Sensor driver read, payload of the end is the esp_err_t */
+    APP_TRACE_NET_FETCH,        /*!< Network fetch, payload is the request id */
+    APP_TRACE_ID_MAX,
+} app_trace_id_t;
+
+typedef enum {
+    APP_TRACE_PH_BEGIN,
+    APP_TRACE_PH_END,
+    APP_TRACE_PH_INSTANT,
+    APP_TRACE_PH_COUNTER,
+} app_trace_phase_t;
+
+/**
+ * @brief Add an event, with the running task, to the ring of the calling core
+ *
+ * Safe from tasks and ISRs on both cores, takes no lock. The oldest events get overwritten.
+ */
+void app_trace_record(app_trace_id_t id, app_trace_phase_t phase, uint32_t payload);
+
+#if CONFIG_APP_TRACE
+#define APP_TRACE_BEGIN(id, payload)    app_trace_record((id), APP_TRACE_PH_BEGIN, (payload))
+#define APP_TRACE_END(id, payload)      app_trace_record((id), APP_TRACE_PH_END, (payload))
+#define APP_TRACE_INSTANT(id, payload)  app_trace_record((id), APP_TRACE_PH_INSTANT, (payload))
+#define APP_TRACE_COUNTER(id, value)    app_trace_record((id), APP_TRACE_PH_COUNTER, (value))
+#else
+#define APP_TRACE_BEGIN(id, payload)    do { (void)(payload); } while (0)
+#define APP_TRACE_END(id, payload)      do { (void)(payload); } while (0)
+#define APP_TRACE_INSTANT(id, payload)  do { (void)(payload); } while (0)
+#define APP_TRACE_COUNTER(id, value)    do { (void)(value); } while (0)
+#endif
+
+/**
+ * @brief Start recording: clock sync on both cores, then measure the cost of one event
+ */
+esp_err_t app_trace_init(void);
+
+/**
+ * @brief Trace refresh, render and flush of a display
+ *
+ * Must be called with the LVGL lock held.
+ */
+esp_err_t app_trace_attach_display(lv_display_t *disp);
+
+/**
+ * @brief Print both rings as hex between "trace: begin" and "trace: end"
+ *
+ * Recording pauses while printing. trace_to_chrome.js turns the output into a Chrome trace.
+ */
+void app_trace_dump(void);
+
+/**
+ * @brief Add the "trace" console command dumping the rings
+ */
+esp_err_t app_trace_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
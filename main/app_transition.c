@@ -0,0 +1,327 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_console.h"
+#include "esp_lvgl_port.h"
+#include "app_transition.h"
+
+#define TRANSITION_PROGRESS_MAX     (256)
+
+static const char *TAG = "transition";
+
+typedef struct {
+    lv_draw_buf_t buf;
+    lv_image_dsc_t dsc;             /* The same pixels as an image source */
+    lv_obj_t *img;
+} transition_snapshot_t;
+
+static struct {
+    lv_display_t *disp;
+    lv_obj_t *screen;               /* Holds only the two snapshots while animating */
+    transition_snapshot_t from;
+    transition_snapshot_t to;
+    lv_obj_t *target;
+    app_transition_type_t type;
+    bool active;
+    int64_t start_us;
+    int64_t render_start_us;
+    uint32_t frames;
+    uint64_t render_sum_us;
+    uint32_t render_max_us;
+    uint32_t snapshot_ms;
+    lv_obj_t *pages[APP_TRANSITION_MAX_PAGES];
+    int num_pages;
+    int page;
+    portMUX_TYPE stats_lock;
+    app_transition_stats_t stats;
+} s_tr = {
+    .stats_lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+static esp_err_t transition_alloc_snapshot(transition_snapshot_t *snap, int32_t w, int32_t h)
+{
+    uint32_t stride = w * sizeof(uint16_t);
+    void *px = heap_caps_malloc(stride * h, MALLOC_CAP_SPIRAM);
+    ESP_RETURN_ON_FALSE(px, ESP_ERR_NO_MEM, TAG, "no memory for a snapshot");
+    if (lv_draw_buf_init(&snap->buf, w, h, LV_COLOR_FORMAT_RGB565, stride, px, stride * h) != LV_RESULT_OK) {
+        heap_caps_free(px);
+        memset(snap, 0, sizeof(*snap));
+        return ESP_ERR_INVALID_SIZE;
+    }
+    snap->dsc = (lv_image_dsc_t) {
+        .header = {
+            .magic = LV_IMAGE_HEADER_MAGIC,
+            .cf = LV_COLOR_FORMAT_RGB565,
+            .w = w,
+            .h = h,
+            .stride = stride,
+        },
+        .data_size = stride * h,
+        .data = px,
+    };
+    snap->img = lv_image_create(s_tr.screen);
+    lv_image_set_src(snap->img, &snap->dsc);
+    return ESP_OK;
+}
+
+/* The snapshot screen never needs anything drawn below it, not even the display background */
+static void transition_cover_cb(lv_event_t *e)
+{
+    lv_event_set_cover_res(e, LV_COVER_RES_COVER);
+}
+
+static esp_err_t transition_prepare(void)
+{
+    if (s_tr.screen) {
+        return ESP_OK;
+    }
+    int32_t w = lv_display_get_horizontal_resolution(s_tr.disp);
+    int32_t h = lv_display_get_vertical_resolution(s_tr.disp);
+
+    s_tr.screen = lv_obj_create(NULL);
+    lv_obj_remove_style_all(s_tr.screen);
+    lv_obj_remove_flag(s_tr.screen, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_event_cb(s_tr.screen, transition_cover_cb, LV_EVENT_COVER_CHECK, NULL);
+    esp_err_t ret = transition_alloc_snapshot(&s_tr.from, w, h);
+    if (ret == ESP_OK) {
+        ret = transition_alloc_snapshot(&s_tr.to, w, h);
+    }
+    if (ret != ESP_OK) {
+        heap_caps_free(s_tr.from.buf.data);
+        lv_obj_delete(s_tr.screen);
+        s_tr.screen = NULL;
+        memset(&s_tr.from, 0, sizeof(s_tr.from));
+        return ret;
+    }
+    return ESP_OK;
+}
+
+/* Give the snapshots back once the target screen is shown, they are only needed while animating */
+static void transition_release(void)
+{
+    lv_image_cache_drop(&s_tr.from.dsc);
+    lv_image_cache_drop(&s_tr.to.dsc);
+    lv_obj_delete(s_tr.screen);
+    heap_caps_free(s_tr.from.buf.data);
+    heap_caps_free(s_tr.to.buf.data);
+    memset(&s_tr.from, 0, sizeof(s_tr.from));
+    memset(&s_tr.to, 0, sizeof(s_tr.to));
+    s_tr.screen = NULL;
+}
+
+static esp_err_t transition_take(transition_snapshot_t *snap, lv_obj_t *screen)
+{
+    lv_obj_update_layout(screen);
+    ESP_RETURN_ON_FALSE(lv_snapshot_take_to_draw_buf(screen, LV_COLOR_FORMAT_RGB565, &snap->buf) == LV_RESULT_OK,
+                        ESP_FAIL, TAG, "snapshot failed");
+    /* Same buffer, new pixels */
+    lv_image_cache_drop(&snap->dsc);
+    return ESP_OK;
+}
+
+/* Pure slides draw two opaque, unscaled RGB565 images: LVGL's software renderer copies them
+ * with one memcpy per row. Fades blend the new snapshot over the old one. */
+static void transition_anim_cb(void *var, int32_t progress)
+{
+    int32_t w = lv_display_get_horizontal_resolution(s_tr.disp);
+    int32_t dx = w * progress / TRANSITION_PROGRESS_MAX;
+
+    switch (s_tr.type) {
+    case APP_TRANSITION_SLIDE_LEFT:
+        lv_obj_set_x(s_tr.from.img, -dx);
+        lv_obj_set_x(s_tr.to.img, w - dx);
+        break;
+    case APP_TRANSITION_SLIDE_RIGHT:
+        lv_obj_set_x(s_tr.from.img, dx);
+        lv_obj_set_x(s_tr.to.img, dx - w);
+        break;
+    case APP_TRANSITION_FADE:
+        lv_obj_set_style_image_opa(s_tr.to.img, (lv_opa_t)LV_MIN(progress, LV_OPA_COVER), 0);
+        break;
+    }
+}
+
+static void transition_completed_cb(lv_anim_t *a)
+{
+    uint32_t ms = (uint32_t)((esp_timer_get_time() - s_tr.start_us) / 1000);
+    lv_screen_load(s_tr.target);
+    transition_release();
+    s_tr.active = false;
+
+    app_transition_stats_t st = {
+        .frames = s_tr.frames,
+        .duration_ms = ms,
+        .fps_x10 = ms ? s_tr.frames * 10000 / ms : 0,
+        .render_avg_us = s_tr.frames ? (uint32_t)(s_tr.render_sum_us / s_tr.frames) : 0,
+        .render_max_us = s_tr.render_max_us,
+        .snapshot_ms = s_tr.snapshot_ms,
+    };
+    portENTER_CRITICAL(&s_tr.stats_lock);
+    st.transitions = s_tr.stats.transitions + 1;
+    s_tr.stats = st;
+    portEXIT_CRITICAL(&s_tr.stats_lock);
+    ESP_LOGI(TAG, "%s frames=%"PRIu32" ms=%"PRIu32" fps=%"PRIu32".%"PRIu32" render_avg_us=%"PRIu32
+             " render_max_us=%"PRIu32" snapshot_ms=%"PRIu32, s_tr.type == APP_TRANSITION_FADE ? "fade" : "slide",
+             st.frames, st.duration_ms, st.fps_x10 / 10, st.fps_x10 % 10, st.render_avg_us, st.render_max_us,
+             st.snapshot_ms);
+}
+
+static void transition_render_cb(lv_event_t *e)
+{
+    if (!s_tr.active) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    if (lv_event_get_code(e) == LV_EVENT_RENDER_START) {
+        s_tr.render_start_us = now;
+    } else if (s_tr.render_start_us) {
+        uint32_t us = (uint32_t)(now - s_tr.render_start_us);
+        s_tr.frames++;
+        s_tr.render_sum_us += us;
+        s_tr.render_max_us = LV_MAX(s_tr.render_max_us, us);
+        s_tr.render_start_us = 0;
+    }
+}
+
+esp_err_t app_transition_init(lv_display_t *disp)
+{
+    ESP_RETURN_ON_FALSE(disp, ESP_ERR_INVALID_ARG, TAG, "display is required");
+
+    s_tr.disp = disp;
+    lv_display_add_event_cb(disp, transition_render_cb, LV_EVENT_RENDER_START, NULL);
+    lv_display_add_event_cb(disp, transition_render_cb, LV_EVENT_RENDER_READY, NULL);
+    return ESP_OK;
+}
+
+esp_err_t app_transition_load(lv_obj_t *screen, app_transition_type_t type)
+{
+    ESP_RETURN_ON_FALSE(s_tr.disp, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    ESP_RETURN_ON_FALSE(screen && type <= APP_TRANSITION_FADE, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(!s_tr.active, ESP_ERR_INVALID_STATE, TAG, "a transition is running");
+    lv_obj_t *from = lv_display_get_screen_active(s_tr.disp);
+    if (from == screen) {
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_ERROR(transition_prepare(), TAG, "no memory for the snapshots");
+
+    esp_err_t ret = ESP_OK;
+    int64_t start = esp_timer_get_time();
+    ESP_GOTO_ON_ERROR(transition_take(&s_tr.from, from), err, TAG, "snapshot of the old screen failed");
+    ESP_GOTO_ON_ERROR(transition_take(&s_tr.to, screen), err, TAG, "snapshot of the new screen failed");
+    s_tr.snapshot_ms = (uint32_t)((esp_timer_get_time() - start) / 1000);
+
+    /* The new snapshot is drawn last, over the old one */
+    lv_obj_set_pos(s_tr.from.img, 0, 0);
+    lv_obj_set_pos(s_tr.to.img, 0, 0);
+    lv_obj_set_style_image_opa(s_tr.to.img, LV_OPA_COVER, 0);
+    s_tr.target = screen;
+    s_tr.type = type;
+    transition_anim_cb(NULL, 0);
+    lv_screen_load(s_tr.screen);
+
+    s_tr.frames = 0;
+    s_tr.render_sum_us = 0;
+    s_tr.render_max_us = 0;
+    s_tr.render_start_us = 0;
+    s_tr.start_us = esp_timer_get_time();
+    s_tr.active = true;
+
+    lv_anim_t a;
+    lv_anim_init(&a);
+    lv_anim_set_var(&a, &s_tr);
+    lv_anim_set_values(&a, 0, TRANSITION_PROGRESS_MAX);
+    lv_anim_set_duration(&a, CONFIG_APP_TRANSITION_TIME_MS);
+    lv_anim_set_exec_cb(&a, transition_anim_cb);
+    lv_anim_set_path_cb(&a, lv_anim_path_ease_out);
+    lv_anim_set_completed_cb(&a, transition_completed_cb);
+    lv_anim_start(&a);
+    return ESP_OK;
+
+err:
+    transition_release();
+    return ret;
+}
+
+static void transition_gesture_cb(lv_event_t *e)
+{
+    lv_dir_t dir = lv_indev_get_gesture_dir(lv_indev_active());
+    if (dir == LV_DIR_LEFT && s_tr.page + 1 < s_tr.num_pages) {
+        app_transition_show_page(s_tr.page + 1, APP_TRANSITION_SLIDE_LEFT);
+    } else if (dir == LV_DIR_RIGHT && s_tr.page > 0) {
+        app_transition_show_page(s_tr.page - 1, APP_TRANSITION_SLIDE_RIGHT);
+    }
+}
+
+esp_err_t app_transition_add_page(lv_obj_t *screen)
+{
+    ESP_RETURN_ON_FALSE(screen, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(s_tr.num_pages < APP_TRANSITION_MAX_PAGES, ESP_ERR_NO_MEM, TAG, "too many pages");
+
+    s_tr.pages[s_tr.num_pages++] = screen;
+    lv_obj_add_event_cb(screen, transition_gesture_cb, LV_EVENT_GESTURE, NULL);
+    return ESP_OK;
+}
+
+esp_err_t app_transition_show_page(int page, app_transition_type_t type)
+{
+    ESP_RETURN_ON_FALSE(page >= 0 && page < s_tr.num_pages, ESP_ERR_INVALID_ARG, TAG, "no page %d", page);
+    if (type != APP_TRANSITION_FADE) {
+        type = page > s_tr.page ? APP_TRANSITION_SLIDE_LEFT : APP_TRANSITION_SLIDE_RIGHT;
+    }
+    ESP_RETURN_ON_ERROR(app_transition_load(s_tr.pages[page], type), TAG, "load page %d failed", page);
+    s_tr.page = page;
+    return ESP_OK;
+}
+
+void app_transition_get_stats(app_transition_stats_t *stats)
+{
+    portENTER_CRITICAL(&s_tr.stats_lock);
+    *stats = s_tr.stats;
+    s_tr.stats.transitions = 0;
+    portEXIT_CRITICAL(&s_tr.stats_lock);
+}
+
+static int transition_cmd(int argc, char **argv)
+{
+    if (argc >= 2) {
+        app_transition_type_t type = APP_TRANSITION_SLIDE_LEFT;
+        if (argc == 3 && strcmp(argv[2], "fade") == 0) {
+            type = APP_TRANSITION_FADE;
+        } else if (argc == 3 && strcmp(argv[2], "slide") != 0) {
+            printf("usage: page [<page> [slide|fade]]\n");
+            return 1;
+        }
+        lvgl_port_lock(0);
+        esp_err_t err = app_transition_show_page(atoi(argv[1]), type);
+        lvgl_port_unlock();
+        return err == ESP_OK ? 0 : 1;
+    }
+
+    app_transition_stats_t st;
+    app_transition_get_stats(&st);
+    printf("page: page=%d pages=%d transitions=%" PRIu32 " frames=%" PRIu32 " ms=%" PRIu32 " fps=%" PRIu32 ".%" PRIu32
+           " render_avg_us=%" PRIu32 " render_max_us=%" PRIu32 " snapshot_ms=%" PRIu32 "\n", s_tr.page, s_tr.num_pages,
+           st.transitions, st.frames, st.duration_ms, st.fps_x10 / 10, st.fps_x10 % 10, st.render_avg_us,
+           st.render_max_us, st.snapshot_ms);
+    return 0;
+}
+
+esp_err_t app_transition_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "page",
+        .help = "Show the last page transition, or go to a page: page [<page> [slide|fade]]",
+        .func = transition_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
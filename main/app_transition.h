@@ -0,0 +1,79 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APP_TRANSITION_MAX_PAGES    (4)
+
+typedef enum {
+    APP_TRANSITION_SLIDE_LEFT,      /*!< The new screen comes in from the right */
+    APP_TRANSITION_SLIDE_RIGHT,     /*!< The new screen comes in from the left */
+    APP_TRANSITION_FADE,            /*!< The new screen fades in over the old one */
+} app_transition_type_t;
+
+typedef struct {
+    uint32_t transitions;           /*!< Transitions completed */
+    uint32_t frames;                /*!< Frames rendered during the last one */
+    uint32_t duration_ms;           /*!< From the start of its animation to the end */
+    uint32_t fps_x10;
+    uint32_t render_avg_us;         /*!< Per frame, LV_EVENT_RENDER_START to LV_EVENT_RENDER_READY */
+    uint32_t render_max_us;
+    uint32_t snapshot_ms;           /*!< Rendering both screens into snapshots */
+} app_transition_stats_t;
+
+/**
+ * @brief Prepare transitions on `disp`
+ *
+ * The snapshot buffers, two screens of RGB565 in PSRAM, are allocated by each transition
+ * and freed once it completed.
+ * Must be called with the LVGL lock held.
+ */
+esp_err_t app_transition_init(lv_display_t *disp);
+
+/**
+ * @brief Load `screen` with an animated transition from the active screen
+ *
+ * Both screens are rendered once into snapshots, then a screen holding only the two snapshots
+ * is shown while they are moved or blended, and `screen` is loaded when the animation ends.
+ * Neither live screen is drawn during the animation. Must be called with the LVGL lock held.
+ *
+ * @return ESP_ERR_INVALID_STATE while another transition runs
+ */
+esp_err_t app_transition_load(lv_obj_t *screen, app_transition_type_t type);
+
+/**
+ * @brief Add a screen to the pages swiped through with left and right gestures, in order
+ *
+ * Must be called with the LVGL lock held.
+ */
+esp_err_t app_transition_add_page(lv_obj_t *screen);
+
+/**
+ * @brief Go to page `page` with `type`, or sliding in the direction of the page when `type` is a slide
+ *
+ * Must be called with the LVGL lock held.
+ */
+esp_err_t app_transition_show_page(int page, app_transition_type_t type);
+
+/**
+ * @brief Read the results of the last transition and clear the count
+ */
+void app_transition_get_stats(app_transition_stats_t *stats);
+
+/**
+ * @brief Add the "page" console command
+ */
+esp_err_t app_transition_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,174 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "esp_log.h"
+#include "esp_check.h"
+#include "app_vlist.h"
+
+#define VLIST_UNBOUND   UINT32_MAX
+
+static const char *TAG = "vlist";
+
+typedef struct {
+    lv_obj_t *obj;
+    uint32_t index;             /* Item shown, VLIST_UNBOUND when hidden */
+} vlist_row_t;
+
+typedef struct {
+    app_vlist_config_t config;
+    lv_obj_t *list;
+    lv_obj_t *spacer;           /* Last pixel of the last item, sets how far the list scrolls */
+    vlist_row_t *rows;
+    uint32_t num_rows;
+    uint32_t count;
+    uint32_t binds;
+} vlist_t;
+
+static vlist_t *vlist_get(lv_obj_t *list)
+{
+    return lv_obj_get_user_data(list);
+}
+
+static void vlist_unbind_all(vlist_t *v)
+{
+    for (uint32_t i = 0; i < v->num_rows; i++) {
+        v->rows[i].index = VLIST_UNBOUND;
+        lv_obj_add_flag(v->rows[i].obj, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
+/* Build rows until they cover the content height plus the margins, or every item, rows are never released */
+static void vlist_build_rows(vlist_t *v)
+{
+    int32_t height = lv_obj_get_content_height(v->list);
+    uint32_t needed = (uint32_t)(LV_MAX(height, 0) / v->config.row_height) + 2 + 2 * v->config.margin_rows;
+    needed = LV_MIN(needed, v->count);
+    if (needed <= v->num_rows) {
+        return;
+    }
+
+    vlist_row_t *rows = lv_realloc(v->rows, needed * sizeof(vlist_row_t));
+    if (!rows) {
+        ESP_LOGE(TAG, "no memory for %u rows", (unsigned)needed);
+        return;
+    }
+    v->rows = rows;
+    /* Item k always lives in row k % num_rows, the mapping changes with the row count */
+    vlist_unbind_all(v);
+    for (uint32_t i = v->num_rows; i < needed; i++) {
+        lv_obj_t *row = lv_obj_create(v->list);
+        lv_obj_set_size(row, LV_PCT(100), v->config.row_height);
+        lv_obj_remove_flag(row, LV_OBJ_FLAG_SCROLLABLE);
+        lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+        v->config.create_row(row, v->config.user_data);
+        v->rows[i] = (vlist_row_t) {
+            .obj = row,
+            .index = VLIST_UNBOUND,
+        };
+    }
+    v->num_rows = needed;
+}
+
+/* Bind the rows to the items around the scroll position, rows already showing their item are left alone */
+static void vlist_update(vlist_t *v)
+{
+    if (!v->num_rows) {
+        return;
+    }
+    int32_t first = lv_obj_get_scroll_y(v->list) / v->config.row_height - (int32_t)v->config.margin_rows;
+    first = LV_MAX(first, 0);
+
+    for (uint32_t index = first; index < first + v->num_rows; index++) {
+        vlist_row_t *row = &v->rows[index % v->num_rows];
+        if (index >= v->count) {
+            if (row->index != VLIST_UNBOUND) {
+                lv_obj_add_flag(row->obj, LV_OBJ_FLAG_HIDDEN);
+                row->index = VLIST_UNBOUND;
+            }
+            continue;
+        }
+        if (row->index == index) {
+            continue;
+        }
+        lv_obj_set_y(row->obj, (int32_t)index * v->config.row_height);
+        v->config.bind_row(row->obj, index, v->config.user_data);
+        lv_obj_remove_flag(row->obj, LV_OBJ_FLAG_HIDDEN);
+        row->index = index;
+        v->binds++;
+    }
+}
+
+static void vlist_event_cb(lv_event_t *e)
+{
+    vlist_t *v = lv_event_get_user_data(e);
+
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_SIZE_CHANGED:
+        vlist_build_rows(v);
+        vlist_update(v);
+        break;
+    case LV_EVENT_SCROLL:
+        vlist_update(v);
+        break;
+    case LV_EVENT_DELETE:
+        lv_free(v->rows);
+        lv_free(v);
+        break;
+    default:
+        break;
+    }
+}
+
+lv_obj_t *app_vlist_create(lv_obj_t *parent, const app_vlist_config_t *config)
+{
+    ESP_RETURN_ON_FALSE(config && config->row_height > 0 && config->create_row && config->bind_row, NULL, TAG,
+                        "invalid argument");
+
+    vlist_t *v = lv_malloc(sizeof(vlist_t));
+    ESP_RETURN_ON_FALSE(v, NULL, TAG, "no memory for the list");
+    *v = (vlist_t) {
+        .config = *config,
+    };
+
+    v->list = lv_obj_create(parent);
+    lv_obj_set_user_data(v->list, v);
+    lv_obj_set_scroll_dir(v->list, LV_DIR_VER);
+    lv_obj_add_event_cb(v->list, vlist_event_cb, LV_EVENT_SIZE_CHANGED, v);
+    lv_obj_add_event_cb(v->list, vlist_event_cb, LV_EVENT_SCROLL, v);
+    lv_obj_add_event_cb(v->list, vlist_event_cb, LV_EVENT_DELETE, v);
+
+    v->spacer = lv_obj_create(v->list);
+    lv_obj_remove_style_all(v->spacer);
+    lv_obj_remove_flag(v->spacer, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_set_size(v->spacer, 1, 1);
+    lv_obj_set_pos(v->spacer, 0, 0);
+    return v->list;
+}
+
+void app_vlist_set_count(lv_obj_t *list, uint32_t count)
+{
+    vlist_t *v = vlist_get(list);
+    v->count = count;
+    lv_obj_set_y(v->spacer, count ? (int32_t)count * v->config.row_height - 1 : 0);
+    /* Scroll back into range when the list got shorter, before the rows are bound to the scroll position */
+    lv_obj_update_layout(list);
+    lv_obj_readjust_scroll(list, LV_ANIM_OFF);
+    vlist_build_rows(v);
+    app_vlist_refresh(list);
+}
+
+void app_vlist_refresh(lv_obj_t *list)
+{
+    vlist_t *v = vlist_get(list);
+    vlist_unbind_all(v);
+    vlist_update(v);
+}
+
+void app_vlist_get_stats(lv_obj_t *list, app_vlist_stats_t *stats)
+{
+    vlist_t *v = vlist_get(list);
+    stats->rows = v->num_rows;
+    stats->binds = v->binds;
+    v->binds = 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Add the children of an empty row, called once per row object
+ */
+typedef void (*app_vlist_create_row_cb_t)(lv_obj_t *row, void *user_data);
+
+/**
+ * @brief Show item `index` in a row built by app_vlist_create_row_cb_t
+ */
+typedef void (*app_vlist_bind_row_cb_t)(lv_obj_t *row, uint32_t index, void *user_data);
+
+typedef struct {
+    int32_t row_height;                     /*!< Every row is this high, in pixels */
+    uint32_t margin_rows;                   /*!< Rows kept bound above and below the visible ones */
+    app_vlist_create_row_cb_t create_row;
+    app_vlist_bind_row_cb_t bind_row;
+    void *user_data;
+} app_vlist_config_t;
+
+typedef struct {
+    uint32_t rows;              /*!< Row objects built, whatever the item count */
+    uint32_t binds;             /*!< Rows bound to another item */
+} app_vlist_stats_t;
+
+/**
+ * @brief Create a vertically scrolling list of equally high rows that only builds the visible ones
+ *
+ * Rows are built once the list got its size, enough to cover its height plus `margin_rows`
+ * on either side. When scrolled, rows that left that window are moved to the other end
+ * and bound to the items that came into view. Only call with the LVGL lock held.
+ */
+lv_obj_t *app_vlist_create(lv_obj_t *parent, const app_vlist_config_t *config);
+
+/**
+ * @brief Set the number of items, rebinding every row
+ */
+void app_vlist_set_count(lv_obj_t *list, uint32_t count);
+
+/**
+ * @brief Rebind every row after the items changed in place
+ */
+void app_vlist_refresh(lv_obj_t *list);
+
+/**
+ * @brief Read the statistics of `list`, the bind count is cleared
+ */
+void app_vlist_get_stats(lv_obj_t *list, app_vlist_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,325 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_console.h"
+#include "app_config.h"
+#include "app_http.h"
+#include "app_mem.h"
+#include "app_model.h"
+#include "app_render.h"
+#include "app_trace.h"
+#include "app_wifi.h"
+#include "app_weather.h"
+
+#define WEATHER_TASK_STACK      (3072)
+#define WEATHER_WORKER_STACK    (8192)  /* TLS handshakes run on the workers */
+#define WEATHER_URL_MAX         (96)
+#define WEATHER_CODE_LEN        (sizeof(((app_weather_snapshot_t *)0)->city_code))
+
+static const char *TAG = "weather";
+
+/* d1.weather.com.cn answers 403 without a referer from its own site */
+static const char *const s_headers[] = {
+    "Referer: http://www.weather.com.cn/",
+    NULL,
+};
+
+/* A console request, applied by the refresh task between refreshes */
+typedef struct {
+    int concurrency;                                        /* 0 keeps the current one */
+    int count;                                              /* 0 keeps the current cities */
+    char base_url[WEATHER_URL_MAX];                         /* Empty keeps the current one */
+    char codes[APP_MODEL_MAX_CITIES][WEATHER_CODE_LEN];
+} weather_request_t;
+
+static struct {
+    char base_url[WEATHER_URL_MAX];
+    char cities[APP_CONFIG_WEATHER_CITIES_MAX];             /* Setting the codes were last taken from */
+    char codes[APP_MODEL_MAX_CITIES][WEATHER_CODE_LEN];
+    int count;
+    int concurrency;
+    TaskHandle_t refresher;
+    TaskHandle_t workers[CONFIG_APP_WEATHER_CONCURRENCY];
+    QueueHandle_t requests;
+    /* State of the refresh in progress */
+    atomic_int next;                /* Index of the next city to fetch */
+    atomic_int active;              /* Workers still fetching, the last one wakes the refresher */
+    int64_t start_us;
+    portMUX_TYPE lock;
+    uint32_t first_ms;              /* Until the first city was published */
+    uint32_t slowest_ms;            /* Longest single city */
+    uint32_t failures;
+} s_weather = {
+    .lock = portMUX_INITIALIZER_UNLOCKED,
+};
+
+/* Copies the string value of `key` from the flat JSON object, false when it is missing */
+static bool weather_json_string(const char *json, const char *key, char *out, size_t len)
+{
+    char pattern[24];
+    snprintf(pattern, sizeof(pattern), "\"%s\":\"", key);
+    const char *p = strstr(json, pattern);
+    if (!p) {
+        return false;
+    }
+    p += strlen(pattern);
+    const char *end = strchr(p, '"');
+    if (!end) {
+        return false;
+    }
+
+    size_t n = end - p;
+    if (n >= len) {
+        /* Cut at a UTF-8 character boundary */
+        n = len - 1;
+        while (n && ((uint8_t)p[n] & 0xC0) == 0x80) {
+            n--;
+        }
+    }
+    memcpy(out, p, n);
+    out[n] = '\0';
+    return true;
+}
+
+/* Parses the "var dataSK={...}" body of d1.weather.com.cn/sk_2d/<code>.html */
+static esp_err_t weather_parse(const char *body, app_weather_snapshot_t *snap)
+{
+    char value[16];
+    const char *json = body ? strchr(body, '{') : NULL;
+    ESP_RETURN_ON_FALSE(json, ESP_ERR_INVALID_RESPONSE, TAG, "no JSON object in the response");
+    ESP_RETURN_ON_FALSE(weather_json_string(json, "temp", value, sizeof(value)), ESP_ERR_INVALID_RESPONSE, TAG,
+                        "no temperature in the response");
+
+    snap->temp_c10 = (int16_t)lroundf(strtof(value, NULL) * 10.0f);
+    snap->temp_low_c10 = APP_WEATHER_TEMP_NONE;     /* The current conditions carry no range */
+    snap->temp_high_c10 = APP_WEATHER_TEMP_NONE;
+    if (weather_json_string(json, "SD", value, sizeof(value))) {
+        snap->humidity_pct = (uint8_t)MIN(atoi(value), 100);
+    }
+    if (weather_json_string(json, "weathercode", value, sizeof(value))) {
+        snap->icon = (uint8_t)atoi(value + 1);      /* "d01" by day, "n01" by night */
+    }
+    weather_json_string(json, "cityname", snap->city_name, sizeof(snap->city_name));
+    weather_json_string(json, "weather", snap->condition, sizeof(snap->condition));
+    return ESP_OK;
+}
+
+static void weather_fetch_city(int city, app_arena_handle_t arena)
+{
+    const char *code = s_weather.codes[city];
+    char url[WEATHER_URL_MAX + WEATHER_CODE_LEN + 8];
+    snprintf(url, sizeof(url), "%s%s.html", s_weather.base_url, code);
+
+    app_weather_snapshot_t snap = { 0 };
+    app_http_response_t resp;
+    int64_t start = esp_timer_get_time();
+    APP_TRACE_BEGIN(APP_TRACE_NET_FETCH, city);
+    esp_err_t ret = app_http_get(url, s_headers, arena, &resp);
+    if (ret == ESP_OK && resp.status != 200) {
+        ret = ESP_ERR_INVALID_RESPONSE;
+    }
+    if (ret == ESP_OK) {
+        ret = weather_parse(resp.body, &snap);
+    }
+    APP_TRACE_END(APP_TRACE_NET_FETCH, city);
+
+    int64_t now = esp_timer_get_time();
+    uint32_t ms = (uint32_t)((now - start) / 1000);
+    uint32_t at_ms = (uint32_t)((now - s_weather.start_us) / 1000);
+    if (ret == ESP_OK) {
+        strlcpy(snap.city_code, code, sizeof(snap.city_code));
+        snap.updated_us = now;
+        app_model_publish_weather(city, &snap);
+        ESP_LOGI(TAG, "%s %s %s%d.%dC at %"PRIu32" ms", code, snap.city_name, snap.temp_c10 < 0 ? "-" : "",
+                 abs(snap.temp_c10) / 10, abs(snap.temp_c10) % 10, at_ms);
+    } else {
+        ESP_LOGW(TAG, "%s: %s, status %d", code, esp_err_to_name(ret), resp.status);
+    }
+
+    /* The body was parsed into the model, the next city starts from an empty arena */
+    app_arena_reset(arena);
+
+    portENTER_CRITICAL(&s_weather.lock);
+    if (ret == ESP_OK && !s_weather.first_ms) {
+        s_weather.first_ms = MAX(at_ms, 1);
+    }
+    s_weather.slowest_ms = MAX(s_weather.slowest_ms, ms);
+    s_weather.failures += ret != ESP_OK;
+    portEXIT_CRITICAL(&s_weather.lock);
+}
+
+static void weather_worker_task(void *arg)
+{
+    app_arena_handle_t arena = app_mem_fetch_arena((int)(intptr_t)arg);
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        /* Take the next city until none is left, so a slow response never holds up the others */
+        int city;
+        while ((city = atomic_fetch_add(&s_weather.next, 1)) < s_weather.count) {
+            weather_fetch_city(city, arena);
+        }
+        if (atomic_fetch_sub(&s_weather.active, 1) == 1) {
+            xTaskNotifyGive(s_weather.refresher);
+        }
+    }
+}
+
+static void weather_refresh(void)
+{
+    int workers = MIN(s_weather.concurrency, s_weather.count);
+
+    s_weather.first_ms = 0;
+    s_weather.slowest_ms = 0;
+    s_weather.failures = 0;
+    atomic_store(&s_weather.next, 0);
+    atomic_store(&s_weather.active, workers);
+    s_weather.start_us = esp_timer_get_time();
+    for (int i = 0; i < workers; i++) {
+        xTaskNotifyGive(s_weather.workers[i]);
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    ESP_LOGI(TAG, "refresh cities=%d concurrency=%d first_ms=%"PRIu32" total_ms=%"PRIu32" slowest_ms=%"PRIu32
+             " failures=%"PRIu32, s_weather.count, workers, s_weather.first_ms,
+             (uint32_t)((esp_timer_get_time() - s_weather.start_us) / 1000), s_weather.slowest_ms, s_weather.failures);
+}
+
+static void weather_apply_request(const weather_request_t *req)
+{
+    if (req->concurrency) {
+        s_weather.concurrency = req->concurrency;
+    }
+    if (req->base_url[0]) {
+        strlcpy(s_weather.base_url, req->base_url, sizeof(s_weather.base_url));
+    }
+    if (req->count) {
+        memcpy(s_weather.codes, req->codes, sizeof(s_weather.codes));
+        s_weather.count = req->count;
+    }
+}
+
+/* Appends the codes of a space or comma separated list after the first `count`, returns the new count */
+static int weather_add_codes(char codes[][WEATHER_CODE_LEN], int count, const char *list)
+{
+    char buf[128];
+    char *save = NULL;
+    strlcpy(buf, list, sizeof(buf));
+    for (char *tok = strtok_r(buf, " ,", &save); tok && count < APP_MODEL_MAX_CITIES; tok = strtok_r(NULL, " ,", &save)) {
+        strlcpy(codes[count++], tok, WEATHER_CODE_LEN);
+    }
+    return count;
+}
+
+static void weather_task(void *arg)
+{
+    bool refresh = app_config_get()->weather_refresh_s > 0;
+    weather_request_t req;
+
+    while (1) {
+        /* Cities from the console last until the setting changes */
+        const app_config_t *cfg = app_config_get();
+        if (strcmp(cfg->weather_cities, s_weather.cities) != 0) {
+            strlcpy(s_weather.cities, cfg->weather_cities, sizeof(s_weather.cities));
+            s_weather.count = weather_add_codes(s_weather.codes, 0, s_weather.cities);
+        }
+        if (refresh && s_weather.count) {
+            app_wifi_wait_connected(-1);
+            weather_refresh();
+        }
+        refresh = true;
+        uint32_t refresh_s = app_config_get()->weather_refresh_s;
+        TickType_t period = refresh_s ? pdMS_TO_TICKS(refresh_s * 1000) : portMAX_DELAY;
+        if (xQueueReceive(s_weather.requests, &req, period) == pdTRUE) {
+            weather_apply_request(&req);
+        }
+    }
+}
+
+/* New cities, or a new period, take effect with a refresh right away */
+static void weather_config_changed(uint32_t changed, void *arg)
+{
+    if (changed & ((1u << APP_CONFIG_WEATHER_CITIES) | (1u << APP_CONFIG_WEATHER_REFRESH_S))) {
+        /* An empty request only wakes the refresh task, one already queued does as well */
+        const weather_request_t req = { 0 };
+        xQueueSend(s_weather.requests, &req, 0);
+    }
+}
+
+esp_err_t app_weather_start(void)
+{
+    ESP_RETURN_ON_FALSE(!s_weather.refresher, ESP_ERR_INVALID_STATE, TAG, "already started");
+
+    strlcpy(s_weather.base_url, CONFIG_APP_WEATHER_URL, sizeof(s_weather.base_url));
+    s_weather.concurrency = CONFIG_APP_WEATHER_CONCURRENCY;
+
+    s_weather.requests = xQueueCreate(1, sizeof(weather_request_t));
+    ESP_RETURN_ON_FALSE(s_weather.requests, ESP_ERR_NO_MEM, TAG, "no memory for queue");
+    for (int i = 0; i < CONFIG_APP_WEATHER_CONCURRENCY; i++) {
+        char name[configMAX_TASK_NAME_LEN];
+        snprintf(name, sizeof(name), "weather%d", i);
+        BaseType_t ret = xTaskCreatePinnedToCore(weather_worker_task, name, WEATHER_WORKER_STACK, (void *)(intptr_t)i,
+                                                 2, &s_weather.workers[i], app_render_background_core());
+        ESP_RETURN_ON_FALSE(ret == pdPASS, ESP_ERR_NO_MEM, TAG, "create worker task failed");
+    }
+    BaseType_t ret = xTaskCreatePinnedToCore(weather_task, "weather", WEATHER_TASK_STACK, NULL, 2, &s_weather.refresher,
+                                             app_render_background_core());
+    ESP_RETURN_ON_FALSE(ret == pdPASS, ESP_ERR_NO_MEM, TAG, "create weather task failed");
+    return app_config_add_listener(weather_config_changed, NULL);
+}
+
+static int weather_cmd(int argc, char **argv)
+{
+    weather_request_t req = { 0 };
+
+    int i = 1;
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (strcmp(argv[i], "-c") == 0) {
+            req.concurrency = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-u") == 0) {
+            strlcpy(req.base_url, argv[i + 1], sizeof(req.base_url));
+        } else {
+            break;
+        }
+    }
+    if ((i < argc && argv[i][0] == '-') || req.concurrency < 0 || req.concurrency > CONFIG_APP_WEATHER_CONCURRENCY) {
+        printf("usage: weather [-c <1..%d>] [-u <base url>] [city code ...]\n", CONFIG_APP_WEATHER_CONCURRENCY);
+        return 1;
+    }
+    for (; i < argc; i++) {
+        req.count = weather_add_codes(req.codes, req.count, argv[i]);
+    }
+
+    if (!s_weather.requests || xQueueSend(s_weather.requests, &req, 0) != pdTRUE) {
+        printf("weather: busy\n");
+        return 1;
+    }
+    return 0;
+}
+
+esp_err_t app_weather_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "weather",
+        .help = "Refresh the weather now, optionally changing the cities, the concurrency or the server: "
+                "weather [-c <concurrency>] [-u <base url>] [city code ...]",
+        .func = weather_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,32 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Start refreshing the weather of the wx_cities setting every wx_refresh_s seconds
+ *
+ * Up to CONFIG_APP_WEATHER_CONCURRENCY cities are fetched at once over the app_http pool.
+ * Each city is parsed and published to the data model as soon as its response is in,
+ * the first city goes to the dashboard. Every refresh logs
+ * "weather: refresh cities= concurrency= first_ms= total_ms= slowest_ms= failures=".
+ *
+ * Changing either setting refreshes right away. Call after app_http_init().
+ */
+esp_err_t app_weather_start(void);
+
+/**
+ * @brief Add the "weather" console command refreshing now, optionally with other cities
+ */
+esp_err_t app_weather_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
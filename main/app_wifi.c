@@ -0,0 +1,148 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <inttypes.h>
+#include <sys/param.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "esp_console.h"
+#include "app_timeline.h"
+#include "app_wifi.h"
+
+#define WIFI_CONNECTED_BIT      BIT0
+#define WIFI_RETRY_MIN_MS       (500)
+#define WIFI_RETRY_MAX_MS       (30000)
+
+static const char *TAG = "wifi";
+
+static struct {
+    EventGroupHandle_t events;
+    esp_timer_handle_t retry_timer;
+    uint32_t retry_ms;              /* Doubles after every failed attempt */
+} s_wifi;
+
+static void wifi_retry_cb(void *arg)
+{
+    esp_wifi_connect();
+}
+
+static void wifi_event_handler(void *arg, esp_event_base_t base, int32_t id, void *data)
+{
+    if (base == WIFI_EVENT && id == WIFI_EVENT_STA_START) {
+        esp_wifi_connect();
+    } else if (base == WIFI_EVENT && id == WIFI_EVENT_STA_DISCONNECTED) {
+        const wifi_event_sta_disconnected_t *ev = data;
+        xEventGroupClearBits(s_wifi.events, WIFI_CONNECTED_BIT);
+        ESP_LOGW(TAG, "disconnected, reason %d, retry in %"PRIu32" ms", ev->reason, s_wifi.retry_ms);
+        esp_timer_stop(s_wifi.retry_timer);
+        esp_timer_start_once(s_wifi.retry_timer, (uint64_t)s_wifi.retry_ms * 1000);
+        s_wifi.retry_ms = MIN(s_wifi.retry_ms * 2, WIFI_RETRY_MAX_MS);
+    } else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
+        const ip_event_got_ip_t *ev = data;
+        ESP_LOGI(TAG, "got ip " IPSTR, IP2STR(&ev->ip_info.ip));
+        s_wifi.retry_ms = WIFI_RETRY_MIN_MS;
+        xEventGroupSetBits(s_wifi.events, WIFI_CONNECTED_BIT);
+        app_timeline_mark(APP_TIMELINE_WIFI_CONNECTED);
+    }
+}
+
+esp_err_t app_wifi_start(void)
+{
+    ESP_RETURN_ON_FALSE(!s_wifi.events, ESP_ERR_INVALID_STATE, TAG, "already started");
+    s_wifi.events = xEventGroupCreate();
+    ESP_RETURN_ON_FALSE(s_wifi.events, ESP_ERR_NO_MEM, TAG, "no memory for event group");
+    s_wifi.retry_ms = WIFI_RETRY_MIN_MS;
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = wifi_retry_cb,
+        .name = "wifi_retry",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &s_wifi.retry_timer), TAG, "create retry timer failed");
+
+    ESP_RETURN_ON_ERROR(esp_netif_init(), TAG, "netif init failed");
+    ESP_RETURN_ON_ERROR(esp_event_loop_create_default(), TAG, "create event loop failed");
+    esp_netif_create_default_wifi_sta();
+
+    const wifi_init_config_t init_cfg = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_RETURN_ON_ERROR(esp_wifi_init(&init_cfg), TAG, "Wi-Fi init failed");
+    ESP_RETURN_ON_ERROR(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_event_handler, NULL), TAG,
+                        "register Wi-Fi events failed");
+    ESP_RETURN_ON_ERROR(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, wifi_event_handler, NULL), TAG,
+                        "register IP events failed");
+    ESP_RETURN_ON_ERROR(esp_wifi_set_mode(WIFI_MODE_STA), TAG, "set station mode failed");
+
+    wifi_config_t cfg = { 0 };
+    if (strlen(CONFIG_APP_WIFI_SSID)) {
+        strlcpy((char *)cfg.sta.ssid, CONFIG_APP_WIFI_SSID, sizeof(cfg.sta.ssid));
+        strlcpy((char *)cfg.sta.password, CONFIG_APP_WIFI_PASSWORD, sizeof(cfg.sta.password));
+        ESP_RETURN_ON_ERROR(esp_wifi_set_config(WIFI_IF_STA, &cfg), TAG, "set station config failed");
+    } else {
+        esp_wifi_get_config(WIFI_IF_STA, &cfg);
+    }
+    if (!cfg.sta.ssid[0]) {
+        ESP_LOGW(TAG, "no credentials, set them with the \"wifi\" command");
+        return ESP_OK;
+    }
+    ESP_LOGI(TAG, "connecting to %s", (const char *)cfg.sta.ssid);
+    return esp_wifi_start();
+}
+
+esp_err_t app_wifi_wait_connected(int timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(s_wifi.events, ESP_ERR_INVALID_STATE, TAG, "not started");
+    EventBits_t bits = xEventGroupWaitBits(s_wifi.events, WIFI_CONNECTED_BIT, pdFALSE, pdTRUE,
+                                           timeout_ms < 0 ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms));
+    return (bits & WIFI_CONNECTED_BIT) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+bool app_wifi_is_connected(void)
+{
+    return s_wifi.events && (xEventGroupGetBits(s_wifi.events) & WIFI_CONNECTED_BIT);
+}
+
+static int wifi_cmd(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3) {
+        printf("usage: wifi <ssid> [password]\n");
+        return 1;
+    }
+    wifi_config_t cfg = { 0 };
+    strlcpy((char *)cfg.sta.ssid, argv[1], sizeof(cfg.sta.ssid));
+    if (argc == 3) {
+        strlcpy((char *)cfg.sta.password, argv[2], sizeof(cfg.sta.password));
+    }
+
+    /* The driver keeps the credentials in NVS for the next boot. A station that was not
+     * running connects on start, a connected one reconnects from the disconnect event. */
+    s_wifi.retry_ms = WIFI_RETRY_MIN_MS;
+    esp_err_t ret = esp_wifi_set_config(WIFI_IF_STA, &cfg);
+    if (ret == ESP_OK) {
+        ret = esp_wifi_start();
+    }
+    if (ret == ESP_OK) {
+        esp_wifi_disconnect();
+    } else {
+        printf("wifi: %s\n", esp_err_to_name(ret));
+        return 1;
+    }
+    return 0;
+}
+
+esp_err_t app_wifi_register_console_cmd(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "wifi",
+        .help = "Connect to a Wi-Fi network and remember it: wifi <ssid> [password]",
+        .func = wifi_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
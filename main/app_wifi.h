@@ -0,0 +1,42 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Bring up the station and keep it connected
+ *
+ * Uses CONFIG_APP_WIFI_SSID when set, otherwise the credentials the Wi-Fi driver kept
+ * in NVS from the last "wifi" console command. Without either the station stays idle.
+ * Call after app_config_init(), which initializes NVS.
+ */
+esp_err_t app_wifi_start(void);
+
+/**
+ * @brief Wait until the station has an IP address
+ *
+ * @return ESP_OK when connected, ESP_ERR_TIMEOUT otherwise
+ */
+esp_err_t app_wifi_wait_connected(int timeout_ms);
+
+/**
+ * @brief Whether the station has an IP address right now
+ */
+bool app_wifi_is_connected(void);
+
+/**
+ * @brief Add the "wifi" console command setting the credentials
+ */
+esp_err_t app_wifi_register_console_cmd(void);
+
+#ifdef __cplusplus
+}
+#endif
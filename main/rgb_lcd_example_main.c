@@ -316,14 +316,14 @@ void app_main(void)
     //Reset the touch screen. It is recommended that you reset the touch screen before using it.
     write_buf = 0x2C;
     i2c_master_write_to_device(I2C_MASTER_NUM, 0x38, &write_buf, 1, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
-    esp_rom_delay_us(100 * 1000);
+    vTaskDelay(pdMS_TO_TICKS(100));
 
     gpio_set_level(GPIO_INPUT_IO_4,0);
-    esp_rom_delay_us(100 * 1000);
+    vTaskDelay(pdMS_TO_TICKS(100));
 
     write_buf = 0x2E;
     i2c_master_write_to_device(I2C_MASTER_NUM, 0x38, &write_buf, 1, I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS);
-    esp_rom_delay_us(200 * 1000);
+    vTaskDelay(pdMS_TO_TICKS(200));
     
     esp_lcd_touch_handle_t tp = NULL;
     esp_lcd_panel_io_handle_t tp_io_handle = NULL;
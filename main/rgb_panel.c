@@ -7,14 +7,61 @@
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp_check.h"
-#include "driver/i2c.h"
 #include "esp_lcd_panel_io.h"
 #include "esp_lcd_panel_ops.h"
 #include "esp_lcd_panel_rgb.h"
 #include "esp_lvgl_port.h"
 #include "lv_demos.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
 
 #include "esp_lcd_touch_gt911.h"
+#include "app_i2c_bus.h"
+#include "app_sensor.h"
+#include "app_render.h"
+#include "app_model.h"
+#include "app_dashboard.h"
+#include "app_dashboard_draw.h"
+#include "app_forecast.h"
+#include "app_icons.h"
+#include "app_shadow.h"
+#include "app_backdrop.h"
+#include "app_transition.h"
+#include "app_bind.h"
+#include "app_mem.h"
+#include "app_console.h"
+#include "app_boot.h"
+#include "app_timeline.h"
+#include "app_wifi.h"
+#include "app_http.h"
+#include "app_weather.h"
+#include "app_history.h"
+#include "app_config.h"
+
+#if CONFIG_APP_LATENCY_TRACE
+#include "app_latency.h"
+#endif
+#if CONFIG_APP_HOTSET_PROFILE
+#include "app_hotset.h"
+#endif
+#if CONFIG_APP_TRACE
+#include "app_trace.h"
+#endif
+#if CONFIG_APP_TASKMON
+#include "app_taskmon.h"
+#endif
+#if CONFIG_APP_OTA
+#include "app_ota.h"
+#endif
+#if CONFIG_APP_API
+#include "app_api.h"
+#endif
+#if CONFIG_APP_TELEMETRY
+#include "app_telemetry.h"
+#endif
+#if CONFIG_APP_MIRROR
+#include "app_mirror.h"
+#endif
 
 /* LCD size */
 #define EXAMPLE_LCD_H_RES   (800)
@@ -61,6 +108,10 @@
 #define EXAMPLE_TOUCH_I2C_SCL       (GPIO_NUM_9)
 #define EXAMPLE_TOUCH_I2C_SDA       (GPIO_NUM_8)
 
+/* Boot */
+#define EXAMPLE_BOOT_TASK_STACK     (4096)
+#define EXAMPLE_BOOT_TOUCH_DONE_BIT (BIT0)
+
 #define EXAMPLE_LCD_PANEL_35HZ_RGB_TIMING()  \
     {                                               \
         .pclk_hz = 18 * 1000 * 1000,                \
@@ -88,6 +139,10 @@ static esp_lcd_touch_handle_t touch_handle = NULL;
 static lv_display_t *lvgl_disp = NULL;
 static lv_indev_t *lvgl_touch_indev = NULL;
 
+/* Peripheral bring-up running next to app_main */
+static EventGroupHandle_t boot_events = NULL;
+static esp_err_t touch_init_ret = ESP_FAIL;
+
 static esp_err_t app_lcd_init(void)
 {
     esp_err_t ret = ESP_OK;
@@ -141,19 +196,29 @@ err:
     return ret;
 }
 
+#if CONFIG_APP_TRACE
+static esp_err_t (*touch_read_data)(esp_lcd_touch_handle_t tp);
+
+/* Brackets every GT911 read, the I2C transfers it makes show up nested */
+static esp_err_t app_touch_read_data_traced(esp_lcd_touch_handle_t tp)
+{
+    APP_TRACE_BEGIN(APP_TRACE_TOUCH_READ, 0);
+    esp_err_t ret = touch_read_data(tp);
+    APP_TRACE_END(APP_TRACE_TOUCH_READ, ret);
+    return ret;
+}
+#endif
+
 static esp_err_t app_touch_init(void)
 {
     /* Initilize I2C */
-    const i2c_config_t i2c_conf = {
-        .mode = I2C_MODE_MASTER,
+    const app_i2c_bus_config_t i2c_conf = {
+        .port = EXAMPLE_TOUCH_I2C_NUM,
         .sda_io_num = EXAMPLE_TOUCH_I2C_SDA,
-        .sda_pullup_en = GPIO_PULLUP_DISABLE,
         .scl_io_num = EXAMPLE_TOUCH_I2C_SCL,
-        .scl_pullup_en = GPIO_PULLUP_DISABLE,
-        .master.clk_speed = EXAMPLE_TOUCH_I2C_CLK_HZ
+        .enable_internal_pullup = false,
     };
-    ESP_RETURN_ON_ERROR(i2c_param_config(EXAMPLE_TOUCH_I2C_NUM, &i2c_conf), TAG, "I2C configuration failed");
-    ESP_RETURN_ON_ERROR(i2c_driver_install(EXAMPLE_TOUCH_I2C_NUM, i2c_conf.mode, 0, 0, 0), TAG, "I2C initialization failed");
+    ESP_RETURN_ON_ERROR(app_i2c_bus_init(&i2c_conf), TAG, "I2C initialization failed");
 
     /* Initialize touch HW */
     const esp_lcd_touch_config_t tp_cfg = {
@@ -170,11 +235,33 @@ static esp_err_t app_touch_init(void)
             .mirror_x = 0,
             .mirror_y = 0,
         },
+#if CONFIG_APP_LATENCY_TRACE
+        .process_coordinates = app_latency_touch_sample_cb,
+#endif
     };
     esp_lcd_panel_io_handle_t tp_io_handle = NULL;
+    app_i2c_dev_handle_t tp_dev = NULL;
     const esp_lcd_panel_io_i2c_config_t tp_io_config = ESP_LCD_TOUCH_IO_I2C_GT911_CONFIG();
-    ESP_RETURN_ON_ERROR(esp_lcd_new_panel_io_i2c((esp_lcd_i2c_bus_handle_t)EXAMPLE_TOUCH_I2C_NUM, &tp_io_config, &tp_io_handle), TAG, "");
-    return esp_lcd_touch_new_i2c_gt911(tp_io_handle, &tp_cfg, &touch_handle);
+    ESP_RETURN_ON_ERROR(app_i2c_bus_add_device(tp_io_config.dev_addr, EXAMPLE_TOUCH_I2C_CLK_HZ, APP_I2C_PRIO_TOUCH,
+                                               &tp_dev), TAG, "add touch to the I2C bus failed");
+    ESP_RETURN_ON_ERROR(app_i2c_bus_new_panel_io(tp_dev, &tp_io_config, &tp_io_handle), TAG, "touch panel IO failed");
+    ESP_RETURN_ON_ERROR(esp_lcd_touch_new_i2c_gt911(tp_io_handle, &tp_cfg, &touch_handle), TAG, "GT911 init failed");
+#if CONFIG_APP_TRACE
+    touch_read_data = touch_handle->read_data;
+    touch_handle->read_data = app_touch_read_data_traced;
+#endif
+    return ESP_OK;
+}
+
+/* I2C and GT911 probing only need the bus, so they overlap with the LCD and LVGL setup */
+static void app_touch_init_task(void *arg)
+{
+    touch_init_ret = app_touch_init();
+    if (touch_init_ret == ESP_OK) {
+        app_timeline_mark(APP_TIMELINE_TOUCH_UP);
+    }
+    xEventGroupSetBits(boot_events, EXAMPLE_BOOT_TOUCH_DONE_BIT);
+    vTaskDelete(NULL);
 }
 
 static esp_err_t app_lvgl_init(void)
@@ -183,7 +270,7 @@ static esp_err_t app_lvgl_init(void)
     const lvgl_port_cfg_t lvgl_cfg = {
         .task_priority = 4,         /* LVGL task priority */
         .task_stack = 6144,         /* LVGL task stack size */
-        .task_affinity = -1,        /* LVGL task pinned to core (-1 is no affinity) */
+        .task_affinity = app_render_lvgl_task_core(), /* LVGL task pinned to core (-1 is no affinity) */
         .task_max_sleep_ms = 500,   /* Maximum sleep in LVGL task */
         .timer_period_ms = 5        /* LVGL timer tick period in ms */
     };
@@ -241,7 +328,11 @@ static esp_err_t app_lvgl_init(void)
     };
     lvgl_disp = lvgl_port_add_disp_rgb(&disp_cfg, &rgb_cfg);
     ESP_ERROR_CHECK(!lvgl_disp ? ESP_FAIL : ESP_OK);
+    return ESP_OK;
+}
 
+static esp_err_t app_lvgl_add_touch(void)
+{
     /* Add touch input (for selected screen) */
     const lvgl_port_touch_cfg_t touch_cfg = {
         .disp = lvgl_disp,
@@ -263,6 +354,11 @@ static void _app_button_cb(lv_event_t *e)
     lv_disp_set_rotation(lvgl_disp, rotation);
 }
 
+static void app_forecast_page_ready(lv_obj_t *screen)
+{
+    ESP_ERROR_CHECK(app_transition_add_page(screen));
+}
+
 void demo_widget()
 {
     LV_FONT_DECLARE(HarmonyMedium);
@@ -278,6 +374,13 @@ void demo_widget()
     lv_obj_t *login_dialog = lv_obj_create(lv_scr_act());
     lv_obj_set_size(login_dialog, 300, 200);
     lv_obj_center(login_dialog);
+    // 对话框浮在仪表盘上方, 加一层阴影
+    lv_obj_set_style_shadow_width(login_dialog, 30, 0);
+    lv_obj_set_style_shadow_offset_y(login_dialog, 8, 0);
+    lv_obj_set_style_shadow_opa(login_dialog, LV_OPA_30, 0);
+#if CONFIG_APP_SHADOW_CACHE
+    app_shadow_attach(login_dialog);
+#endif
 
     // 创建用户名标签和文本框
     lv_obj_t *username_label = lv_label_create(login_dialog);
@@ -315,20 +418,156 @@ void demo_widget()
 
 void app_main(void)
 {
+#if CONFIG_APP_TRACE
+    ESP_ERROR_CHECK(app_trace_init());
+#endif
+
+    /* Touch initialization, in parallel with the LCD and LVGL */
+    boot_events = xEventGroupCreate();
+    ESP_ERROR_CHECK(!boot_events ? ESP_ERR_NO_MEM : ESP_OK);
+    BaseType_t task_ret = xTaskCreate(app_touch_init_task, "boot_touch", EXAMPLE_BOOT_TASK_STACK, NULL, 5, NULL);
+    ESP_ERROR_CHECK(task_ret != pdPASS ? ESP_ERR_NO_MEM : ESP_OK);
+
     /* LCD HW initialization */
     ESP_ERROR_CHECK(app_lcd_init());
-
-    /* Touch initialization */
-    ESP_ERROR_CHECK(app_touch_init());
+    app_timeline_mark(APP_TIMELINE_PANEL_UP);
 
     /* LVGL initialization */
     ESP_ERROR_CHECK(app_lvgl_init());
+    app_timeline_mark(APP_TIMELINE_LVGL_READY);
 
-    /* Show LVGL objects */
+    /* First frame: the dashboard as last rendered, until the UI below is built */
     lvgl_port_lock(0);
+    ESP_ERROR_CHECK(app_mem_init());
+#if CONFIG_APP_TRACE
+    ESP_ERROR_CHECK(app_trace_attach_display(lvgl_disp));
+#endif
+    ESP_ERROR_CHECK(app_boot_show_cached_frame(lvgl_disp));
+    lv_refr_now(lvgl_disp);
+
+    /* Show LVGL objects */
     //app_main_display();
     // lv_demo_widgets();
     demo_widget();
     // lv_demo_music();
+    ESP_ERROR_CHECK(app_bind_init(lvgl_disp));
+    ESP_ERROR_CHECK(app_icons_init());
+#if CONFIG_APP_DASHBOARD_CUSTOM_DRAW
+    app_dashboard_draw_create(lv_scr_act());
+    ESP_ERROR_CHECK(app_model_init(app_dashboard_draw_apply));
+#else
+    app_dashboard_create(lv_scr_act());
+    ESP_ERROR_CHECK(app_model_init(app_dashboard_apply));
+#endif
+    lvgl_port_unlock();
+
+    /* Touch input once the touch task is done */
+    xEventGroupWaitBits(boot_events, EXAMPLE_BOOT_TOUCH_DONE_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+    ESP_ERROR_CHECK(touch_init_ret);
+    ESP_ERROR_CHECK(app_lvgl_add_touch());
+
+    lvgl_port_lock(0);
+#if CONFIG_APP_LATENCY_TRACE
+    ESP_ERROR_CHECK(app_latency_init(lvgl_disp, lvgl_touch_indev));
+#if CONFIG_APP_LATENCY_SYNTHETIC_TAPS
+    /* Centre of the login button in demo_widget() */
+    app_latency_start_synthetic_taps(lvgl_disp, EXAMPLE_LCD_H_RES / 2, EXAMPLE_LCD_V_RES / 2 + 55,
+                                     CONFIG_APP_LATENCY_SYNTHETIC_TAP_PERIOD_MS);
+#endif
+#endif
+    app_boot_mark_interactive();
+#if CONFIG_APP_LVGL_RENDER_BENCH
+    app_render_bench_full_redraw(lvgl_disp, CONFIG_APP_LVGL_RENDER_BENCH_FRAMES, NULL);
+#endif
+#if CONFIG_APP_FORECAST_BENCH
+    app_forecast_bench(lvgl_disp, CONFIG_APP_FORECAST_BENCH_FRAMES);
+#endif
+#if CONFIG_APP_DASHBOARD_BENCH
+    app_dashboard_draw_bench(lvgl_disp, CONFIG_APP_DASHBOARD_BENCH_FRAMES);
+#endif
+#if CONFIG_APP_SHADOW_BENCH
+    app_shadow_bench(lvgl_disp, CONFIG_APP_SHADOW_BENCH_FRAMES);
+#endif
+    /* Pages, swiped through with snapshot transitions */
+    ESP_ERROR_CHECK(app_transition_init(lvgl_disp));
+    ESP_ERROR_CHECK(app_transition_add_page(lv_scr_act()));
+    /* Swiped to only once it has rows, nothing fetches a forecast yet */
+    app_forecast_create(lv_obj_create(NULL), app_forecast_page_ready);
+#if CONFIG_APP_BACKDROP
+    ESP_ERROR_CHECK(app_backdrop_start(lv_scr_act()));
+#endif
+    lvgl_port_unlock();
+#if CONFIG_APP_OTA
+    /* The UI came up, so a freshly updated image is good to keep */
+    app_ota_confirm();
+#endif
+
+    /* Settings, before anything reads them */
+    ESP_ERROR_CHECK(app_config_init(NULL));
+
+    /* Sensor polling, readings reach the UI through the data model */
+    ESP_ERROR_CHECK(app_sensor_scheduler_init(app_model_publish_sensor_reading, NULL));
+    ESP_ERROR_CHECK(app_history_init());
+#if CONFIG_APP_SENSOR_SIMULATED
+    ESP_ERROR_CHECK(app_sensor_sim_register_all());
+#endif
+
+    /* Network, once the UI takes input */
+    ESP_ERROR_CHECK(app_wifi_start());
+    ESP_ERROR_CHECK(app_http_init());
+    ESP_ERROR_CHECK(app_weather_start());
+#if CONFIG_APP_API
+    ESP_ERROR_CHECK(app_api_start());
+#endif
+#if CONFIG_APP_TELEMETRY
+    ESP_ERROR_CHECK(app_telemetry_start());
+#endif
+#if CONFIG_APP_MIRROR
+    lvgl_port_lock(0);
+    ESP_ERROR_CHECK(app_mirror_start(lvgl_disp));
     lvgl_port_unlock();
+#endif
+
+#if CONFIG_APP_HOTSET_PROFILE
+    ESP_ERROR_CHECK(app_hotset_start());
+#endif
+#if CONFIG_APP_TASKMON
+    ESP_ERROR_CHECK(app_taskmon_start());
+#endif
+
+#if CONFIG_APP_CONSOLE
+    ESP_ERROR_CHECK(app_console_init());
+    ESP_ERROR_CHECK(app_mem_register_console_cmd());
+    ESP_ERROR_CHECK(app_config_register_console_cmd());
+    ESP_ERROR_CHECK(app_wifi_register_console_cmd());
+    ESP_ERROR_CHECK(app_http_register_console_cmd());
+    ESP_ERROR_CHECK(app_weather_register_console_cmd());
+    ESP_ERROR_CHECK(app_transition_register_console_cmd());
+    ESP_ERROR_CHECK(app_forecast_register_console_cmd());
+    ESP_ERROR_CHECK(app_icons_register_console_cmd());
+    ESP_ERROR_CHECK(app_shadow_register_console_cmd());
+    ESP_ERROR_CHECK(app_backdrop_register_console_cmd());
+#if CONFIG_APP_OTA
+    ESP_ERROR_CHECK(app_ota_register_console_cmd());
+#endif
+#if CONFIG_APP_API
+    ESP_ERROR_CHECK(app_api_register_console_cmd());
+#endif
+#if CONFIG_APP_TELEMETRY
+    ESP_ERROR_CHECK(app_telemetry_register_console_cmd());
+#endif
+#if CONFIG_APP_MIRROR
+    ESP_ERROR_CHECK(app_mirror_register_console_cmd());
+#endif
+#if CONFIG_APP_HOTSET_PROFILE
+    ESP_ERROR_CHECK(app_hotset_register_console_cmd());
+#endif
+#if CONFIG_APP_TRACE
+    ESP_ERROR_CHECK(app_trace_register_console_cmd());
+#endif
+#if CONFIG_APP_TASKMON
+    ESP_ERROR_CHECK(app_taskmon_register_console_cmd());
+#endif
+    ESP_ERROR_CHECK(app_console_start());
+#endif
 }
\ No newline at end of file
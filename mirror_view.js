@@ -0,0 +1,216 @@
+const fs = require('fs');
+const net = require('net');
+const zlib = require('zlib');
+
+// 用法: node mirror_view.js <设备 IP> [--port 5800] [--token 令牌] [--out mirror.png] [--seconds 0]
+// 连接设备端 app_mirror.c 的画面镜像, 按收到的脏矩形重建整屏, 每帧结束后 (最多每秒两次) 写出 PNG,
+// 每 5 秒和退出时打印帧数, 矩形数和带宽; --seconds 为 0 时一直运行.
+// 令牌是设备的 CONFIG_APP_MIRROR_TOKEN, 也可以放在环境变量 MIRROR_TOKEN 里
+const args = process.argv.slice(2);
+function option(name, fallback) {
+    const i = args.indexOf(name);
+    return i >= 0 && i + 1 < args.length ? args[i + 1] : fallback;
+}
+const host = args[0] && !args[0].startsWith('--') ? args[0] : null;
+const port = parseInt(option('--port', '5800'), 10);
+const token = option('--token', process.env.MIRROR_TOKEN || '');
+const out = option('--out', 'mirror.png');
+const seconds = parseFloat(option('--seconds', '0'));
+
+if (!host || !token) {
+    console.error('用法: node mirror_view.js <设备 IP> [--port 5800] [--token 令牌] [--out mirror.png] [--seconds 0]');
+    process.exit(1);
+}
+
+// 与 app_mirror.h 中的 app_mirror_msg_t 保持一致
+const MSG_RECT = 1;
+const MSG_FRAME = 2;
+const HEADER_SIZE = 14;
+const RLE_RUN = 0x8000;
+const RLE_MAX = 0x7fff;
+const PNG_PERIOD_MS = 500;
+
+let width = 0;
+let height = 0;
+let screen = new Uint16Array(0);    // RGB565, 与面板一致
+const total = { frames: 0, rects: 0, pixels: 0, bytes: 0, errors: 0 };
+let recent = { frames: 0, bytes: 0, since: Date.now() };
+let lastPng = 0;
+
+function resize(w, h) {
+    if (w === width && h === height) {
+        return;
+    }
+    const next = new Uint16Array(w * h);
+    for (let y = 0; y < Math.min(h, height); y++) {
+        next.set(screen.subarray(y * width, y * width + Math.min(w, width)), y * w);
+    }
+    width = w;
+    height = h;
+    screen = next;
+}
+
+// 每行独立编码: 最高位为 1 时是 (n & 0x7fff) 个相同像素, 否则是 n 个原样像素
+function drawRect(x, y, w, h, data) {
+    if (x + w > width || y + h > height) {
+        resize(Math.max(width, x + w), Math.max(height, y + h));
+    }
+    let i = 0;
+    const words = data.length / 2;
+    for (let row = 0; row < h; row++) {
+        let o = (y + row) * width + x;
+        const end = o + w;
+        while (o < end) {
+            if (i >= words) {
+                throw new Error(`矩形 (${x},${y},${w},${h}) 数据不足`);
+            }
+            const word = data.readUInt16LE(i++ * 2);
+            const n = word & RLE_MAX;
+            if (o + n > end) {
+                throw new Error(`矩形 (${x},${y},${w},${h}) 第 ${row} 行越界`);
+            }
+            if (word & RLE_RUN) {
+                screen.fill(data.readUInt16LE(i++ * 2), o, o + n);
+            } else {
+                for (let k = 0; k < n; k++) {
+                    screen[o + k] = data.readUInt16LE(i++ * 2);
+                }
+            }
+            o += n;
+        }
+    }
+    if (i !== words) {
+        throw new Error(`矩形 (${x},${y},${w},${h}) 末尾多出 ${(words - i) * 2} 字节`);
+    }
+}
+
+const CRC_TABLE = new Int32Array(256).map((_, n) => {
+    let c = n;
+    for (let k = 0; k < 8; k++) {
+        c = c & 1 ? 0xedb88320 ^ (c >>> 1) : c >>> 1;
+    }
+    return c;
+});
+
+function crc32(buf) {
+    let c = -1;
+    for (const b of buf) {
+        c = CRC_TABLE[(c ^ b) & 0xff] ^ (c >>> 8);
+    }
+    return (c ^ -1) >>> 0;
+}
+
+function pngChunk(type, data) {
+    const head = Buffer.alloc(8);
+    head.writeUInt32BE(data.length, 0);
+    head.write(type, 4, 'ascii');
+    const crc = Buffer.alloc(4);
+    crc.writeUInt32BE(crc32(Buffer.concat([head.subarray(4), data])), 0);
+    return Buffer.concat([head, data, crc]);
+}
+
+// 写到临时文件再改名, 看图工具不会读到写了一半的 PNG
+function writePng() {
+    const raw = Buffer.alloc((width * 3 + 1) * height);
+    for (let y = 0; y < height; y++) {
+        let o = y * (width * 3 + 1) + 1;
+        for (let x = 0; x < width; x++) {
+            const p = screen[y * width + x];
+            raw[o++] = ((p >> 11) & 0x1f) * 255 / 31;
+            raw[o++] = ((p >> 5) & 0x3f) * 255 / 63;
+            raw[o++] = (p & 0x1f) * 255 / 31;
+        }
+    }
+    const ihdr = Buffer.alloc(13);
+    ihdr.writeUInt32BE(width, 0);
+    ihdr.writeUInt32BE(height, 4);
+    ihdr.set([8, 2, 0, 0, 0], 8);
+    const png = Buffer.concat([
+        Buffer.from([0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a]),
+        pngChunk('IHDR', ihdr),
+        pngChunk('IDAT', zlib.deflateSync(raw, { level: 1 })),
+        pngChunk('IEND', Buffer.alloc(0)),
+    ]);
+    fs.writeFileSync(out + '.tmp', png);
+    fs.renameSync(out + '.tmp', out);
+}
+
+function rates(stats, ms) {
+    const s = ms / 1000;
+    return `frames=${stats.frames} bytes=${stats.bytes} fps=${(stats.frames / s).toFixed(1)} ` +
+        `kbps=${(stats.bytes * 8 / 1000 / s).toFixed(1)} bytes_per_frame=${stats.frames ? Math.round(stats.bytes / stats.frames) : 0}`;
+}
+
+let pending = Buffer.alloc(0);
+const started = Date.now();
+const sock = net.connect(port, host, () => {
+    // 设备先要第一行是令牌, 不对就直接断开
+    sock.write(`${token}\n`);
+    console.error(`已连接 ${host}:${port}, 画面写入 ${out}`);
+});
+sock.on('data', (chunk) => {
+    total.bytes += chunk.length;
+    recent.bytes += chunk.length;
+    pending = pending.length ? Buffer.concat([pending, chunk]) : chunk;
+    let off = 0;
+    while (pending.length - off >= HEADER_SIZE) {
+        const len = pending.readUInt32LE(off + 10);
+        if (pending.length - off < HEADER_SIZE + len) {
+            break;
+        }
+        const type = pending[off];
+        const x = pending.readUInt16LE(off + 2);
+        const y = pending.readUInt16LE(off + 4);
+        const w = pending.readUInt16LE(off + 6);
+        const h = pending.readUInt16LE(off + 8);
+        const data = pending.subarray(off + HEADER_SIZE, off + HEADER_SIZE + len);
+        off += HEADER_SIZE + len;
+        if (type === MSG_RECT) {
+            try {
+                drawRect(x, y, w, h, data);
+                total.rects++;
+                total.pixels += w * h;
+            } catch (e) {
+                total.errors++;
+                console.error(e.message);
+            }
+        } else if (type === MSG_FRAME) {
+            resize(w, h);
+            total.frames++;
+            recent.frames++;
+            if (Date.now() - lastPng >= PNG_PERIOD_MS) {
+                lastPng = Date.now();
+                writePng();
+            }
+        } else {
+            total.errors++;
+            console.error(`未知消息类型 ${type}`);
+        }
+    }
+    pending = pending.subarray(off);
+});
+
+const timer = setInterval(() => {
+    console.log(`view: ${rates(recent, Date.now() - recent.since)}`);
+    recent = { frames: 0, bytes: 0, since: Date.now() };
+}, 5000);
+
+function finish() {
+    clearInterval(timer);
+    if (width && height) {
+        writePng();
+    }
+    console.log(`mirror: ${rates(total, Date.now() - started)} rects=${total.rects} pixels=${total.pixels} ` +
+        `ratio=${total.bytes ? (total.pixels * 2 / total.bytes).toFixed(1) : 0} errors=${total.errors}`);
+    process.exit(total.errors ? 1 : 0);
+}
+
+sock.on('error', (e) => {
+    console.error(`连接失败: ${e.message}`);
+    process.exit(1);
+});
+sock.on('close', finish);
+process.on('SIGINT', finish);
+if (seconds > 0) {
+    setTimeout(() => sock.destroy(), seconds * 1000);
+}
@@ -0,0 +1,63 @@
+const fs = require('fs');
+const path = require('path');
+const http = require('http');
+
+// 用法: node ota_server.js <目录> [--port 8070] [--rate 字节每秒]
+// 本地升级服务器: 提供目录下的整包 .bin 和 build_patch.js 生成的 .patch,
+// --rate 限速用来模拟现场的慢速链路, 每次下载结束打印字节数和用时
+const args = process.argv.slice(2);
+function option(name, fallback) {
+    const i = args.indexOf(name);
+    return i >= 0 && i + 1 < args.length ? args[i + 1] : fallback;
+}
+const root = args[0] && !args[0].startsWith('--') ? path.resolve(args[0]) : null;
+const port = parseInt(option('--port', '8070'), 10);
+const rate = parseInt(option('--rate', '0'), 10);
+
+if (!root) {
+    console.error('用法: node ota_server.js <目录> [--port 8070] [--rate 字节每秒]');
+    process.exit(1);
+}
+
+const SLICE = 1024;
+
+function send(res, data, done) {
+    if (!rate) {
+        res.end(data, done);
+        return;
+    }
+    // 每 SLICE 字节按限速等待, 模拟慢速链路
+    let off = 0;
+    const interval = SLICE * 1000 / rate;
+    const timer = setInterval(() => {
+        const chunk = data.subarray(off, off + SLICE);
+        off += chunk.length;
+        if (off >= data.length) {
+            clearInterval(timer);
+            res.end(chunk, done);
+        } else {
+            res.write(chunk);
+        }
+    }, interval);
+    res.on('close', () => clearInterval(timer));
+}
+
+const server = http.createServer((req, res) => {
+    const started = Date.now();
+    const file = path.join(root, path.normalize(decodeURIComponent(new URL(req.url, 'http://ota').pathname)));
+    if (!file.startsWith(root + path.sep) || !fs.existsSync(file) || !fs.statSync(file).isFile()) {
+        res.writeHead(404, { 'Content-Length': 0 });
+        res.end();
+        console.log(`ota_server: ${req.method} ${req.url} 404`);
+        return;
+    }
+    const data = fs.readFileSync(file);
+    res.writeHead(200, { 'Content-Type': 'application/octet-stream', 'Content-Length': data.length });
+    send(res, data, () => {
+        console.log(`ota_server: ${req.method} ${req.url} 200 bytes=${data.length} ms=${Date.now() - started}`);
+    });
+});
+server.keepAliveTimeout = 120000;
+server.listen(port, () => {
+    console.log(`ota_server: listening on http://0.0.0.0:${port} serving ${root} rate=${rate || '-'}`);
+});
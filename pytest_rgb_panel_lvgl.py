@@ -1,9 +1,106 @@
 # SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
 # SPDX-License-Identifier: CC0-1.0
 
+import contextlib
+import os
+import re
+import shutil
+import socket
+import subprocess
+import time
+from typing import Generator
+from typing import Iterator
+
 import pytest
 from pytest_embedded import Dut
 
+# Milliseconds since boot by which each app_timeline stage must be reached
+TIMELINE_BUDGET_MS = {
+    'panel': 1000,
+    'touch': 1500,
+    'lvgl': 1500,
+    'first_frame': 2000,
+    'interactive': 3000,
+    'wifi': 10000,
+    'weather': 20000,
+}
+
+# pytest cache key of the full redraw render_avg_us of render_bench (two draw units, no hot set). The cache
+# outlives the session, so the variants below also run on their own once render_bench ran on this host.
+RENDER_BASELINE_KEY = 'rgb_panel_lvgl/full_redraw_us'
+
+
+def host_ip() -> str:
+    """Address of this host as seen from the Wi-Fi network the DUT joins"""
+    if os.getenv('STANDIN_HOST'):
+        return os.environ['STANDIN_HOST']
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+        s.connect(('8.8.8.8', 80))
+        return s.getsockname()[0]
+
+
+@contextlib.contextmanager
+def run_standin(latency_ms: int = 0) -> Iterator[str]:
+    """Run weather_standin.js, answering every request after `latency_ms`, and yield its base URL"""
+    script = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'weather_standin.js')
+    proc = subprocess.Popen(['node', script, '--port', '8443', '--latency', str(latency_ms)],
+                            stdout=subprocess.PIPE, text=True)
+    try:
+        assert 'listening' in proc.stdout.readline()
+        yield f'https://{host_ip()}:8443'
+    finally:
+        proc.terminate()
+        proc.wait()
+
+
+@contextlib.contextmanager
+def run_ota_server(directory: str) -> Iterator[str]:
+    """Serve `directory` with ota_server.js and yield its base URL"""
+    script = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'ota_server.js')
+    proc = subprocess.Popen(['node', script, directory, '--port', '8070'], stdout=subprocess.PIPE, text=True)
+    try:
+        assert 'listening' in proc.stdout.readline()
+        yield f'http://{host_ip()}:8070'
+    finally:
+        proc.terminate()
+        proc.wait()
+
+
+@pytest.fixture
+def weather_standin() -> Generator[str, None, None]:
+    with run_standin() as url:
+        yield url
+
+
+def connect_wifi(dut: Dut) -> str:
+    ssid = os.getenv('WIFI_SSID')
+    if not ssid:
+        pytest.skip('set WIFI_SSID (and WIFI_PASSWORD) to the network of the stand-in host')
+    dut.expect_exact('weather>', timeout=30)
+    dut.write(f'wifi {ssid} {os.getenv("WIFI_PASSWORD", "")}'.strip())
+    return dut.expect(r'wifi: got ip (\d+\.\d+\.\d+\.\d+)', timeout=30).group(1).decode()
+
+
+def expect_timeline(dut: Dut, timeout: int = 30, until: str = '') -> dict:
+    """Wait for the next "timeline:" line, or the first one with stage `until` reached, and return {stage: ms or None}
+
+    A line is logged at INTERACTIVE and again as each later stage is reached.
+    """
+    while True:
+        line = dut.expect(r'timeline: ((?:\w+=(?:\d+|-) ?)+)', timeout=timeout).group(1).decode()
+        stages = dict(item.split('=') for item in line.split())
+        timeline = {k: None if v == '-' else int(v) for k, v in stages.items()}
+        if not until or timeline.get(until) is not None:
+            return timeline
+
+
+def check_timeline_budgets(timeline: dict, stages: list) -> None:
+    """Every stage of `stages` was reached within its TIMELINE_BUDGET_MS"""
+    for stage in stages:
+        assert timeline.get(stage) is not None, f'{stage} not reached'
+        budget_ms = TIMELINE_BUDGET_MS[stage]
+        assert timeline[stage] <= budget_ms, f'{stage} took {timeline[stage]} ms, budget {budget_ms} ms'
+
 
 @pytest.mark.esp32s3
 @pytest.mark.octal_psram
@@ -17,12 +114,522 @@ from pytest_embedded import Dut
     indirect=True,
 )
 def test_rgb_lcd_lvgl(dut: Dut) -> None:
-    dut.expect_exact('example: Turn off LCD backlight')
-    dut.expect_exact('example: Install RGB LCD panel driver')
-    dut.expect_exact('example: Register event callbacks')
-    dut.expect_exact('example: Initialize RGB LCD panel')
-    dut.expect_exact('example: Turn on LCD backlight')
-    dut.expect_exact('example: Initialize LVGL library')
-    dut.expect_exact('example: Register display driver to LVGL')
-    dut.expect_exact('example: Install LVGL tick timer')
-    dut.expect_exact('example: Display LVGL Scatter Chart')
+    dut.expect_exact('EXAMPLE: Initialize RGB panel')
+    timeline = expect_timeline(dut)
+    assert timeline['panel'] <= timeline['lvgl'] <= timeline['first_frame'] <= timeline['interactive']
+    assert timeline['touch'] <= timeline['interactive']
+    # The network stages are checked by test_rgb_lcd_lvgl_network_timeline
+    check_timeline_budgets(timeline, ['panel', 'touch', 'lvgl', 'first_frame', 'interactive'])
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.parametrize('config', ['latency'], indirect=True)
+def test_rgb_lcd_lvgl_touch_latency(dut: Dut) -> None:
+    dut.expect_exact('latency: Synthetic taps at')
+    res = dut.expect(r'latency: taps=(\d+) nored=(\d+) .* p90=(\d+) .* hist=([\d,]+)', timeout=30)
+    assert int(res.group(1)) > 0
+    assert len(res.group(4).split(b',')) == 16
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.parametrize('config', ['render_bench'], indirect=True)
+def test_rgb_lcd_lvgl_render_bench(dut: Dut, cache: pytest.Cache) -> None:
+    res = dut.expect(r'render: full redraw units=(\d+) frames=(\d+) render_avg_us=(\d+)', timeout=60)
+    assert int(res.group(1)) == 2
+    assert int(res.group(2)) > 0
+    cache.set(RENDER_BASELINE_KEY, int(res.group(3)))
+
+    bench = {}
+    for variant in ('plain', 'recycled'):
+        res = dut.expect(r'forecast: bench %s rows=\d+ objects=(\d+) lvgl_bytes=(\d+) binds=\d+ frames=\d+ '
+                         r'render_avg_us=(\d+)' % variant, timeout=60)
+        bench[variant] = [int(g) for g in res.groups()]
+    print(f'forecast objects, LVGL bytes, render us: {bench}')
+    assert bench['recycled'][0] < bench['plain'][0]
+    assert bench['recycled'][1] < bench['plain'][1]
+
+    bench = {}
+    for variant in ('tree', 'widget'):
+        res = dut.expect(r'dash_draw: bench %s tiles=\d+ objects=(\d+) lvgl_bytes=(\d+) build_layout_us=\d+ '
+                         r'layout_avg_us=(\d+) frames=\d+ render_avg_us=(\d+)' % variant, timeout=60)
+        bench[variant] = [int(g) for g in res.groups()]
+    print(f'dashboard objects, LVGL bytes, layout us, render us: {bench}')
+    assert bench['widget'][0] < bench['tree'][0]
+    assert bench['widget'][1] < bench['tree'][1]
+
+    bench = {}
+    for variant in ('lvgl', 'cached'):
+        res = dut.expect(r'shadow: bench %s cards=\d+ frames=\d+ render_avg_us=(\d+) render_max_us=\d+ '
+                         r'frame_avg_us=(\d+) draws=(\d+) hits=(\d+) builds=(\d+)' % variant, timeout=60)
+        bench[variant] = [int(g) for g in res.groups()]
+    print(f'shadow render us, frame us, draws, hits, builds: {bench}')
+    # One card style and the dialog, built once and reused every frame after that
+    assert bench['cached'][3] > 0
+    assert bench['cached'][4] <= 2
+    assert bench['cached'][0] < bench['lvgl'][0]
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.parametrize('config', ['render_bench_1unit'], indirect=True)
+def test_rgb_lcd_lvgl_render_units(dut: Dut, cache: pytest.Cache) -> None:
+    res = dut.expect(r'render: full redraw units=(\d+) frames=\d+ render_avg_us=(\d+)', timeout=60)
+    assert int(res.group(1)) == 1
+    single = int(res.group(2))
+    baseline = cache.get(RENDER_BASELINE_KEY, None)
+    print(f'full redraw render us: one draw unit {single}, two draw units {baseline}')
+    if baseline is None:
+        pytest.skip('no baseline in the pytest cache, run the render_bench config first')
+    assert baseline < single
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.parametrize('config', ['double_fb', 'bind_always_set'], indirect=True)
+def test_rgb_lcd_lvgl_bind_stats(dut: Dut, config: str) -> None:
+    res = dut.expect(r'bind: notified=(\d+) applied=(\d+) suppressed=(\d+) invalidated_px=\d+', timeout=90)
+    notified, applied, suppressed = (int(g) for g in res.groups())
+    assert notified > 0
+    assert applied + suppressed == notified
+    if config == 'bind_always_set':
+        assert suppressed == 0
+    else:
+        # Sensor values repeat, so some notifications must not touch their label
+        assert suppressed > 0
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.parametrize('config', ['double_fb'], indirect=True)
+def test_rgb_lcd_lvgl_heap_report(dut: Dut) -> None:
+    dut.expect_exact('weather>', timeout=30)
+    dut.write('heap')
+    dut.expect(r'mem: fetch0\s+arena\s+\S+\s+(\d+)')
+    dut.expect(r'mem: sensor\s+pool')
+    res = dut.expect(r'mem: lvgl\s+lvgl\s+\S+\s+(\d+)\s+(\d+)\s+(\d+)')
+    assert int(res.group(3)) >= int(res.group(2))
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.parametrize('config', ['hotset_profile'], indirect=True)
+def test_rgb_lcd_lvgl_hotset_profile(dut: Dut) -> None:
+    dut.expect_exact('hotset: begin', timeout=60)
+    dump = dut.expect(r'((?:.*\n)*?).*hotset: end', timeout=30).group(1).decode()
+    calls = sorted((int(n) for n in re.findall(r'hotset: fn 0x[0-9a-f]{8} (\d+)', dump)), reverse=True)
+    glyphs = re.findall(r'hotset: glyph 0x[0-9a-f]+ U\+[0-9A-F]+ (\d+)', dump)
+    print(f'hotset: {len(calls)} functions, {sum(calls)} calls, {len(glyphs)} glyphs')
+    assert len(calls) > 20 and glyphs
+    # Worth placing: a small share of the functions takes most of the calls
+    assert sum(calls[:len(calls) // 10 + 1]) * 2 > sum(calls)
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.parametrize('config', ['render_bench_hotset'], indirect=True)
+def test_rgb_lcd_lvgl_hotset_render_gain(dut: Dut, cache: pytest.Cache) -> None:
+    res = dut.expect(r'render: full redraw units=\d+ frames=\d+ render_avg_us=(\d+) .* hotset=(\d)', timeout=60)
+    if res.group(2) == b'0':
+        pytest.skip('no main/hotset.lf, generate it with build_hotset.js from a hotset_profile run')
+    placed = int(res.group(1))
+    baseline = cache.get(RENDER_BASELINE_KEY, None)
+    print(f'full redraw render us: in PSRAM {baseline}, hot set in internal RAM {placed}')
+    if baseline is None:
+        pytest.skip('no baseline in the pytest cache, run the render_bench config first')
+    assert placed < baseline
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.parametrize('config', ['trace'], indirect=True)
+def test_rgb_lcd_lvgl_trace(dut: Dut) -> None:
+    res = dut.expect(r'trace: (\d+) events per core, (\d+) ns per event', timeout=30)
+    assert int(res.group(2)) < 100
+    dut.expect_exact('weather>', timeout=30)
+    dut.write('trace')
+    dut.expect_exact('trace: begin cores=2')
+    dut.expect_exact('trace: name 1 lvgl_refr')
+    dut.expect(r'trace: task [0-9a-f]{8} taskLVGL')
+    dut.expect(r'trace: data 0 ([0-9a-f]{32})+')
+    dut.expect_exact('trace: end')
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.parametrize('config', ['double_fb'], indirect=True)
+def test_rgb_lcd_lvgl_task_monitor(dut: Dut) -> None:
+    dut.expect_exact('weather>', timeout=30)
+    time.sleep(12)  # One summary window
+    dut.write('tasks')
+    for core in range(2):
+        res = dut.expect(r'taskmon: core%d load=(\d+)\.\d%% wake_avg_us=(\d+) wake_max_us=(\d+) samples=(\d+)' % core,
+                         timeout=30)
+        assert int(res.group(1)) <= 100
+        assert int(res.group(2)) <= int(res.group(3))
+        assert int(res.group(4)) > 0
+    res = dut.expect(r'taskmon: taskLVGL\s+-?\d+\s+4\s+\d+\.\d% +(\d+)')
+    assert int(res.group(1)) > 512
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.parametrize('config', ['double_fb'], indirect=True)
+def test_rgb_lcd_lvgl_boot_times(dut: Dut) -> None:
+    res = dut.expect(r'boot: first_pixel_ms=(\d+) interactive_ms=(\d+) cached_frame=(\d)', timeout=30)
+    assert int(res.group(1)) <= int(res.group(2))
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.parametrize('config', ['double_fb'], indirect=True)
+def test_rgb_lcd_lvgl_page_transitions(dut: Dut) -> None:
+    dut.expect_exact('weather>', timeout=30)
+    dut.write('page')
+    dut.expect(r'page: page=0 pages=1 ', timeout=10)
+    # The forecast page joins once it has rows
+    dut.write('forecast demo')
+    dut.expect(r'forecast: hourly=48 daily=15', timeout=10)
+    fps = {}
+    for page, kind in ((1, 'slide'), (0, 'fade')):
+        dut.write(f'page {page} {kind}')
+        res = dut.expect(r'transition: %s frames=(\d+) ms=(\d+) fps=(\d+\.\d) render_avg_us=(\d+)' % kind, timeout=10)
+        assert int(res.group(1)) > 0
+        fps[kind] = float(res.group(3))
+    print(f'transition fps: {fps}')
+    dut.write('page')
+    dut.expect(r'page: page=0 pages=2 transitions=2 ', timeout=10)
+
+
+ICONS_STATS = (r'icons: lookups=(\d+) hits=(\d+) hit_pct=(\d+) decodes=(\d+) decode_avg_us=(\d+) '
+               r'decode_max_us=(\d+) evictions=(\d+) cached_bytes=(\d+) flash_bytes=(\d+) raw_bytes=(\d+)')
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.parametrize('config', ['double_fb'], indirect=True)
+def test_rgb_lcd_lvgl_icon_cache(dut: Dut) -> None:
+    dut.expect_exact('weather>', timeout=30)
+    dut.write('icons')      # Start from clear counters
+    flash_bytes = int(dut.expect(ICONS_STATS, timeout=10).group(9))
+    if not flash_bytes:
+        pytest.skip('no atlas in the "icons" partition, build with node and the package.json dev dependencies')
+
+    # 48 hourly and 15 daily rows over a handful of conditions, at one size
+    dut.write('forecast demo')
+    dut.expect(r'forecast: hourly=\d+ daily=\d+', timeout=10)
+    dut.write('page 1')
+    dut.expect(r'transition: slide frames=\d+', timeout=10)
+    dut.write('icons')
+    (lookups, hits, hit_pct, decodes, decode_avg_us, decode_max_us, evictions, cached_bytes, _,
+     raw_bytes) = (int(g) for g in dut.expect(ICONS_STATS, timeout=10).groups())
+    print(f'icons: lookups={lookups} hit_pct={hit_pct} decodes={decodes} decode_avg_us={decode_avg_us} '
+          f'cached_bytes={cached_bytes}')
+    assert lookups > 0 and decodes > 0
+    # A miss is decoded at most once, the rows sharing a condition hit the cache
+    assert hits + decodes <= lookups
+    assert hit_pct >= 50
+    assert decode_avg_us <= decode_max_us
+    assert 0 < cached_bytes <= raw_bytes
+    # The RLE atlas, tables included, is smaller than the A8 glyphs it decodes to
+    assert flash_bytes < raw_bytes
+
+
+BACKDROP_STATS = (r'backdrop: playing=(\d) paused=(\d) frames=(\d+) tiles_avg=\d+ apply_avg_us=(\d+) '
+                  r'apply_max_us=(\d+) psram_bytes_avg=(\d+) full_frame_bytes=(\d+)')
+
+
+def read_backdrop(dut: Dut, wait_s: float = 0) -> list:
+    """Clear the backdrop counters, wait `wait_s` and return the next "backdrop" line as integers"""
+    dut.write('backdrop')
+    dut.expect(BACKDROP_STATS, timeout=10)
+    time.sleep(wait_s)
+    dut.write('backdrop')
+    return [int(g) for g in dut.expect(BACKDROP_STATS, timeout=10).groups()]
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.parametrize('config', ['backdrop'], indirect=True)
+def test_rgb_lcd_lvgl_backdrop(dut: Dut) -> None:
+    dut.expect_exact('weather>', timeout=30)
+    playing, paused, frames, apply_avg_us, apply_max_us, psram_bytes_avg, full_frame_bytes = read_backdrop(dut, 2)
+    assert playing, 'no animation in the "backdrop" partition, is assets/backdrop.bin flashed?'
+    print(f'backdrop: frames={frames} apply_avg_us={apply_avg_us} psram_bytes_avg={psram_bytes_avg}')
+    assert not paused and frames > 0
+    assert apply_avg_us <= apply_max_us
+    # Only the changed tiles are written. Full refresh still redraws the whole screen, so render time is not checked
+    assert psram_bytes_avg < full_frame_bytes
+
+    # No frames while the forecast page hides the dashboard
+    dut.write('forecast demo')
+    dut.expect(r'forecast: hourly=\d+ daily=\d+', timeout=10)
+    dut.write('page 1')
+    dut.expect(r'transition: slide frames=\d+', timeout=10)
+    playing, paused, frames = read_backdrop(dut, 2)[:3]
+    assert playing and paused and frames == 0
+
+    dut.write('page 0')
+    dut.expect(r'transition: slide frames=\d+', timeout=10)
+    playing, paused, frames = read_backdrop(dut, 2)[:3]
+    assert playing and not paused and frames > 0
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.parametrize('config', ['double_fb'], indirect=True)
+def test_rgb_lcd_lvgl_config_batching(dut: Dut) -> None:
+    dut.expect_exact('weather>', timeout=30)
+    dut.write('config')     # Start from clear counters
+    dut.expect(r'config: sets=\d+', timeout=10)
+
+    # A burst of changes is applied as one snapshot with one commit
+    for i in range(19):
+        dut.write(f'config set wx_cities 1012{i:05d}')
+    dut.write('config set wx_cities 101010100,101020100')
+    time.sleep(5)
+    dut.write('config')
+    dut.expect_exact('"101010100,101020100"', timeout=10)
+    res = dut.expect(r'config: sets=(\d+) rejected=0 batches=(\d+) stored=(\d+) commit_max_ms=(\d+) staged=0', timeout=10)
+    assert int(res.group(1)) == 20
+    assert res.group(2) == '1' and res.group(3) == '1'
+
+    dut.write('config set wx_refresh_s 100000')
+    dut.expect_exact('config: wx_refresh_s rejected the value', timeout=10)
+
+    # What was committed survives a reset
+    dut.serial.hard_reset()
+    dut.expect_exact('weather>', timeout=30)
+    dut.write('config')
+    dut.expect_exact('"101010100,101020100"', timeout=10)
+    dut.write('config set wx_cities 101250101')
+    dut.write('config commit')
+    dut.write('config')
+    dut.expect(r'config: sets=1 rejected=0 batches=1 stored=1', timeout=10)
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.wifi_router
+@pytest.mark.parametrize('config', ['http_standin'], indirect=True)
+def test_rgb_lcd_lvgl_network_timeline(dut: Dut, weather_standin: str) -> None:
+    timeline = expect_timeline(dut)
+    if timeline['wifi'] is None:
+        # Nothing stored from an earlier run, join now; still well within the budget from boot
+        connect_wifi(dut)
+        timeline = expect_timeline(dut, until='wifi')
+    dut.write(f'weather -u {weather_standin}/sk_2d/ 101250101')
+    timeline = expect_timeline(dut, until='weather')
+    assert timeline['interactive'] <= timeline['wifi'] <= timeline['weather']
+    check_timeline_budgets(timeline, list(TIMELINE_BUDGET_MS))
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.wifi_router
+@pytest.mark.parametrize('config', ['http_standin'], indirect=True)
+def test_rgb_lcd_lvgl_http_keepalive(dut: Dut, weather_standin: str) -> None:
+    connect_wifi(dut)
+    url = f'{weather_standin}/sk_2d/101250101.html'
+
+    # Kept-alive: one handshake for all requests, chunked bodies included
+    dut.write(f'fetch {url} 5')
+    res = dut.expect(r'http: requests=(\d+) reused=(\d+) handshakes=(\d+) ticket_offers=\d+ retries=\d+ failures=(\d+) '
+                     r'handshake_avg_ms=(\d+) handshake_max_ms=\d+ fetch_avg_ms=(\d+)', timeout=60)
+    assert [int(res.group(i)) for i in range(1, 5)] == [5, 4, 1, 0]
+    full_handshake_ms = int(res.group(5))
+    dut.write(f'fetch {url}?chunked=1 2')
+    res = dut.expect(r'http: requests=(\d+) reused=(\d+) handshakes=(\d+) ticket_offers=\d+ retries=\d+ failures=(\d+)',
+                     timeout=60)
+    assert [int(res.group(i)) for i in range(1, 5)] == [2, 2, 0, 0]
+
+    # Closed in between: every request handshakes again, resuming the saved session
+    dut.write(f'fetch {url} 5 close')
+    res = dut.expect(r'http: requests=(\d+) reused=(\d+) handshakes=(\d+) ticket_offers=(\d+) retries=\d+ failures=(\d+) '
+                     r'handshake_avg_ms=(\d+)', timeout=60)
+    assert [int(res.group(i)) for i in range(1, 6)] == [5, 0, 5, 5, 0]
+    assert int(res.group(6)) < full_handshake_ms
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.wifi_router
+@pytest.mark.parametrize('config', ['http_standin'], indirect=True)
+def test_rgb_lcd_lvgl_weather_pipeline(dut: Dut) -> None:
+    latency_ms = 300
+    connect_wifi(dut)
+    with run_standin(latency_ms) as url:
+        totals = {}
+        for concurrency in (1, 3):
+            for n in (1, 2, 4, 8):
+                codes = ' '.join(str(101250101 + i) for i in range(n))
+                dut.write(f'weather -c {concurrency} -u {url}/sk_2d/ {codes}')
+                res = dut.expect(r'weather: refresh cities=(\d+) concurrency=(\d+) first_ms=(\d+) total_ms=(\d+) '
+                                 r'slowest_ms=\d+ failures=(\d+)', timeout=60)
+                assert int(res.group(1)) == n and int(res.group(5)) == 0
+                totals[(concurrency, n)] = (int(res.group(3)), int(res.group(4)))
+
+    print('cities  sequential_ms  pipelined_ms  pipelined_first_ms')
+    for n in (1, 2, 4, 8):
+        print(f'{n:6}  {totals[(1, n)][1]:13}  {totals[(3, n)][1]:12}  {totals[(3, n)][0]:18}')
+
+    # Sequential grows by the latency per city, pipelined by the latency per batch of 3
+    assert totals[(1, 8)][1] >= 8 * latency_ms
+    assert totals[(3, 8)][1] < totals[(1, 8)][1] / 2
+    # Results stream in: the first city is published long before the last
+    assert totals[(3, 8)][0] < totals[(3, 8)][1] / 2
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.wifi_router
+@pytest.mark.parametrize('config', ['http_standin'], indirect=True)
+def test_rgb_lcd_lvgl_delta_ota(dut: Dut, tmp_path: str) -> None:
+    # The patch applies to the running image, OTA_NEW_BIN may name a later build to update to
+    old_bin = dut.app.binary_file
+    new_bin = os.path.join(tmp_path, 'app.bin')
+    shutil.copy(os.getenv('OTA_NEW_BIN', old_bin), new_bin)
+    script = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'build_patch.js')
+    print(subprocess.run(['node', script, old_bin, new_bin, os.path.join(tmp_path, 'app.patch')],
+                         check=True, capture_output=True, text=True).stdout)
+
+    running = dut.expect(r'ota: running (\w+)', timeout=30).group(1).decode()
+    connect_wifi(dut)
+    with run_ota_server(str(tmp_path)) as url:
+        dut.write(f'ota {url}/app.bin')
+        full = dut.expect(r'ota: full download_bytes=(\d+) image_bytes=(\d+) ratio=\d+% ms=(\d+)', timeout=300)
+        dut.write(f'ota {url}/app.patch reboot')
+        delta = dut.expect(r'ota: delta download_bytes=(\d+) image_bytes=(\d+) ratio=(\d+)% ms=(\d+) ram_bytes=(\d+)',
+                           timeout=300)
+
+    print(f'full:  {int(full.group(1))} bytes in {int(full.group(3))} ms')
+    print(f'delta: {int(delta.group(1))} bytes ({int(delta.group(3))}% of full) in {int(delta.group(4))} ms, '
+          f'{int(delta.group(5))} bytes of RAM')
+    assert int(delta.group(2)) == int(full.group(2)) == os.path.getsize(new_bin)
+    assert int(delta.group(1)) < int(full.group(1))
+    assert int(delta.group(5)) < 64 * 1024
+
+    # The patched image boots from the other slot and keeps itself
+    res = dut.expect(r'ota: running (\w+), new image accepted', timeout=60)
+    assert res.group(1).decode() != running
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.wifi_router
+@pytest.mark.parametrize('config', ['http_standin'], indirect=True)
+def test_rgb_lcd_lvgl_http_api(dut: Dut) -> None:
+    ip = connect_wifi(dut)
+    script = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'scrape_bench.js')
+    dut.write('api')    # Start from clear counters
+    dut.expect(r'api: requests=', timeout=10)
+
+    rows = []
+    for clients in (1, 2, 4):
+        out = subprocess.run(['node', script, f'http://{ip}', '--clients', str(clients), '--seconds', '10',
+                              '--path', '/metrics,/api/readings,/api/history?format=bin'],
+                             check=True, capture_output=True, text=True).stdout
+        print(out)
+        bench = dict(item.split('=') for item in out.split('scrape: ')[1].split())
+        dut.write('api')
+        res = dut.expect(r'api: requests=(\d+) errors=(\d+) bytes=\d+ handler_avg_us=(\d+) handler_max_us=\d+ '
+                         r'heap_min_free=(\d+)', timeout=10)
+        assert int(bench['errors']) == 0 and int(res.group(2)) == 0
+        assert int(res.group(1)) >= int(bench['requests'])
+        rows.append((clients, float(bench['rps']), float(bench['p99_ms']), int(res.group(3)), int(res.group(4))))
+
+    print('clients  req/s  p99_ms  handler_avg_us  heap_min_free')
+    for row in rows:
+        print(f'{row[0]:7}  {row[1]:5.1f}  {row[2]:6.1f}  {row[3]:14}  {row[4]:13}')
+    # Concurrent scrapers queue on the one server task instead of costing heap per client
+    assert rows[-1][4] > rows[0][4] - 8 * 1024
+    assert rows[-1][1] >= rows[0][1] * 0.8
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.wifi_router
+@pytest.mark.parametrize('config', ['telemetry'], indirect=True)
+def test_rgb_lcd_lvgl_telemetry(dut: Dut, tmp_path: str) -> None:
+    if not shutil.which('mosquitto') or not shutil.which('mosquitto_sub'):
+        pytest.skip('needs mosquitto and mosquitto_sub on the host')
+    conf = os.path.join(tmp_path, 'mosquitto.conf')
+    with open(conf, 'w') as f:
+        f.write('listener 1883 0.0.0.0\nallow_anonymous true\n')
+    frames = os.path.join(tmp_path, 'frames.txt')
+    broker = subprocess.Popen(['mosquitto', '-c', conf])
+    with open(frames, 'w') as out:
+        sub = subprocess.Popen(['mosquitto_sub', '-h', '127.0.0.1', '-q', '1', '-t', 'weather/+/telemetry',
+                                '-F', '%t %x'], stdout=out)
+    try:
+        connect_wifi(dut)
+        dut.write('telemetry')  # Start from clear counters
+        dut.expect(r'telemetry: samples=', timeout=10)
+        dut.write(f'telemetry broker mqtt://{host_ip()}:1883')
+        dut.expect(r'I \(\d+\) telemetry: connected', timeout=30)
+
+        # Online: frames go out as they close
+        time.sleep(35)
+        dut.write('telemetry')
+        online = dut.expect(r'telemetry: samples=(\d+) frames=(\d+) bytes_per_sample=([\d.]+) wire_bytes_per_sample=([\d.]+) '
+                            r'single_wire_bytes_per_sample=([\d.]+) live=(\d+) spooled=(\d+)', timeout=10)
+        assert int(online.group(6)) >= 2
+
+        # Offline: frames go to flash, then drain at the configured rate once the broker is back
+        dut.write('telemetry offline')
+        time.sleep(60)
+        dut.write('telemetry flush')
+        dut.write('telemetry')
+        offline = dut.expect(r'telemetry: samples=\d+ frames=(\d+) .* live=(\d+) spooled=(\d+) .* backlog=(\d+)', timeout=10)
+        assert int(offline.group(2)) == 0 and int(offline.group(3)) >= 5 and int(offline.group(4)) >= 5
+        dut.write('telemetry online')
+        drain = dut.expect(r'I \(\d+\) telemetry: drained frames=(\d+) bytes=(\d+) ms=(\d+) bytes_per_s=(\d+)', timeout=120)
+        dut.write('telemetry')
+        dut.expect(r'telemetry: .* lost=0 backlog=0', timeout=10)
+        time.sleep(2)
+    finally:
+        sub.terminate()
+        sub.wait()
+        broker.terminate()
+        broker.wait()
+
+    script = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'telemetry_decode.js')
+    with open(frames) as f:
+        decoded = subprocess.run(['node', script], stdin=f, check=True, capture_output=True, text=True).stdout
+    print(decoded)
+    summary = dict(item.split('=') for item in decoded.split('decode: ')[1].split())
+
+    print(f'bytes/sample: payload {online.group(3)}, on the wire {online.group(4)}, '
+          f'published one by one {online.group(5)}')
+    print(f'drain: {drain.group(1)} frames, {drain.group(2)} bytes in {drain.group(3)} ms = {drain.group(4)} B/s')
+    assert float(online.group(4)) * 5 < float(online.group(5))
+    assert int(drain.group(1)) >= int(offline.group(4))
+    assert int(drain.group(4)) < 2 * 64
+    assert summary['gaps'] == '0' and summary['errors'] == '0'
+
+
+@pytest.mark.esp32s3
+@pytest.mark.octal_psram
+@pytest.mark.wifi_router
+@pytest.mark.parametrize('config', ['http_standin'], indirect=True)
+def test_rgb_lcd_lvgl_display_mirror(dut: Dut, tmp_path: str) -> None:
+    ip = connect_wifi(dut)
+    script = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'mirror_view.js')
+    png = os.path.join(tmp_path, 'mirror.png')
+    dut.write('mirror')     # Start from clear counters
+    dut.expect(r'mirror: viewer=0', timeout=10)
+
+    out = subprocess.run(['node', script, ip, '--token', 'ci-mirror', '--out', png, '--seconds', '20'],
+                         check=True, capture_output=True, text=True).stdout
+    print(out)
+    view = dict(item.split('=') for item in out.split('mirror: ')[1].split())
+    dut.write('mirror')
+    res = dut.expect(r'mirror: viewer=\d frames=\d+ rects=\d+ pixels=(\d+) .* flush_max_us=(\d+)', timeout=10)
+
+    # The viewer got the whole screen once, then only what changed
+    assert view['errors'] == '0' and int(view['frames']) > 0 and os.path.getsize(png) > 0
+    assert int(res.group(1)) >= 800 * 480
+    assert int(view['bytes']) < 2 * 800 * 480 + int(view['frames']) * 800 * 480 * 2 // 10
+    # Encoding stays within the budget, one band of overrun at most
+    assert int(res.group(2)) < 2000 + 1000
@@ -0,0 +1,69 @@
+const http = require('http');
+
+// 用法: node scrape_bench.js <设备地址, 如 http://192.168.1.50> [--clients 4] [--seconds 10] [--path /metrics]
+// 模拟多个监控端同时抓取设备的 HTTP API: 每个客户端一条长连接, 收完一个响应立即发下一个,
+// 结束时打印每秒请求数和延迟分位数
+const args = process.argv.slice(2);
+function option(name, fallback) {
+    const i = args.indexOf(name);
+    return i >= 0 && i + 1 < args.length ? args[i + 1] : fallback;
+}
+const base = args[0] && !args[0].startsWith('--') ? args[0].replace(/\/$/, '') : null;
+const clients = parseInt(option('--clients', '4'), 10);
+const seconds = parseFloat(option('--seconds', '10'));
+const paths = option('--path', '/metrics').split(',');
+
+if (!base) {
+    console.error('用法: node scrape_bench.js <设备地址> [--clients 4] [--seconds 10] [--path /metrics[,/api/readings]]');
+    process.exit(1);
+}
+
+const latencies = [];
+let bytes = 0;
+let errors = 0;
+const deadline = Date.now() + seconds * 1000;
+
+function client(id) {
+    // 每个客户端独占一条连接, 与 Prometheus 的抓取方式一致
+    const agent = new http.Agent({ keepAlive: true, maxSockets: 1 });
+    return new Promise((resolve) => {
+        let n = 0;
+        const next = () => {
+            if (Date.now() >= deadline) {
+                agent.destroy();
+                resolve();
+                return;
+            }
+            const started = process.hrtime.bigint();
+            const req = http.get(base + paths[(id + n++) % paths.length], { agent }, (res) => {
+                let len = 0;
+                res.on('data', (chunk) => len += chunk.length);
+                res.on('end', () => {
+                    if (res.statusCode === 200) {
+                        latencies.push(Number(process.hrtime.bigint() - started) / 1e6);
+                        bytes += len;
+                    } else {
+                        errors++;
+                    }
+                    next();
+                });
+            });
+            req.setTimeout(5000, () => req.destroy(new Error('超时')));
+            req.on('error', () => {
+                errors++;
+                setTimeout(next, 100);
+            });
+        };
+        next();
+    });
+}
+
+const started = Date.now();
+Promise.all(Array.from({ length: clients }, (_, i) => client(i))).then(() => {
+    const elapsed = (Date.now() - started) / 1000;
+    latencies.sort((a, b) => a - b);
+    const pct = (p) => latencies.length ? latencies[Math.min(latencies.length - 1, Math.floor(latencies.length * p))].toFixed(1) : '-';
+    console.log(`scrape: clients=${clients} requests=${latencies.length} errors=${errors} ` +
+        `rps=${(latencies.length / elapsed).toFixed(1)} p50_ms=${pct(0.5)} p99_ms=${pct(0.99)} ` +
+        `max_ms=${pct(1)} bytes_per_req=${latencies.length ? Math.round(bytes / latencies.length) : 0}`);
+});
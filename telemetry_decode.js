@@ -0,0 +1,115 @@
+const readline = require('readline');
+
+// 用法: mosquitto_sub -h <broker> -t 'weather/+/telemetry' -F '%t %x' | node telemetry_decode.js [--csv]
+// 解码设备端 app_telemetry.c 发布的遥测帧 (格式见 app_telemetry.h), 按 (boot_id, seq) 去重,
+// 输入结束时打印帧数, 重复帧, 缺失帧和每个样本的平均字节数; --csv 时逐个样本输出
+const csv = process.argv.includes('--csv');
+
+// 与 app_telemetry.h 中的 app_telemetry_frame_header_t 保持一致
+const FRAME_VERSION = 1;
+const HEADER_SIZE = 16;
+const QUANTITIES = ['temperature', 'humidity', 'pressure', 'light', 'air_quality'];
+
+function readVarint(buf, pos) {
+    let value = 0;
+    let shift = 0;
+    for (;;) {
+        if (pos.off >= buf.length) {
+            throw new Error('帧被截断');
+        }
+        const b = buf[pos.off++];
+        value += (b & 0x7f) * 2 ** shift;
+        if (!(b & 0x80)) {
+            return value;
+        }
+        shift += 7;
+    }
+}
+
+function unzigzag(v) {
+    return v % 2 ? -(v + 1) / 2 : v / 2;
+}
+
+function decodeFrame(buf) {
+    if (buf.length < HEADER_SIZE || buf[0] !== FRAME_VERSION) {
+        throw new Error(`不支持的帧, 版本 ${buf[0]}`);
+    }
+    const frame = {
+        records: buf.readUInt16LE(2),
+        seq: buf.readUInt32LE(4),
+        bootId: buf.readUInt32LE(8),
+        baseMs: buf.readUInt32LE(12),
+        samples: [],
+    };
+    const pos = { off: HEADER_SIZE };
+    const last = new Array(QUANTITIES.length).fill(0);
+    let ms = frame.baseMs;
+    for (let r = 0; r < frame.records; r++) {
+        ms += readVarint(buf, pos);
+        const mask = buf[pos.off++];
+        for (let q = 0; q < QUANTITIES.length; q++) {
+            if (mask & (1 << q)) {
+                last[q] += unzigzag(readVarint(buf, pos));
+                frame.samples.push({ ms, quantity: QUANTITIES[q], value: last[q] / 100 });
+            }
+        }
+    }
+    if (pos.off !== buf.length) {
+        throw new Error(`帧末尾多出 ${buf.length - pos.off} 字节`);
+    }
+    return frame;
+}
+
+const seen = new Map();     // 每个设备和启动: 已收到的 seq
+let frames = 0;
+let duplicates = 0;
+let bytes = 0;
+let samples = 0;
+let errors = 0;
+
+if (csv) {
+    console.log('topic,boot_id,seq,ms,quantity,value');
+}
+
+readline.createInterface({ input: process.stdin }).on('line', (line) => {
+    const [topic, hex] = line.trim().split(/\s+/);
+    if (!hex) {
+        return;
+    }
+    let frame;
+    try {
+        frame = decodeFrame(Buffer.from(hex, 'hex'));
+    } catch (e) {
+        errors++;
+        console.error(`${topic}: ${e.message}`);
+        return;
+    }
+    const key = `${topic} ${frame.bootId}`;
+    if (!seen.has(key)) {
+        seen.set(key, new Set());
+    }
+    // QoS 1 至少送达一次, 断线重发会产生重复帧
+    if (seen.get(key).has(frame.seq)) {
+        duplicates++;
+        return;
+    }
+    seen.get(key).add(frame.seq);
+    frames++;
+    bytes += hex.length / 2;
+    samples += frame.samples.length;
+    if (csv) {
+        for (const s of frame.samples) {
+            console.log(`${topic},${frame.bootId},${frame.seq},${s.ms},${s.quantity},${s.value}`);
+        }
+    }
+}).on('close', () => {
+    // 每次启动内 seq 连续, 中间缺的就是丢失的帧
+    let gaps = 0;
+    for (const seqs of seen.values()) {
+        const sorted = [...seqs].sort((a, b) => a - b);
+        gaps += sorted[sorted.length - 1] - sorted[0] + 1 - sorted.length;
+    }
+    const summary = `decode: frames=${frames} duplicates=${duplicates} gaps=${gaps} errors=${errors} ` +
+        `samples=${samples} bytes_per_sample=${samples ? (bytes / samples).toFixed(2) : 0}`;
+    (csv ? console.error : console.log)(summary);
+});
@@ -0,0 +1,120 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "app_config_mock.h"
+
+#define MOCK_MAX_KEYS       (16)
+#define MOCK_KEY_LEN        (16)        /* Same limit as NVS */
+#define MOCK_VALUE_MAX      (APP_CONFIG_WEATHER_CITIES_MAX)
+
+static const char *TAG = "config_mock";
+
+typedef struct {
+    char key[MOCK_KEY_LEN];
+    app_config_type_t type;
+    uint8_t value[MOCK_VALUE_MAX];      /* Committed */
+    uint8_t staged[MOCK_VALUE_MAX];
+    bool present;
+    bool dirty;
+} mock_entry_t;
+
+static struct {
+    mock_entry_t entries[MOCK_MAX_KEYS];
+    int num_entries;
+    uint32_t fail_next;
+    uint32_t stores;
+    uint32_t commits;
+} s_mock;
+
+static mock_entry_t *mock_find(const char *key)
+{
+    for (int i = 0; i < s_mock.num_entries; i++) {
+        if (strcmp(s_mock.entries[i].key, key) == 0) {
+            return &s_mock.entries[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t mock_load(void *ctx, const char *key, app_config_type_t type, void *value, size_t size)
+{
+    mock_entry_t *entry = mock_find(key);
+    if (!entry || !entry->present) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    ESP_RETURN_ON_FALSE(entry->type == type, ESP_ERR_INVALID_STATE, TAG, "%s stored with another type", key);
+    if (type == APP_CONFIG_TYPE_U32) {
+        memcpy(value, entry->value, sizeof(uint32_t));
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_FALSE(strlen((const char *)entry->value) < size, ESP_ERR_INVALID_SIZE, TAG, "%s too long", key);
+    strcpy(value, (const char *)entry->value);
+    return ESP_OK;
+}
+
+static esp_err_t mock_store(void *ctx, const char *key, app_config_type_t type, const void *value)
+{
+    ESP_RETURN_ON_FALSE(strlen(key) < MOCK_KEY_LEN, ESP_ERR_INVALID_ARG, TAG, "key %s too long", key);
+    size_t len = type == APP_CONFIG_TYPE_U32 ? sizeof(uint32_t) : strlen(value) + 1;
+    ESP_RETURN_ON_FALSE(len <= MOCK_VALUE_MAX, ESP_ERR_INVALID_SIZE, TAG, "%s too long", key);
+
+    mock_entry_t *entry = mock_find(key);
+    if (!entry) {
+        ESP_RETURN_ON_FALSE(s_mock.num_entries < MOCK_MAX_KEYS, ESP_ERR_NO_MEM, TAG, "too many keys");
+        entry = &s_mock.entries[s_mock.num_entries++];
+        strcpy(entry->key, key);
+    }
+    entry->type = type;
+    memcpy(entry->staged, value, len);
+    entry->dirty = true;
+    s_mock.stores++;
+    return ESP_OK;
+}
+
+static esp_err_t mock_commit(void *ctx)
+{
+    s_mock.commits++;
+    if (s_mock.fail_next) {
+        /* Like losing power before the commit: nothing staged survives */
+        s_mock.fail_next--;
+        for (int i = 0; i < s_mock.num_entries; i++) {
+            s_mock.entries[i].dirty = false;
+        }
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < s_mock.num_entries; i++) {
+        mock_entry_t *entry = &s_mock.entries[i];
+        if (entry->dirty) {
+            memcpy(entry->value, entry->staged, sizeof(entry->value));
+            entry->present = true;
+            entry->dirty = false;
+        }
+    }
+    return ESP_OK;
+}
+
+static const app_config_backend_t s_mock_backend = {
+    .load = mock_load,
+    .store = mock_store,
+    .commit = mock_commit,
+};
+
+const app_config_backend_t *app_config_mock_backend(void)
+{
+    return &s_mock_backend;
+}
+
+void app_config_mock_fail_next(uint32_t count)
+{
+    s_mock.fail_next = count;
+}
+
+void app_config_mock_get_counters(uint32_t *stores, uint32_t *commits)
+{
+    *stores = s_mock.stores;
+    *commits = s_mock.commits;
+}
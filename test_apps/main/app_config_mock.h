@@ -0,0 +1,31 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "app_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Mock backend for tests: keys in RAM, staged until committed
+ */
+const app_config_backend_t *app_config_mock_backend(void);
+
+/**
+ * @brief Make the next `count` commits of the mock fail, dropping what was staged
+ */
+void app_config_mock_fail_next(uint32_t count);
+
+/**
+ * @brief Number of stores and commits seen by the mock
+ */
+void app_config_mock_get_counters(uint32_t *stores, uint32_t *commits);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,125 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_check.h"
+#include "app_i2c_bus_mock.h"
+
+#define MOCK_MAX_DEVICES    (8)
+/* Start, address byte with ACK, stop */
+#define MOCK_FRAME_BITS     (2 + 9)
+
+static const char *TAG = "i2c_mock";
+
+typedef struct {
+    uint16_t addr;
+    uint8_t reg_bytes;
+    uint8_t *regs;
+    size_t regs_len;
+    size_t reg_ptr;
+    uint32_t fail_next;
+    uint32_t scl_speed_hz;
+} mock_dev_t;
+
+static struct {
+    mock_dev_t devs[MOCK_MAX_DEVICES];
+    int num_devs;
+    uint32_t xfers;
+    uint64_t wire_us;
+} s_mock;
+
+static mock_dev_t *mock_find(uint16_t addr)
+{
+    for (int i = 0; i < s_mock.num_devs; i++) {
+        if (s_mock.devs[i].addr == addr) {
+            return &s_mock.devs[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t mock_add_device(void *ctx, uint16_t addr, uint32_t scl_speed_hz, void **ret_dev)
+{
+    mock_dev_t *dev = mock_find(addr);
+    ESP_RETURN_ON_FALSE(dev, ESP_ERR_NOT_FOUND, TAG, "no simulated device at 0x%02x", addr);
+    dev->scl_speed_hz = scl_speed_hz;
+    *ret_dev = dev;
+    return ESP_OK;
+}
+
+static esp_err_t mock_transfer(void *ctx, void *handle, const app_i2c_xfer_t *xfer, int timeout_ms)
+{
+    mock_dev_t *dev = handle;
+    size_t bits = 0;
+
+    s_mock.xfers++;
+    if (dev->fail_next) {
+        dev->fail_next--;
+        s_mock.wire_us += (uint64_t)MOCK_FRAME_BITS * 1000000 / dev->scl_speed_hz;
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (xfer->tx_len) {
+        size_t i = 0;
+        if (xfer->tx_len >= dev->reg_bytes) {
+            dev->reg_ptr = 0;
+            for (; i < dev->reg_bytes; i++) {
+                dev->reg_ptr = (dev->reg_ptr << 8) | xfer->tx[i];
+            }
+        }
+        for (; i < xfer->tx_len; i++) {
+            dev->regs[dev->reg_ptr++ % dev->regs_len] = xfer->tx[i];
+        }
+        bits += MOCK_FRAME_BITS + xfer->tx_len * 9;
+    }
+    for (size_t i = 0; i < xfer->rx_len; i++) {
+        xfer->rx[i] = dev->regs[dev->reg_ptr++ % dev->regs_len];
+    }
+    if (xfer->rx_len) {
+        bits += MOCK_FRAME_BITS + xfer->rx_len * 9;
+    }
+    s_mock.wire_us += (uint64_t)bits * 1000000 / dev->scl_speed_hz;
+    return ESP_OK;
+}
+
+static const app_i2c_backend_t s_mock_backend = {
+    .add_device = mock_add_device,
+    .transfer = mock_transfer,
+};
+
+const app_i2c_backend_t *app_i2c_bus_mock_backend(void)
+{
+    return &s_mock_backend;
+}
+
+esp_err_t app_i2c_bus_mock_add_device(uint16_t addr, uint8_t reg_bytes, uint8_t *regs, size_t regs_len)
+{
+    ESP_RETURN_ON_FALSE(regs && regs_len && reg_bytes <= 2, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    ESP_RETURN_ON_FALSE(!mock_find(addr), ESP_ERR_INVALID_STATE, TAG, "0x%02x already simulated", addr);
+    ESP_RETURN_ON_FALSE(s_mock.num_devs < MOCK_MAX_DEVICES, ESP_ERR_NO_MEM, TAG, "too many devices");
+
+    s_mock.devs[s_mock.num_devs++] = (mock_dev_t) {
+        .addr = addr,
+        .reg_bytes = reg_bytes,
+        .regs = regs,
+        .regs_len = regs_len,
+        .scl_speed_hz = 100000,
+    };
+    return ESP_OK;
+}
+
+void app_i2c_bus_mock_fail_next(uint16_t addr, uint32_t count)
+{
+    mock_dev_t *dev = mock_find(addr);
+    if (dev) {
+        dev->fail_next = count;
+    }
+}
+
+void app_i2c_bus_mock_get_counters(uint32_t *xfers, uint64_t *wire_us)
+{
+    *xfers = s_mock.xfers;
+    *wire_us = s_mock.wire_us;
+}
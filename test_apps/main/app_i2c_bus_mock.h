@@ -0,0 +1,41 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "app_i2c_bus.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Mock backend for tests: register-file devices that log every transfer
+ *
+ * The first `reg_bytes` written select the register, the rest are stored from there on;
+ * reads continue from the selected register.
+ */
+const app_i2c_backend_t *app_i2c_bus_mock_backend(void);
+
+/**
+ * @brief Add a simulated device to the mock bus
+ */
+esp_err_t app_i2c_bus_mock_add_device(uint16_t addr, uint8_t reg_bytes, uint8_t *regs, size_t regs_len);
+
+/**
+ * @brief Make the next `count` transfers to `addr` fail with a NACK
+ */
+void app_i2c_bus_mock_fail_next(uint16_t addr, uint32_t count);
+
+/**
+ * @brief Number of transfers seen by the mock and simulated wire time in microseconds
+ */
+void app_i2c_bus_mock_get_counters(uint32_t *xfers, uint64_t *wire_us);
+
+#ifdef __cplusplus
+}
+#endif
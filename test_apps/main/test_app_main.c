@@ -0,0 +1,10 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "unity.h"
+
+void app_main(void)
+{
+    unity_run_menu();
+}
@@ -0,0 +1,121 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "unity.h"
+#include "app_config_mock.h"
+
+/* Long enough for a batch to be applied, and for a retry after a failed one */
+#define TEST_BATCH_WAIT_MS  (CONFIG_APP_CONFIG_COMMIT_DELAY_MS * 10)
+
+static SemaphoreHandle_t s_applied;
+static uint32_t s_changed;
+
+static void test_listener(uint32_t changed, void *arg)
+{
+    s_changed = changed;
+    xSemaphoreGive(s_applied);
+}
+
+/* The config task has no deinit, so it is started once for every test */
+static void test_config_setup(void)
+{
+    app_config_stats_t stats;
+
+    if (!s_applied) {
+        s_applied = xSemaphoreCreateCounting(8, 0);
+        TEST_ASSERT_NOT_NULL(s_applied);
+        TEST_ESP_OK(app_config_init(app_config_mock_backend()));
+        TEST_ESP_OK(app_config_add_listener(test_listener, NULL));
+    }
+    while (xSemaphoreTake(s_applied, 0) == pdTRUE) {
+    }
+    TEST_ESP_OK(app_config_get_stats(&stats));
+}
+
+TEST_CASE("config stores a burst of changes with one commit", "[config]")
+{
+    uint32_t stores_before, commits_before, stores_after, commits_after;
+    app_config_stats_t stats;
+
+    test_config_setup();
+    const app_config_t *cfg = app_config_get();
+    const uint32_t refresh_s = cfg->weather_refresh_s + 60;
+    const char *cities = strcmp(cfg->weather_cities, "101010100") ? "101010100" : "101020100";
+    const char *broker = strcmp(cfg->telemetry_broker, "mqtt://broker.local") ? "mqtt://broker.local" : "";
+
+    app_config_mock_get_counters(&stores_before, &commits_before);
+    TEST_ESP_OK(app_config_set_u32(APP_CONFIG_WEATHER_REFRESH_S, refresh_s));
+    TEST_ESP_OK(app_config_set_str(APP_CONFIG_WEATHER_CITIES, cities));
+    TEST_ESP_OK(app_config_set_str(APP_CONFIG_TELEMETRY_BROKER, broker));
+    TEST_ASSERT_TRUE(xSemaphoreTake(s_applied, pdMS_TO_TICKS(TEST_BATCH_WAIT_MS)));
+    TEST_ASSERT_EQUAL_UINT32((1u << APP_CONFIG_KEY_MAX) - 1, s_changed);
+    /* Nothing is left for another batch */
+    TEST_ASSERT_FALSE(xSemaphoreTake(s_applied, pdMS_TO_TICKS(CONFIG_APP_CONFIG_COMMIT_DELAY_MS * 3)));
+
+    cfg = app_config_get();
+    TEST_ASSERT_EQUAL_UINT32(refresh_s, cfg->weather_refresh_s);
+    TEST_ASSERT_EQUAL_STRING(cities, cfg->weather_cities);
+    TEST_ASSERT_EQUAL_STRING(broker, cfg->telemetry_broker);
+
+    app_config_mock_get_counters(&stores_after, &commits_after);
+    TEST_ASSERT_EQUAL_UINT32(APP_CONFIG_KEY_MAX, stores_after - stores_before);
+    TEST_ASSERT_EQUAL_UINT32(1, commits_after - commits_before);
+    TEST_ESP_OK(app_config_get_stats(&stats));
+    TEST_ASSERT_EQUAL_UINT32(APP_CONFIG_KEY_MAX, stats.sets);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.batches);
+    TEST_ASSERT_EQUAL_UINT32(APP_CONFIG_KEY_MAX, stats.stored);
+}
+
+TEST_CASE("config stores the changes again after a failed commit", "[config]")
+{
+    uint32_t stores_before, commits_before, stores_after, commits_after;
+    uint32_t stored = 0;
+    app_config_stats_t stats;
+
+    test_config_setup();
+    const uint32_t refresh_s = app_config_get()->weather_refresh_s + 60;
+
+    app_config_mock_get_counters(&stores_before, &commits_before);
+    app_config_mock_fail_next(1);
+    TEST_ESP_OK(app_config_set_u32(APP_CONFIG_WEATHER_REFRESH_S, refresh_s));
+    /* Readers see the value as soon as the batch is applied, even though storing it failed */
+    TEST_ASSERT_TRUE(xSemaphoreTake(s_applied, pdMS_TO_TICKS(TEST_BATCH_WAIT_MS)));
+    TEST_ASSERT_EQUAL_UINT32(refresh_s, app_config_get()->weather_refresh_s);
+    TEST_ASSERT_TRUE(xSemaphoreTake(s_applied, pdMS_TO_TICKS(TEST_BATCH_WAIT_MS)));
+    TEST_ASSERT_EQUAL_UINT32(1u << APP_CONFIG_WEATHER_REFRESH_S, s_changed);
+
+    app_config_mock_get_counters(&stores_after, &commits_after);
+    TEST_ASSERT_EQUAL_UINT32(2, stores_after - stores_before);
+    TEST_ASSERT_EQUAL_UINT32(2, commits_after - commits_before);
+    TEST_ESP_OK(app_config_get_stats(&stats));
+    TEST_ASSERT_EQUAL_UINT32(1, stats.batches);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.stored);
+
+    const app_config_backend_t *backend = app_config_mock_backend();
+    TEST_ESP_OK(backend->load(backend->ctx, "wx_refresh_s", APP_CONFIG_TYPE_U32, &stored, sizeof(stored)));
+    TEST_ASSERT_EQUAL_UINT32(refresh_s, stored);
+}
+
+TEST_CASE("config rejects a value out of range", "[config]")
+{
+    uint32_t stores_before, commits_before, stores_after, commits_after;
+    app_config_stats_t stats;
+
+    test_config_setup();
+    app_config_mock_get_counters(&stores_before, &commits_before);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_config_set_u32(APP_CONFIG_WEATHER_REFRESH_S, 24 * 3600 + 1));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, app_config_set_str(APP_CONFIG_TELEMETRY_BROKER, "http://broker.local"));
+    TEST_ASSERT_FALSE(xSemaphoreTake(s_applied, pdMS_TO_TICKS(CONFIG_APP_CONFIG_COMMIT_DELAY_MS * 3)));
+
+    app_config_mock_get_counters(&stores_after, &commits_after);
+    TEST_ASSERT_EQUAL_UINT32(0, stores_after - stores_before);
+    TEST_ASSERT_EQUAL_UINT32(0, commits_after - commits_before);
+    TEST_ESP_OK(app_config_get_stats(&stats));
+    TEST_ASSERT_EQUAL_UINT32(2, stats.rejected);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.sets);
+}
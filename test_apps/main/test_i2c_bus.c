@@ -0,0 +1,159 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "unity.h"
+#include "app_i2c_bus_mock.h"
+
+#define TEST_TOUCH_ADDR     (0x5d)
+#define TEST_SENSOR_ADDR    (0x44)
+#define TEST_TIMEOUT_MS     (100)
+#define TEST_LOG_LEN        (8)
+
+static uint8_t s_touch_regs[256];
+static uint8_t s_sensor_regs[16];
+static app_i2c_dev_handle_t s_touch;
+static app_i2c_dev_handle_t s_sensor;
+
+/* Transfers in the order the bus ran them; the gated one waits for `s_release` */
+static const app_i2c_xfer_t *s_log[TEST_LOG_LEN];
+static int s_log_len;
+static const app_i2c_xfer_t *s_gate;
+static SemaphoreHandle_t s_started;
+static SemaphoreHandle_t s_release;
+
+static esp_err_t test_transfer(void *ctx, void *dev, const app_i2c_xfer_t *xfer, int timeout_ms)
+{
+    if (s_log_len < TEST_LOG_LEN) {
+        s_log[s_log_len++] = xfer;
+    }
+    if (xfer == s_gate) {
+        xSemaphoreGive(s_started);
+        xSemaphoreTake(s_release, portMAX_DELAY);
+    }
+    return app_i2c_bus_mock_backend()->transfer(ctx, dev, xfer, timeout_ms);
+}
+
+/* Runs in the bus task, a failed request is noticed by the test timing out */
+static void test_done_cb(app_i2c_dev_handle_t dev, esp_err_t err, void *arg)
+{
+    if (err == ESP_OK) {
+        xSemaphoreGive((SemaphoreHandle_t)arg);
+    }
+}
+
+/* The bus has no deinit, so it is created once for every test */
+static void test_bus_setup(void)
+{
+    static app_i2c_backend_t backend;
+    app_i2c_bus_stats_t stats;
+
+    if (!s_touch) {
+        backend = *app_i2c_bus_mock_backend();
+        backend.transfer = test_transfer;
+        s_started = xSemaphoreCreateBinary();
+        s_release = xSemaphoreCreateBinary();
+        TEST_ASSERT_NOT_NULL(s_started);
+        TEST_ASSERT_NOT_NULL(s_release);
+        TEST_ESP_OK(app_i2c_bus_mock_add_device(TEST_TOUCH_ADDR, 2, s_touch_regs, sizeof(s_touch_regs)));
+        TEST_ESP_OK(app_i2c_bus_mock_add_device(TEST_SENSOR_ADDR, 1, s_sensor_regs, sizeof(s_sensor_regs)));
+        const app_i2c_bus_config_t config = {
+            .backend = &backend,
+        };
+        TEST_ESP_OK(app_i2c_bus_init(&config));
+        TEST_ESP_OK(app_i2c_bus_add_device(TEST_TOUCH_ADDR, 400000, APP_I2C_PRIO_TOUCH, &s_touch));
+        TEST_ESP_OK(app_i2c_bus_add_device(TEST_SENSOR_ADDR, 100000, APP_I2C_PRIO_SENSOR, &s_sensor));
+    }
+    s_log_len = 0;
+    s_gate = NULL;
+    app_i2c_bus_get_stats(&stats);
+}
+
+TEST_CASE("i2c bus reads back what was written through the mock", "[i2c_bus]")
+{
+    const uint8_t write[] = { 0x81, 0x4e, 0xaa, 0x55 };
+    const uint8_t reg[] = { 0x81, 0x4e };
+    uint8_t read[2] = { 0 };
+    uint32_t xfers_before, xfers_after;
+    uint64_t wire_before, wire_after;
+    app_i2c_bus_stats_t stats;
+
+    test_bus_setup();
+    app_i2c_bus_mock_get_counters(&xfers_before, &wire_before);
+    TEST_ESP_OK(app_i2c_write(s_touch, write, sizeof(write), TEST_TIMEOUT_MS));
+    TEST_ESP_OK(app_i2c_write_read(s_touch, reg, sizeof(reg), read, sizeof(read), TEST_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(&write[2], read, sizeof(read));
+
+    app_i2c_bus_mock_get_counters(&xfers_after, &wire_after);
+    TEST_ASSERT_EQUAL_UINT32(2, xfers_after - xfers_before);
+    TEST_ASSERT_TRUE(wire_after > wire_before);
+    app_i2c_bus_get_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.xfers[APP_I2C_PRIO_TOUCH]);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.errors);
+}
+
+TEST_CASE("i2c bus runs a touch read between two sensor transfers", "[i2c_bus]")
+{
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(2, 0);
+    const uint8_t sensor_reg = 0x00;
+    const uint8_t touch_reg[] = { 0x81, 0x4e };
+    uint8_t sensor_data[3][2];
+    uint8_t touch_data[1];
+    const app_i2c_xfer_t sensor_xfers[3] = {
+        { .tx = &sensor_reg, .tx_len = 1, .rx = sensor_data[0], .rx_len = 2 },
+        { .tx = &sensor_reg, .tx_len = 1, .rx = sensor_data[1], .rx_len = 2 },
+        { .tx = &sensor_reg, .tx_len = 1, .rx = sensor_data[2], .rx_len = 2 },
+    };
+    const app_i2c_xfer_t touch_xfer = {
+        .tx = touch_reg, .tx_len = sizeof(touch_reg), .rx = touch_data, .rx_len = sizeof(touch_data),
+    };
+    app_i2c_bus_stats_t stats;
+
+    TEST_ASSERT_NOT_NULL(done);
+    test_bus_setup();
+    /* Hold the first sensor transfer on the wire until the touch read is queued behind it */
+    s_gate = &sensor_xfers[0];
+    TEST_ESP_OK(app_i2c_submit(s_sensor, sensor_xfers, 3, test_done_cb, done, TEST_TIMEOUT_MS));
+    TEST_ASSERT_TRUE(xSemaphoreTake(s_started, pdMS_TO_TICKS(TEST_TIMEOUT_MS)));
+    TEST_ESP_OK(app_i2c_submit(s_touch, &touch_xfer, 1, test_done_cb, done, TEST_TIMEOUT_MS));
+    xSemaphoreGive(s_release);
+    TEST_ASSERT_TRUE(xSemaphoreTake(done, pdMS_TO_TICKS(TEST_TIMEOUT_MS)));
+    TEST_ASSERT_TRUE(xSemaphoreTake(done, pdMS_TO_TICKS(TEST_TIMEOUT_MS)));
+
+    TEST_ASSERT_EQUAL(4, s_log_len);
+    TEST_ASSERT_EQUAL_PTR(&sensor_xfers[0], s_log[0]);
+    TEST_ASSERT_EQUAL_PTR(&touch_xfer, s_log[1]);
+    TEST_ASSERT_EQUAL_PTR(&sensor_xfers[1], s_log[2]);
+    TEST_ASSERT_EQUAL_PTR(&sensor_xfers[2], s_log[3]);
+
+    app_i2c_bus_get_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.xfers[APP_I2C_PRIO_TOUCH]);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.xfers[APP_I2C_PRIO_SENSOR]);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.preemptions);
+    /* Everything after the first transfer ran without the bus task sleeping */
+    TEST_ASSERT_EQUAL_UINT32(3, stats.back_to_back);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.errors);
+    vSemaphoreDelete(done);
+}
+
+TEST_CASE("i2c bus reports a NACK and recovers", "[i2c_bus]")
+{
+    const uint8_t reg = 0x04;
+    const uint8_t write[] = { reg, 0x12, 0x34 };
+    uint8_t read[2] = { 0 };
+    app_i2c_bus_stats_t stats;
+
+    test_bus_setup();
+    TEST_ESP_OK(app_i2c_write(s_sensor, write, sizeof(write), TEST_TIMEOUT_MS));
+    app_i2c_bus_mock_fail_next(TEST_SENSOR_ADDR, 1);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, app_i2c_write_read(s_sensor, &reg, 1, read, sizeof(read), TEST_TIMEOUT_MS));
+    TEST_ESP_OK(app_i2c_write_read(s_sensor, &reg, 1, read, sizeof(read), TEST_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(&write[1], read, sizeof(read));
+
+    app_i2c_bus_get_stats(&stats);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.xfers[APP_I2C_PRIO_SENSOR]);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.errors);
+}
@@ -0,0 +1,106 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "unity.h"
+#include "app_sensor.h"
+
+#define TEST_SLOW_PERIOD_MS     (50)
+#define TEST_FAST_PERIOD_MS     (20)
+#define TEST_STALL_MS           (120)
+#define TEST_LOG_LEN            (4)
+/* How late both sensors are at least, with room for the tick rounding of the stall */
+#define TEST_LATE_US            ((TEST_STALL_MS - TEST_SLOW_PERIOD_MS) / 2 * 1000)
+
+/* Triggers in the order the scheduler ran them, recorded while `s_logging` is set */
+static app_sensor_handle_t s_log[TEST_LOG_LEN];
+static int s_log_len;
+static volatile bool s_logging;
+static volatile bool s_stall;
+static SemaphoreHandle_t s_stalled;
+static SemaphoreHandle_t s_release;
+static SemaphoreHandle_t s_logged;
+static app_sensor_handle_t s_slow;
+static app_sensor_handle_t s_fast;
+
+static esp_err_t test_trigger(void *ctx)
+{
+    if (s_logging && s_log_len < TEST_LOG_LEN) {
+        s_log[s_log_len++] = *(app_sensor_handle_t *)ctx;
+        xSemaphoreGive(s_logged);
+    }
+    return ESP_OK;
+}
+
+/* Holds the scheduler task once, so that the other sensors fall behind their deadlines */
+static esp_err_t test_stall_trigger(void *ctx)
+{
+    if (s_stall) {
+        s_stall = false;
+        xSemaphoreGive(s_stalled);
+        xSemaphoreTake(s_release, portMAX_DELAY);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t test_read(void *ctx, app_sensor_reading_t *reading)
+{
+    reading->quantity[0] = APP_SENSOR_TEMPERATURE;
+    reading->value[0] = 21.5f;
+    reading->channels = 1;
+    return ESP_OK;
+}
+
+static const app_sensor_driver_t s_slow_driver = {
+    .name = "slow", .period_ms = TEST_SLOW_PERIOD_MS, .trigger = test_trigger, .read = test_read, .ctx = &s_slow,
+};
+static const app_sensor_driver_t s_fast_driver = {
+    .name = "fast", .period_ms = TEST_FAST_PERIOD_MS, .trigger = test_trigger, .read = test_read, .ctx = &s_fast,
+};
+static const app_sensor_driver_t s_stall_driver = {
+    .name = "stall", .period_ms = 10000, .trigger = test_stall_trigger, .read = test_read,
+};
+
+TEST_CASE("sensor scheduler triggers overdue sensors in deadline order and counts the misses", "[sensor]")
+{
+    app_sensor_stats_t slow, fast;
+
+    s_stalled = xSemaphoreCreateBinary();
+    s_release = xSemaphoreCreateBinary();
+    s_logged = xSemaphoreCreateCounting(TEST_LOG_LEN, 0);
+    TEST_ASSERT_NOT_NULL(s_stalled);
+    TEST_ASSERT_NOT_NULL(s_release);
+    TEST_ASSERT_NOT_NULL(s_logged);
+
+    /* All three are due at once. The slow one comes first in the table, so scanning
+     * the table instead of comparing deadlines would trigger it first after the stall. */
+    s_stall = true;
+    TEST_ESP_OK(app_sensor_register(&s_slow_driver, &s_slow));
+    TEST_ESP_OK(app_sensor_register(&s_fast_driver, &s_fast));
+    TEST_ESP_OK(app_sensor_register(&s_stall_driver, NULL));
+    TEST_ESP_OK(app_sensor_scheduler_init(NULL, NULL));
+    TEST_ASSERT_TRUE(xSemaphoreTake(s_stalled, pdMS_TO_TICKS(100)));
+
+    /* Both sensors miss their next deadline, the fast one several times */
+    vTaskDelay(pdMS_TO_TICKS(TEST_STALL_MS));
+    s_logging = true;
+    xSemaphoreGive(s_release);
+    TEST_ASSERT_TRUE(xSemaphoreTake(s_logged, pdMS_TO_TICKS(100)));
+    TEST_ASSERT_TRUE(xSemaphoreTake(s_logged, pdMS_TO_TICKS(100)));
+    s_logging = false;
+
+    TEST_ASSERT_EQUAL_PTR(s_fast, s_log[0]);
+    TEST_ASSERT_EQUAL_PTR(s_slow, s_log[1]);
+
+    TEST_ESP_OK(app_sensor_get_stats(s_slow, &slow));
+    TEST_ESP_OK(app_sensor_get_stats(s_fast, &fast));
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(1, slow.overruns);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(TEST_STALL_MS / TEST_FAST_PERIOD_MS - 2, fast.overruns);
+    /* The late triggers are measured against the deadline they missed */
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(TEST_LATE_US, slow.jitter_max_us);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(TEST_LATE_US, fast.jitter_max_us);
+    TEST_ASSERT_EQUAL_UINT32(0, slow.errors + fast.errors);
+}
@@ -0,0 +1,176 @@
+const fs = require('fs');
+
+// 用法: node trace_to_chrome.js <monitor 日志> [输出 .json]
+// 日志来自 CONFIG_APP_TRACE=y 的固件执行 "trace" 命令的输出, 结果可用 chrome://tracing 或 ui.perfetto.dev 打开
+const logPath = process.argv[2];
+
+if (!logPath) {
+    console.error('用法: node trace_to_chrome.js <monitor 日志> [输出 .json]');
+    process.exit(1);
+}
+
+const outputPath = process.argv[3] || logPath.replace(/\.[^./\\]*$/, '') + '.trace.json';
+
+// 与 app_trace.c 中的 trace_event_t 保持一致
+const EVENT_SIZE = 16;
+const PHASES = ['B', 'E', 'i', 'C'];
+const SYNC_ID = 0;
+
+// 读取 "trace: begin" 和 "trace: end" 之间最后一段数据
+function parseLog(text) {
+    let dump = null;
+    let current = null;
+    for (const line of text.split(/\r?\n/)) {
+        let m = line.match(/trace: begin cores=(\d+) cpu_mhz=(\d+) event_size=(\d+)/);
+        if (m) {
+            current = { cores: parseInt(m[1], 10), mhz: parseInt(m[2], 10), names: new Map(), tasks: new Map(), data: [] };
+            if (parseInt(m[3], 10) !== EVENT_SIZE) {
+                console.error(`事件大小 ${m[3]} 与本工具 (${EVENT_SIZE}) 不一致`);
+                process.exit(1);
+            }
+            continue;
+        }
+        if (!current) {
+            continue;
+        }
+        if (line.includes('trace: end')) {
+            dump = current;
+            current = null;
+            continue;
+        }
+        m = line.match(/trace: name (\d+) (\S+)/);
+        if (m) {
+            current.names.set(parseInt(m[1], 10), m[2]);
+            continue;
+        }
+        m = line.match(/trace: task ([0-9a-f]{8}) (.+)/);
+        if (m) {
+            current.tasks.set(parseInt(m[1], 16), m[2].trim());
+            continue;
+        }
+        m = line.match(/trace: data (\d+) ([0-9a-f]+)/);
+        if (m) {
+            const core = parseInt(m[1], 10);
+            current.data[core] = (current.data[core] || '') + m[2];
+        }
+    }
+    return dump;
+}
+
+function decodeEvents(hex) {
+    const buf = Buffer.from(hex || '', 'hex');
+    const events = [];
+    for (let off = 0; off + EVENT_SIZE <= buf.length; off += EVENT_SIZE) {
+        events.push({
+            cycles: buf.readUInt32LE(off),
+            id: buf.readUInt16LE(off + 4),      // tag 的低 16 位
+            phase: buf.readUInt8(off + 6),      // tag 的 16..23 位
+            payload: buf.readUInt32LE(off + 8),
+            task: buf.readUInt32LE(off + 12),
+        });
+    }
+    return events;
+}
+
+// 每个核的周期计数器独立且约 18 秒回绕一次, 按顺序展开成 64 位,
+// 再用每秒一次的 sync 事件 (携带 esp_timer 微秒数) 换算到统一时间轴
+function toMicroseconds(events, mhz) {
+    let wrap = 0;
+    let prev = null;
+    for (const ev of events) {
+        if (prev !== null && ev.cycles < prev) {
+            wrap += 0x100000000;
+        }
+        prev = ev.cycles;
+        ev.cycles += wrap;
+    }
+
+    const syncs = [];
+    let usWrap = 0;
+    let prevUs = null;
+    for (const ev of events) {
+        if (ev.id !== SYNC_ID) {
+            continue;
+        }
+        if (prevUs !== null && ev.payload < prevUs) {
+            usWrap += 0x100000000;
+        }
+        prevUs = ev.payload;
+        syncs.push({ cycles: ev.cycles, us: ev.payload + usWrap });
+    }
+    if (syncs.length === 0 && events.length > 0) {
+        console.warn('没有 sync 事件, 各核时间无法对齐');
+    }
+
+    let s = 0;
+    for (const ev of events) {
+        while (s + 1 < syncs.length && syncs[s + 1].cycles <= ev.cycles) {
+            s++;
+        }
+        const ref = syncs[s] || { cycles: 0, us: 0 };
+        ev.ts = ref.us + (ev.cycles - ref.cycles) / mhz;
+    }
+}
+
+function eventArgs(name, ev) {
+    if (name === 'i2c_xfer' && ev.phase === 0) {
+        return {
+            addr: '0x' + (ev.payload & 0xff).toString(16),
+            prio: (ev.payload >> 8) & 0xff,
+            len: ev.payload >>> 16,
+        };
+    }
+    if (PHASES[ev.phase] === 'C') {
+        return { value: ev.payload };
+    }
+    return { payload: ev.payload };
+}
+
+const dump = parseLog(fs.readFileSync(logPath, 'utf8'));
+if (!dump) {
+    console.error('日志中没有完整的 "trace: begin" ... "trace: end"');
+    process.exit(1);
+}
+
+const traceEvents = [{ name: 'process_name', ph: 'M', pid: 0, args: { name: 'esp32' } }];
+const all = [];
+for (let core = 0; core < dump.cores; core++) {
+    const events = decodeEvents(dump.data[core]);
+    toMicroseconds(events, dump.mhz);
+    for (const ev of events) {
+        if (ev.id !== SYNC_ID) {
+            all.push({ ...ev, core });
+        }
+    }
+    console.log(`核 ${core}: ${events.length} 个事件`);
+}
+
+// 每个任务一条线: B/E 只在同一任务内成对嵌套, 任务在两个核之间迁移时也不会错位
+const tids = new Map();
+for (const ev of all) {
+    if (!tids.has(ev.task)) {
+        tids.set(ev.task, tids.size);
+        const name = dump.tasks.get(ev.task) || `task ${ev.task.toString(16).padStart(8, '0')}`;
+        traceEvents.push({ name: 'thread_name', ph: 'M', pid: 0, tid: tids.get(ev.task), args: { name } });
+    }
+}
+
+const t0 = Math.min(...all.map((ev) => ev.ts));
+for (const ev of all) {
+    const name = dump.names.get(ev.id) || `id_${ev.id}`;
+    const out = {
+        name,
+        ph: PHASES[ev.phase] || 'i',
+        ts: Number((ev.ts - t0).toFixed(3)),
+        pid: 0,
+        tid: tids.get(ev.task),
+        args: { ...eventArgs(name, ev), core: ev.core },
+    };
+    if (out.ph === 'i') {
+        out.s = 't';
+    }
+    traceEvents.push(out);
+}
+
+fs.writeFileSync(outputPath, JSON.stringify({ traceEvents, displayTimeUnit: 'ms' }), 'utf8');
+console.log(`已生成 ${outputPath}`);
@@ -0,0 +1,104 @@
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const http = require('http');
+const https = require('https');
+const { execFileSync } = require('child_process');
+
+// 用法: node weather_standin.js [--port 8443] [--http] [--latency 毫秒]
+// 本地天气服务替身, 用于测试设备的 HTTP 连接池: 支持 keep-alive 和 TLS 会话票据,
+// 每个新连接和每次 TLS 握手都会打印出来, 方便 pytest 统计握手次数和会话复用
+const args = process.argv.slice(2);
+function option(name, fallback) {
+    const i = args.indexOf(name);
+    return i >= 0 && i + 1 < args.length ? args[i + 1] : fallback;
+}
+const useHttp = args.includes('--http');
+const port = parseInt(option('--port', useHttp ? '8080' : '8443'), 10);
+const latencyMs = parseInt(option('--latency', '0'), 10);
+
+const stats = { connections: 0, handshakes: 0, resumed: 0, requests: 0 };
+
+// 自签名证书只在第一次运行时用 openssl 生成, 设备端用 CONFIG_ESP_TLS_SKIP_SERVER_CERT_VERIFY 跳过校验
+function loadCert() {
+    const dir = path.join(os.tmpdir(), 'weather_standin');
+    const keyPath = path.join(dir, 'key.pem');
+    const certPath = path.join(dir, 'cert.pem');
+    if (!fs.existsSync(certPath)) {
+        fs.mkdirSync(dir, { recursive: true });
+        execFileSync('openssl', ['req', '-x509', '-newkey', 'ec', '-pkeyopt', 'ec_paramgen_curve:prime256v1',
+            '-nodes', '-days', '365', '-subj', '/CN=weather-standin', '-keyout', keyPath, '-out', certPath],
+        { stdio: 'ignore' });
+    }
+    return { key: fs.readFileSync(keyPath), cert: fs.readFileSync(certPath) };
+}
+
+// 与 d1.weather.com.cn/sk_2d/<城市代码>.html 相同的格式, 数值由城市代码决定, 每次请求略有变化
+function weatherBody(code) {
+    const seed = [...code].reduce((sum, ch) => sum + ch.charCodeAt(0), 0);
+    const temp = (seed % 30) + (stats.requests % 10) / 10;
+    const data = {
+        nameen: `city${code.slice(-3)}`,
+        cityname: `City ${code.slice(-3)}`,
+        city: code,
+        temp: temp.toFixed(1),
+        tempf: (temp * 9 / 5 + 32).toFixed(1),
+        WD: '东北风',
+        WS: '2级',
+        SD: `${40 + (seed % 50)}%`,
+        weather: '多云',
+        weathere: 'Cloudy',
+        weathercode: `d0${seed % 10}`,
+        time: new Date().toTimeString().slice(0, 5),
+        date: new Date().toISOString().slice(0, 10),
+    };
+    return `var dataSK=${JSON.stringify(data)}`;
+}
+
+function handler(req, res) {
+    stats.requests++;
+    const url = new URL(req.url, 'http://standin');
+    const delay = latencyMs + parseInt(url.searchParams.get('delay_ms') || '0', 10);
+    const m = url.pathname.match(/^\/sk_2d\/(\d+)\.html$/);
+
+    setTimeout(() => {
+        if (url.pathname === '/stats') {
+            const body = JSON.stringify(stats);
+            res.writeHead(200, { 'Content-Type': 'application/json', 'Content-Length': Buffer.byteLength(body) });
+            res.end(body);
+        } else if (m) {
+            const body = weatherBody(m[1]);
+            if (url.searchParams.has('chunked')) {
+                // 不带 Content-Length, 按分块编码发送
+                res.writeHead(200, { 'Content-Type': 'text/html; charset=utf-8' });
+                const half = Math.floor(body.length / 2);
+                res.write(body.slice(0, half));
+                res.end(body.slice(half));
+            } else {
+                res.writeHead(200, { 'Content-Type': 'text/html; charset=utf-8', 'Content-Length': Buffer.byteLength(body) });
+                res.end(body);
+            }
+        } else {
+            res.writeHead(404, { 'Content-Length': 0 });
+            res.end();
+        }
+        console.log(`standin: ${req.method} ${req.url} ${res.statusCode} delay=${delay}ms`);
+    }, delay);
+}
+
+const server = useHttp ? http.createServer(handler) : https.createServer(loadCert(), handler);
+server.keepAliveTimeout = 120000;
+server.headersTimeout = 125000;
+server.on('connection', () => {
+    stats.connections++;
+    console.log(`standin: connection ${stats.connections}`);
+});
+server.on('secureConnection', (socket) => {
+    stats.handshakes++;
+    const resumed = socket.isSessionReused();
+    stats.resumed += resumed ? 1 : 0;
+    console.log(`standin: handshake ${stats.handshakes} resumed=${resumed ? 1 : 0} ${socket.getProtocol()}`);
+});
+server.listen(port, () => {
+    console.log(`standin: listening on ${useHttp ? 'http' : 'https'}://0.0.0.0:${port} latency=${latencyMs}ms`);
+});